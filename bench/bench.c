@@ -0,0 +1,751 @@
+/*
+ * Copyright (C) 2025 Rhys Weatherley
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Benchmark harness for the interpreter.  Runs each workload in a
+ * manifest several times, reports the median wall-clock time, the
+ * number of statements executed per second, and the peak resident set
+ * size, and compares the results against a stored baseline.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <getopt.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#define short_options "x:n:s:b:S:t:w:O:B:"
+static struct option long_options[] = {
+    {"interpreter", required_argument,  0,  'x'},
+    {"runs",        required_argument,  0,  'n'},
+    {"seed",        required_argument,  0,  's'},
+    {"baseline",    required_argument,  0,  'b'},
+    {"save",        required_argument,  0,  'S'},
+    {"tolerance",   required_argument,  0,  't'},
+    {"workload",    required_argument,  0,  'w'},
+    {"optimise",    required_argument,  0,  'O'},
+    {"build-type",  required_argument,  0,  'B'},
+    {0,             0,                  0,  0},
+};
+
+static void usage(const char *progname)
+{
+    fprintf(stderr, "Usage: %s --interpreter PATH [options] MANIFEST\n\n", progname);
+
+    fprintf(stderr, "--interpreter PATH, -x PATH\n");
+    fprintf(stderr, "    Path to the interprogram executable to benchmark.\n\n");
+
+    fprintf(stderr, "--runs N, -n N\n");
+    fprintf(stderr, "    Number of times to run each workload (default is 5).\n\n");
+
+    fprintf(stderr, "--seed N, -s N\n");
+    fprintf(stderr, "    Random number seed to pass to each workload (default is 1).\n\n");
+
+    fprintf(stderr, "--baseline FILE, -b FILE\n");
+    fprintf(stderr, "    Compare the results against a baseline JSON file and fail if\n");
+    fprintf(stderr, "    any workload is slower than the tolerance allows.\n\n");
+
+    fprintf(stderr, "--save FILE, -S FILE\n");
+    fprintf(stderr, "    Save the results to FILE as a new baseline.\n\n");
+
+    fprintf(stderr, "--tolerance PCT, -t PCT\n");
+    fprintf(stderr, "    Percentage slowdown that is allowed before a workload is\n");
+    fprintf(stderr, "    reported as a regression (default is 10).\n\n");
+
+    fprintf(stderr, "--workload NAME, -w NAME\n");
+    fprintf(stderr, "    Only run the named workload from the manifest.\n\n");
+
+    fprintf(stderr, "--optimise LEVEL, -O LEVEL\n");
+    fprintf(stderr, "    Optimisation level to pass to the interpreter (default is 0).\n\n");
+
+    fprintf(stderr, "--build-type TYPE, -B TYPE\n");
+    fprintf(stderr, "    CMake build type of the interpreter; e.g. \"Release\".  This is\n");
+    fprintf(stderr, "    recorded in saved baselines, and regressions are not reported\n");
+    fprintf(stderr, "    against a baseline from a different build type.\n\n");
+}
+
+/**
+ * @brief Information about a workload and its results.
+ */
+typedef struct
+{
+    /** Name of the workload */
+    char *name;
+
+    /** Path to the program for the workload */
+    char *program;
+
+    /** Path to the input file, or NULL for no input */
+    char *input;
+
+    /** Number of blocks to generate for the input, or zero */
+    unsigned long tape_blocks;
+
+    /** Median wall-clock time in seconds */
+    double median;
+
+    /** Number of statements that the workload executes */
+    uint64_t statements;
+
+    /** Peak resident set size in kilobytes */
+    long peak_rss;
+
+} workload_t;
+
+/**
+ * @brief Extracts the next whitespace-separated word from a manifest line.
+ *
+ * @param[in,out] line Points to the current position in the line.
+ *
+ * @return The word, or NULL if there are no more words on the line.
+ */
+static char *next_word(char **line)
+{
+    char *word = *line;
+    while (*word == ' ' || *word == '\t' || *word == '\r' || *word == '\n') {
+        ++word;
+    }
+    if (*word == '\0') {
+        *line = word;
+        return 0;
+    }
+    *line = word;
+    while (**line != '\0' && **line != ' ' && **line != '\t' &&
+           **line != '\r' && **line != '\n') {
+        ++(*line);
+    }
+    if (**line != '\0') {
+        **line = '\0';
+        ++(*line);
+    }
+    return word;
+}
+
+/**
+ * @brief Resolves a path relative to the manifest's directory.
+ *
+ * @param[in] dir Directory containing the manifest, including the
+ * trailing '/', or the empty string for the current directory.
+ * @param[in] word The path from the manifest.
+ *
+ * @return The resolved path, which must be freed by the caller.
+ */
+static char *resolve_path(const char *dir, const char *word)
+{
+    char *path;
+    if (word[0] == '/') {
+        dir = "";
+    }
+    path = malloc(strlen(dir) + strlen(word) + 1);
+    if (!path) {
+        perror("malloc");
+        exit(1);
+    }
+    strcpy(path, dir);
+    strcat(path, word);
+    return path;
+}
+
+/**
+ * @brief Reads the workloads from a manifest file.
+ *
+ * @param[in] manifest Name of the manifest file.
+ * @param[in] only Name of the only workload to read, or NULL for all.
+ * @param[out] num_workloads Returns the number of workloads.
+ *
+ * @return The array of workloads, or NULL on error.
+ */
+static workload_t *read_manifest
+    (const char *manifest, const char *only, size_t *num_workloads)
+{
+    FILE *file;
+    char *dir;
+    const char *slash;
+    char *line = 0;
+    size_t line_size = 0;
+    size_t max_workloads = 0;
+    workload_t *workloads = 0;
+    workload_t *workload;
+    char *posn;
+    char *name;
+    char *program;
+    char *input;
+
+    /* Open the manifest and find the directory that it is in */
+    *num_workloads = 0;
+    file = fopen(manifest, "r");
+    if (!file) {
+        perror(manifest);
+        return 0;
+    }
+    slash = strrchr(manifest, '/');
+    dir = strdup(manifest);
+    if (!dir) {
+        perror("strdup");
+        exit(1);
+    }
+    dir[slash ? (size_t)(slash - manifest + 1) : 0] = '\0';
+
+    /* Read the workloads */
+    while (getline(&line, &line_size, file) >= 0) {
+        posn = line;
+        name = next_word(&posn);
+        if (!name || name[0] == '#') {
+            continue;
+        }
+        program = next_word(&posn);
+        if (!program) {
+            fprintf(stderr, "%s: no program for workload '%s'\n",
+                    manifest, name);
+            continue;
+        }
+        if (only && strcmp(name, only) != 0) {
+            continue;
+        }
+        input = next_word(&posn);
+        if (*num_workloads >= max_workloads) {
+            max_workloads = max_workloads ? max_workloads * 2 : 16;
+            workloads = realloc
+                (workloads, max_workloads * sizeof(workload_t));
+            if (!workloads) {
+                perror("realloc");
+                exit(1);
+            }
+        }
+        workload = &(workloads[*num_workloads]);
+        memset(workload, 0, sizeof(workload_t));
+        workload->name = strdup(name);
+        workload->program = resolve_path(dir, program);
+        if (input && input[0] == '@') {
+            workload->tape_blocks = strtoul(input + 1, 0, 0);
+        } else if (input) {
+            workload->input = resolve_path(dir, input);
+        }
+        ++(*num_workloads);
+    }
+
+    /* Clean up */
+    free(line);
+    free(dir);
+    fclose(file);
+    return workloads;
+}
+
+/**
+ * @brief Generates a tape of input data for a workload.
+ *
+ * @param[in] blocks Number of pairs of blocks to generate.
+ *
+ * @return The name of the temporary file that contains the tape.
+ *
+ * The first line of the tape is the number of pairs of blocks.
+ * Each block is a few lines of text followed by "~~~~~".
+ */
+static char *generate_tape(unsigned long blocks)
+{
+    char template[] = "/tmp/interprogram-bench-XXXXXX";
+    unsigned long block, line;
+    FILE *file;
+    int fd;
+
+    fd = mkstemp(template);
+    if (fd < 0 || (file = fdopen(fd, "w")) == 0) {
+        perror(template);
+        exit(1);
+    }
+    fprintf(file, "%lu\n", blocks);
+    for (block = 0; block < blocks * 2; ++block) {
+        for (line = 0; line < 8; ++line) {
+            fprintf(file, "BLOCK %lu LINE %lu: THE QUICK BROWN FOX "
+                          "JUMPS OVER THE LAZY DOG\n", block, line);
+        }
+        fprintf(file, "~~~~~\n");
+    }
+    fclose(file);
+    return strdup(template);
+}
+
+/**
+ * @brief Runs the interpreter once on a workload.
+ *
+ * @param[in] workload The workload.
+ * @param[in] argv Arguments for the interpreter, terminated by NULL.
+ * @param[out] elapsed Returns the elapsed wall-clock time in seconds.
+ * @param[out] max_rss Returns the peak resident set size in kilobytes.
+ *
+ * @return Non-zero if the interpreter ran successfully, zero if not.
+ */
+static int run_once
+    (const workload_t *workload, char **argv, double *elapsed, long *max_rss)
+{
+    struct timespec start, end;
+    struct rusage usage;
+    pid_t pid;
+    int status;
+    int fd;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return 0;
+    } else if (pid == 0) {
+        /* Redirect the input and output of the child and run it */
+        fd = open(workload->input ? workload->input : "/dev/null", O_RDONLY);
+        if (fd < 0) {
+            perror(workload->input);
+            _exit(127);
+        }
+        dup2(fd, 0);
+        close(fd);
+        fd = open("/dev/null", O_WRONLY);
+        if (fd >= 0) {
+            dup2(fd, 1);
+            close(fd);
+        }
+        execv(argv[0], argv);
+        perror(argv[0]);
+        _exit(127);
+    }
+    if (wait4(pid, &status, 0, &usage) < 0) {
+        perror("wait4");
+        return 0;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    *elapsed = (double)(end.tv_sec - start.tv_sec) +
+               ((double)(end.tv_nsec - start.tv_nsec)) / 1000000000.0;
+    *max_rss = usage.ru_maxrss;
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "%s: workload failed\n", workload->name);
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief Counts the number of statements that a workload executes.
+ *
+ * @param[in] workload The workload.
+ * @param[in] interpreter Path to the interpreter.
+ * @param[in] seed Random number seed argument for the interpreter.
+ * @param[in] optimise Optimisation level argument for the interpreter.
+ *
+ * @return The number of statements, or zero if it could not be determined.
+ *
+ * The workloads are deterministic for a fixed seed, so the count from
+ * a single profiled run applies to all of the timed runs.
+ */
+static uint64_t count_statements
+    (const workload_t *workload, const char *interpreter, const char *seed,
+     const char *optimise)
+{
+    char template[] = "/tmp/interprogram-profile-XXXXXX";
+    char profile_arg[64];
+    char *argv[8];
+    char *line = 0;
+    size_t line_size = 0;
+    uint64_t count = 0;
+    const char *posn;
+    double elapsed;
+    long max_rss;
+    FILE *file;
+    int fd;
+
+    fd = mkstemp(template);
+    if (fd < 0) {
+        perror(template);
+        return 0;
+    }
+    close(fd);
+    snprintf(profile_arg, sizeof(profile_arg), "--profile=%s", template);
+    argv[0] = (char *)interpreter;
+    argv[1] = "--seed";
+    argv[2] = (char *)seed;
+    argv[3] = "--optimise";
+    argv[4] = (char *)optimise;
+    argv[5] = profile_arg;
+    argv[6] = workload->program;
+    argv[7] = 0;
+    if (run_once(workload, argv, &elapsed, &max_rss)) {
+        /* First line is "Profile of NAME: N statements, M cycles" */
+        file = fopen(template, "r");
+        if (file) {
+            if (getline(&line, &line_size, file) >= 0) {
+                posn = strstr(line, " statements, ");
+                if (posn) {
+                    while (posn > line && posn[-1] >= '0' && posn[-1] <= '9') {
+                        --posn;
+                    }
+                    count = strtoull(posn, 0, 10);
+                }
+            }
+            free(line);
+            fclose(file);
+        }
+    }
+    unlink(template);
+    return count;
+}
+
+/**
+ * @brief Compares two times for sorting.
+ *
+ * @param[in] e1 Points to the first time.
+ * @param[in] e2 Points to the second time.
+ *
+ * @return Comparison result for qsort().
+ */
+static int compare_times(const void *e1, const void *e2)
+{
+    double t1 = *((const double *)e1);
+    double t2 = *((const double *)e2);
+    return (t1 > t2) - (t1 < t2);
+}
+
+/**
+ * @brief Runs a workload several times and records the results.
+ *
+ * @param[in,out] workload The workload.
+ * @param[in] interpreter Path to the interpreter.
+ * @param[in] seed Random number seed argument for the interpreter.
+ * @param[in] optimise Optimisation level argument for the interpreter.
+ * @param[in] runs Number of times to run the workload.
+ *
+ * @return Non-zero if all runs succeeded, zero if not.
+ */
+static int run_workload
+    (workload_t *workload, const char *interpreter, const char *seed,
+     const char *optimise, int runs)
+{
+    char *argv[7];
+    double *times;
+    long max_rss;
+    int run;
+    int ok = 1;
+
+    times = calloc((size_t)runs, sizeof(double));
+    if (!times) {
+        perror("calloc");
+        exit(1);
+    }
+    workload->statements =
+        count_statements(workload, interpreter, seed, optimise);
+    argv[0] = (char *)interpreter;
+    argv[1] = "--seed";
+    argv[2] = (char *)seed;
+    argv[3] = "--optimise";
+    argv[4] = (char *)optimise;
+    argv[5] = workload->program;
+    argv[6] = 0;
+    for (run = 0; run < runs && ok; ++run) {
+        ok = run_once(workload, argv, &(times[run]), &max_rss);
+        if (max_rss > workload->peak_rss) {
+            workload->peak_rss = max_rss;
+        }
+    }
+    if (ok) {
+        qsort(times, (size_t)runs, sizeof(double), compare_times);
+        if (runs % 2) {
+            workload->median = times[runs / 2];
+        } else {
+            workload->median = (times[runs / 2 - 1] + times[runs / 2]) / 2.0;
+        }
+    }
+    free(times);
+    return ok;
+}
+
+/**
+ * @brief Reads an entire file into memory.
+ *
+ * @param[in] filename Name of the file.
+ *
+ * @return The NUL-terminated contents of the file, or NULL on error.
+ */
+static char *read_file(const char *filename)
+{
+    FILE *file;
+    char *data = 0;
+    size_t len = 0;
+    size_t size = 0;
+    size_t n;
+
+    file = fopen(filename, "r");
+    if (!file) {
+        perror(filename);
+        return 0;
+    }
+    do {
+        if ((size - len) < 1024) {
+            size += 4096;
+            data = realloc(data, size);
+            if (!data) {
+                perror("realloc");
+                exit(1);
+            }
+        }
+        n = fread(data + len, 1, size - len - 1, file);
+        len += n;
+    } while (n > 0);
+    data[len] = '\0';
+    fclose(file);
+    return data;
+}
+
+/**
+ * @brief Finds a numeric field for a workload in a baseline JSON file.
+ *
+ * @param[in] json The contents of the baseline file.
+ * @param[in] name The name of the workload.
+ * @param[in] field The name of the field.
+ * @param[out] value Returns the value of the field.
+ *
+ * @return Non-zero if the field was found, zero if not.
+ *
+ * This only understands the simple layout that save_baseline() writes:
+ * an object of workloads, each of which is an object of numbers.
+ */
+static int find_baseline
+    (const char *json, const char *name, const char *field, double *value)
+{
+    char key[256];
+    const char *posn;
+    const char *end;
+    snprintf(key, sizeof(key), "\"%s\"", name);
+    posn = strstr(json, key);
+    if (!posn) {
+        return 0;
+    }
+    end = strchr(posn, '}');
+    snprintf(key, sizeof(key), "\"%s\"", field);
+    posn = strstr(posn, key);
+    if (!posn || (end && posn > end)) {
+        return 0;
+    }
+    posn = strchr(posn + strlen(key), ':');
+    if (!posn) {
+        return 0;
+    }
+    *value = strtod(posn + 1, 0);
+    return 1;
+}
+
+/**
+ * @brief Finds the build type that a baseline JSON file was measured with.
+ *
+ * @param[in] json The contents of the baseline file.
+ * @param[out] build_type Returns the build type.
+ * @param[in] size The size of the @a build_type buffer.
+ *
+ * @return Non-zero if the build type was found, zero if not.
+ */
+static int find_build_type(const char *json, char *build_type, size_t size)
+{
+    const char *posn;
+    const char *end;
+    posn = strstr(json, "\"build_type\"");
+    if (!posn) {
+        return 0;
+    }
+    posn = strchr(posn + 12, ':');
+    if (posn) {
+        posn = strchr(posn, '"');
+    }
+    end = posn ? strchr(posn + 1, '"') : 0;
+    if (!end || (size_t)(end - posn) > size) {
+        return 0;
+    }
+    memcpy(build_type, posn + 1, (size_t)(end - posn - 1));
+    build_type[end - posn - 1] = '\0';
+    return 1;
+}
+
+/**
+ * @brief Saves the results as a baseline JSON file.
+ *
+ * @param[in] filename Name of the file to save to.
+ * @param[in] build_type The build type of the interpreter.
+ * @param[in] workloads The workloads.
+ * @param[in] num_workloads The number of workloads.
+ *
+ * @return Non-zero if the file was saved, zero on error.
+ */
+static int save_baseline
+    (const char *filename, const char *build_type,
+     const workload_t *workloads, size_t num_workloads)
+{
+    FILE *file;
+    size_t index;
+    file = fopen(filename, "w");
+    if (!file) {
+        perror(filename);
+        return 0;
+    }
+    fprintf(file, "{\n");
+    fprintf(file, "    \"build_type\": \"%s\",\n", build_type);
+    for (index = 0; index < num_workloads; ++index) {
+        fprintf(file, "    \"%s\": {\"median\": %.6f, \"statements\": %"
+                      PRIu64 ", \"peak_rss\": %ld}%s\n",
+                workloads[index].name, workloads[index].median,
+                workloads[index].statements, workloads[index].peak_rss,
+                index < (num_workloads - 1) ? "," : "");
+    }
+    fprintf(file, "}\n");
+    fclose(file);
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    const char *progname = argv[0];
+    const char *interpreter = 0;
+    const char *seed = "1";
+    const char *baseline_filename = 0;
+    const char *save_filename = 0;
+    const char *only = 0;
+    const char *optimise = "0";
+    const char *build_type = "";
+    char base_build_type[64];
+    int compare = 1;
+    double tolerance = 10.0;
+    int runs = 5;
+    workload_t *workloads;
+    workload_t *workload;
+    size_t num_workloads;
+    size_t index;
+    char *baseline = 0;
+    double base_median;
+    double base_statements;
+    double change;
+    int opt, option_index;
+    int failed = 0;
+    int exitval = 0;
+
+    /* Parse the command-line options */
+    while ((opt = getopt_long(argc, argv, short_options, long_options,
+                              &option_index)) >= 0) {
+        switch (opt) {
+        case 'x': interpreter = optarg; break;
+        case 'n': runs = atoi(optarg); break;
+        case 's': seed = optarg; break;
+        case 'b': baseline_filename = optarg; break;
+        case 'S': save_filename = optarg; break;
+        case 't': tolerance = atof(optarg); break;
+        case 'w': only = optarg; break;
+        case 'O': optimise = optarg; break;
+        case 'B': build_type = optarg; break;
+        default:
+            usage(progname);
+            return 1;
+        }
+    }
+    if (!interpreter || optind >= argc || runs < 1) {
+        usage(progname);
+        return 1;
+    }
+
+    /* Read the workloads and the baseline */
+    workloads = read_manifest(argv[optind], only, &num_workloads);
+    if (!workloads) {
+        return 1;
+    }
+    if (baseline_filename) {
+        baseline = read_file(baseline_filename);
+    }
+
+    /* Timings from different build types cannot be compared */
+    if (baseline && find_build_type(baseline, base_build_type,
+                                    sizeof(base_build_type)) &&
+            strcmp(base_build_type, build_type) != 0) {
+        printf("Baseline was measured with a \"%s\" build, but this is a "
+               "\"%s\" build;\nregressions will not be reported.\n\n",
+               base_build_type, build_type);
+        compare = 0;
+    }
+
+    /* Run the workloads and report the results */
+    printf("%-12s %12s %14s %14s %14s %10s\n",
+           "Workload", "Median (s)", "Statements", "Statements/s",
+           "Peak RSS (KB)", "Baseline");
+    for (index = 0; index < num_workloads; ++index) {
+        workload = &(workloads[index]);
+        if (workload->tape_blocks) {
+            workload->input = generate_tape(workload->tape_blocks);
+        }
+        if (!run_workload(workload, interpreter, seed, optimise, runs)) {
+            failed = 1;
+            exitval = 1;
+        } else {
+            printf("%-12s %12.4f %14" PRIu64 " %14.0f %14ld",
+                   workload->name, workload->median, workload->statements,
+                   workload->median > 0 ?
+                        (double)(workload->statements) / workload->median : 0,
+                   workload->peak_rss);
+            if (baseline && find_baseline(baseline, workload->name, "median",
+                                          &base_median) && base_median > 0) {
+                change = 100.0 * (workload->median - base_median) / base_median;
+                printf(" %+9.1f%%", change);
+                if (change > tolerance && compare) {
+                    printf("  REGRESSION");
+                    exitval = 1;
+                }
+                if (find_baseline(baseline, workload->name, "statements",
+                                  &base_statements) &&
+                        (uint64_t)base_statements != workload->statements) {
+                    printf("  (statement count changed)");
+                }
+            } else if (baseline) {
+                printf(" %10s", "new");
+            }
+            printf("\n");
+        }
+        fflush(stdout);
+        if (workload->tape_blocks) {
+            unlink(workload->input);
+        }
+    }
+
+    /* Save the results as the new baseline if requested */
+    if (save_filename && !failed) {
+        if (!save_baseline
+                (save_filename, build_type, workloads, num_workloads)) {
+            exitval = 1;
+        }
+    }
+
+    /* Clean up and exit */
+    for (index = 0; index < num_workloads; ++index) {
+        free(workloads[index].name);
+        free(workloads[index].program);
+        free(workloads[index].input);
+    }
+    free(workloads);
+    free(baseline);
+    return exitval;
+}
@@ -0,0 +1,456 @@
+/*
+ * Copyright (C) 2025 Rhys Weatherley
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Micro-benchmarks for the core primitives of the interpreter: the
+ * tokeniser, keyword lookup, symbol tables, strings, values, and the
+ * start-up cost of parsing a small program with the built-in library.
+ * Each benchmark is run on synthetic inputs of growing size, and the
+ * results are written to standard output in JSON Lines format, one
+ * object per benchmark and size.
+ */
+
+#include "ip_token.h"
+#include "ip_parser.h"
+#include "ip_math_lib.h"
+#include "ip_string_lib.h"
+#include "ip_symbols.h"
+#include "ip_string.h"
+#include "ip_value.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ * @brief Gets the current time in seconds from the monotonic clock.
+ *
+ * @return The current time.
+ */
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)(ts.tv_sec) + ((double)(ts.tv_nsec)) / 1000000000.0;
+}
+
+/**
+ * @brief Reports the result of a benchmark.
+ *
+ * @param[in] name Name of the benchmark.
+ * @param[in] size Size of the synthetic input.
+ * @param[in] ops Number of operations that were performed.
+ * @param[in] seconds Elapsed time for all operations.
+ * @param[in] bytes Number of bytes processed, or zero if not relevant.
+ */
+static void report(const char *name, unsigned long size, unsigned long ops,
+                   double seconds, unsigned long bytes)
+{
+    printf("{\"benchmark\": \"%s\", \"size\": %lu, \"ops\": %lu, "
+           "\"seconds\": %.6f, \"ns_per_op\": %.2f",
+           name, size, ops, seconds,
+           ops ? (seconds * 1000000000.0) / (double)ops : 0.0);
+    if (bytes) {
+        printf(", \"mb_per_s\": %.2f",
+               seconds > 0 ? ((double)bytes / (1024.0 * 1024.0)) / seconds
+                           : 0.0);
+    }
+    printf("}\n");
+    fflush(stdout);
+}
+
+/**
+ * @brief Simple linear congruential generator for shuffling inputs.
+ *
+ * @param[in,out] state The generator state.
+ *
+ * @return The next pseudo-random number.
+ */
+static unsigned long next_random(unsigned long *state)
+{
+    *state = *state * 6364136223846793005UL + 1442695040888963407UL;
+    return *state >> 33;
+}
+
+/* ---------------------------------------------------------------- */
+
+/* Lines of representative source code for the tokeniser benchmark */
+static const char * const source_lines[] = {
+    "symbols for integers I, J, K, COUNT\n",
+    "set TOTAL = TOTAL + I * 3.14159 - (J / 2)\n",
+    "take 'The quick brown fox', add ' jumps', replace S\n",
+    "if this is greater than 100, go to DONE\n",
+    "repeat for I = 1 to 1000 by 2\n",
+    "    output 'Value: ', output I\n",
+    "end repeat\n",
+    "# A comment line that the tokeniser must skip over\n",
+    "*DONE\n",
+    "form square root, multiply by X, & 2, round down\n"
+};
+#define NUM_SOURCE_LINES (sizeof(source_lines) / sizeof(source_lines[0]))
+
+/**
+ * @brief State for reading the synthetic source from memory.
+ */
+typedef struct
+{
+    const char *data;
+    size_t posn;
+    size_t len;
+
+} source_t;
+
+/**
+ * @brief Reads a character from the synthetic source in memory.
+ *
+ * @param[in,out] user_data Points to the source_t state.
+ *
+ * @return The next character, or -1 at EOF.
+ */
+static int read_source(void *user_data)
+{
+    source_t *source = (source_t *)user_data;
+    if (source->posn < source->len) {
+        return (unsigned char)(source->data[(source->posn)++]);
+    }
+    return -1;
+}
+
+/**
+ * @brief Measures the throughput of the tokeniser.
+ *
+ * @param[in] size Approximate size of the synthetic source in bytes.
+ * @param[in] block Non-zero to read the source as a block of memory,
+ * or zero to read it one character at a time through "read_char".
+ */
+static void bench_tokeniser(unsigned long size, int block)
+{
+    ip_tokeniser_t tokeniser;
+    source_t source;
+    char *data;
+    size_t len = 0;
+    size_t line_len;
+    unsigned long tokens = 0;
+    unsigned long index = 0;
+    double start, end;
+
+    /* Build the synthetic source */
+    data = malloc(size + 128);
+    if (!data) {
+        exit(1);
+    }
+    while (len < size) {
+        line_len = strlen(source_lines[index % NUM_SOURCE_LINES]);
+        memcpy(data + len, source_lines[index % NUM_SOURCE_LINES], line_len);
+        len += line_len;
+        ++index;
+    }
+
+    /* Tokenise it */
+    source.data = data;
+    source.posn = 0;
+    source.len = len;
+    ip_tokeniser_init(&tokeniser);
+    if (block) {
+        ip_tokeniser_set_block(&tokeniser, data, len);
+    } else {
+        tokeniser.read_char = read_source;
+        tokeniser.user_data = &source;
+    }
+    tokeniser.filename = "bench";
+    start = now();
+    while (ip_tokeniser_get_next
+                (&tokeniser, ITOK_TYPE_ANY | ITOK_TYPE_EXTENSION) != ITOK_EOF) {
+        ++tokens;
+    }
+    end = now();
+    ip_tokeniser_free(&tokeniser);
+    report(block ? "tokeniser_get_next_block" : "tokeniser_get_next",
+           (unsigned long)len, tokens, end - start, (unsigned long)len);
+    free(data);
+}
+
+/**
+ * @brief Measures the cost of looking up keywords and non-keywords.
+ *
+ * @param[in] iterations Number of passes over the list of names.
+ */
+static void bench_lookup_keyword(unsigned long iterations)
+{
+    const char *names[ITOK_LAST_KEYWORD - ITOK_FIRST_KEYWORD + 1 + 4];
+    size_t lens[sizeof(names) / sizeof(names[0])];
+    const ip_token_info_t *info;
+    unsigned long num_names = 0;
+    unsigned long found = 0;
+    unsigned long iter, index;
+    int token;
+    double start, end;
+
+    /* Look up every keyword plus a few names that are not keywords */
+    for (token = ITOK_FIRST_KEYWORD; token <= ITOK_LAST_KEYWORD; ++token) {
+        info = ip_tokeniser_get_keyword(token);
+        if (info) {
+            names[num_names++] = info->name;
+        }
+    }
+    names[num_names++] = "COUNT";
+    names[num_names++] = "TOTAL";
+    names[num_names++] = "FACTORIAL";
+    names[num_names++] = "X";
+    for (index = 0; index < num_names; ++index) {
+        lens[index] = strlen(names[index]);
+    }
+    start = now();
+    for (iter = 0; iter < iterations; ++iter) {
+        for (index = 0; index < num_names; ++index) {
+            if (ip_tokeniser_lookup_keyword
+                    (names[index], lens[index],
+                     ITOK_TYPE_ANY | ITOK_TYPE_EXTENSION)) {
+                ++found;
+            }
+        }
+    }
+    end = now();
+    report("tokeniser_lookup_keyword", num_names, iterations * num_names,
+           end - start, 0);
+}
+
+/**
+ * @brief Measures symbol table insertion and lookup.
+ *
+ * @param[in] count Number of symbols to insert and then look up.
+ */
+static void bench_symbols(unsigned long count)
+{
+    ip_symbol_table_t symbols;
+    ip_symbol_t *symbol;
+    unsigned long *order;
+    unsigned long index, temp, other;
+    unsigned long state = 42;
+    unsigned long found = 0;
+    char name[32];
+    double start, end;
+
+    /* Insert the symbols in a shuffled order */
+    order = malloc(count * sizeof(unsigned long));
+    if (!order) {
+        exit(1);
+    }
+    for (index = 0; index < count; ++index) {
+        order[index] = index;
+    }
+    for (index = count - 1; index > 0; --index) {
+        other = next_random(&state) % (index + 1);
+        temp = order[index];
+        order[index] = order[other];
+        order[other] = temp;
+    }
+    ip_symbol_table_init(&symbols);
+    start = now();
+    for (index = 0; index < count; ++index) {
+        snprintf(name, sizeof(name), "SYMBOL%07lu", order[index]);
+        symbol = calloc(1, sizeof(ip_symbol_t));
+        if (!symbol || !(symbol->name = strdup(name))) {
+            exit(1);
+        }
+        symbol->num = -1;
+        ip_symbol_insert(&symbols, symbol);
+    }
+    end = now();
+    report("symbol_insert", count, count, end - start, 0);
+
+    /* Look them all up again in a different order */
+    start = now();
+    for (index = 0; index < count; ++index) {
+        snprintf(name, sizeof(name), "SYMBOL%07lu", index);
+        if (ip_symbol_lookup_by_name(&symbols, name)) {
+            ++found;
+        }
+    }
+    end = now();
+    report("symbol_lookup", count, count, end - start, 0);
+    if (found != count) {
+        fprintf(stderr, "symbol_lookup: only found %lu of %lu\n", found, count);
+        exit(1);
+    }
+    ip_symbol_table_free(&symbols);
+    free(order);
+}
+
+/**
+ * @brief Measures string concatenation and substring extraction.
+ *
+ * @param[in] len Length of the input strings.
+ * @param[in] iterations Number of times to perform each operation.
+ */
+static void bench_strings(unsigned long len, unsigned long iterations)
+{
+    ip_string_t *str1;
+    ip_string_t *str2;
+    ip_string_t *result;
+    unsigned long iter;
+    char *data;
+    double start, end;
+
+    data = malloc(len + 1);
+    if (!data) {
+        exit(1);
+    }
+    memset(data, 'x', len);
+    data[len] = '\0';
+    str1 = ip_string_create(data);
+    str2 = ip_string_create(data);
+
+    start = now();
+    for (iter = 0; iter < iterations; ++iter) {
+        result = ip_string_concat(str1, str2);
+        ip_string_deref(result);
+    }
+    end = now();
+    report("string_concat", len, iterations, end - start,
+           (unsigned long)(len * 2 * iterations));
+
+    start = now();
+    for (iter = 0; iter < iterations; ++iter) {
+        result = ip_string_substring(str1, len / 4, len / 2);
+        ip_string_deref(result);
+    }
+    end = now();
+    report("string_substring", len, iterations, end - start,
+           (unsigned long)((len / 2) * iterations));
+
+    ip_string_deref(str1);
+    ip_string_deref(str2);
+    free(data);
+}
+
+/**
+ * @brief Measures value assignment between values of mixed types.
+ *
+ * @param[in] iterations Number of assignments to perform.
+ */
+static void bench_values(unsigned long iterations)
+{
+    ip_value_t values[3];
+    ip_value_t dest;
+    ip_string_t *str;
+    unsigned long iter;
+    double start, end;
+
+    ip_value_init(&(values[0]));
+    ip_value_init(&(values[1]));
+    ip_value_init(&(values[2]));
+    ip_value_init(&dest);
+    ip_value_set_int(&(values[0]), 42);
+    ip_value_set_float(&(values[1]), 3.5);
+    str = ip_string_create("Hello, World!");
+    ip_value_set_string(&(values[2]), str);
+    ip_string_deref(str);
+
+    /* Assign a mix of types so that the string reference counts change */
+    start = now();
+    for (iter = 0; iter < iterations; ++iter) {
+        ip_value_assign(&dest, &(values[iter % 3]));
+    }
+    end = now();
+    report("value_assign", 3, iterations, end - start, 0);
+
+    ip_value_release(&dest);
+    ip_value_release(&(values[0]));
+    ip_value_release(&(values[1]));
+    ip_value_release(&(values[2]));
+}
+
+/**
+ * @brief Registers the built-in library for the start-up benchmark.
+ *
+ * @param[in,out] parser The parser.
+ * @param[in] options Options for the built-ins to register.
+ */
+static void register_builtins(ip_parser_t *parser, unsigned options)
+{
+    ip_register_math_builtins(parser->program, options);
+    ip_register_string_builtins(parser->program, options);
+}
+
+/* Small program that uses a couple of the built-ins */
+static const char startup_source[] =
+    "TITLE Start-up benchmark\n"
+    "TAKE 2.5\n"
+    "ROUND UP\n"
+    "TAKE SQUARE ROOT OF 16\n"
+    "OUTPUT THIS\n"
+    "END OF INTERPROGRAM\n";
+
+/**
+ * @brief Measures creating a program, registering the built-in library,
+ * and parsing a small program, as a multi-tenant host would per request.
+ *
+ * @param[in] iterations Number of programs to create and parse.
+ */
+static void bench_program_startup(unsigned long iterations)
+{
+    ip_program_t *program;
+    unsigned long iter;
+    double start, end;
+
+    start = now();
+    for (iter = 0; iter < iterations; ++iter) {
+        program = ip_program_new("startup.ip");
+        ip_parse_program_buffer
+            (program, startup_source, sizeof(startup_source) - 1,
+             ITOK_TYPE_EXTENSION, 0, 0, register_builtins);
+        ip_program_free(program);
+    }
+    end = now();
+    report("program_startup", sizeof(startup_source) - 1, iterations,
+           end - start, 0);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long scale = 1;
+    unsigned long size;
+
+    /* An optional argument scales down the work for quick checks */
+    if (argc > 1) {
+        scale = strtoul(argv[1], 0, 0);
+        if (scale < 1) {
+            scale = 1;
+        }
+    }
+
+    for (size = 16 * 1024; size <= 16 * 1024 * 1024; size *= 16) {
+        bench_tokeniser(size / scale, 0);
+        bench_tokeniser(size / scale, 1);
+    }
+    bench_lookup_keyword(20000 / scale);
+    for (size = 10000; size <= 1000000; size *= 10) {
+        bench_symbols(size / scale);
+    }
+    for (size = 16; size <= 4096; size *= 16) {
+        bench_strings(size, 1000000 / scale);
+    }
+    bench_values(10000000 / scale);
+    bench_program_startup(100000 / scale);
+    return 0;
+}
@@ -0,0 +1,548 @@
+/*
+ * Copyright (C) 2025 Rhys Weatherley
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Generates synthetic INTERPROGRAM programs and input tapes at a
+ * configurable scale, and optionally checks that the time taken to
+ * parse and run them grows near-linearly with the scale.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#define short_options "l:v:r:L:i:o:t:x:c:R:s:"
+static struct option long_options[] = {
+    {"labels",      required_argument,  0,  'l'},
+    {"variables",   required_argument,  0,  'v'},
+    {"routines",    required_argument,  0,  'r'},
+    {"line-length", required_argument,  0,  'L'},
+    {"input",       required_argument,  0,  'i'},
+    {"output",      required_argument,  0,  'o'},
+    {"tape",        required_argument,  0,  't'},
+    {"interpreter", required_argument,  0,  'x'},
+    {"check",       required_argument,  0,  'c'},
+    {"runs",        required_argument,  0,  'R'},
+    {"slack",       required_argument,  0,  's'},
+    {0,             0,                  0,  0},
+};
+
+static void usage(const char *progname)
+{
+    fprintf(stderr, "Usage: %s [options]\n\n", progname);
+
+    fprintf(stderr, "--labels N, -l N\n");
+    fprintf(stderr, "    Number of labelled statements to generate.\n\n");
+
+    fprintf(stderr, "--variables N, -v N\n");
+    fprintf(stderr, "    Number of variables to declare and assign.\n\n");
+
+    fprintf(stderr, "--routines N, -r N\n");
+    fprintf(stderr, "    Number of multi-word routines to define and call.\n\n");
+
+    fprintf(stderr, "--line-length N, -L N\n");
+    fprintf(stderr, "    Approximate length of the long expression lines.\n\n");
+
+    fprintf(stderr, "--input N, -i N\n");
+    fprintf(stderr, "    Number of values on the input tape.\n\n");
+
+    fprintf(stderr, "--output FILE, -o FILE\n");
+    fprintf(stderr, "    Write the program to FILE (default is standard output).\n\n");
+
+    fprintf(stderr, "--tape FILE, -t FILE\n");
+    fprintf(stderr, "    Write the input tape to FILE.\n\n");
+
+    fprintf(stderr, "--interpreter PATH, -x PATH\n");
+    fprintf(stderr, "    Path to the interprogram executable for --check.\n\n");
+
+    fprintf(stderr, "--check FACTOR, -c FACTOR\n");
+    fprintf(stderr, "    Generate programs at the given scale and at FACTOR times\n");
+    fprintf(stderr, "    the scale, time the interpreter on both, and fail if the\n");
+    fprintf(stderr, "    parse or run time grows faster than near-linearly.\n\n");
+
+    fprintf(stderr, "--runs N, -R N\n");
+    fprintf(stderr, "    Number of times to time each program for --check (default is 3).\n\n");
+
+    fprintf(stderr, "--slack N, -s N\n");
+    fprintf(stderr, "    Allowed ratio of the time growth to FACTOR for --check\n");
+    fprintf(stderr, "    (default is 2).\n\n");
+}
+
+/**
+ * @brief Scale parameters for a generated program.
+ */
+typedef struct
+{
+    /** Number of labelled statements */
+    unsigned long labels;
+
+    /** Number of variables */
+    unsigned long variables;
+
+    /** Number of multi-word routines */
+    unsigned long routines;
+
+    /** Approximate length of the long expression lines */
+    unsigned long line_length;
+
+    /** Number of values on the input tape */
+    unsigned long input;
+
+} scale_t;
+
+/**
+ * @brief Number of names to declare on each "SYMBOLS FOR" line.
+ */
+#define NAMES_PER_LINE 8
+
+/**
+ * @brief Number of long expression lines to generate.
+ */
+#define LONG_LINES 16
+
+/**
+ * @brief Writes a number as a name made up only of letters.
+ *
+ * @param[in] file The file to write to.
+ * @param[in] prefix Prefix for the name.
+ * @param[in] num The number to convert.
+ *
+ * Variable names cannot contain digits, so the number is written in
+ * base 26 with the letters A to Z.  The result has a fixed width so
+ * that no name is a prefix of another.
+ */
+static void write_name(FILE *file, const char *prefix, unsigned long num)
+{
+    char letters[8];
+    int posn;
+    for (posn = 6; posn >= 0; --posn) {
+        letters[posn] = 'A' + (char)(num % 26);
+        num /= 26;
+    }
+    letters[7] = '\0';
+    fprintf(file, "%s%s", prefix, letters);
+}
+
+/**
+ * @brief Writes a list of names as "SYMBOLS FOR" declarations.
+ *
+ * @param[in] file The file to write to.
+ * @param[in] type The type of symbol, "INTEGERS" or "ROUTINES".
+ * @param[in] prefix Prefix for the names.
+ * @param[in] count Number of names to declare.
+ */
+static void write_symbols
+    (FILE *file, const char *type, const char *prefix, unsigned long count)
+{
+    unsigned long index;
+    for (index = 0; index < count; ++index) {
+        if ((index % NAMES_PER_LINE) == 0) {
+            fprintf(file, "SYMBOLS FOR %s ", type);
+        } else {
+            fprintf(file, ", ");
+        }
+        if (!strcmp(type, "ROUTINES")) {
+            fputc('\'', file);
+            write_name(file, prefix, index);
+            fputc('\'', file);
+        } else {
+            write_name(file, prefix, index);
+        }
+        if ((index % NAMES_PER_LINE) == (NAMES_PER_LINE - 1) ||
+                index == (count - 1)) {
+            fprintf(file, "\n");
+        }
+    }
+}
+
+/**
+ * @brief Generates a synthetic program.
+ *
+ * @param[in] file The file to write the program to.
+ * @param[in] scale The scale parameters for the program.
+ *
+ * The program sums values into QSUM from every part of the program
+ * and then outputs the total, so that all generated statements are
+ * both parsed and executed.
+ */
+static void generate_program(FILE *file, const scale_t *scale)
+{
+    unsigned long index;
+    unsigned long len;
+
+    /* Declarations */
+    fprintf(file, "TITLE Generated stress test program\n");
+    fprintf(file, "SYMBOLS FOR INTEGERS QSUM, QN, QI, QX\n");
+    write_symbols(file, "INTEGERS", "QV", scale->variables);
+    write_symbols(file, "ROUTINES", "QR ", scale->routines);
+    fprintf(file, "SET QSUM = 0\n");
+
+    /* Assign to every variable, then add them all up */
+    for (index = 0; index < scale->variables; ++index) {
+        fprintf(file, "SET ");
+        write_name(file, "QV", index);
+        fprintf(file, " = %lu\n", index % 100);
+    }
+    for (index = 0; index < scale->variables; ++index) {
+        fprintf(file, "SET QSUM = QSUM + ");
+        write_name(file, "QV", index);
+        fprintf(file, "\n");
+    }
+
+    /* Labelled statements, each with a backwards reference to its label.
+     * Numeric labels are limited to 9999, so use named labels instead. */
+    for (index = 0; index < scale->labels; ++index) {
+        fprintf(file, "*");
+        write_name(file, "QL", index);
+        fprintf(file, "\nIF QSUM IS SMALLER THAN 0, GO TO ");
+        write_name(file, "QL", index);
+        fprintf(file, "\n");
+    }
+
+    /* Call every routine using its multi-word name */
+    for (index = 0; index < scale->routines; ++index) {
+        write_name(file, "QR ", index);
+        fprintf(file, " %lu\n", index % 10);
+        fprintf(file, "SET QSUM = QSUM + THIS\n");
+    }
+
+    /* Long lines of expressions */
+    if (scale->line_length > 0) {
+        for (index = 0; index < LONG_LINES; ++index) {
+            fprintf(file, "SET QSUM = QSUM");
+            for (len = 15; len < scale->line_length; len += 4) {
+                fprintf(file, " + 1");
+            }
+            fprintf(file, "\n");
+        }
+    }
+
+    /* Read the input tape and add up the values on it */
+    if (scale->input > 0) {
+        fprintf(file, "INPUT QN\n");
+        fprintf(file, "REPEAT FOR QI = 1 TO QN\n");
+        fprintf(file, "    INPUT QX\n");
+        fprintf(file, "    SET QSUM = QSUM + QX\n");
+        fprintf(file, "END REPEAT\n");
+    }
+
+    fprintf(file, "OUTPUT QSUM\n");
+    fprintf(file, "END OF INTERPROGRAM\n");
+
+    /* Routine definitions */
+    for (index = 0; index < scale->routines; ++index) {
+        fprintf(file, "*");
+        write_name(file, "QR ", index);
+        fprintf(file, "\nRETURN @1 + 1\n");
+    }
+}
+
+/**
+ * @brief Generates an input tape for a synthetic program.
+ *
+ * @param[in] file The file to write the tape to.
+ * @param[in] scale The scale parameters for the program.
+ */
+static void generate_tape(FILE *file, const scale_t *scale)
+{
+    unsigned long index;
+    fprintf(file, "%lu\n", scale->input);
+    for (index = 0; index < scale->input; ++index) {
+        fprintf(file, "%lu\n", (index * 7) % 1000);
+    }
+}
+
+/**
+ * @brief Generates a program and its input tape into temporary files.
+ *
+ * @param[in] scale The scale parameters for the program.
+ * @param[out] program Returns the name of the program file.
+ * @param[out] tape Returns the name of the tape file.
+ *
+ * @return Non-zero if the files were generated, zero on error.
+ */
+static int generate_files(const scale_t *scale, char *program, char *tape)
+{
+    FILE *file;
+    int fd;
+
+    strcpy(program, "/tmp/interprogram-stress-XXXXXX");
+    strcpy(tape, "/tmp/interprogram-stress-XXXXXX");
+    fd = mkstemp(program);
+    if (fd < 0 || (file = fdopen(fd, "w")) == 0) {
+        perror(program);
+        return 0;
+    }
+    generate_program(file, scale);
+    fclose(file);
+    fd = mkstemp(tape);
+    if (fd < 0 || (file = fdopen(fd, "w")) == 0) {
+        perror(tape);
+        unlink(program);
+        return 0;
+    }
+    generate_tape(file, scale);
+    fclose(file);
+    return 1;
+}
+
+/**
+ * @brief Runs the interpreter once and times it.
+ *
+ * @param[in] argv Arguments for the interpreter, terminated by NULL.
+ * @param[in] input Name of the file to use as standard input.
+ * @param[out] elapsed Returns the elapsed wall-clock time in seconds.
+ *
+ * @return Non-zero if the interpreter ran successfully, zero if not.
+ */
+static int run_once(char **argv, const char *input, double *elapsed)
+{
+    struct timespec start, end;
+    pid_t pid;
+    int status;
+    int fd;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return 0;
+    } else if (pid == 0) {
+        /* Redirect the input and output of the child and run it */
+        fd = open(input, O_RDONLY);
+        if (fd < 0) {
+            perror(input);
+            _exit(127);
+        }
+        dup2(fd, 0);
+        close(fd);
+        fd = open("/dev/null", O_WRONLY);
+        if (fd >= 0) {
+            dup2(fd, 1);
+            close(fd);
+        }
+        execv(argv[0], argv);
+        perror(argv[0]);
+        _exit(127);
+    }
+    if (waitpid(pid, &status, 0) < 0) {
+        perror("waitpid");
+        return 0;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    *elapsed = (double)(end.tv_sec - start.tv_sec) +
+               ((double)(end.tv_nsec - start.tv_nsec)) / 1000000000.0;
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "%s: interpreter failed on %s\n", argv[0],
+                argv[1][0] == '-' ? argv[2] : argv[1]);
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief Times the interpreter on a program, taking the best of several runs.
+ *
+ * @param[in] interpreter Path to the interpreter.
+ * @param[in] program Name of the program file.
+ * @param[in] tape Name of the tape file.
+ * @param[in] parse_only Non-zero to only parse the program.
+ * @param[in] runs Number of times to run the interpreter.
+ * @param[out] best Returns the best time in seconds.
+ *
+ * @return Non-zero if all runs succeeded, zero if not.
+ *
+ * The best time is used rather than the median because it is the
+ * least affected by other activity on the machine.
+ */
+static int time_program
+    (const char *interpreter, char *program, const char *tape,
+     int parse_only, int runs, double *best)
+{
+    char *argv[4];
+    double elapsed;
+    int run;
+    argv[0] = (char *)interpreter;
+    if (parse_only) {
+        argv[1] = "--parse-only";
+        argv[2] = program;
+        argv[3] = 0;
+    } else {
+        argv[1] = program;
+        argv[2] = 0;
+    }
+    *best = 0;
+    for (run = 0; run < runs; ++run) {
+        if (!run_once(argv, tape, &elapsed)) {
+            return 0;
+        }
+        if (run == 0 || elapsed < *best) {
+            *best = elapsed;
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief Checks that the parse and run times scale near-linearly.
+ *
+ * @param[in] interpreter Path to the interpreter.
+ * @param[in] scale The scale parameters for the smaller program.
+ * @param[in] factor Factor to multiply the scale by for the larger program.
+ * @param[in] runs Number of times to time each program.
+ * @param[in] slack Allowed ratio of the time growth to @a factor.
+ *
+ * @return Zero if the times scale near-linearly, or 1 if not.
+ */
+static int check_scaling
+    (const char *interpreter, const scale_t *scale, unsigned long factor,
+     int runs, double slack)
+{
+    static const char * const phases[2] = {"run", "parse"};
+    char program[2][64];
+    char tape[2][64];
+    scale_t scales[2];
+    double times[2];
+    double growth;
+    int phase, size;
+    int exitval = 0;
+
+    /* Generate the programs at both scales */
+    scales[0] = *scale;
+    scales[1].labels = scale->labels * factor;
+    scales[1].variables = scale->variables * factor;
+    scales[1].routines = scale->routines * factor;
+    scales[1].line_length = scale->line_length * factor;
+    scales[1].input = scale->input * factor;
+    if (!generate_files(&(scales[0]), program[0], tape[0])) {
+        return 1;
+    }
+    if (!generate_files(&(scales[1]), program[1], tape[1])) {
+        unlink(program[0]);
+        unlink(tape[0]);
+        return 1;
+    }
+
+    /* Time the parse and the full run at both scales */
+    for (phase = 1; phase >= 0 && !exitval; --phase) {
+        for (size = 0; size < 2; ++size) {
+            if (!time_program(interpreter, program[size], tape[size],
+                              phase, runs, &(times[size]))) {
+                exitval = 1;
+                break;
+            }
+        }
+        if (exitval) {
+            break;
+        }
+        growth = times[0] > 0 ? times[1] / times[0] : 0;
+        printf("%-5s x1: %.4fs  x%lu: %.4fs  growth: %.2f",
+               phases[phase], times[0], factor, times[1], growth);
+        if (growth > slack * (double)factor) {
+            printf("  SUPER-LINEAR\n");
+            exitval = 1;
+        } else {
+            printf("\n");
+        }
+    }
+
+    /* Clean up */
+    for (size = 0; size < 2; ++size) {
+        unlink(program[size]);
+        unlink(tape[size]);
+    }
+    return exitval;
+}
+
+int main(int argc, char **argv)
+{
+    const char *progname = argv[0];
+    const char *output = 0;
+    const char *tape = 0;
+    const char *interpreter = 0;
+    unsigned long factor = 0;
+    double slack = 2.0;
+    int runs = 3;
+    scale_t scale;
+    FILE *file;
+    int opt, option_index;
+
+    /* Parse the command-line options */
+    memset(&scale, 0, sizeof(scale));
+    while ((opt = getopt_long(argc, argv, short_options, long_options,
+                              &option_index)) >= 0) {
+        switch (opt) {
+        case 'l': scale.labels = strtoul(optarg, 0, 0); break;
+        case 'v': scale.variables = strtoul(optarg, 0, 0); break;
+        case 'r': scale.routines = strtoul(optarg, 0, 0); break;
+        case 'L': scale.line_length = strtoul(optarg, 0, 0); break;
+        case 'i': scale.input = strtoul(optarg, 0, 0); break;
+        case 'o': output = optarg; break;
+        case 't': tape = optarg; break;
+        case 'x': interpreter = optarg; break;
+        case 'c': factor = strtoul(optarg, 0, 0); break;
+        case 'R': runs = atoi(optarg); break;
+        case 's': slack = atof(optarg); break;
+        default:
+            usage(progname);
+            return 1;
+        }
+    }
+    if (optind < argc || runs < 1 || (factor != 0 && !interpreter)) {
+        usage(progname);
+        return 1;
+    }
+
+    /* Check the scaling of the interpreter if requested */
+    if (factor != 0) {
+        return check_scaling(interpreter, &scale, factor, runs, slack);
+    }
+
+    /* Generate the program and the input tape */
+    if (output) {
+        file = fopen(output, "w");
+        if (!file) {
+            perror(output);
+            return 1;
+        }
+        generate_program(file, &scale);
+        fclose(file);
+    } else {
+        generate_program(stdout, &scale);
+    }
+    if (tape) {
+        file = fopen(tape, "w");
+        if (!file) {
+            perror(tape);
+            return 1;
+        }
+        generate_tape(file, &scale);
+        fclose(file);
+    }
+    return 0;
+}
@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2025 Rhys Weatherley
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Example native extension module for INTERPROGRAM.
+ *
+ * Build this as a shared object and load it into the interpreter with
+ * "interprogram --load-module example_module.so program.ip".  Extended
+ * programs can then use:
+ *
+ *     SUM OF SQUARES              THIS = 1*1 + 2*2 + ... + THIS*THIS
+ *     FORM HYPOTENUSE WITH X      THIS = sqrt(THIS*THIS + X*X)
+ *     FACTORIAL OF X              Function that returns X!
+ *     PHI                         Golden ratio, defined by the init hook
+ *
+ * Modules may only call the interpreter through the host functions in
+ * the ip_module_api_t table that is passed to the init hook.
+ */
+
+#include "ip_module.h"
+#include <math.h>
+
+/* Host functions, saved by the init hook */
+static const ip_module_api_t *api;
+
+static int example_sum_of_squares
+    (ip_exec_t *exec, ip_value_t *args, size_t num_args)
+{
+    ip_value_t *this_value = api->this_value(exec);
+    ip_int_t limit, sum, n;
+    int status;
+    (void)args;
+    (void)num_args;
+    status = api->value_to_int(this_value);
+    if (status == IP_EXEC_OK) {
+        limit = this_value->ivalue;
+        sum = 0;
+        for (n = 1; n <= limit; ++n) {
+            sum += n * n;
+        }
+        api->value_set_int(this_value, sum);
+    }
+    return status;
+}
+
+static int example_hypotenuse
+    (ip_exec_t *exec, ip_value_t *args, size_t num_args)
+{
+    ip_value_t *this_value = api->this_value(exec);
+    int status;
+    (void)num_args;
+    status = api->value_to_float(this_value);
+    if (status == IP_EXEC_OK) {
+        status = api->value_to_float(&(args[0]));
+        if (status == IP_EXEC_OK) {
+            api->value_set_float
+                (this_value, hypot(this_value->fvalue, args[0].fvalue));
+        }
+    }
+    return status;
+}
+
+static int example_factorial_of
+    (ip_exec_t *exec, ip_value_t *args, size_t num_args)
+{
+    ip_int_t result = 1;
+    ip_int_t n;
+    int status;
+    (void)exec;
+    (void)num_args;
+    status = api->value_to_int(&(args[0]));
+    if (status == IP_EXEC_OK) {
+        for (n = 2; n <= args[0].ivalue; ++n) {
+            result *= n;
+        }
+        api->value_set_int(&(args[0]), result);
+    }
+    return status;
+}
+
+static ip_builtin_info_t const example_builtins[] = {
+    {"SUM OF SQUARES",              example_sum_of_squares, 0,  0},
+    {"FORM HYPOTENUSE WITH",        example_hypotenuse,     1,  1},
+
+    /* Functions that can be used in expressions */
+    {"FACTORIAL OF",                example_factorial_of,   1,  0},
+
+    /* End of the list */
+    {0,                             0,                      0,  0}
+};
+
+static void example_init
+    (ip_program_t *program, unsigned options, const ip_module_api_t *host)
+{
+    (void)options;
+    api = host;
+    api->define_float(program, "PHI", (1.0 + sqrt(5.0)) / 2.0);
+}
+
+/* Description of the module that the interpreter looks for */
+const ip_module_t ip_module = {
+    IP_MODULE_ABI_VERSION,
+    "example",
+    example_builtins,
+    example_init
+};
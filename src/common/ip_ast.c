@@ -24,6 +24,36 @@
 #include <stdlib.h>
 #include <string.h>
 
+/**
+ * @brief Names of the meta-tokens for non-keyword node types.
+ */
+static const char * const ip_ast_meta_names[] = {
+    "variable",             /* ITOK_VAR_NAME */
+    "integer constant",     /* ITOK_INT_VALUE */
+    "float constant",       /* ITOK_FLOAT_VALUE */
+    "string constant",      /* ITOK_STR_VALUE */
+    "error",                /* ITOK_ERROR */
+    "end of file",          /* ITOK_EOF */
+    "end of line",          /* ITOK_EOL */
+    "text",                 /* ITOK_TEXT */
+    "convert to integer",   /* ITOK_TO_INT */
+    "convert to float",     /* ITOK_TO_FLOAT */
+    "convert to string",    /* ITOK_TO_STRING */
+    "convert to dynamic",   /* ITOK_TO_DYNAMIC */
+    "integer array index",  /* ITOK_INDEX_INT */
+    "float array index",    /* ITOK_INDEX_FLOAT */
+    "string array index",   /* ITOK_INDEX_STRING */
+    "OUTPUT (no newline)",  /* ITOK_OUTPUT_NO_EOL */
+    "input data",           /* ITOK_INPUT_DATA */
+    "argument number",      /* ITOK_ARG_NUMBER */
+    "argument list",        /* ITOK_ARG_LIST */
+    "routine name",         /* ITOK_ROUTINE_NAME */
+    "function name",        /* ITOK_FUNCTION_NAME */
+    "function name",        /* ITOK_FUNCTION_NAME0 */
+    "function invocation",  /* ITOK_FUNCTION_INVOKE */
+    "fused THIS chain"      /* ITOK_THIS_CHAIN */
+};
+
 static ip_ast_node_t *ip_ast_make_node
     (unsigned char type, unsigned char value_type, const ip_loc_t *loc)
 {
@@ -64,6 +94,58 @@ void ip_ast_node_free(ip_ast_node_t *node)
     }
 }
 
+/**
+ * @brief Copies a node and its siblings.
+ *
+ * @param[in] node The first node to copy, may be NULL.
+ *
+ * @return The copy of the list of nodes.
+ */
+static ip_ast_node_t *ip_ast_copy_siblings(const ip_ast_node_t *node)
+{
+    ip_ast_node_t *first = 0;
+    ip_ast_node_t *last = 0;
+    ip_ast_node_t *copy;
+    while (node) {
+        copy = ip_ast_copy(node);
+        if (last) {
+            last->next = copy;
+        } else {
+            first = copy;
+        }
+        last = copy;
+        node = node->next;
+    }
+    return first;
+}
+
+ip_ast_node_t *ip_ast_copy(const ip_ast_node_t *node)
+{
+    ip_ast_node_t *copy;
+    if (!node) {
+        return 0;
+    }
+    copy = (ip_ast_node_t *)malloc(sizeof(ip_ast_node_t));
+    if (!copy) {
+        ip_out_of_memory();
+    }
+    *copy = *node;
+    copy->next = 0;
+    if (node->has_children) {
+        copy->children.left = ip_ast_copy_siblings(node->children.left);
+        if (!(node->dont_free_right)) {
+            copy->children.right = ip_ast_copy_siblings(node->children.right);
+        }
+    } else if (node->type == ITOK_EOL || node->type == ITOK_TITLE ||
+               node->type == ITOK_PUNCH || node->type == ITOK_TEXT ||
+               node->type == ITOK_STR_VALUE) {
+        if (node->text) {
+            ip_string_ref(node->text);
+        }
+    }
+    return copy;
+}
+
 ip_ast_node_t *ip_ast_make_int_constant(ip_int_t value, const ip_loc_t *loc)
 {
     ip_ast_node_t *node = ip_ast_make_node(ITOK_INT_VALUE, IP_TYPE_INT, loc);
@@ -430,3 +512,132 @@ void ip_ast_list_add(ip_ast_list_t *list, ip_ast_node_t *node)
         list->last = node;
     }
 }
+
+const char *ip_ast_type_name(int type)
+{
+    const ip_token_info_t *info = ip_tokeniser_get_keyword(type);
+    if (info) {
+        return info->name;
+    } else if (type >= ITOK_VAR_NAME && type <= ITOK_THIS_CHAIN) {
+        return ip_ast_meta_names[type - ITOK_VAR_NAME];
+    } else {
+        return "unknown";
+    }
+}
+
+size_t ip_ast_count_nodes(const ip_ast_node_t *node)
+{
+    size_t count = 0;
+    while (node) {
+        ++count;
+        if (node->has_children) {
+            count += ip_ast_count_nodes(node->children.left);
+            if (!(node->dont_free_right)) {
+                count += ip_ast_count_nodes(node->children.right);
+            }
+        }
+        node = node->next;
+    }
+    return count;
+}
+
+/**
+ * @brief Writes the name of a symbol to a dump of the abstract syntax tree.
+ *
+ * @param[in] symbol The symbol, which may be NULL.
+ * @param[in] out The stream to write to.
+ */
+static void ip_ast_dump_symbol(const ip_symbol_t *symbol, FILE *out)
+{
+    if (!symbol) {
+        fputs(" ?", out);
+    } else if (symbol->name) {
+        fprintf(out, " %s", symbol->name);
+    } else {
+        fprintf(out, " %ld", (long)(symbol->num));
+    }
+}
+
+static void ip_ast_dump_siblings
+    (const ip_ast_node_t *node, int depth, FILE *out);
+
+/**
+ * @brief Dumps a node and its children in the abstract syntax tree.
+ *
+ * @param[in] node The node to dump.
+ * @param[in] depth Indentation depth for the node.
+ * @param[in] out The stream to write to.
+ */
+static void ip_ast_dump_node
+    (const ip_ast_node_t *node, int depth, FILE *out)
+{
+    fprintf(out, "%5lu: %*s%s", node->loc.line, depth * 2, "",
+            ip_ast_type_name(node->type));
+    if (node->has_children) {
+        if (node->dont_free_right && node->children.right) {
+            /* Right child is a reference to a later statement */
+            fprintf(out, " -> line %lu", node->children.right->loc.line);
+        }
+        fputc('\n', out);
+        ip_ast_dump_siblings(node->children.left, depth + 1, out);
+        if (!(node->dont_free_right)) {
+            ip_ast_dump_siblings(node->children.right, depth + 1, out);
+        }
+        return;
+    }
+    switch (node->type) {
+    case ITOK_INT_VALUE:
+    case ITOK_ARG_NUMBER:
+        fprintf(out, " %ld", (long)(node->ivalue));
+        break;
+
+    case ITOK_FLOAT_VALUE:
+        fprintf(out, " %.17g", (double)(node->fvalue));
+        break;
+
+    case ITOK_STR_VALUE:
+    case ITOK_TEXT:
+    case ITOK_TITLE:
+    case ITOK_PUNCH:
+        if (node->text) {
+            fprintf(out, " \"%s\"", node->text->data);
+        }
+        break;
+
+    case ITOK_VAR_NAME:
+        ip_ast_dump_symbol((const ip_symbol_t *)(node->var), out);
+        break;
+
+    case ITOK_LABEL:
+        ip_ast_dump_symbol((const ip_symbol_t *)(node->label), out);
+        break;
+
+    default:
+        break;
+    }
+    fputc('\n', out);
+}
+
+/**
+ * @brief Dumps a node and its siblings in the abstract syntax tree.
+ *
+ * @param[in] node The first node to dump, may be NULL.
+ * @param[in] depth Indentation depth for the nodes.
+ * @param[in] out The stream to write to.
+ */
+static void ip_ast_dump_siblings
+    (const ip_ast_node_t *node, int depth, FILE *out)
+{
+    while (node) {
+        ip_ast_dump_node(node, depth, out);
+        node = node->next;
+    }
+}
+
+void ip_ast_dump(const ip_ast_list_t *list, FILE *out)
+{
+    const ip_ast_node_t *stmt;
+    for (stmt = list->first; stmt != 0; stmt = stmt->next) {
+        ip_ast_dump_node(stmt, 0, out);
+    }
+}
@@ -25,6 +25,7 @@
 
 #include "ip_token.h"
 #include "ip_vars.h"
+#include <stdio.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -114,6 +115,19 @@ typedef struct
  */
 void ip_ast_node_free(ip_ast_node_t *node);
 
+/**
+ * @brief Makes a deep copy of a node in the abstract syntax tree.
+ *
+ * @param[in] node The node to copy, may be NULL.
+ *
+ * @return The copy of @a node and its children, or NULL if @a node is NULL.
+ *
+ * The siblings of @a node are not copied, but the siblings of its
+ * children are.  A right child that is not owned by @a node, such as
+ * the "next" clause of a "THEN" node, is shared with the copy.
+ */
+ip_ast_node_t *ip_ast_copy(const ip_ast_node_t *node);
+
 /**
  * @brief Makes a new integer constant node.
  *
@@ -366,6 +380,36 @@ void ip_ast_list_free(ip_ast_list_t *list);
  */
 void ip_ast_list_add(ip_ast_list_t *list, ip_ast_node_t *node);
 
+/**
+ * @brief Gets the name of a node type for reports and debug output.
+ *
+ * @param[in] type The ITOK_* type of the node.
+ *
+ * @return The name of the node type; e.g. "TAKE" or "integer constant".
+ */
+const char *ip_ast_type_name(int type);
+
+/**
+ * @brief Counts the nodes in a sub-tree and all of its siblings.
+ *
+ * @param[in] node The first node to count, may be NULL.
+ *
+ * @return The number of nodes, not counting references to other
+ * statements via the right child of "IF" and "REPEAT" nodes.
+ */
+size_t ip_ast_count_nodes(const ip_ast_node_t *node);
+
+/**
+ * @brief Dumps a list of statements in a readable form for debugging.
+ *
+ * @param[in] list The list of statements to dump.
+ * @param[in] out The stream to write to.
+ *
+ * Each node is written on a line of its own, prefixed with its source
+ * line number, with sub-expressions indented underneath their statement.
+ */
+void ip_ast_dump(const ip_ast_list_t *list, FILE *out);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2025 Rhys Weatherley
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef INTERPROGRAM_ATOMIC_H
+#define INTERPROGRAM_ATOMIC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Atomic operations for data that may be shared between threads.
+ *
+ * The code base is C99, which has no standard atomics, so we use the
+ * compiler built-ins when they are available.  Otherwise we fall back
+ * to plain operations, which are only safe for single-threaded use.
+ */
+
+#if defined(__GNUC__) || defined(__clang__)
+
+/**
+ * @brief Atomically increments a value.
+ *
+ * @param[in,out] ptr Points to the value to increment.
+ */
+#define ip_atomic_increment(ptr) \
+    ((void)__atomic_add_fetch((ptr), 1, __ATOMIC_RELAXED))
+
+/**
+ * @brief Atomically decrements a value.
+ *
+ * @param[in,out] ptr Points to the value to decrement.
+ *
+ * @return The new value.
+ *
+ * The decrement has acquire-release semantics so that a thread that
+ * drops the count to zero sees all writes made by the other owners.
+ */
+#define ip_atomic_decrement(ptr) \
+    (__atomic_sub_fetch((ptr), 1, __ATOMIC_ACQ_REL))
+
+/**
+ * @brief Atomically replaces a value if it is equal to an expected value.
+ *
+ * @param[in,out] ptr Points to the value to replace.
+ * @param[in,out] expected Points to the expected value; set to the
+ * actual value if the replacement failed.
+ * @param[in] desired The value to replace it with.
+ *
+ * @return Non-zero if the value was replaced, or zero if not.
+ */
+#define ip_atomic_compare_exchange(ptr, expected, desired) \
+    (__atomic_compare_exchange_n((ptr), (expected), (desired), 0, \
+                                 __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+
+/**
+ * @brief Atomically loads a value.
+ *
+ * @param[in] ptr Points to the value to load.
+ *
+ * @return The value.
+ */
+#define ip_atomic_load(ptr) (__atomic_load_n((ptr), __ATOMIC_ACQUIRE))
+
+/**
+ * @brief Atomically stores a value.
+ *
+ * @param[out] ptr Points to the value to store to.
+ * @param[in] value The value to store.
+ */
+#define ip_atomic_store(ptr, value) \
+    (__atomic_store_n((ptr), (value), __ATOMIC_RELEASE))
+
+#else /* !__GNUC__ */
+
+#define ip_atomic_increment(ptr) ((void)(++(*(ptr))))
+#define ip_atomic_decrement(ptr) (--(*(ptr)))
+#define ip_atomic_compare_exchange(ptr, expected, desired) \
+    (*(ptr) == *(expected) ? (*(ptr) = (desired), 1) \
+                           : (*(expected) = *(ptr), 0))
+#define ip_atomic_load(ptr) (*(ptr))
+#define ip_atomic_store(ptr, value) ((void)(*(ptr) = (value)))
+
+#endif /* !__GNUC__ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
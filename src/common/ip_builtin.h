@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2025 Rhys Weatherley
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef INTERPROGRAM_BUILTIN_H
+#define INTERPROGRAM_BUILTIN_H
+
+#include "ip_types.h"
+#include "ip_string.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * This header defines the types that built-in statements work with.
+ * It is shared with native extension modules (see ip_module.h), so it
+ * must only include headers that are self-contained and installed.
+ */
+
+/* Status codes for execution functions */
+#define IP_EXEC_OK              0   /**< Execution OK, program continuing */
+#define IP_EXEC_FINISHED        1   /**< Execution finished successfully */
+#define IP_EXEC_DIV_ZERO        2   /**< Division by zero error occurred */
+#define IP_EXEC_UNINIT          3   /**< Read from an uninitialised variable */
+#define IP_EXEC_BAD_INDEX       4   /**< Array index out of range */
+#define IP_EXEC_BAD_TYPE        5   /**< Incompatible types */
+#define IP_EXEC_BAD_STATEMENT   6   /**< Unknown statement in program */
+#define IP_EXEC_BAD_RETURN      7   /**< Attempt to return from top-level */
+#define IP_EXEC_BAD_LABEL       8   /**< Could not find "GO TO" label */
+#define IP_EXEC_BAD_INPUT       9   /**< Invalid input data */
+#define IP_EXEC_BAD_LOCAL       10  /**< Reference to local at global scope */
+#define IP_EXEC_BAD_LOOP        11  /**< "END REPEAT" without matching "FOR" */
+#define IP_EXEC_FALSE           12  /**< Condition is false */
+
+/**
+ * @brief Value that has been evaluated by the program.
+ */
+typedef struct
+{
+    /** Type of value; e.g. IP_TYPE_INT */
+    unsigned char type;
+
+    union {
+        /** Integer value */
+        ip_int_t ivalue;
+
+        /** Floating-point value */
+        ip_float_t fvalue;
+
+        /** String value (reference counted) */
+        ip_string_t *svalue;
+    };
+
+} ip_value_t;
+
+/**
+ * @brief Execution context for an INTERPROGRAM.
+ *
+ * The structure is defined in ip_exec.h.
+ */
+typedef struct ip_exec_s ip_exec_t;
+
+/**
+ * @brief Structure of a program in memory after it has been parsed.
+ *
+ * The structure is defined in ip_program.h.
+ */
+typedef struct ip_program_s ip_program_t;
+
+/**
+ * @brief Function prototype for built-in statements.
+ *
+ * @param[in,out] exec The execution context.
+ * @param[in] args Points to the arguments and local variable space.
+ * @param[in] num_args Number of arguments (0 to IP_MAX_LOCALS-1).
+ *
+ * @return IP_EXEC_OK or an error code.
+ *
+ * The argument array pointed to by @a args has IP_MAX_LOCALS entries.
+ * These can be used for temporary local variable storage by the built-in.
+ */
+typedef int (*ip_builtin_handler_t)
+    (ip_exec_t *exec, ip_value_t *args, size_t num_args);
+
+/**
+ * @brief Information about a built-in statement in the interpreter,
+ * for registering multiple built-ins in bulk;
+ */
+typedef struct
+{
+    /** Name of the built-in, must be in uppercase; NULL at end of the list. */
+    const char *name;
+
+    /** Pointer to the built-in handler */
+    ip_builtin_handler_t handler;
+
+    /** Minimum number of allowable arguments (0 to 9) */
+    signed char min_args;
+
+    /** Maximum number of allowable arguments (0 to 9) */
+    signed char max_args;
+
+} ip_builtin_info_t;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
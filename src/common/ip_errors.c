@@ -27,132 +27,137 @@
 
 void ip_error(ip_parser_t *parser, const char *format, ...)
 {
+    FILE *out = parser->program->errors;
     va_list va;
     if (parser->tokeniser.loc.filename) {
-        fprintf(stderr, "%s:%lu: ", parser->tokeniser.loc.filename,
+        fprintf(out, "%s:%lu: ", parser->tokeniser.loc.filename,
                 parser->tokeniser.loc.line);
     } else {
-        fprintf(stderr, "%lu: ", parser->tokeniser.loc.line);
+        fprintf(out, "%lu: ", parser->tokeniser.loc.line);
     }
     if (format) {
         va_start(va, format);
-        vfprintf(stderr, format, va);
+        vfprintf(out, format, va);
         va_end(va);
     } else {
-        fputs("syntax error", stderr);
+        fputs("syntax error", out);
     }
-    putc('\n', stderr);
+    putc('\n', out);
     ++(parser->num_errors);
 }
 
 void ip_error_at
     (ip_parser_t *parser, const ip_loc_t *loc, const char *format, ...)
 {
+    FILE *out = parser->program->errors;
     va_list va;
     if (loc) {
         if (loc->filename) {
-            fprintf(stderr, "%s:%lu: ", loc->filename, loc->line);
+            fprintf(out, "%s:%lu: ", loc->filename, loc->line);
         } else {
-            fprintf(stderr, "%lu: ", loc->line);
+            fprintf(out, "%lu: ", loc->line);
         }
     }
     if (format) {
         va_start(va, format);
-        vfprintf(stderr, format, va);
+        vfprintf(out, format, va);
         va_end(va);
     } else {
-        fputs("syntax error", stderr);
+        fputs("syntax error", out);
     }
-    putc('\n', stderr);
+    putc('\n', out);
     ++(parser->num_errors);
 }
 
 void ip_error_near(ip_parser_t *parser, const char *format, ...)
 {
     const char *name;
+    FILE *out = parser->program->errors;
     va_list va;
     if (parser->tokeniser.loc.filename) {
-        fprintf(stderr, "%s:%lu: ", parser->tokeniser.loc.filename,
+        fprintf(out, "%s:%lu: ", parser->tokeniser.loc.filename,
                 parser->tokeniser.loc.line);
     } else {
-        fprintf(stderr, "%lu: ", parser->tokeniser.loc.line);
+        fprintf(out, "%lu: ", parser->tokeniser.loc.line);
     }
     if (format) {
         va_start(va, format);
-        vfprintf(stderr, format, va);
+        vfprintf(out, format, va);
         va_end(va);
     } else {
-        fputs("syntax error", stderr);
+        fputs("syntax error", out);
     }
-    fprintf(stderr, ", at or near ");
+    fprintf(out, ", at or near ");
     switch (parser->tokeniser.token) {
     case ITOK_EOL:
-        fputs("<EOL>", stderr);
+        fputs("<EOL>", out);
         break;
 
     case ITOK_EOF:
-        fputs("<EOF>", stderr);
+        fputs("<EOF>", out);
         break;
 
     default:
         name = parser->tokeniser.token_info->name;
-        putc('"', stderr);
+        putc('"', out);
         while (name && *name != '\0') {
             int ch = *name++;
             if (ch < 0x20 || ch > 0x7E) {
-                fprintf(stderr, "\\x%02X", ch & 0xFF);
+                fprintf(out, "\\x%02X", ch & 0xFF);
             } else {
-                putc(ch, stderr);
+                putc(ch, out);
             }
         }
-        putc('"', stderr);
+        putc('"', out);
         break;
     }
-    putc('\n', stderr);
+    putc('\n', out);
     ++(parser->num_errors);
 }
 
 void ip_warning(ip_parser_t *parser, const char *format, ...)
 {
+    FILE *out = parser->program->errors;
     va_list va;
     if (parser->tokeniser.loc.filename) {
-        fprintf(stderr, "%s:%lu: ", parser->tokeniser.loc.filename,
+        fprintf(out, "%s:%lu: ", parser->tokeniser.loc.filename,
                 parser->tokeniser.loc.line);
     } else {
-        fprintf(stderr, "%lu: ", parser->tokeniser.loc.line);
+        fprintf(out, "%lu: ", parser->tokeniser.loc.line);
     }
-    fputs("warning: ", stderr);
+    fputs("warning: ", out);
     if (format) {
         va_start(va, format);
-        vfprintf(stderr, format, va);
+        vfprintf(out, format, va);
         va_end(va);
     } else {
-        fputs("syntax warning", stderr);
+        fputs("syntax warning", out);
     }
-    putc('\n', stderr);
+    putc('\n', out);
     ++(parser->num_warnings);
 }
 
 void ip_warning_at
     (ip_parser_t *parser, const ip_loc_t *loc, const char *format, ...)
 {
+    FILE *out = parser->program->errors;
     va_list va;
     if (loc) {
         if (loc->filename) {
-            fprintf(stderr, "%s:%lu: ", loc->filename, loc->line);
+            fprintf(out, "%s:%lu: ", loc->filename, loc->line);
         } else {
-            fprintf(stderr, "%lu: ", loc->line);
+            fprintf(out, "%lu: ", loc->line);
         }
     }
-    fputs("warning: ", stderr);
+    fputs("warning: ", out);
     if (format) {
         va_start(va, format);
-        vfprintf(stderr, format, va);
+        vfprintf(out, format, va);
         va_end(va);
     } else {
-        fputs("syntax warning", stderr);
+        fputs("syntax warning", out);
     }
-    putc('\n', stderr);
+    putc('\n', out);
     ++(parser->num_warnings);
 }
 
@@ -21,6 +21,8 @@
  */
 
 #include "ip_exec.h"
+#include "ip_profile.h"
+#include "ip_perf.h"
 #include <stdlib.h>
 #include <string.h>
 #include <inttypes.h>
@@ -28,16 +30,29 @@
 #include <time.h>
 #include <unistd.h>
 
-void ip_exec_init(ip_exec_t *exec, ip_program_t *program)
+void ip_exec_init(ip_exec_t *exec, const ip_program_t *program)
 {
     memset(exec, 0, sizeof(ip_exec_t));
     exec->program = program;
     ip_value_init(&(exec->this_value));
     exec->pc = exec->program->statements.first;
-    ip_program_reset_variables(exec->program);
+    ip_var_state_init(&(exec->vars), &(program->vars));
+    exec->next_input = program->embedded_input;
     exec->input = stdin;
     exec->output = stdout;
-    srand(time(0));
+    exec->errors = stderr;
+    ip_exec_seed_random
+        (exec, ((ip_uint_t)time(0)) ^ ((ip_uint_t)(size_t)exec));
+}
+
+void ip_exec_seed_random(ip_exec_t *exec, ip_uint_t seed)
+{
+    ip_random_seed(&(exec->random), seed);
+}
+
+ip_float_t ip_exec_random(ip_exec_t *exec)
+{
+    return ip_random_float(&(exec->random));
 }
 
 /**
@@ -124,7 +139,7 @@ void ip_exec_free(ip_exec_t *exec)
 {
     ip_exec_stack_item_t *stack;
     ip_exec_stack_item_t *next;
-    ip_program_free(exec->program);
+    ip_var_state_free(&(exec->vars));
     ip_value_release(&(exec->this_value));
     stack = exec->stack;
     while (stack != 0) {
@@ -139,7 +154,8 @@ void ip_exec_reset(ip_exec_t *exec)
 {
     ip_value_set_unknown(&(exec->this_value));
     exec->pc = exec->program->statements.first;
-    ip_program_reset_variables(exec->program);
+    ip_var_state_reset(&(exec->vars));
+    exec->next_input = exec->program->embedded_input;
 }
 
 /* Forward declaration */
@@ -730,7 +746,7 @@ static int ip_eval_string_length(ip_value_t *result, ip_string_t *x)
 }
 
 /**
- * @brief Evaluates an expression.
+ * @brief Evaluates an expression node without instrumentation.
  *
  * @param[in,out] exec The execution context.
  * @param[in] expr The expression to be evaluated.
@@ -738,7 +754,7 @@ static int ip_eval_string_length(ip_value_t *result, ip_string_t *x)
  *
  * @return IP_EXEC_OK or an error code.
  */
-static int ip_exec_eval_expression
+static int ip_exec_eval_node
     (ip_exec_t *exec, ip_ast_node_t *expr, ip_value_t *result)
 {
     int status = IP_EXEC_OK;
@@ -764,7 +780,8 @@ static int ip_exec_eval_expression
 
     case ITOK_VAR_NAME:
         /* Get the value of a variable */
-        status = ip_value_from_var(result, expr->var);
+        status = ip_value_from_var
+            (result, expr->var, ip_var_state_get(&(exec->vars), expr->var));
         break;
 
     case ITOK_INT_VALUE:
@@ -821,8 +838,10 @@ static int ip_exec_eval_expression
         if (status == IP_EXEC_OK) {
             status = ip_value_to_int(&right);
             if (status == IP_EXEC_OK) {
+                ip_var_t *var = expr->children.left->var;
                 status = ip_value_from_array
-                    (result, expr->children.left->var, right.ivalue);
+                    (result, var, ip_var_state_get(&(exec->vars), var),
+                     right.ivalue);
             }
         }
         break;
@@ -982,12 +1001,51 @@ static int ip_exec_eval_expression
         break;
     }
 
+    /* Remember the innermost node that failed */
+    if (status != IP_EXEC_OK && !(exec->error_node)) {
+        exec->error_node = expr;
+    }
+
     /* Clean up and exit */
     ip_value_release(&left);
     ip_value_release(&right);
     return status;
 }
 
+/**
+ * @brief Evaluates an expression.
+ *
+ * @param[in,out] exec The execution context.
+ * @param[in] expr The expression to be evaluated.
+ * @param[out] result Returns the result.
+ *
+ * @return IP_EXEC_OK or an error code.
+ *
+ * If the interpreter was built with IP_PERF_COUNTERS, then the hardware
+ * performance counters are attributed to the type of each node.
+ */
+static int ip_exec_eval_expression
+    (ip_exec_t *exec, ip_ast_node_t *expr, ip_value_t *result)
+{
+#if defined(IP_PERF_COUNTERS)
+    if (exec->perf && expr) {
+        ip_perf_frame_t frame;
+        int status;
+        ip_perf_enter(exec->perf, &frame);
+        status = ip_exec_eval_node(exec, expr, result);
+        ip_perf_leave(exec->perf, &frame, IP_PERF_EXPRESSION, expr->type);
+        return status;
+    }
+#endif
+    return ip_exec_eval_node(exec, expr, result);
+}
+
+int ip_exec_eval
+    (ip_exec_t *exec, ip_ast_node_t *expr, ip_value_t *result)
+{
+    return ip_exec_eval_node(exec, expr, result);
+}
+
 /**
  * @brief Evaluates a boolean condition.
  *
@@ -1052,7 +1110,8 @@ static int ip_exec_assign_variable
     /* Is this a variable or array assignment? */
     if (node->type == ITOK_VAR_NAME) {
         /* Assign to an ordinary variable */
-        status = ip_value_to_var(node->var, value);
+        status = ip_value_to_var
+            (node->var, ip_var_state_get(&(exec->vars), node->var), value);
     } else if (node->type == ITOK_INDEX_INT ||
                node->type == ITOK_INDEX_FLOAT ||
                node->type == ITOK_INDEX_STRING) {
@@ -1063,8 +1122,10 @@ static int ip_exec_assign_variable
             status = ip_value_to_int(&index);
             if (status == IP_EXEC_OK) {
                 /* Finally assign to the array element */
+                ip_var_t *var = node->children.left->var;
                 status = ip_value_to_array
-                    (node->children.left->var, index.ivalue, value);
+                    (var, ip_var_state_get(&(exec->vars), var),
+                     index.ivalue, value);
             }
         }
         ip_value_release(&index);
@@ -1118,6 +1179,44 @@ static int ip_exec_assignment_statement(ip_exec_t *exec, ip_ast_node_t *node)
     return status;
 }
 
+/**
+ * @brief Performs a fused chain of statements that operate on "THIS".
+ *
+ * @param[in,out] exec The execution context.
+ * @param[in] node The ITOK_THIS_CHAIN node.
+ *
+ * @return IP_EXEC_OK or an error code.
+ *
+ * If an error occurs, then the location is moved to the node that failed
+ * so that the error is reported against the original statement.
+ */
+static int ip_exec_this_chain(ip_exec_t *exec, ip_ast_node_t *node)
+{
+    ip_ast_node_t *target;
+    int status;
+
+    /* Evaluate the chain and put the result in "THIS" */
+    exec->error_node = 0;
+    status = ip_exec_eval_expression
+        (exec, node->children.left, &(exec->this_value));
+    if (status != IP_EXEC_OK) {
+        if (exec->error_node) {
+            exec->loc = exec->error_node->loc;
+        }
+        return status;
+    }
+
+    /* Perform the equivalent of "REPLACE var" for each of the targets */
+    for (target = node->children.right; target != 0; target = target->next) {
+        status = ip_exec_assign_variable(exec, target, &(exec->this_value));
+        if (status != IP_EXEC_OK) {
+            exec->loc = target->loc;
+            return status;
+        }
+    }
+    return IP_EXEC_OK;
+}
+
 /**
  * @brief Writes tilde characters that are not part of a separator.
  *
@@ -1148,31 +1247,31 @@ static void ip_exec_copy_tape(ip_exec_t *exec, FILE *input, int ignore_output)
 {
     size_t tilde_count = 0;
     int ch;
-    if (exec->program->next_input) {
+    if (exec->next_input) {
         /* Read from the embedded input data in the program */
-        if (exec->program->next_input[0] == '\0') {
+        if (exec->next_input[0] == '\0') {
             /* We have reached the end of the embedded input.
              * Report EOF and switch to using exec->input next time. */
-            exec->program->next_input = 0;
+            exec->next_input = 0;
             return;
         }
 
         /* Copy characters from the embedded input until "~~~~~" or EOF */
-        while ((ch = *(exec->program->next_input)++) != '\0') {
+        while ((ch = *(exec->next_input)++) != '\0') {
             if (ch == '~') {
                 ++tilde_count;
                 if (tilde_count >= 5) {
                     /* We have found the "~~~~~" separator.  It may be
                      * followed by more tilde's, so deal with them too. */
-                    while ((ch = *(exec->program->next_input)++) != '\0') {
+                    while ((ch = *(exec->next_input)++) != '\0') {
                         if (ch != '~') {
-                            --(exec->program->next_input);
+                            --(exec->next_input);
                             break;
                         }
                     }
-                    if (exec->program->next_input[0] == '\n') {
+                    if (exec->next_input[0] == '\n') {
                         /* Skip the EOL after the tildes if present */
-                        ++(exec->program->next_input);
+                        ++(exec->next_input);
                     }
                     return;
                 }
@@ -1307,19 +1406,21 @@ static int ip_exec_jump_to_label
 static int ip_exec_repeat_from(ip_exec_t *exec, ip_ast_node_t *node)
 {
     ip_var_t *var = node->children.right->var;
+    ip_var_value_t *value;
     if (ip_var_get_type(var) != IP_TYPE_INT) {
         /* Loop variable must be an integer */
         return IP_EXEC_BAD_TYPE;
     }
-    if (var->ivalue == 0) {
+    value = ip_var_state_get(&(exec->vars), var);
+    if (value->ivalue == 0) {
         /* Loop variable is zero, so the loop now ends */
         return IP_EXEC_OK;
-    } else if (var->ivalue > 0) {
+    } else if (value->ivalue > 0) {
         /* Decrement the loop variable towards zero */
-        --(var->ivalue);
+        --(value->ivalue);
     } else {
         /* Increment the loop variable towards zero */
-        ++(var->ivalue);
+        ++(value->ivalue);
     }
     return ip_exec_jump_to_label(exec, node->children.left, 0, 0);
 }
@@ -1614,7 +1715,7 @@ static int ip_exec_read_float(ip_exec_t *exec, ip_float_t *value)
 
 static void ip_exec_input_skip_spaces(ip_exec_t *exec)
 {
-    const char *input = exec->program->next_input;
+    const char *input = exec->next_input;
     int ch;
     while ((ch = *input) != '\0') {
         if (ch == ' ' || ch == '\t' || ch == '\v' || ch == '\f' || ch == '\n') {
@@ -1623,7 +1724,7 @@ static void ip_exec_input_skip_spaces(ip_exec_t *exec)
             break;
         }
     }
-    exec->program->next_input = input;
+    exec->next_input = input;
 }
 
 /**
@@ -1653,24 +1754,24 @@ static int ip_exec_input(ip_exec_t *exec, ip_ast_node_t *node)
     switch (node->children.left->value_type) {
     case IP_TYPE_INT:
         /* Read an integer value */
-        if (exec->program->next_input) {
+        if (exec->next_input) {
             /* Read from the embedded input data in the program */
             ip_exec_input_skip_spaces(exec);
-            if (exec->program->next_input[0] == '\0') {
+            if (exec->next_input[0] == '\0') {
                 /* We have reached the end of the embedded input.
                  * Report EOF and switch to using exec->input next time. */
-                exec->program->next_input = 0;
+                exec->next_input = 0;
                 eof = 1;
                 skip_eol = 0;
             } else {
                 long long llvalue =
-                    strtoll(exec->program->next_input, &end, 10);
-                if (!llvalue && end == exec->program->next_input) {
+                    strtoll(exec->next_input, &end, 10);
+                if (!llvalue && end == exec->next_input) {
                     /* Invalid number in the embedded input */
                     status = IP_EXEC_BAD_INPUT;
                     break;
                 }
-                exec->program->next_input = end;
+                exec->next_input = end;
                 ip_value_set_int(&value, (ip_int_t)llvalue);
             }
             break;
@@ -1690,23 +1791,23 @@ static int ip_exec_input(ip_exec_t *exec, ip_ast_node_t *node)
          * uses notation like "1.23(45)" to indicate a number with an
          * exponent.  However, fscanf() doesn't do this so any existing
          * input data needs to be modified to use "e" notation instead. */
-        if (exec->program->next_input) {
+        if (exec->next_input) {
             /* Read from the embedded input data in the program */
             ip_exec_input_skip_spaces(exec);
-            if (exec->program->next_input[0] == '\0') {
+            if (exec->next_input[0] == '\0') {
                 /* We have reached the end of the embedded input.
                  * Report EOF and switch to using exec->input next time. */
-                exec->program->next_input = 0;
+                exec->next_input = 0;
                 eof = 1;
                 skip_eol = 0;
             } else {
-                fvalue = strtod(exec->program->next_input, &end);
-                if (fvalue == 0.0 && end == exec->program->next_input) {
+                fvalue = strtod(exec->next_input, &end);
+                if (fvalue == 0.0 && end == exec->next_input) {
                     /* Invalid number in the embedded input */
                     status = IP_EXEC_BAD_INPUT;
                     break;
                 }
-                exec->program->next_input = end;
+                exec->next_input = end;
                 ip_value_set_float(&value, (ip_float_t)fvalue);
             }
             break;
@@ -1725,29 +1826,29 @@ static int ip_exec_input(ip_exec_t *exec, ip_ast_node_t *node)
         /* Read a string value; every character until the next newline */
         value.type = IP_TYPE_STRING;
         skip_eol = 0;
-        if (exec->program->next_input) {
+        if (exec->next_input) {
             /* Read from the embedded input data in the program */
-            if (exec->program->next_input[0] == '\0') {
+            if (exec->next_input[0] == '\0') {
                 /* We have reached the end of the embedded input.
                  * Report EOF and switch to using exec->input next time. */
-                exec->program->next_input = 0;
+                exec->next_input = 0;
                 value.svalue = ip_string_create_empty();
                 eof = 1;
             } else {
                 /* Read characters from the embedded input until EOL */
-                end = strchr(exec->program->next_input, '\n');
+                end = strchr(exec->next_input, '\n');
                 if (end) {
                     value.svalue = ip_string_create_with_length
-                        (exec->program->next_input,
-                         end - exec->program->next_input);
+                        (exec->next_input,
+                         end - exec->next_input);
                     ++end;
                 } else {
-                    end = strchr(exec->program->next_input, '\0');
+                    end = strchr(exec->next_input, '\0');
                     value.svalue = ip_string_create_with_length
-                        (exec->program->next_input,
-                         end - exec->program->next_input);
+                        (exec->next_input,
+                         end - exec->next_input);
                 }
-                exec->program->next_input = end;
+                exec->next_input = end;
             }
             break;
         }
@@ -1767,9 +1868,9 @@ static int ip_exec_input(ip_exec_t *exec, ip_ast_node_t *node)
      * This ensures that if the previous line ended in a number, reading a
      * string will read a new line instead of the '\n' on the previous line. */
     if (skip_eol) {
-        if (exec->program->next_input) {
-            if (exec->program->next_input[0] == '\n') {
-                ++(exec->program->next_input);
+        if (exec->next_input) {
+            if (exec->next_input[0] == '\n') {
+                ++(exec->next_input);
             }
         } else if (exec->input_line == 0) {
             ch = fgetc(exec->input);
@@ -1910,6 +2011,23 @@ static int ip_exec_output(ip_exec_t *exec, ip_ast_node_t *node, int with_eol)
     return status;
 }
 
+/**
+ * @brief Fills an array with random numbers.
+ *
+ * @param[in,out] exec The execution context.
+ * @param[in] node The "FILL ARRAY WITH RANDOM NUMBERS" node for the statement.
+ */
+static void ip_exec_fill_random(ip_exec_t *exec, ip_ast_node_t *node)
+{
+    const ip_var_t *var = node->children.left->var;
+    ip_var_value_t *value = ip_var_state_get(&(exec->vars), var);
+    if (value->farray) {
+        ip_random_fill
+            (&(exec->random), value->farray,
+             (size_t)(var->max_subscript - var->min_subscript + 1));
+    }
+}
+
 /**
  * @brief Extracts a substring from "THIS".
  *
@@ -2021,7 +2139,95 @@ static int ip_exec_eval_call_arguments
     return status;
 }
 
-int ip_exec_step(ip_exec_t *exec)
+/**
+ * @brief Finds the call frame to reuse if a "CALL" is a tail call.
+ *
+ * @param[in,out] exec The execution context.
+ * @param[in] node The "CALL" node.
+ *
+ * @return The frame of the routine that is making the call, or NULL if
+ * the call is not in tail position.
+ *
+ * A call is in tail position if the next statement to run after it,
+ * ignoring end of line markers and labels, is a "RETURN" or
+ * "END PROCESS" with no value.  Calls to built-in statements are
+ * never tail calls because the built-in pops the frame when it is done.
+ */
+static ip_exec_stack_call_t *ip_exec_find_tail_frame
+    (ip_exec_t *exec, ip_ast_node_t *node)
+{
+    ip_ast_node_t *target = node->children.left;
+    ip_ast_node_t *next = exec->pc;
+    if (target->type == ITOK_LABEL && !(target->label->node)) {
+        return 0;
+    }
+    while (next && (next->type == ITOK_EOL || next->type == ITOK_LABEL)) {
+        next = next->next;
+    }
+    if (!next || (next->type != ITOK_RETURN &&
+                  next->type != ITOK_END_PROCESS)) {
+        return 0;
+    }
+    if (next->has_children && next->children.left) {
+        /* "RETURN value" changes "THIS" after the call returns */
+        return 0;
+    }
+    return ip_exec_find_call(exec);
+}
+
+/**
+ * @brief Performs a tail call by reusing the caller's frame.
+ *
+ * @param[in,out] exec The execution context.
+ * @param[in] node The "CALL" node.
+ * @param[in,out] frame The frame of the routine that is making the call.
+ *
+ * @return IP_EXEC_OK or an error code.
+ *
+ * The arguments are evaluated before the frame is reset because they
+ * may refer to the caller's local variables.  The frame keeps its
+ * original return node, so the "RETURN" at the end of the callee goes
+ * straight back to where the caller would have returned to.
+ */
+static int ip_exec_tail_call
+    (ip_exec_t *exec, ip_ast_node_t *node, ip_exec_stack_call_t *frame)
+{
+    ip_exec_stack_call_t args;
+    unsigned index;
+    int num_args = 0;
+    int status;
+
+    /* Evaluate the arguments into a temporary set of locals */
+    memset(&args, 0, sizeof(args));
+    status = ip_exec_eval_call_arguments
+        (exec, &args, node->children.right, &num_args);
+    if (status != IP_EXEC_OK) {
+        for (index = 0; index < IP_MAX_LOCALS; ++index) {
+            ip_value_release(&(args.locals[index]));
+        }
+        return status;
+    }
+
+    /* Discard any loops that the caller is in, and then replace the
+     * caller's locals with the arguments */
+    ip_exec_pop_stack_to(exec, &(frame->base));
+    for (index = 0; index < IP_MAX_LOCALS; ++index) {
+        ip_value_release(&(frame->locals[index]));
+        frame->locals[index] = args.locals[index];
+    }
+    frame->call_node = node;
+    return ip_exec_jump_to_label(exec, node->children.left, 1, num_args);
+}
+
+/**
+ * @brief Performs a single statement without instrumentation.
+ *
+ * @param[in,out] exec The execution context.
+ *
+ * @return IP_EXEC_OK if execution is continuing, IP_EXEC_FINISHED
+ * if the program finished successfully, or an error code otherwise.
+ */
+static int ip_exec_step_statement(ip_exec_t *exec)
 {
     ip_exec_stack_call_t *frame;
     ip_ast_node_t *node = exec->pc;
@@ -2103,6 +2309,10 @@ int ip_exec_step(ip_exec_t *exec)
         /* Set a variable to an expression value */
         return ip_exec_assignment_statement(exec, node);
 
+    case ITOK_THIS_CHAIN:
+        /* Chain of "THIS" statements that was fused by the optimiser */
+        return ip_exec_this_chain(exec, node);
+
     case ITOK_IF:
         /* Conditional statement */
         status = ip_exec_eval_condition(exec, node->children.left);
@@ -2175,6 +2385,12 @@ int ip_exec_step(ip_exec_t *exec)
 
     case ITOK_EXECUTE_PROCESS:
     case ITOK_CALL:
+        /* A call that is followed by "RETURN" reuses the current frame */
+        frame = ip_exec_find_tail_frame(exec, node);
+        if (frame) {
+            return ip_exec_tail_call(exec, node, frame);
+        }
+
         /* Call a subroutine */
         frame = calloc(1, sizeof(ip_exec_stack_call_t));
         if (!frame) {
@@ -2182,6 +2398,7 @@ int ip_exec_step(ip_exec_t *exec)
         }
         frame->base.type = ITOK_CALL;
         frame->return_node = exec->pc;
+        frame->call_node = node;
         num_args = 0;
         if (node->children.right) {
             /* Evaluate the arguments to the call and populate the
@@ -2265,6 +2482,10 @@ int ip_exec_step(ip_exec_t *exec)
     case ITOK_SUBSTRING:
         return ip_exec_extract_substring(exec, node);
 
+    case ITOK_FILL_RANDOM:
+        ip_exec_fill_random(exec, node);
+        break;
+
     default:
         /* Unknown statement.  Back up the program counter and exit */
         exec->pc = node;
@@ -2275,15 +2496,61 @@ int ip_exec_step(ip_exec_t *exec)
     return IP_EXEC_OK;
 }
 
-int ip_exec_run(ip_exec_t *exec)
+int ip_exec_step(ip_exec_t *exec)
 {
-    const char *error;
-    int status;
+#if defined(IP_PERF_COUNTERS)
+    if (exec->perf && exec->pc) {
+        ip_perf_frame_t frame;
+        int type = exec->pc->type;
+        int status;
+        ip_perf_enter(exec->perf, &frame);
+        status = ip_exec_step_statement(exec);
+        ip_perf_leave(exec->perf, &frame, IP_PERF_STATEMENT, type);
+        return status;
+    }
+#endif
+    return ip_exec_step_statement(exec);
+}
+
+int ip_exec_run_steps(ip_exec_t *exec, unsigned long max_steps)
+{
+    int status = IP_EXEC_OK;
+    if (exec->profile) {
+        while (max_steps > 0 &&
+               (status = ip_profile_step(exec->profile, exec)) == IP_EXEC_OK) {
+            --max_steps;
+        }
+        return status;
+    }
+    while (max_steps > 0 && (status = ip_exec_step(exec)) == IP_EXEC_OK) {
+        --max_steps;
+    }
+    return status;
+}
 
-    /* Keep stepping through the code until finished or error */
-    while ((status = ip_exec_step(exec)) == IP_EXEC_OK) {
-        /* Do nothing */
+const char *ip_exec_error_message(int status)
+{
+    switch (status) {
+    case IP_EXEC_OK:            return 0;
+    case IP_EXEC_FINISHED:      return 0;
+    case IP_EXEC_DIV_ZERO:      return "division by zero";
+    case IP_EXEC_UNINIT:        return "uninitialised variable";
+    case IP_EXEC_BAD_INDEX:     return "index out of range";
+    case IP_EXEC_BAD_TYPE:      return "incompatible types";
+    case IP_EXEC_BAD_STATEMENT: return "unknown statement";
+    case IP_EXEC_BAD_RETURN:    return "return from subroutine without call";
+    case IP_EXEC_BAD_LABEL:     return "unknown label";
+    case IP_EXEC_BAD_INPUT:     return "invalid input data";
+    case IP_EXEC_BAD_LOCAL:     return "invalid local variable reference";
+    case IP_EXEC_BAD_LOOP:      return "'END REPEAT' without a matching 'REPEAT'";
+    case IP_EXEC_FALSE:         return "condition is false";
+    default:                    return "program failed";
     }
+}
+
+int ip_exec_finish(ip_exec_t *exec, int status)
+{
+    const char *error;
 
     /* If the console is active, deactivate it before printing any errors */
     if (exec->deactivate_console) {
@@ -2291,8 +2558,7 @@ int ip_exec_run(ip_exec_t *exec)
     }
 
     /* Determine what happened in the last statement */
-    switch (status) {
-    case IP_EXEC_FINISHED:
+    if (status == IP_EXEC_FINISHED) {
         /* Get the exit status from the final state of the "THIS" variable */
         ip_value_to_int(&(exec->this_value));
         if (exec->this_value.type == IP_TYPE_INT) {
@@ -2302,25 +2568,35 @@ int ip_exec_run(ip_exec_t *exec)
             }
         }
         return 1; /* "THIS" is not an integer or is out of range */
-
-    case IP_EXEC_DIV_ZERO:      error = "division by zero"; break;
-    case IP_EXEC_UNINIT:        error = "uninitialised variable"; break;
-    case IP_EXEC_BAD_INDEX:     error = "index out of range"; break;
-    case IP_EXEC_BAD_TYPE:      error = "incompatible types"; break;
-    case IP_EXEC_BAD_STATEMENT: error = "unknown statement"; break;
-    case IP_EXEC_BAD_RETURN:    error = "return from subroutine without call"; break;
-    case IP_EXEC_BAD_LABEL:     error = "unknown label"; break;
-    case IP_EXEC_BAD_INPUT:     error = "invalid input data"; break;
-    case IP_EXEC_BAD_LOCAL:     error = "invalid local variable reference"; break;
-    case IP_EXEC_BAD_LOOP:      error = "'END REPEAT' without a matching 'REPEAT'"; break;
-    case IP_EXEC_FALSE:         error = "condition is false"; break;
-    default:                    error = "program failed"; break;
     }
 
     /* Print the error and exit */
+    error = ip_exec_error_message(status);
+    if (!error) {
+        error = "program failed";
+    }
     if (exec->loc.filename) {
-        fprintf(stderr, "%s:", exec->loc.filename);
+        fprintf(exec->errors, "%s:", exec->loc.filename);
     }
-    fprintf(stderr, "%lu: %s\n", exec->loc.line, error);
+    fprintf(exec->errors, "%lu: %s\n", exec->loc.line, error);
     return 2; /* Exit status of 2 for an error */
 }
+
+int ip_exec_run(ip_exec_t *exec)
+{
+    int status;
+
+    /* Keep stepping through the code until finished or error.  The check
+     * for profiling is hoisted out of the loop so that it costs nothing
+     * when profiling is disabled. */
+    if (exec->profile) {
+        while ((status = ip_profile_step(exec->profile, exec)) == IP_EXEC_OK) {
+            /* Do nothing */
+        }
+    } else {
+        while ((status = ip_exec_step(exec)) == IP_EXEC_OK) {
+            /* Do nothing */
+        }
+    }
+    return ip_exec_finish(exec, status);
+}
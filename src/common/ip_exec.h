@@ -24,32 +24,28 @@
 #define INTERPROGRAM_EXEC_H
 
 #include "ip_program.h"
+#include "ip_random.h"
 #include <stdio.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-/* Status codes for execution functions */
-#define IP_EXEC_OK              0   /**< Execution OK, program continuing */
-#define IP_EXEC_FINISHED        1   /**< Execution finished successfully */
-#define IP_EXEC_DIV_ZERO        2   /**< Division by zero error occurred */
-#define IP_EXEC_UNINIT          3   /**< Read from an uninitialised variable */
-#define IP_EXEC_BAD_INDEX       4   /**< Array index out of range */
-#define IP_EXEC_BAD_TYPE        5   /**< Incompatible types */
-#define IP_EXEC_BAD_STATEMENT   6   /**< Unknown statement in program */
-#define IP_EXEC_BAD_RETURN      7   /**< Attempt to return from top-level */
-#define IP_EXEC_BAD_LABEL       8   /**< Could not find "GO TO" label */
-#define IP_EXEC_BAD_INPUT       9   /**< Invalid input data */
-#define IP_EXEC_BAD_LOCAL       10  /**< Reference to local at global scope */
-#define IP_EXEC_BAD_LOOP        11  /**< "END REPEAT" without matching "FOR" */
-#define IP_EXEC_FALSE           12  /**< Condition is false */
-
 /**
  * @brief Value that is "very close to zero" for zero comparisons.
  */
 #define IP_FLOAT_EPSILON 1e-20
 
+/**
+ * @brief Execution profile for a program.
+ */
+typedef struct ip_profile_s ip_profile_t;
+
+/**
+ * @brief Hardware performance counter state for an execution context.
+ */
+typedef struct ip_perf_s ip_perf_t;
+
 /**
  * @brief Item on the execution stack for subroutine calls and loops.
  */
@@ -74,6 +70,9 @@ typedef struct
     /** Node for control to return back to at the end of the subroutine */
     ip_ast_node_t *return_node;
 
+    /** "CALL" node that created this frame, for walking the call chain */
+    ip_ast_node_t *call_node;
+
     /** Local variables for this subroutine */
     ip_value_t locals[IP_MAX_LOCALS];
 
@@ -106,8 +105,14 @@ typedef struct
  */
 struct ip_exec_s
 {
-    /** Points to the parsed program image */
-    ip_program_t *program;
+    /** Points to the parsed program image, which is not modified */
+    const ip_program_t *program;
+
+    /** Values of the program's variables for this execution context */
+    ip_var_state_t vars;
+
+    /** Next embedded character to be read by "INPUT", or NULL */
+    const char *next_input;
 
     /** The value of the "THIS" variable */
     ip_value_t this_value;
@@ -124,12 +129,19 @@ struct ip_exec_s
     /** Location of the last node that was executed in the source file */
     ip_loc_t loc;
 
+    /** Innermost expression node that failed to evaluate since this was
+     * last cleared, or NULL.  Used to locate errors in fused chains. */
+    ip_ast_node_t *error_node;
+
     /** Stream to read input from (default is stdin) */
     FILE *input;
 
     /** Stream to write output to (default is stdout) */
     FILE *output;
 
+    /** Stream to report runtime errors on (default is stderr) */
+    FILE *errors;
+
     /** Override to output a string (used in console mode) */
     void (*output_string)(ip_exec_t *exec, const char *str);
 
@@ -141,6 +153,19 @@ struct ip_exec_s
 
     /** Deactivate console mode */
     void (*deactivate_console)(ip_exec_t *exec);
+
+    /** Random number generator for this execution context */
+    ip_random_t random;
+
+    /** Text attributes for console mode, or zero if not set yet */
+    int console_attributes;
+
+    /** Profile to record the cost of each statement in, or NULL */
+    ip_profile_t *profile;
+
+    /** Hardware performance counters to record into, or NULL.  Only used
+     * if the interpreter was built with IP_PERF_COUNTERS defined. */
+    ip_perf_t *perf;
 };
 
 /**
@@ -149,10 +174,37 @@ struct ip_exec_s
  * @param[out] exec The execution context.
  * @param[in] program Pointer to the program for the execution context.
  *
- * This module takes ownership of @a program and will destroy it
- * when ip_exec_free() is called.
+ * The @a program is not modified by execution, so the same program can
+ * be shared between multiple execution contexts, including contexts
+ * that are running in other threads.  The caller retains ownership of
+ * @a program and must not free it until all execution contexts that
+ * use it have been freed with ip_exec_free().
+ */
+void ip_exec_init(ip_exec_t *exec, const ip_program_t *program);
+
+/**
+ * @brief Seeds the random number generator for an execution context.
+ *
+ * @param[in,out] exec The execution context.
+ * @param[in] seed The seed value.
+ *
+ * Use ip_random_seed_stream() on the "random" member instead to give
+ * parallel jobs that share a seed independent streams.
+ */
+void ip_exec_seed_random(ip_exec_t *exec, ip_uint_t seed);
+
+/**
+ * @brief Generates a random number from an execution context's
+ * random number generator.
+ *
+ * @param[in,out] exec The execution context.
+ *
+ * @return A random number between 0 and 1, excluding 1.
+ *
+ * Every execution context has its own random number generator so
+ * that execution contexts in different threads do not interfere.
  */
-void ip_exec_init(ip_exec_t *exec, ip_program_t *program);
+ip_float_t ip_exec_random(ip_exec_t *exec);
 
 /**
  * @brief Frees an execution context.
@@ -171,6 +223,22 @@ void ip_exec_free(ip_exec_t *exec);
  */
 void ip_exec_reset(ip_exec_t *exec);
 
+/**
+ * @brief Evaluates an expression in an execution context.
+ *
+ * @param[in,out] exec The execution context.
+ * @param[in] expr The expression to evaluate.
+ * @param[in,out] result Returns the value of the expression.  Must have
+ * been initialised with ip_value_init().
+ *
+ * @return IP_EXEC_OK or an error code.
+ *
+ * This allows the optimiser to evaluate constant expressions ahead of
+ * time with exactly the same semantics as when the program is run.
+ */
+int ip_exec_eval
+    (ip_exec_t *exec, ip_ast_node_t *expr, ip_value_t *result);
+
 /**
  * @brief Performs a single instruction.
  *
@@ -181,6 +249,46 @@ void ip_exec_reset(ip_exec_t *exec);
  */
 int ip_exec_step(ip_exec_t *exec);
 
+/**
+ * @brief Runs the program for a limited number of instructions.
+ *
+ * @param[in,out] exec The execution context.
+ * @param[in] max_steps The maximum number of instructions to perform.
+ *
+ * @return IP_EXEC_OK if the program is still running after @a max_steps
+ * instructions, IP_EXEC_FINISHED if the program finished successfully,
+ * or an error code otherwise.
+ *
+ * This allows a host application to interleave the execution of the
+ * program with other work.  Pass the final status to ip_exec_finish()
+ * once it is something other than IP_EXEC_OK.
+ */
+int ip_exec_run_steps(ip_exec_t *exec, unsigned long max_steps);
+
+/**
+ * @brief Finishes running a program and determines its exit status.
+ *
+ * @param[in,out] exec The execution context.
+ * @param[in] status The status from the last call to ip_exec_step()
+ * or ip_exec_run_steps().
+ *
+ * @return The exit status for the program to return from main().
+ *
+ * If @a status is an error code, then an error message is written to
+ * the errors stream for @a exec.
+ */
+int ip_exec_finish(ip_exec_t *exec, int status);
+
+/**
+ * @brief Gets the error message that corresponds to a status code.
+ *
+ * @param[in] status The status code; e.g. IP_EXEC_DIV_ZERO.
+ *
+ * @return The error message, or NULL if @a status is IP_EXEC_OK or
+ * IP_EXEC_FINISHED.
+ */
+const char *ip_exec_error_message(int status);
+
 /**
  * @brief Runs the program to completion.
  *
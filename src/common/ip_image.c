@@ -0,0 +1,1212 @@
+/*
+ * Copyright (C) 2025 Rhys Weatherley
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "ip_image.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#ifndef INTERPROGRAM_VERSION
+#define INTERPROGRAM_VERSION "unknown"
+#endif
+
+/*
+ * Layout of an image file.  All integers are little-endian.
+ *
+ *      Header:
+ *          magic "IPC" 0x1A
+ *          u32 format version
+ *          u64 cache key
+ *          u64 checksum over the rest of the image
+ *          u32 options for registering the built-ins
+ *      Embedded input:
+ *          string
+ *      Variables:
+ *          u32 count
+ *          { string name, u8 type, u16 flags, u64 min, u64 max }
+ *      Labels:
+ *          u32 count
+ *          { label-ref, u8 type, u16 flags }
+ *      Nodes:
+ *          u32 count
+ *          { u8 type, u8 value_type, u8 this_type, u8 has_children,
+ *            u8 dont_free_right, u64 line, payload }
+ *      Statements:
+ *          u32 count
+ *          { u32 node index }
+ *
+ * Strings are a u32 length, the bytes, and a NUL terminator so that they
+ * can be used in-place from the memory-mapped file.  A length of
+ * 0xFFFFFFFF indicates a NULL string.  A label-ref is a u8 that indicates
+ * if the label is named, followed by either a string or a u64 number.
+ *
+ * The payload of a node with children, or a node with a right link
+ * that it does not own, is two u32 node references, where zero is
+ * NULL and N is the node at index N - 1.  The payload of
+ * other nodes depends upon the node type.  Variables, labels, and
+ * built-in functions are referred to by name so that the image does not
+ * depend upon the addresses of anything in the interpreter.
+ */
+
+/** Magic number at the start of an image file */
+static unsigned char const ip_image_magic[4] = {'I', 'P', 'C', 0x1A};
+
+/** Size of the header up to and including the checksum */
+#define IP_IMAGE_HEADER_SIZE 24
+
+/** Initial value for FNV-1a hashes */
+#define IP_IMAGE_HASH_INIT 0xCBF29CE484222325ULL
+
+/** Length value that indicates a NULL string */
+#define IP_IMAGE_NULL_STRING 0xFFFFFFFFU
+
+/**
+ * @brief Buffer for writing an image.
+ */
+typedef struct
+{
+    /** Data that has been written so far */
+    unsigned char *data;
+
+    /** Length of the data that has been written */
+    size_t len;
+
+    /** Maximum length of the data before reallocation is required */
+    size_t max;
+
+} ip_image_writer_t;
+
+/**
+ * @brief Mapping from a node pointer to its index in the image.
+ */
+typedef struct
+{
+    /** Pointer to the node */
+    const ip_ast_node_t *node;
+
+    /** Index of the node in the image */
+    uint32_t index;
+
+} ip_image_node_ref_t;
+
+/**
+ * @brief State for saving an image.
+ */
+typedef struct
+{
+    /** Buffer for the image data */
+    ip_image_writer_t out;
+
+    /** Program that is being saved */
+    const ip_program_t *program;
+
+    /** Array of all nodes in the program, in image order */
+    const ip_ast_node_t **nodes;
+
+    /** Number of nodes in the array */
+    size_t num_nodes;
+
+    /** Maximum number of nodes before reallocation is required */
+    size_t max_nodes;
+
+    /** Node references, sorted by pointer for fast lookup */
+    ip_image_node_ref_t *refs;
+
+    /** Number of items that have been counted by a visitor */
+    uint32_t count;
+
+    /** Non-zero if an error occurred while saving */
+    int error;
+
+} ip_image_saver_t;
+
+/**
+ * @brief State for reading an image.
+ */
+typedef struct
+{
+    /** Data for the image */
+    const unsigned char *data;
+
+    /** Current read position */
+    size_t posn;
+
+    /** Length of the image data */
+    size_t len;
+
+    /** Non-zero if the image is truncated or otherwise invalid */
+    int error;
+
+} ip_image_reader_t;
+
+/**
+ * @brief Hashes a block of data with the 64-bit FNV-1a hash algorithm.
+ *
+ * @param[in] hash The hash value so far.
+ * @param[in] data Points to the data to hash.
+ * @param[in] len Length of the data to hash.
+ *
+ * @return The new hash value.
+ */
+static ip_uint_t ip_image_hash
+    (ip_uint_t hash, const void *data, size_t len)
+{
+    const unsigned char *d = (const unsigned char *)data;
+    while (len > 0) {
+        hash ^= *d++;
+        hash *= 0x100000001B3ULL;
+        --len;
+    }
+    return hash;
+}
+
+/**
+ * @brief Finishes computing a cache key by hashing in the options
+ * and the versions.
+ *
+ * @param[in] hash The hash of the program source.
+ * @param[in] options Command-line parsing options for the source.
+ *
+ * @return The final cache key.
+ */
+static ip_uint_t ip_image_finish_key(ip_uint_t hash, unsigned options)
+{
+    unsigned char header[8];
+    header[0] = (unsigned char)options;
+    header[1] = (unsigned char)(options >> 8);
+    header[2] = (unsigned char)(options >> 16);
+    header[3] = (unsigned char)(options >> 24);
+    header[4] = (unsigned char)IP_IMAGE_FORMAT_VERSION;
+    header[5] = (unsigned char)(IP_IMAGE_FORMAT_VERSION >> 8);
+    header[6] = (unsigned char)(IP_IMAGE_FORMAT_VERSION >> 16);
+    header[7] = (unsigned char)(IP_IMAGE_FORMAT_VERSION >> 24);
+    hash = ip_image_hash(hash, header, sizeof(header));
+    return ip_image_hash
+        (hash, INTERPROGRAM_VERSION, strlen(INTERPROGRAM_VERSION));
+}
+
+int ip_image_compute_key
+    (const char *filename, unsigned options, ip_uint_t *key)
+{
+    unsigned char buf[8192];
+    ip_uint_t hash = IP_IMAGE_HASH_INIT;
+    size_t len;
+    FILE *file;
+
+    /* Hash the contents of the source file */
+    file = fopen(filename, "rb");
+    if (!file) {
+        return 0;
+    }
+    while ((len = fread(buf, 1, sizeof(buf), file)) > 0) {
+        hash = ip_image_hash(hash, buf, len);
+    }
+    if (ferror(file)) {
+        fclose(file);
+        return 0;
+    }
+    fclose(file);
+
+    /* Hash the options and the versions */
+    *key = ip_image_finish_key(hash, options);
+    return 1;
+}
+
+ip_uint_t ip_image_compute_buffer_key
+    (const char *data, size_t len, unsigned options)
+{
+    return ip_image_finish_key
+        (ip_image_hash(IP_IMAGE_HASH_INIT, data, len), options);
+}
+
+/* ------------------------------ Writing ------------------------------ */
+
+static void ip_image_write_bytes
+    (ip_image_writer_t *out, const void *data, size_t len)
+{
+    if ((out->len + len) > out->max) {
+        size_t new_max = out->max ? out->max * 2 : 4096;
+        while (new_max < (out->len + len)) {
+            new_max *= 2;
+        }
+        out->data = realloc(out->data, new_max);
+        if (!(out->data)) {
+            ip_out_of_memory();
+        }
+        out->max = new_max;
+    }
+    memcpy(out->data + out->len, data, len);
+    out->len += len;
+}
+
+static void ip_image_write_u8(ip_image_writer_t *out, unsigned value)
+{
+    unsigned char buf = (unsigned char)value;
+    ip_image_write_bytes(out, &buf, 1);
+}
+
+static void ip_image_write_u16(ip_image_writer_t *out, unsigned value)
+{
+    unsigned char buf[2];
+    buf[0] = (unsigned char)value;
+    buf[1] = (unsigned char)(value >> 8);
+    ip_image_write_bytes(out, buf, sizeof(buf));
+}
+
+static void ip_image_write_u32(ip_image_writer_t *out, uint32_t value)
+{
+    unsigned char buf[4];
+    buf[0] = (unsigned char)value;
+    buf[1] = (unsigned char)(value >> 8);
+    buf[2] = (unsigned char)(value >> 16);
+    buf[3] = (unsigned char)(value >> 24);
+    ip_image_write_bytes(out, buf, sizeof(buf));
+}
+
+static void ip_image_write_u64(ip_image_writer_t *out, ip_uint_t value)
+{
+    ip_image_write_u32(out, (uint32_t)value);
+    ip_image_write_u32(out, (uint32_t)(value >> 32));
+}
+
+static void ip_image_write_string
+    (ip_image_writer_t *out, const char *str, size_t len)
+{
+    if (str) {
+        ip_image_write_u32(out, (uint32_t)len);
+        ip_image_write_bytes(out, str, len);
+        ip_image_write_u8(out, 0);
+    } else {
+        ip_image_write_u32(out, IP_IMAGE_NULL_STRING);
+    }
+}
+
+static void ip_image_write_cstring(ip_image_writer_t *out, const char *str)
+{
+    ip_image_write_string(out, str, str ? strlen(str) : 0);
+}
+
+/**
+ * @brief Adds a node and all of the nodes that it owns to the node array.
+ *
+ * @param[in,out] saver The image saving state.
+ * @param[in] node The node to add.
+ */
+static void ip_image_collect_node
+    (ip_image_saver_t *saver, const ip_ast_node_t *node)
+{
+    if (saver->num_nodes >= saver->max_nodes) {
+        saver->max_nodes = saver->max_nodes ? saver->max_nodes * 2 : 256;
+        saver->nodes = realloc
+            (saver->nodes, saver->max_nodes * sizeof(ip_ast_node_t *));
+        if (!(saver->nodes)) {
+            ip_out_of_memory();
+        }
+    }
+    saver->nodes[(saver->num_nodes)++] = node;
+    if (node->has_children) {
+        if (node->children.left) {
+            ip_image_collect_node(saver, node->children.left);
+        }
+        if (node->children.right && !(node->dont_free_right)) {
+            ip_image_collect_node(saver, node->children.right);
+        }
+    }
+}
+
+static int ip_image_compare_refs(const void *e1, const void *e2)
+{
+    uintptr_t p1 = (uintptr_t)(((const ip_image_node_ref_t *)e1)->node);
+    uintptr_t p2 = (uintptr_t)(((const ip_image_node_ref_t *)e2)->node);
+    if (p1 < p2) {
+        return -1;
+    } else if (p1 > p2) {
+        return 1;
+    } else {
+        return 0;
+    }
+}
+
+/**
+ * @brief Finds the image reference for a node.
+ *
+ * @param[in,out] saver The image saving state.
+ * @param[in] node The node to look for, which may be NULL.
+ *
+ * @return Zero if @a node is NULL, or the index of the node plus 1.
+ */
+static uint32_t ip_image_node_ref
+    (ip_image_saver_t *saver, const ip_ast_node_t *node)
+{
+    ip_image_node_ref_t key;
+    ip_image_node_ref_t *ref;
+    if (!node) {
+        return 0;
+    }
+    key.node = node;
+    key.index = 0;
+    ref = bsearch(&key, saver->refs, saver->num_nodes,
+                  sizeof(ip_image_node_ref_t), ip_image_compare_refs);
+    if (!ref) {
+        /* Reference to a node that is not part of the program */
+        saver->error = 1;
+        return 0;
+    }
+    return ref->index + 1;
+}
+
+/**
+ * @brief Information for finding the name of a built-in function.
+ */
+typedef struct
+{
+    /** The handler to look for */
+    void *handler;
+
+    /** Name of the built-in that was found, or NULL */
+    const char *name;
+
+} ip_image_builtin_search_t;
+
+static void ip_image_find_builtin(ip_symbol_t *symbol, void *user_data)
+{
+    ip_image_builtin_search_t *search = (ip_image_builtin_search_t *)user_data;
+    ip_builtin_t *builtin = (ip_builtin_t *)symbol;
+    int min_args = symbol->type & 0x0F;
+    int max_args = (symbol->type >> 4) & 0x0F;
+    if (symbol->type != 0xFF && min_args <= max_args) {
+        /* This is a built-in routine, not a built-in function */
+        return;
+    }
+    if (!(search->name) && (void *)(builtin->handler) == search->handler) {
+        search->name = symbol->name;
+    }
+}
+
+static void ip_image_write_label_ref
+    (ip_image_writer_t *out, const ip_label_t *label)
+{
+    if (label->base.name) {
+        ip_image_write_u8(out, 1);
+        ip_image_write_cstring(out, label->base.name);
+    } else {
+        ip_image_write_u8(out, 0);
+        ip_image_write_u64(out, (ip_uint_t)(label->base.num));
+    }
+}
+
+/**
+ * @brief Determine if a node type carries a text string.
+ *
+ * @param[in] type The node type.
+ *
+ * @return Non-zero if the node type carries a text string.
+ */
+static int ip_image_is_text_node(unsigned char type)
+{
+    return type == ITOK_EOL || type == ITOK_TITLE || type == ITOK_PUNCH ||
+           type == ITOK_TEXT || type == ITOK_STR_VALUE;
+}
+
+static void ip_image_write_node
+    (ip_image_saver_t *saver, const ip_ast_node_t *node)
+{
+    ip_image_writer_t *out = &(saver->out);
+    ip_image_builtin_search_t search;
+    ip_uint_t bits;
+    ip_image_write_u8(out, node->type);
+    ip_image_write_u8(out, node->value_type);
+    ip_image_write_u8(out, node->this_type);
+    ip_image_write_u8(out, node->has_children);
+    ip_image_write_u8(out, node->dont_free_right);
+    ip_image_write_u64(out, node->loc.line);
+    if (node->has_children || node->dont_free_right) {
+        /* "ELSE" nodes have no children but do use the right pointer */
+        ip_image_write_u32(out, ip_image_node_ref(saver, node->children.left));
+        ip_image_write_u32(out, ip_image_node_ref(saver, node->children.right));
+        return;
+    }
+    switch (node->type) {
+    case ITOK_VAR_NAME:
+        ip_image_write_cstring(out, ip_var_get_name(node->var));
+        break;
+
+    case ITOK_LABEL:
+        ip_image_write_label_ref(out, node->label);
+        break;
+
+    case ITOK_FUNCTION_NAME:
+        search.handler = node->builtin_handler;
+        search.name = 0;
+        ip_symbol_table_visit
+            (&(saver->program->builtins), ip_image_find_builtin, &search);
+        if (!(search.name) && saver->program->registry) {
+            ip_symbol_table_visit
+                (&(saver->program->registry->program->builtins),
+                 ip_image_find_builtin, &search);
+        }
+        if (!(search.name)) {
+            saver->error = 1;
+        }
+        ip_image_write_cstring(out, search.name);
+        break;
+
+    case ITOK_FLOAT_VALUE:
+        memcpy(&bits, &(node->fvalue), sizeof(bits));
+        ip_image_write_u64(out, bits);
+        break;
+
+    default:
+        if (ip_image_is_text_node(node->type)) {
+            if (node->text) {
+                ip_image_write_string(out, node->text->data, node->text->len);
+            } else {
+                ip_image_write_string(out, 0, 0);
+            }
+        } else {
+            /* Integer constants, argument numbers, and standalone nodes */
+            ip_image_write_u64(out, (ip_uint_t)(node->ivalue));
+        }
+        break;
+    }
+}
+
+static void ip_image_count_var(ip_symbol_t *symbol, void *user_data)
+{
+    ip_image_saver_t *saver = (ip_image_saver_t *)user_data;
+    if ((symbol->flags & IP_SYMBOL_NO_RESET) == 0) {
+        ++(saver->count);
+    }
+}
+
+static void ip_image_write_var(ip_symbol_t *symbol, void *user_data)
+{
+    ip_image_saver_t *saver = (ip_image_saver_t *)user_data;
+    ip_var_t *var = (ip_var_t *)symbol;
+
+    /* Constants and "ARGV" are re-created when the image is loaded */
+    if ((symbol->flags & IP_SYMBOL_NO_RESET) != 0) {
+        return;
+    }
+    ip_image_write_cstring(&(saver->out), symbol->name);
+    ip_image_write_u8(&(saver->out), symbol->type);
+    ip_image_write_u16(&(saver->out), symbol->flags);
+    ip_image_write_u64(&(saver->out), (ip_uint_t)(var->min_subscript));
+    ip_image_write_u64(&(saver->out), (ip_uint_t)(var->max_subscript));
+}
+
+static void ip_image_count_label(ip_label_t *label, void *user_data)
+{
+    ip_image_saver_t *saver = (ip_image_saver_t *)user_data;
+    if (!(label->builtin)) {
+        ++(saver->count);
+    }
+}
+
+static void ip_image_write_label(ip_label_t *label, void *user_data)
+{
+    ip_image_saver_t *saver = (ip_image_saver_t *)user_data;
+
+    /* Labels for built-ins are re-created when the image is loaded */
+    if (label->builtin) {
+        return;
+    }
+    ip_image_write_label_ref(&(saver->out), label);
+    ip_image_write_u8(&(saver->out), label->base.type);
+    ip_image_write_u16(&(saver->out), label->base.flags);
+}
+
+/**
+ * @brief Writes the image data to a file.
+ *
+ * @param[in] filename The name of the file to write.
+ * @param[in] data Points to the data to write.
+ * @param[in] len Length of the data to write.
+ *
+ * @return Non-zero on success, or zero on failure.
+ */
+static int ip_image_write_file
+    (const char *filename, const unsigned char *data, size_t len)
+{
+    size_t name_len = strlen(filename);
+    char *temp_name;
+    ssize_t written;
+    int fd;
+
+    /* Write to a temporary file in the same directory and then rename */
+    temp_name = malloc(name_len + 8);
+    if (!temp_name) {
+        ip_out_of_memory();
+    }
+    memcpy(temp_name, filename, name_len);
+    strcpy(temp_name + name_len, ".XXXXXX");
+    fd = mkstemp(temp_name);
+    if (fd < 0) {
+        free(temp_name);
+        return 0;
+    }
+    while (len > 0) {
+        written = write(fd, data, len);
+        if (written <= 0) {
+            close(fd);
+            unlink(temp_name);
+            free(temp_name);
+            return 0;
+        }
+        data += written;
+        len -= (size_t)written;
+    }
+    fchmod(fd, 0644);
+    if (close(fd) < 0 || rename(temp_name, filename) < 0) {
+        unlink(temp_name);
+        free(temp_name);
+        return 0;
+    }
+    free(temp_name);
+    return 1;
+}
+
+int ip_image_save
+    (const ip_program_t *program, const char *filename, ip_uint_t key)
+{
+    ip_image_saver_t saver;
+    const ip_ast_node_t *node;
+    ip_uint_t checksum;
+    size_t index;
+    int ok;
+
+    memset(&saver, 0, sizeof(saver));
+    saver.program = program;
+
+    /* Number all of the nodes in the program */
+    for (node = program->statements.first; node; node = node->next) {
+        ip_image_collect_node(&saver, node);
+    }
+    if (saver.num_nodes > 0) {
+        saver.refs = malloc(saver.num_nodes * sizeof(ip_image_node_ref_t));
+        if (!(saver.refs)) {
+            ip_out_of_memory();
+        }
+        for (index = 0; index < saver.num_nodes; ++index) {
+            saver.refs[index].node = saver.nodes[index];
+            saver.refs[index].index = (uint32_t)index;
+        }
+        qsort(saver.refs, saver.num_nodes, sizeof(ip_image_node_ref_t),
+              ip_image_compare_refs);
+    }
+
+    /* Write the header and the embedded input */
+    ip_image_write_bytes(&(saver.out), ip_image_magic, sizeof(ip_image_magic));
+    ip_image_write_u32(&(saver.out), IP_IMAGE_FORMAT_VERSION);
+    ip_image_write_u64(&(saver.out), key);
+    ip_image_write_u64(&(saver.out), 0); /* Checksum is patched in later */
+    ip_image_write_u32(&(saver.out), program->options);
+    ip_image_write_cstring(&(saver.out), program->embedded_input);
+
+    /* Write the variables */
+    saver.count = 0;
+    ip_symbol_table_visit
+        (&(program->vars.symbols), ip_image_count_var, &saver);
+    ip_image_write_u32(&(saver.out), saver.count);
+    ip_symbol_table_visit
+        (&(program->vars.symbols), ip_image_write_var, &saver);
+
+    /* Write the labels */
+    saver.count = 0;
+    ip_label_table_visit
+        ((ip_label_table_t *)&(program->labels), ip_image_count_label, &saver);
+    ip_image_write_u32(&(saver.out), saver.count);
+    ip_label_table_visit
+        ((ip_label_table_t *)&(program->labels), ip_image_write_label, &saver);
+
+    /* Write the nodes */
+    ip_image_write_u32(&(saver.out), (uint32_t)(saver.num_nodes));
+    for (index = 0; index < saver.num_nodes; ++index) {
+        ip_image_write_node(&saver, saver.nodes[index]);
+    }
+
+    /* Write the statement list */
+    saver.count = 0;
+    for (node = program->statements.first; node; node = node->next) {
+        ++(saver.count);
+    }
+    ip_image_write_u32(&(saver.out), saver.count);
+    for (node = program->statements.first; node; node = node->next) {
+        ip_image_write_u32(&(saver.out), ip_image_node_ref(&saver, node) - 1);
+    }
+
+    /* Patch the checksum into the header */
+    checksum = ip_image_hash
+        (IP_IMAGE_HASH_INIT, saver.out.data + IP_IMAGE_HEADER_SIZE,
+         saver.out.len - IP_IMAGE_HEADER_SIZE);
+    for (index = 0; index < 8; ++index) {
+        saver.out.data[IP_IMAGE_HEADER_SIZE - 8 + index] =
+            (unsigned char)(checksum >> (index * 8));
+    }
+
+    /* Write the image to the file if everything was OK */
+    if (!(saver.error)) {
+        ok = ip_image_write_file(filename, saver.out.data, saver.out.len);
+    } else {
+        ok = 0;
+    }
+
+    /* Clean up and exit */
+    free(saver.out.data);
+    free(saver.nodes);
+    free(saver.refs);
+    return ok;
+}
+
+/* ------------------------------ Reading ------------------------------ */
+
+static const unsigned char *ip_image_read_bytes
+    (ip_image_reader_t *in, size_t len)
+{
+    const unsigned char *data;
+    if (in->error || len > (in->len - in->posn)) {
+        in->error = 1;
+        return 0;
+    }
+    data = in->data + in->posn;
+    in->posn += len;
+    return data;
+}
+
+static unsigned ip_image_read_u8(ip_image_reader_t *in)
+{
+    const unsigned char *data = ip_image_read_bytes(in, 1);
+    return data ? data[0] : 0;
+}
+
+static unsigned ip_image_read_u16(ip_image_reader_t *in)
+{
+    const unsigned char *data = ip_image_read_bytes(in, 2);
+    return data ? (data[0] | (((unsigned)(data[1])) << 8)) : 0;
+}
+
+static uint32_t ip_image_read_u32(ip_image_reader_t *in)
+{
+    const unsigned char *data = ip_image_read_bytes(in, 4);
+    if (!data) {
+        return 0;
+    }
+    return ((uint32_t)(data[0])) | (((uint32_t)(data[1])) << 8) |
+           (((uint32_t)(data[2])) << 16) | (((uint32_t)(data[3])) << 24);
+}
+
+static ip_uint_t ip_image_read_u64(ip_image_reader_t *in)
+{
+    ip_uint_t value = ip_image_read_u32(in);
+    return value | (((ip_uint_t)ip_image_read_u32(in)) << 32);
+}
+
+/**
+ * @brief Reads a string from an image.
+ *
+ * @param[in,out] in The image reader.
+ * @param[out] len Returns the length of the string, or NULL if the
+ * caller doesn't need the length.
+ *
+ * @return A pointer to the NUL-terminated string within the image,
+ * or NULL if the string is NULL or there was an error.
+ */
+static const char *ip_image_read_string(ip_image_reader_t *in, size_t *len)
+{
+    uint32_t size = ip_image_read_u32(in);
+    const unsigned char *data;
+    if (size == IP_IMAGE_NULL_STRING) {
+        return 0;
+    }
+    data = ip_image_read_bytes(in, ((size_t)size) + 1);
+    if (!data || data[size] != '\0') {
+        in->error = 1;
+        return 0;
+    }
+    if (len) {
+        *len = size;
+    }
+    return (const char *)data;
+}
+
+/**
+ * @brief Reads a label reference and finds the corresponding label.
+ *
+ * @param[in,out] in The image reader.
+ * @param[in,out] program The program to find the label in.
+ * @param[in] create Non-zero to create the label if it does not exist.
+ *
+ * @return The label, or NULL if the label does not exist.
+ */
+static ip_label_t *ip_image_read_label_ref
+    (ip_image_reader_t *in, ip_program_t *program, int create)
+{
+    ip_label_t *label = 0;
+    const char *name;
+    ip_int_t num;
+    if (ip_image_read_u8(in)) {
+        name = ip_image_read_string(in, 0);
+        if (name) {
+            label = ip_program_lookup_label(program, name);
+            if (!label && create) {
+                label = ip_label_create_by_name(&(program->labels), name);
+            }
+        }
+    } else {
+        num = (ip_int_t)ip_image_read_u64(in);
+        if (!(in->error)) {
+            label = ip_label_lookup_by_number(&(program->labels), num);
+            if (!label && create) {
+                label = ip_label_create_by_number(&(program->labels), num);
+            }
+        }
+    }
+    if (!label) {
+        in->error = 1;
+    }
+    return label;
+}
+
+static int ip_image_read_vars(ip_image_reader_t *in, ip_program_t *program)
+{
+    uint32_t count = ip_image_read_u32(in);
+    const char *name;
+    unsigned char type;
+    unsigned short flags;
+    ip_int_t min_subscript;
+    ip_int_t max_subscript;
+    ip_var_t *var;
+    while (count > 0 && !(in->error)) {
+        name = ip_image_read_string(in, 0);
+        type = (unsigned char)ip_image_read_u8(in);
+        flags = (unsigned short)ip_image_read_u16(in);
+        min_subscript = (ip_int_t)ip_image_read_u64(in);
+        max_subscript = (ip_int_t)ip_image_read_u64(in);
+        if (!name || in->error) {
+            break;
+        }
+        if (!ip_var_lookup(&(program->vars), name)) {
+            /* Arrays are created as scalars and then dimensioned */
+            switch (type) {
+            case IP_TYPE_ARRAY_OF_INT:
+                var = ip_var_create(&(program->vars), name, IP_TYPE_INT);
+                ip_var_dimension_array(var, min_subscript, max_subscript);
+                break;
+
+            case IP_TYPE_ARRAY_OF_FLOAT:
+                var = ip_var_create(&(program->vars), name, IP_TYPE_FLOAT);
+                ip_var_dimension_array(var, min_subscript, max_subscript);
+                break;
+
+            case IP_TYPE_ARRAY_OF_STRING:
+                var = ip_var_create(&(program->vars), name, IP_TYPE_STRING);
+                ip_var_dimension_array(var, min_subscript, max_subscript);
+                break;
+
+            default:
+                var = ip_var_create(&(program->vars), name, type);
+                break;
+            }
+            var->base.flags = flags;
+        }
+        --count;
+    }
+    return !(in->error);
+}
+
+static int ip_image_read_labels(ip_image_reader_t *in, ip_program_t *program)
+{
+    uint32_t count = ip_image_read_u32(in);
+    ip_label_t *label;
+    unsigned char type;
+    unsigned short flags;
+    while (count > 0 && !(in->error)) {
+        label = ip_image_read_label_ref(in, program, 1);
+        type = (unsigned char)ip_image_read_u8(in);
+        flags = (unsigned short)ip_image_read_u16(in);
+        if (!label) {
+            break;
+        }
+        if (type != IP_TYPE_UNKNOWN) {
+            label->base.type = type;
+        }
+        label->base.flags |= flags;
+        --count;
+    }
+    return !(in->error);
+}
+
+/**
+ * @brief Frees the nodes that were loaded from an image when the
+ * image turns out to be invalid.
+ *
+ * @param[in] nodes The array of nodes.
+ * @param[in] num_nodes The number of nodes in the array.
+ *
+ * The nodes are freed individually because the child links between
+ * the nodes may be incomplete.
+ */
+static void ip_image_free_nodes(ip_ast_node_t **nodes, uint32_t num_nodes)
+{
+    uint32_t index;
+    for (index = 0; index < num_nodes; ++index) {
+        ip_ast_node_t *node = nodes[index];
+        if (node && !(node->has_children) && ip_image_is_text_node(node->type)) {
+            if (node->text) {
+                ip_string_deref(node->text);
+            }
+        }
+        free(node);
+    }
+    free(nodes);
+}
+
+/**
+ * @brief Reads a single node from an image.
+ *
+ * @param[in,out] in The image reader.
+ * @param[in,out] program The program that is being loaded.
+ * @param[out] links Returns the left and right child references.
+ *
+ * @return The new node, or NULL if the node is invalid.
+ */
+static ip_ast_node_t *ip_image_read_node
+    (ip_image_reader_t *in, ip_program_t *program, uint32_t *links)
+{
+    ip_ast_node_t *node;
+    ip_builtin_t *builtin;
+    const char *str;
+    size_t len;
+    ip_uint_t bits;
+
+    node = calloc(1, sizeof(ip_ast_node_t));
+    if (!node) {
+        ip_out_of_memory();
+    }
+    node->type = (unsigned char)ip_image_read_u8(in);
+    node->value_type = (unsigned char)ip_image_read_u8(in);
+    node->this_type = (unsigned char)ip_image_read_u8(in);
+    node->has_children = (unsigned char)ip_image_read_u8(in);
+    node->dont_free_right = (unsigned char)ip_image_read_u8(in);
+    node->loc.filename = program->filename;
+    node->loc.line = (unsigned long)ip_image_read_u64(in);
+    if (node->has_children || node->dont_free_right) {
+        links[0] = ip_image_read_u32(in);
+        links[1] = ip_image_read_u32(in);
+        return node;
+    }
+    links[0] = 0;
+    links[1] = 0;
+    switch (node->type) {
+    case ITOK_VAR_NAME:
+        str = ip_image_read_string(in, 0);
+        if (str) {
+            node->var = ip_var_lookup(&(program->vars), str);
+        }
+        if (!(node->var)) {
+            in->error = 1;
+        }
+        break;
+
+    case ITOK_LABEL:
+        node->label = ip_image_read_label_ref(in, program, 0);
+        break;
+
+    case ITOK_FUNCTION_NAME:
+        str = ip_image_read_string(in, 0);
+        builtin = 0;
+        if (str) {
+            builtin = ip_program_lookup_builtin_function(program, str);
+        }
+        if (builtin) {
+            node->builtin_handler = (void *)(builtin->handler);
+        } else {
+            in->error = 1;
+        }
+        break;
+
+    case ITOK_FLOAT_VALUE:
+        bits = ip_image_read_u64(in);
+        memcpy(&(node->fvalue), &bits, sizeof(bits));
+        break;
+
+    default:
+        if (ip_image_is_text_node(node->type)) {
+            str = ip_image_read_string(in, &len);
+            if (str) {
+                node->text = ip_string_create_with_length(str, len);
+            }
+        } else {
+            node->ivalue = (ip_int_t)ip_image_read_u64(in);
+        }
+        break;
+    }
+    return node;
+}
+
+/**
+ * @brief Marks a node as owned by another node or the statement list.
+ *
+ * @param[in,out] owned Array of ownership flags for the nodes.
+ * @param[in] ref Reference to the node; zero for NULL.
+ * @param[in] num_nodes Number of nodes in the image.
+ *
+ * @return Non-zero if the reference is valid, or zero if it is out of
+ * range or the node already has an owner.
+ */
+static int ip_image_mark_owned
+    (unsigned char *owned, uint32_t ref, uint32_t num_nodes)
+{
+    if (ref == 0) {
+        return 1;
+    } else if (ref > num_nodes || owned[ref - 1]) {
+        return 0;
+    } else {
+        owned[ref - 1] = 1;
+        return 1;
+    }
+}
+
+static int ip_image_read_nodes(ip_image_reader_t *in, ip_program_t *program)
+{
+    uint32_t num_nodes = ip_image_read_u32(in);
+    uint32_t num_statements;
+    ip_ast_node_t **nodes;
+    ip_ast_node_t *node;
+    unsigned char *owned;
+    uint32_t *links;
+    uint32_t index;
+    uint32_t ref;
+
+    /* Sanity check on the number of nodes before allocating memory.
+     * Every node needs at least 13 bytes in the image. */
+    if (in->error || num_nodes > ((in->len - in->posn) / 13)) {
+        return 0;
+    }
+
+    /* Load all of the nodes */
+    nodes = calloc(num_nodes + 1, sizeof(ip_ast_node_t *));
+    links = calloc(num_nodes + 1, 2 * sizeof(uint32_t));
+    owned = calloc(num_nodes + 1, 1);
+    if (!nodes || !links || !owned) {
+        ip_out_of_memory();
+    }
+    for (index = 0; index < num_nodes && !(in->error); ++index) {
+        nodes[index] = ip_image_read_node(in, program, links + index * 2);
+    }
+
+    /* Link the children together and check that every node has one owner */
+    for (index = 0; index < num_nodes && !(in->error); ++index) {
+        node = nodes[index];
+        if (!(node->has_children) && !(node->dont_free_right)) {
+            continue;
+        }
+        ref = links[index * 2];
+        if (!(node->has_children) && ref != 0) {
+            in->error = 1;
+            break;
+        }
+        if (!ip_image_mark_owned(owned, ref, num_nodes)) {
+            in->error = 1;
+            break;
+        }
+        node->children.left = ref ? nodes[ref - 1] : 0;
+        ref = links[index * 2 + 1];
+        if (ref > num_nodes) {
+            in->error = 1;
+            break;
+        }
+        if (!(node->dont_free_right) &&
+                !ip_image_mark_owned(owned, ref, num_nodes)) {
+            in->error = 1;
+            break;
+        }
+        node->children.right = ref ? nodes[ref - 1] : 0;
+    }
+
+    /* Read the statement list */
+    num_statements = ip_image_read_u32(in);
+    for (index = 0; index < num_statements && !(in->error); ++index) {
+        ref = ip_image_read_u32(in) + 1;
+        if (ref == 0 || !ip_image_mark_owned(owned, ref, num_nodes)) {
+            in->error = 1;
+        }
+    }
+    for (index = 0; index < num_nodes && !(in->error); ++index) {
+        if (!owned[index]) {
+            /* Orphaned node that is not reachable from the statements */
+            in->error = 1;
+        }
+    }
+    if (in->error) {
+        ip_image_free_nodes(nodes, num_nodes);
+        free(links);
+        free(owned);
+        return 0;
+    }
+
+    /* Everything is valid, so build the statement list.  We need to go
+     * back and re-read the indices because we didn't save them above. */
+    in->posn -= num_statements * 4;
+    for (index = 0; index < num_statements; ++index) {
+        node = nodes[ip_image_read_u32(in)];
+        ip_ast_list_add(&(program->statements), node);
+        if (node->type == ITOK_LABEL && node->label) {
+            /* Statement-level labels are the definitions of the labels */
+            node->label->node = node;
+        }
+    }
+    free(nodes);
+    free(links);
+    free(owned);
+    return 1;
+}
+
+/**
+ * @brief Registers built-ins with a private program while building a
+ * shared registry.
+ *
+ * @param[in,out] program The program to register the built-ins with.
+ * @param[in] options Options for the built-ins to register.
+ * @param[in] user_data Points to the image loader's registration callback.
+ */
+static void ip_image_init_registry
+    (ip_program_t *program, unsigned options, void *user_data)
+{
+    ip_image_register_builtins_t register_builtins =
+        *((ip_image_register_builtins_t *)user_data);
+    (*register_builtins)(program, options);
+}
+
+/**
+ * @brief Loads the contents of an image from memory.
+ *
+ * @param[in,out] in The image reader.
+ * @param[in,out] program The program to load into.
+ * @param[in] key Expected cache key for the program.
+ * @param[in] argc Number of command-line arguments for "ARGV".
+ * @param[in] argv The command-line arguments for "ARGV".
+ * @param[in] register_builtins Function to call to register the built-ins.
+ *
+ * @return Non-zero if the image was loaded, or zero if it is invalid.
+ */
+static int ip_image_load_from_memory
+    (ip_image_reader_t *in, ip_program_t *program, ip_uint_t key,
+     int argc, char **argv, ip_image_register_builtins_t register_builtins)
+{
+    const unsigned char *magic;
+    const char *input;
+    ip_uint_t checksum;
+
+    /* Validate the header */
+    magic = ip_image_read_bytes(in, sizeof(ip_image_magic));
+    if (!magic || memcmp(magic, ip_image_magic, sizeof(ip_image_magic)) != 0) {
+        return 0;
+    }
+    if (ip_image_read_u32(in) != IP_IMAGE_FORMAT_VERSION) {
+        return 0;
+    }
+    if (ip_image_read_u64(in) != key) {
+        return 0;
+    }
+
+    /* Detect corrupted images before we try to interpret the contents */
+    checksum = ip_image_read_u64(in);
+    if (in->error || checksum != ip_image_hash
+            (IP_IMAGE_HASH_INIT, in->data + IP_IMAGE_HEADER_SIZE,
+             in->len - IP_IMAGE_HEADER_SIZE)) {
+        return 0;
+    }
+
+    /* Re-create the things that the parser would have done up-front */
+    ip_program_set_argv(program, argc, argv);
+    program->options = ip_image_read_u32(in);
+    if (in->error) {
+        return 0;
+    }
+    if (register_builtins) {
+        ip_program_register_shared
+            (program, (const void *)register_builtins, program->options,
+             ip_image_init_registry, &register_builtins);
+    }
+
+    /* Load the embedded input */
+    input = ip_image_read_string(in, 0);
+    if (in->error) {
+        return 0;
+    }
+    ip_program_set_input(program, input);
+
+    /* Load the variables, labels, and statements */
+    if (!ip_image_read_vars(in, program)) {
+        return 0;
+    }
+    if (!ip_image_read_labels(in, program)) {
+        return 0;
+    }
+    if (!ip_image_read_nodes(in, program)) {
+        return 0;
+    }
+    return in->posn == in->len;
+}
+
+int ip_image_load
+    (ip_program_t *program, const char *filename, ip_uint_t key,
+     int argc, char **argv, ip_image_register_builtins_t register_builtins)
+{
+    ip_image_reader_t in;
+    struct stat st;
+    void *data;
+    int fd;
+    int ok;
+
+    /* Map the image into memory */
+    fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return 0;
+    }
+    if (fstat(fd, &st) < 0 || st.st_size <= 0) {
+        close(fd);
+        return 0;
+    }
+    data = mmap(0, (size_t)(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return 0;
+    }
+
+    /* Load the program from the mapped image */
+    in.data = (const unsigned char *)data;
+    in.posn = 0;
+    in.len = (size_t)(st.st_size);
+    in.error = 0;
+    ok = ip_image_load_from_memory
+        (&in, program, key, argc, argv, register_builtins);
+
+    /* Clean up and exit */
+    munmap(data, (size_t)(st.st_size));
+    return ok;
+}
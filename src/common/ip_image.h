@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2025 Rhys Weatherley
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef INTERPROGRAM_IMAGE_H
+#define INTERPROGRAM_IMAGE_H
+
+#include "ip_program.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Version of the binary program image format.
+ *
+ * This must be incremented whenever the layout of the image or the
+ * meaning of any of the ITOK_* node types changes.
+ */
+#define IP_IMAGE_FORMAT_VERSION 1
+
+/**
+ * @brief Function that is called to register the built-in statements
+ * for a program that is being loaded from an image.
+ *
+ * @param[in,out] program The program that is being loaded.
+ * @param[in] options The parser options that were in effect when the
+ * built-ins were registered by the original parse.
+ *
+ * The built-ins are registered in a registry that is shared between all
+ * programs that are loaded with the same function and options; see
+ * ip_program_register_shared().
+ */
+typedef void (*ip_image_register_builtins_t)
+    (ip_program_t *program, unsigned options);
+
+/**
+ * @brief Computes the cache key for a program source file.
+ *
+ * @param[in] filename Name of the source file.
+ * @param[in] options Command-line parsing options for the source file.
+ * @param[out] key Returns the cache key.
+ *
+ * @return Non-zero if the key was computed, or zero if the source file
+ * could not be read.
+ *
+ * The key is a hash over the contents of the source file, the
+ * @a options, the image format version, and the interpreter version.
+ */
+int ip_image_compute_key
+    (const char *filename, unsigned options, ip_uint_t *key);
+
+/**
+ * @brief Computes the cache key for program source in a memory buffer.
+ *
+ * @param[in] data Points to the program source.
+ * @param[in] len Length of the program source in bytes.
+ * @param[in] options Command-line parsing options for the source.
+ *
+ * @return The cache key, which is the same as ip_image_compute_key()
+ * would return for a file with the same contents.
+ */
+ip_uint_t ip_image_compute_buffer_key
+    (const char *data, size_t len, unsigned options);
+
+/**
+ * @brief Saves a parsed program to a binary image file.
+ *
+ * @param[in] program The program to save, which must have parsed
+ * without errors.
+ * @param[in] filename Name of the image file to write.
+ * @param[in] key Cache key for the program from ip_image_compute_key().
+ *
+ * @return Non-zero if the image was saved, or zero on error.
+ *
+ * The image is written to a temporary file first and then renamed
+ * into place so that concurrent readers never see a partial image.
+ */
+int ip_image_save
+    (const ip_program_t *program, const char *filename, ip_uint_t key);
+
+/**
+ * @brief Loads a parsed program from a binary image file.
+ *
+ * @param[in,out] program The program to load into, which should have
+ * been freshly created with ip_program_new().
+ * @param[in] filename Name of the image file to load.
+ * @param[in] key Expected cache key for the program.
+ * @param[in] argc Number of command-line arguments for "ARGV".
+ * @param[in] argv The command-line arguments for "ARGV".
+ * @param[in] register_builtins Function to call to register the built-ins.
+ *
+ * @return Non-zero if the image was loaded, or zero if the image does not
+ * exist, is stale, or is invalid.
+ *
+ * If this function fails, then @a program may be partially populated and
+ * should be freed.  The caller should fall back to parsing the source.
+ */
+int ip_image_load
+    (ip_program_t *program, const char *filename, ip_uint_t key,
+     int argc, char **argv, ip_image_register_builtins_t register_builtins);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,169 @@
+/*
+ * Copyright (C) 2025 Rhys Weatherley
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "ip_module.h"
+#include "ip_exec.h"
+#include <stdio.h>
+#if defined(HAVE_DLFCN_H)
+#include <dlfcn.h>
+#endif
+
+/**
+ * @brief Gets the "THIS" value of an execution context for a module.
+ *
+ * @param[in] exec The execution context.
+ *
+ * @return A pointer to the "THIS" value.
+ */
+static ip_value_t *ip_module_this_value(ip_exec_t *exec)
+{
+    return &(exec->this_value);
+}
+
+/**
+ * @brief Defines a global constant for a module.
+ *
+ * @param[in,out] program The program to define the constant in.
+ * @param[in] name The name of the constant.
+ * @param[in] type The type of the constant, IP_TYPE_INT or IP_TYPE_FLOAT.
+ *
+ * @return The variable for the constant, or NULL if the name is in use.
+ */
+static ip_var_t *ip_module_define
+    (ip_program_t *program, const char *name, unsigned char type)
+{
+    ip_var_t *var = ip_var_create(&(program->vars), name, type);
+    if (var) {
+        var->base.flags |= IP_SYMBOL_DEFINED | IP_SYMBOL_NO_RESET;
+    }
+    return var;
+}
+
+/**
+ * @brief Defines a global integer constant for a module.
+ *
+ * @param[in,out] program The program to define the constant in.
+ * @param[in] name The name of the constant.
+ * @param[in] value The value of the constant.
+ */
+static void ip_module_define_int
+    (ip_program_t *program, const char *name, ip_int_t value)
+{
+    ip_var_t *var = ip_module_define(program, name, IP_TYPE_INT);
+    if (var) {
+        var->initial.ivalue = value;
+    }
+}
+
+/**
+ * @brief Defines a global floating-point constant for a module.
+ *
+ * @param[in,out] program The program to define the constant in.
+ * @param[in] name The name of the constant.
+ * @param[in] value The value of the constant.
+ */
+static void ip_module_define_float
+    (ip_program_t *program, const char *name, ip_float_t value)
+{
+    ip_var_t *var = ip_module_define(program, name, IP_TYPE_FLOAT);
+    if (var) {
+        var->initial.fvalue = value;
+    }
+}
+
+/**
+ * @brief Host functions that are passed to the init hook of modules.
+ */
+static ip_module_api_t const ip_module_api = {
+    sizeof(ip_module_api_t),
+    ip_module_this_value,
+    ip_value_to_int,
+    ip_value_to_float,
+    ip_value_to_string,
+    ip_value_set_int,
+    ip_value_set_float,
+    ip_value_set_string,
+    ip_string_create_with_length,
+    ip_string_deref,
+    ip_program_register_builtin,
+    ip_module_define_int,
+    ip_module_define_float
+};
+
+/**
+ * @brief Buffer for error messages from loading a module.
+ */
+static char ip_module_error[256];
+
+const ip_module_t *ip_module_load(const char *path, const char **error)
+{
+#if defined(HAVE_DLFCN_H)
+    void *handle;
+    const ip_module_t *module;
+
+    /* Load the shared object and find its description */
+    handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if (!handle) {
+        snprintf(ip_module_error, sizeof(ip_module_error), "%s", dlerror());
+        *error = ip_module_error;
+        return 0;
+    }
+    module = (const ip_module_t *)dlsym(handle, IP_MODULE_SYMBOL);
+    if (!module) {
+        snprintf(ip_module_error, sizeof(ip_module_error),
+                 "%s: '%s' symbol not found", path, IP_MODULE_SYMBOL);
+        dlclose(handle);
+        *error = ip_module_error;
+        return 0;
+    }
+
+    /* Reject modules that were compiled against a different ABI */
+    if (module->abi_version != IP_MODULE_ABI_VERSION) {
+        snprintf(ip_module_error, sizeof(ip_module_error),
+                 "%s: module ABI version %u is not supported, expected %u",
+                 path, module->abi_version, (unsigned)IP_MODULE_ABI_VERSION);
+        dlclose(handle);
+        *error = ip_module_error;
+        return 0;
+    }
+
+    /* The handle is deliberately leaked because the built-in handlers
+     * must stay mapped for as long as any program might call them */
+    *error = 0;
+    return module;
+#else
+    snprintf(ip_module_error, sizeof(ip_module_error),
+             "%s: loadable modules are not supported on this platform",
+             path);
+    *error = ip_module_error;
+    return 0;
+#endif
+}
+
+void ip_module_register
+    (const ip_module_t *module, ip_program_t *program, unsigned options)
+{
+    ip_program_register_builtins(program, module->builtins);
+    if (module->init) {
+        (*(module->init))(program, options, &ip_module_api);
+    }
+}
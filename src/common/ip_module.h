@@ -0,0 +1,171 @@
+/*
+ * Copyright (C) 2025 Rhys Weatherley
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef INTERPROGRAM_MODULE_H
+#define INTERPROGRAM_MODULE_H
+
+#include "ip_builtin.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * This header is the interface between the interpreter and native
+ * extension modules that are loaded at runtime with "--load-module".
+ *
+ * A module is a shared object that exports a constant ip_module_t
+ * called "ip_module".  The interpreter checks the ABI version, registers
+ * the module's table of built-ins, and then calls the module's init hook
+ * with a table of host functions.  Modules must only use the host
+ * functions in ip_module_api_t; they must not call other ip_* functions
+ * or look inside ip_exec_t or ip_program_t, whose layouts may change.
+ *
+ * The ABI consists of ip_module_t, ip_module_api_t, ip_builtin_info_t,
+ * ip_builtin_handler_t, ip_value_t, the IP_TYPE_* and IP_EXEC_* codes,
+ * and the layout of ip_string_t.  IP_MODULE_ABI_VERSION is incremented
+ * whenever any of these change incompatibly.  New host functions are
+ * only ever added to the end of ip_module_api_t, with a check on
+ * "size" in the module if it needs them.
+ *
+ * This header only depends upon ip_builtin.h, ip_types.h, and ip_string.h,
+ * which are installed alongside it in "include/interprogram" so that
+ * modules can be compiled outside the source tree.
+ */
+
+/**
+ * @brief Version of the native extension module ABI.
+ */
+#define IP_MODULE_ABI_VERSION 1
+
+/**
+ * @brief Name of the symbol that a module exports to describe itself.
+ */
+#define IP_MODULE_SYMBOL "ip_module"
+
+/**
+ * @brief Table of host functions that modules use to access values.
+ */
+typedef struct
+{
+    /** Size of this structure in bytes, for detecting newer hosts */
+    size_t size;
+
+    /** Gets a pointer to the "THIS" value of an execution context */
+    ip_value_t *(*this_value)(ip_exec_t *exec);
+
+    /** Converts a value to an integer; returns an IP_EXEC_* code */
+    int (*value_to_int)(ip_value_t *value);
+
+    /** Converts a value to floating-point; returns an IP_EXEC_* code */
+    int (*value_to_float)(ip_value_t *value);
+
+    /** Converts a value to a string; returns an IP_EXEC_* code */
+    int (*value_to_string)(ip_value_t *value);
+
+    /** Sets a value to an integer */
+    void (*value_set_int)(ip_value_t *dest, ip_int_t src);
+
+    /** Sets a value to a floating-point number */
+    void (*value_set_float)(ip_value_t *dest, ip_float_t src);
+
+    /** Sets a value to a string, adding a reference to @a str */
+    void (*value_set_string)(ip_value_t *dest, ip_string_t *str);
+
+    /** Creates a new string with a reference count of 1 */
+    ip_string_t *(*string_create_with_length)(const char *str, size_t len);
+
+    /** Removes a reference from a string and frees it when unused */
+    void (*string_deref)(ip_string_t *str);
+
+    /** Registers an extra built-in with a program from the init hook */
+    void (*register_builtin)
+        (ip_program_t *program, const char *name,
+         ip_builtin_handler_t handler, signed char min_args,
+         signed char max_args);
+
+    /** Defines a global integer constant from the init hook */
+    void (*define_int)(ip_program_t *program, const char *name, ip_int_t value);
+
+    /** Defines a global floating-point constant from the init hook */
+    void (*define_float)
+        (ip_program_t *program, const char *name, ip_float_t value);
+
+} ip_module_api_t;
+
+/**
+ * @brief Description of a native extension module.
+ */
+typedef struct
+{
+    /** ABI version that the module was compiled against, which must
+     *  be IP_MODULE_ABI_VERSION */
+    unsigned abi_version;
+
+    /** Name of the module for error messages */
+    const char *name;
+
+    /** Built-ins to register, terminated by an entry with a NULL name,
+     *  or NULL if the module only has an init hook */
+    const ip_builtin_info_t *builtins;
+
+    /**
+     * Function to call after the built-ins have been registered, or NULL.
+     *
+     * The @a program is the program to register with, @a options are the
+     * dialect options such as ITOK_TYPE_EXTENSION, and @a api is the table
+     * of host functions, which remains valid for the life of the process.
+     * The hook may be called once and then shared between many programs,
+     * so it should only register built-ins and define constants.
+     */
+    void (*init)(ip_program_t *program, unsigned options,
+                 const ip_module_api_t *api);
+
+} ip_module_t;
+
+/**
+ * @brief Loads a native extension module.
+ *
+ * @param[in] path Path to the shared object for the module.
+ * @param[out] error Returns an error message if the module could not
+ * be loaded, which is valid until the next call.
+ *
+ * @return The module's description, or NULL if the module could not be
+ * loaded.  Modules stay loaded until the process exits.
+ */
+const ip_module_t *ip_module_load(const char *path, const char **error);
+
+/**
+ * @brief Registers the built-ins from a native extension module.
+ *
+ * @param[in] module The module.
+ * @param[in,out] program The program to register the built-ins with.
+ * @param[in] options Options for the built-ins to register.
+ */
+void ip_module_register
+    (const ip_module_t *module, ip_program_t *program, unsigned options);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,535 @@
+/*
+ * Copyright (C) 2025 Rhys Weatherley
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "ip_optimise.h"
+#include "ip_exec.h"
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Determines if a node is an integer or floating-point constant.
+ *
+ * @param[in] node The node to check, may be NULL.
+ *
+ * @return Non-zero if @a node is a numeric constant.
+ */
+static int ip_opt_is_constant(const ip_ast_node_t *node)
+{
+    return node && (node->type == ITOK_INT_VALUE ||
+                    node->type == ITOK_FLOAT_VALUE);
+}
+
+/**
+ * @brief Determines if a node type is a side-effect free operator that
+ * can be evaluated ahead of time when its operands are constant.
+ *
+ * @param[in] type The ITOK_* type of the node.
+ *
+ * @return Non-zero if the node type can be folded.
+ */
+static int ip_opt_is_foldable(int type)
+{
+    switch (type) {
+    case ITOK_TO_INT:
+    case ITOK_TO_FLOAT:
+    case ITOK_TO_DYNAMIC:
+    case ITOK_ADD:
+    case ITOK_PLUS:
+    case ITOK_SUBTRACT:
+    case ITOK_MINUS:
+    case ITOK_MULTIPLY:
+    case ITOK_MUL:
+    case ITOK_DIVIDE:
+    case ITOK_DIV:
+    case ITOK_MODULO:
+    case ITOK_IS:
+    case ITOK_IS_NOT:
+    case ITOK_GREATER_THAN:
+    case ITOK_MUCH_GREATER_THAN:
+    case ITOK_SMALLER_THAN:
+    case ITOK_MUCH_SMALLER_THAN:
+    case ITOK_ZERO:
+    case ITOK_POSITIVE:
+    case ITOK_NEGATIVE:
+    case ITOK_EQUAL_TO:
+    case ITOK_GREATER_OR_EQUAL:
+    case ITOK_SMALLER_OR_EQUAL:
+    case ITOK_FINITE:
+    case ITOK_INFINITE:
+    case ITOK_A_NUMBER:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/**
+ * @brief Makes a constant node from a numeric value.
+ *
+ * @param[in] value The value, which must be an integer or floating-point.
+ * @param[in] old The node that the constant will replace.
+ *
+ * @return The new constant node, which takes the place of @a old in
+ * its list of siblings.
+ */
+static ip_ast_node_t *ip_opt_make_constant
+    (const ip_value_t *value, const ip_ast_node_t *old)
+{
+    ip_ast_node_t *node;
+    if (value->type == IP_TYPE_INT) {
+        node = ip_ast_make_int_constant(value->ivalue, &(old->loc));
+    } else {
+        node = ip_ast_make_float_constant(value->fvalue, &(old->loc));
+    }
+    node->this_type = old->this_type;
+    node->next = old->next;
+    return node;
+}
+
+/**
+ * @brief Folds constant sub-expressions in a node and its siblings.
+ *
+ * @param[in,out] exec Execution context for evaluating the constants.
+ * @param[in,out] node The first node to fold, may be NULL.
+ * @param[in,out] changes Incremented for every node that is folded.
+ *
+ * @return The replacement for @a node.
+ */
+static ip_ast_node_t *ip_opt_fold_tree
+    (ip_exec_t *exec, ip_ast_node_t *node, size_t *changes);
+
+/**
+ * @brief Folds the constant sub-expressions underneath a node.
+ *
+ * @param[in,out] exec Execution context for evaluating the constants.
+ * @param[in,out] node The node whose children should be folded.
+ * @param[in,out] changes Incremented for every node that is folded.
+ */
+static void ip_opt_fold_children
+    (ip_exec_t *exec, ip_ast_node_t *node, size_t *changes)
+{
+    if (node->has_children) {
+        node->children.left =
+            ip_opt_fold_tree(exec, node->children.left, changes);
+        if (!(node->dont_free_right)) {
+            node->children.right =
+                ip_opt_fold_tree(exec, node->children.right, changes);
+        }
+    }
+}
+
+/**
+ * @brief Folds a single node once its children have been folded.
+ *
+ * @param[in,out] exec Execution context for evaluating the constants.
+ * @param[in,out] node The node to fold.
+ * @param[in,out] changes Incremented if the node is folded.
+ *
+ * @return The replacement for @a node, or @a node if it cannot be folded.
+ *
+ * Expressions that fail at run time, such as division by zero, are left
+ * alone so that the error is reported with the right location when the
+ * program is run.
+ */
+static ip_ast_node_t *ip_opt_fold_node
+    (ip_exec_t *exec, ip_ast_node_t *node, size_t *changes)
+{
+    ip_ast_node_t *folded;
+    ip_value_t value;
+    if (!ip_opt_is_foldable(node->type) || !(node->has_children) ||
+            !ip_opt_is_constant(node->children.left) ||
+            (node->children.right &&
+                !ip_opt_is_constant(node->children.right))) {
+        return node;
+    }
+    ip_value_init(&value);
+    if (ip_exec_eval(exec, node, &value) != IP_EXEC_OK ||
+            (value.type != IP_TYPE_INT && value.type != IP_TYPE_FLOAT)) {
+        ip_value_release(&value);
+        return node;
+    }
+    folded = ip_opt_make_constant(&value, node);
+    ip_value_release(&value);
+    node->next = 0;
+    ip_ast_node_free(node);
+    ++(*changes);
+    return folded;
+}
+
+static ip_ast_node_t *ip_opt_fold_tree
+    (ip_exec_t *exec, ip_ast_node_t *node, size_t *changes)
+{
+    ip_ast_node_t *first = node;
+    ip_ast_node_t *prev = 0;
+    ip_ast_node_t *folded;
+    while (node) {
+        ip_opt_fold_children(exec, node, changes);
+        folded = ip_opt_fold_node(exec, node, changes);
+        if (prev) {
+            prev->next = folded;
+        } else {
+            first = folded;
+        }
+        prev = folded;
+        node = folded->next;
+    }
+    return first;
+}
+
+/**
+ * @brief Folds the constant sub-expressions in all statements.
+ *
+ * @param[in,out] exec Execution context for evaluating the constants.
+ * @param[in,out] program The program.
+ *
+ * @return The number of nodes that were folded.
+ *
+ * Statement nodes themselves are never replaced because labels and
+ * control flow constructs may refer to them.
+ */
+static size_t ip_opt_fold_statements(ip_exec_t *exec, ip_program_t *program)
+{
+    ip_ast_node_t *stmt;
+    size_t changes = 0;
+    for (stmt = program->statements.first; stmt != 0; stmt = stmt->next) {
+        ip_opt_fold_children(exec, stmt, &changes);
+    }
+    return changes;
+}
+
+size_t ip_opt_fold_constants(ip_optimiser_t *opt, ip_program_t *program)
+{
+    ip_exec_t exec;
+    size_t changes;
+    (void)opt;
+    ip_exec_init(&exec, program);
+    changes = ip_opt_fold_statements(&exec, program);
+    ip_exec_free(&exec);
+    return changes;
+}
+
+/**
+ * @brief Information about how a variable is used for constant propagation.
+ */
+typedef struct
+{
+    /** Number of places in the program that write to the variable */
+    size_t writes;
+
+    /** The "SET" statement in the entry code that writes the variable */
+    ip_ast_node_t *set;
+
+    /** Non-zero if the variable has already been propagated */
+    int done;
+
+} ip_opt_var_use_t;
+
+/**
+ * @brief Records the writes to variables in a node and its siblings.
+ *
+ * @param[in,out] uses Usage information, indexed by variable index.
+ * @param[in] node The first node to scan, may be NULL.
+ */
+static void ip_opt_scan_writes(ip_opt_var_use_t *uses, ip_ast_node_t *node)
+{
+    ip_ast_node_t *target;
+    while (node) {
+        if (node->has_children) {
+            /* Find the variable that this node writes to, if any */
+            switch (node->type) {
+            case ITOK_SET:
+            case ITOK_REPLACE:
+            case ITOK_INPUT:
+            case ITOK_FILL_RANDOM:
+                target = node->children.left;
+                break;
+
+            case ITOK_REPEAT_FROM:
+                target = node->children.right;
+                break;
+
+            default:
+                target = 0;
+                break;
+            }
+            if (target && target->type == ITOK_VAR_NAME) {
+                ++(uses[target->var->index].writes);
+            }
+            ip_opt_scan_writes(uses, node->children.left);
+            if (!(node->dont_free_right)) {
+                ip_opt_scan_writes(uses, node->children.right);
+            }
+        }
+        node = node->next;
+    }
+}
+
+/**
+ * @brief Determines if a statement can appear in the straight-line entry
+ * code at the start of the program.
+ *
+ * @param[in] type The ITOK_* type of the statement.
+ *
+ * @return Non-zero if the statement always passes control to the next
+ * statement when it succeeds.
+ *
+ * Labels, conditionals, loops, calls, and input (which may jump to the
+ * "AT END OF INPUT" handler) all end the entry code.
+ */
+static int ip_opt_is_straight_line(int type)
+{
+    switch (type) {
+    case ITOK_TITLE:
+    case ITOK_SYMBOLS_INT:
+    case ITOK_MAX_SUBSCRIPTS:
+    case ITOK_COMPILE_PROGRAM:
+    case ITOK_EOL:
+    case ITOK_SET:
+    case ITOK_REPLACE:
+    case ITOK_TAKE:
+    case ITOK_ADD:
+    case ITOK_SUBTRACT:
+    case ITOK_MULTIPLY:
+    case ITOK_DIVIDE:
+    case ITOK_MODULO:
+    case ITOK_LENGTH_OF:
+    case ITOK_OUTPUT:
+    case ITOK_OUTPUT_NO_EOL:
+    case ITOK_PUNCH:
+    case ITOK_SUBSTRING:
+    case ITOK_FILL_RANDOM:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/**
+ * @brief Finds the "SET" statements in the entry code of the program
+ * that are always executed before any of the statements after them.
+ *
+ * @param[in] program The program.
+ * @param[in,out] uses Usage information, indexed by variable index.
+ *
+ * A classic "IF" only skips the rest of its own line, so it does not
+ * end the entry code as long as the rest of the line is straight-line
+ * code.  Assignments on such a line are conditional, so they are not
+ * recorded.
+ */
+static void ip_opt_find_entry_sets
+    (ip_program_t *program, ip_opt_var_use_t *uses)
+{
+    ip_ast_node_t *stmt;
+    int conditional = 0;
+    for (stmt = program->statements.first; stmt != 0; stmt = stmt->next) {
+        if (stmt->type == ITOK_IF) {
+            conditional = 1;
+        } else if (stmt->type == ITOK_EOL) {
+            conditional = 0;
+        } else if (!ip_opt_is_straight_line(stmt->type)) {
+            break;
+        } else if (stmt->type == ITOK_SET && !conditional &&
+                   stmt->children.left->type == ITOK_VAR_NAME) {
+            uses[stmt->children.left->var->index].set = stmt;
+        }
+    }
+}
+
+/**
+ * @brief Replaces reads of a variable with a constant value.
+ *
+ * @param[in] var The variable to replace.
+ * @param[in] value The value of the variable.
+ * @param[in,out] node The first node to replace within, may be NULL.
+ * @param[in,out] changes Incremented for every replacement.
+ *
+ * @return The replacement for @a node.
+ */
+static ip_ast_node_t *ip_opt_replace_var
+    (const ip_var_t *var, const ip_value_t *value, ip_ast_node_t *node,
+     size_t *changes)
+{
+    ip_ast_node_t *first = node;
+    ip_ast_node_t *prev = 0;
+    ip_ast_node_t *replacement;
+    while (node) {
+        if (node->type == ITOK_VAR_NAME && node->var == var) {
+            replacement = ip_opt_make_constant(value, node);
+            node->next = 0;
+            ip_ast_node_free(node);
+            node = replacement;
+            ++(*changes);
+        } else if (node->has_children) {
+            node->children.left = ip_opt_replace_var
+                (var, value, node->children.left, changes);
+            if (!(node->dont_free_right)) {
+                node->children.right = ip_opt_replace_var
+                    (var, value, node->children.right, changes);
+            }
+        }
+        if (prev) {
+            prev->next = node;
+        } else {
+            first = node;
+        }
+        prev = node;
+        node = node->next;
+    }
+    return first;
+}
+
+/**
+ * @brief Replaces reads of a variable in the statements after a point.
+ *
+ * @param[in] var The variable to replace.
+ * @param[in] value The value of the variable.
+ * @param[in] stmt The first statement to replace within.
+ *
+ * @return The number of replacements.
+ */
+static size_t ip_opt_replace_var_from
+    (const ip_var_t *var, const ip_value_t *value, ip_ast_node_t *stmt)
+{
+    size_t changes = 0;
+    for (; stmt != 0; stmt = stmt->next) {
+        if (stmt->has_children) {
+            stmt->children.left = ip_opt_replace_var
+                (var, value, stmt->children.left, &changes);
+            if (!(stmt->dont_free_right)) {
+                stmt->children.right = ip_opt_replace_var
+                    (var, value, stmt->children.right, &changes);
+            }
+        }
+    }
+    return changes;
+}
+
+/**
+ * @brief Information that is passed to the variable visitor.
+ */
+typedef struct
+{
+    /** The program */
+    ip_program_t *program;
+
+    /** Usage information, indexed by variable index */
+    ip_opt_var_use_t *uses;
+
+    /** Number of replacements that have been made */
+    size_t changes;
+
+    /** Number of variables that were propagated */
+    size_t propagated;
+
+} ip_opt_propagate_t;
+
+/**
+ * @brief Propagates the value of a variable if it is constant.
+ *
+ * @param[in] symbol The variable.
+ * @param[in,out] user_data The propagation state.
+ *
+ * A variable is constant if it is never written and has a fixed initial
+ * value like "PI", or if it is written exactly once by a "SET" statement
+ * in the entry code that assigns it a constant.  In the second case,
+ * only the reads after the "SET" are replaced.  Nothing before the
+ * "SET" can run after it, so those reads keep their run-time value.
+ */
+static void ip_opt_propagate_var(ip_symbol_t *symbol, void *user_data)
+{
+    ip_opt_propagate_t *prop = (ip_opt_propagate_t *)user_data;
+    ip_var_t *var = (ip_var_t *)symbol;
+    ip_opt_var_use_t *use = &(prop->uses[var->index]);
+    ip_ast_node_t *from;
+    ip_ast_node_t *rhs;
+    ip_var_value_t stored;
+    ip_value_t value;
+    if (use->done) {
+        return;
+    }
+    if (ip_var_get_type(var) != IP_TYPE_INT &&
+            ip_var_get_type(var) != IP_TYPE_FLOAT) {
+        return;
+    }
+    ip_value_init(&value);
+    if (use->writes == 0 && (var->base.flags & IP_SYMBOL_NO_RESET) != 0) {
+        /* Never written, so the variable keeps its initial value */
+        ip_value_from_var(&value, var, &(var->initial));
+        from = prop->program->statements.first;
+    } else if (use->writes == 1 && use->set &&
+               ip_opt_is_constant(use->set->children.right)) {
+        /* Convert the constant to the variable's type as the
+         * assignment would at run time */
+        memset(&stored, 0, sizeof(stored));
+        rhs = use->set->children.right;
+        if (rhs->type == ITOK_INT_VALUE) {
+            ip_value_set_int(&value, rhs->ivalue);
+        } else {
+            ip_value_set_float(&value, rhs->fvalue);
+        }
+        if (ip_value_to_var(var, &stored, &value) != IP_EXEC_OK) {
+            ip_value_release(&value);
+            return;
+        }
+        ip_value_from_var(&value, var, &stored);
+        from = use->set->next;
+    } else {
+        return;
+    }
+    use->done = 1;
+    ++(prop->propagated);
+    prop->changes += ip_opt_replace_var_from(var, &value, from);
+    ip_value_release(&value);
+}
+
+size_t ip_opt_propagate_constants(ip_optimiser_t *opt, ip_program_t *program)
+{
+    ip_opt_propagate_t prop;
+    ip_exec_t exec;
+    size_t num_vars = program->vars.num_vars;
+    (void)opt;
+
+    /* Find the variables that are written to and where */
+    memset(&prop, 0, sizeof(prop));
+    prop.program = program;
+    prop.uses = calloc(num_vars ? num_vars : 1, sizeof(ip_opt_var_use_t));
+    if (!(prop.uses)) {
+        ip_out_of_memory();
+    }
+    ip_opt_scan_writes(prop.uses, program->statements.first);
+
+    /* Propagate the constants, folding the expressions that become
+     * constant as a result, until there is nothing more to propagate */
+    ip_exec_init(&exec, program);
+    do {
+        ip_opt_find_entry_sets(program, prop.uses);
+        prop.propagated = 0;
+        ip_symbol_table_visit
+            (&(program->vars.symbols), ip_opt_propagate_var, &prop);
+        if (prop.propagated) {
+            prop.changes += ip_opt_fold_statements(&exec, program);
+        }
+    } while (prop.propagated);
+    ip_exec_free(&exec);
+    free(prop.uses);
+    return prop.changes;
+}
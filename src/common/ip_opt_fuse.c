@@ -0,0 +1,254 @@
+/*
+ * Copyright (C) 2025 Rhys Weatherley
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "ip_optimise.h"
+
+/**
+ * @brief Determines if a statement applies an operator to "THIS".
+ *
+ * @param[in] type The ITOK_* type of the statement.
+ *
+ * @return Non-zero if the statement is "ADD", "SUBTRACT", "MULTIPLY",
+ * "DIVIDE", or "MODULO".
+ */
+static int ip_opt_is_this_operator(int type)
+{
+    switch (type) {
+    case ITOK_ADD:
+    case ITOK_SUBTRACT:
+    case ITOK_MULTIPLY:
+    case ITOK_DIVIDE:
+    case ITOK_MODULO:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/**
+ * @brief Determines if an expression may observe the value of "THIS".
+ *
+ * @param[in] node The first node to check, may be NULL.
+ *
+ * @return Non-zero if @a node or its siblings refer to "THIS" or
+ * invoke a built-in function, which is passed the execution context.
+ */
+static int ip_opt_may_observe_this(const ip_ast_node_t *node)
+{
+    while (node) {
+        if (node->type == ITOK_THIS || node->type == ITOK_FUNCTION_INVOKE) {
+            return 1;
+        }
+        if (node->has_children) {
+            if (ip_opt_may_observe_this(node->children.left)) {
+                return 1;
+            }
+            if (!(node->dont_free_right) &&
+                    ip_opt_may_observe_this(node->children.right)) {
+                return 1;
+            }
+        }
+        node = node->next;
+    }
+    return 0;
+}
+
+/**
+ * @brief Skips over end of line markers.
+ *
+ * @param[in] node The first node to check, may be NULL.
+ * @param[in] single_line Non-zero to stop at the first end of line.
+ *
+ * @return The first node at or after @a node that is not an end of line,
+ * or NULL if @a single_line is set and @a node is an end of line.
+ */
+static ip_ast_node_t *ip_opt_skip_eols(ip_ast_node_t *node, int single_line)
+{
+    while (node && node->type == ITOK_EOL) {
+        if (single_line) {
+            return 0;
+        }
+        node = node->next;
+    }
+    return node;
+}
+
+/**
+ * @brief Finds the end of a run of statements that can be fused.
+ *
+ * @param[in] first The first statement in the run, which is "TAKE" or
+ * an operator on "THIS".
+ * @param[in] single_line Non-zero if the run must not extend past the
+ * end of the current line.
+ *
+ * @return The last statement in the run.
+ *
+ * The run consists of operators on "THIS" followed by zero or more
+ * "REPLACE" statements, optionally separated by end of line markers.
+ * An operator whose operand may observe "THIS" ends the run because
+ * "THIS" has not been updated while the run is being evaluated.
+ */
+static ip_ast_node_t *ip_opt_find_run_end
+    (ip_ast_node_t *first, int single_line)
+{
+    ip_ast_node_t *last = first;
+    ip_ast_node_t *node;
+    int replacing = 0;
+    for (;;) {
+        node = ip_opt_skip_eols(last->next, single_line);
+        if (!node) {
+            break;
+        } else if (node->type == ITOK_REPLACE) {
+            replacing = 1;
+        } else if (replacing || !ip_opt_is_this_operator(node->type) ||
+                   ip_opt_may_observe_this(node->children.right)) {
+            break;
+        }
+        last = node;
+    }
+    return last;
+}
+
+/**
+ * @brief Substitutes an expression for the reference to "THIS" in the
+ * left operand of an operator statement.
+ *
+ * @param[in,out] node The operator statement.
+ * @param[in] expr The expression that computes the value of "THIS".
+ *
+ * The left operand is "THIS", possibly wrapped in type conversions.
+ */
+static void ip_opt_substitute_this(ip_ast_node_t *node, ip_ast_node_t *expr)
+{
+    ip_ast_node_t **slot = &(node->children.left);
+    while ((*slot)->type != ITOK_THIS) {
+        slot = &((*slot)->children.left);
+    }
+    ip_ast_node_free(*slot);
+    *slot = expr;
+}
+
+/**
+ * @brief Fuses a run of statements into a single "THIS" chain statement.
+ *
+ * @param[in] first The first statement in the run.
+ * @param[in] last The last statement in the run.
+ *
+ * @return The chain statement, which takes the place of the run in the
+ * list of statements.
+ *
+ * The operators become a single expression tree in which each operator
+ * takes the previous one as its left operand.  The targets of the
+ * "REPLACE" statements become a list that is assigned the final value
+ * of "THIS".  Every node in the tree keeps the location of the statement
+ * that it came from so that run-time errors are reported on the same
+ * line as before.
+ */
+static ip_ast_node_t *ip_opt_fuse_run
+    (ip_ast_node_t *first, ip_ast_node_t *last)
+{
+    ip_ast_node_t *after = last->next;
+    ip_ast_node_t *expr = 0;
+    ip_ast_node_t *targets = 0;
+    ip_ast_node_t *last_target = 0;
+    ip_ast_node_t *chain;
+    ip_ast_node_t *node;
+    ip_ast_node_t *next;
+    unsigned char this_type = last->this_type;
+    ip_loc_t loc = first->loc;
+    for (node = first; node != after; node = next) {
+        next = node->next;
+        node->next = 0;
+        if (node->type == ITOK_TAKE) {
+            expr = node->children.left;
+            node->children.left = 0;
+            ip_ast_node_free(node);
+        } else if (node->type == ITOK_REPLACE) {
+            if (last_target) {
+                last_target->next = node->children.left;
+            } else {
+                targets = node->children.left;
+            }
+            last_target = node->children.left;
+            node->children.left = 0;
+            ip_ast_node_free(node);
+        } else if (node->type == ITOK_EOL) {
+            ip_ast_node_free(node);
+        } else {
+            if (expr) {
+                ip_opt_substitute_this(node, expr);
+            }
+            expr = node;
+        }
+    }
+    if (targets) {
+        chain = ip_ast_make_binary_statement
+            (ITOK_THIS_CHAIN, this_type, expr, targets, &loc);
+    } else {
+        chain = ip_ast_make_unary_statement
+            (ITOK_THIS_CHAIN, this_type, expr, &loc);
+    }
+    chain->next = after;
+    return chain;
+}
+
+size_t ip_opt_fuse_this_chains(ip_optimiser_t *opt, ip_program_t *program)
+{
+    ip_ast_node_t *prev = 0;
+    ip_ast_node_t *stmt = program->statements.first;
+    ip_ast_node_t *last;
+    int single_line = 0;
+    int after_input = 0;
+    size_t changes = 0;
+    (void)opt;
+    while (stmt) {
+        if ((stmt->type == ITOK_TAKE || ip_opt_is_this_operator(stmt->type))
+                && !after_input) {
+            last = ip_opt_find_run_end(stmt, single_line);
+            if (last != stmt) {
+                stmt = ip_opt_fuse_run(stmt, last);
+                if (prev) {
+                    prev->next = stmt;
+                } else {
+                    program->statements.first = stmt;
+                }
+                if (!(stmt->next)) {
+                    program->statements.last = stmt;
+                }
+                ++changes;
+            }
+        }
+
+        /* "IF" and "AT END OF INPUT" skip to the end of their line, so
+         * the end of line markers after them must stay in place.  At the
+         * end of the input, "INPUT" skips the statement after it */
+        if (stmt->type == ITOK_IF || stmt->type == ITOK_AT_END_OF_INPUT) {
+            single_line = 1;
+        } else if (stmt->type == ITOK_EOL) {
+            single_line = 0;
+        }
+        after_input = (stmt->type == ITOK_INPUT);
+        prev = stmt;
+        stmt = stmt->next;
+    }
+    return changes;
+}
@@ -0,0 +1,531 @@
+/*
+ * Copyright (C) 2025 Rhys Weatherley
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "ip_optimise.h"
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * @brief Maximum number of statements in a routine that can be inlined,
+ * not counting end of line markers.
+ */
+#define IP_OPT_INLINE_MAX_STATEMENTS 16
+
+/**
+ * @brief Information about a routine that can be inlined.
+ */
+typedef struct
+{
+    /** First statement of the routine's body, after its label */
+    ip_ast_node_t *first;
+
+    /** "RETURN" or "END PROCESS" statement that ends the body */
+    ip_ast_node_t *ret;
+
+    /** Non-zero if the body contains a classic "IF" statement */
+    int has_if;
+
+    /** Bit mask of the local variables that are read by the body */
+    unsigned reads;
+
+    /** Bit mask of the local variables that are written by the body */
+    unsigned writes;
+
+    /** "SET" statement that writes each local variable */
+    ip_ast_node_t *sets[IP_MAX_LOCALS];
+
+} ip_opt_routine_t;
+
+/**
+ * @brief Records the local variables that are read by an expression.
+ *
+ * @param[in,out] routine The routine information.
+ * @param[in] node The first node to scan, may be NULL.
+ */
+static void ip_opt_scan_local_reads
+    (ip_opt_routine_t *routine, const ip_ast_node_t *node)
+{
+    while (node) {
+        if (node->type == ITOK_ARG_NUMBER) {
+            routine->reads |= 1U << node->ivalue;
+        } else if (node->has_children) {
+            ip_opt_scan_local_reads(routine, node->children.left);
+            if (!(node->dont_free_right)) {
+                ip_opt_scan_local_reads(routine, node->children.right);
+            }
+        }
+        node = node->next;
+    }
+}
+
+/**
+ * @brief Determines if a "CALL" statement calls a built-in statement.
+ *
+ * @param[in] node The "CALL" statement.
+ *
+ * @return Non-zero if @a node calls a built-in.
+ */
+static int ip_opt_is_builtin_call(const ip_ast_node_t *node)
+{
+    const ip_ast_node_t *target = node->children.left;
+    return target->type == ITOK_LABEL && !(target->label->node) &&
+           target->label->builtin != 0;
+}
+
+/**
+ * @brief Analyses a routine to determine if it can be inlined.
+ *
+ * @param[in] label The label for the routine.
+ * @param[out] routine Returns information about the routine.
+ *
+ * @return Non-zero if the routine can be inlined.
+ *
+ * The body must be straight-line code that ends in an unconditional
+ * "RETURN" or "END PROCESS".  The only calls that it may make are to
+ * built-in statements, so the routine cannot be recursive.  Each local
+ * variable that is not an argument must be written once by a "SET"
+ * before it is read, so that it can be replaced with a temporary.
+ */
+static int ip_opt_analyse_routine
+    (const ip_label_t *label, ip_opt_routine_t *routine)
+{
+    ip_ast_node_t *stmt;
+    ip_ast_node_t *target;
+    unsigned bit;
+    int conditional = 0;
+    int count = 0;
+    memset(routine, 0, sizeof(ip_opt_routine_t));
+    if (!(label->node) || label->node->type != ITOK_LABEL) {
+        return 0;
+    }
+    routine->first = label->node->next;
+    for (stmt = routine->first; stmt != 0; stmt = stmt->next) {
+        switch (stmt->type) {
+        case ITOK_EOL:
+            conditional = 0;
+            continue;
+
+        case ITOK_RETURN:
+        case ITOK_END_PROCESS:
+            if (conditional) {
+                return 0;
+            }
+            if (stmt->has_children) {
+                ip_opt_scan_local_reads(routine, stmt->children.left);
+            }
+            routine->ret = stmt;
+            return 1;
+
+        case ITOK_IF:
+            conditional = 1;
+            routine->has_if = 1;
+            ip_opt_scan_local_reads(routine, stmt->children.left);
+            break;
+
+        case ITOK_SET:
+        case ITOK_REPLACE:
+            ip_opt_scan_local_reads(routine, stmt->children.right);
+            target = stmt->children.left;
+            if (target->type == ITOK_ARG_NUMBER) {
+                bit = 1U << target->ivalue;
+                if (stmt->type == ITOK_REPLACE || conditional ||
+                        (routine->reads & bit) != 0 ||
+                        (routine->writes & bit) != 0) {
+                    return 0;
+                }
+                routine->writes |= bit;
+                routine->sets[target->ivalue] = stmt;
+            } else {
+                ip_opt_scan_local_reads(routine, target);
+            }
+            break;
+
+        case ITOK_CALL:
+        case ITOK_EXECUTE_PROCESS:
+            if (!ip_opt_is_builtin_call(stmt)) {
+                return 0;
+            }
+            ip_opt_scan_local_reads(routine, stmt->children.right);
+            break;
+
+        case ITOK_TAKE:
+        case ITOK_ADD:
+        case ITOK_SUBTRACT:
+        case ITOK_MULTIPLY:
+        case ITOK_DIVIDE:
+        case ITOK_MODULO:
+        case ITOK_LENGTH_OF:
+        case ITOK_OUTPUT:
+        case ITOK_OUTPUT_NO_EOL:
+        case ITOK_PUNCH:
+            if (stmt->has_children) {
+                ip_opt_scan_local_reads(routine, stmt->children.left);
+                ip_opt_scan_local_reads(routine, stmt->children.right);
+            }
+            break;
+
+        default:
+            return 0;
+        }
+        if (++count > IP_OPT_INLINE_MAX_STATEMENTS) {
+            return 0;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Information about a call site that is being inlined.
+ */
+typedef struct
+{
+    /** Argument expressions for the call, indexed by local variable */
+    ip_ast_node_t *args[IP_MAX_LOCALS];
+
+    /** Number of arguments to the call */
+    int num_args;
+
+    /** Types of the local variables, or IP_TYPE_UNKNOWN if unused */
+    unsigned char types[IP_MAX_LOCALS];
+
+    /** Temporary variables that replace the local variables, or NULL
+     * if the local is an argument that is replaced with a constant */
+    ip_var_t *temps[IP_MAX_LOCALS];
+
+} ip_opt_call_site_t;
+
+/**
+ * @brief Collects the arguments to a call.
+ *
+ * @param[in,out] site The call site information.
+ * @param[in] arg The argument list from the "CALL" node, may be NULL.
+ */
+static void ip_opt_collect_args(ip_opt_call_site_t *site, ip_ast_node_t *arg)
+{
+    if (!arg) {
+        return;
+    } else if (arg->type == ITOK_ARG_LIST) {
+        ip_opt_collect_args(site, arg->children.left);
+        ip_opt_collect_args(site, arg->children.right);
+    } else {
+        site->args[arg->children.left->ivalue] = arg->children.right;
+        ++(site->num_args);
+    }
+}
+
+/**
+ * @brief Determines if a type can be held in a temporary variable.
+ *
+ * @param[in] type The type of a value.
+ *
+ * @return Non-zero if the type is integer, floating-point, or string.
+ */
+static int ip_opt_is_temp_type(unsigned char type)
+{
+    return type == IP_TYPE_INT || type == IP_TYPE_FLOAT ||
+           type == IP_TYPE_STRING;
+}
+
+/**
+ * @brief Determines if an argument is a constant that can be substituted
+ * directly for the local variable.
+ *
+ * @param[in] node The argument expression.
+ *
+ * @return Non-zero if @a node is a constant.
+ */
+static int ip_opt_is_constant_arg(const ip_ast_node_t *node)
+{
+    return node->type == ITOK_INT_VALUE || node->type == ITOK_FLOAT_VALUE ||
+           node->type == ITOK_STR_VALUE;
+}
+
+/**
+ * @brief Determines the types of the local variables at a call site.
+ *
+ * @param[in] routine The routine that is being called.
+ * @param[in,out] site The call site information.
+ *
+ * @return Non-zero if the call can be inlined.
+ *
+ * Every local variable that is read must be an argument or be written
+ * by the routine, and its run-time type must be known so that it can
+ * be held in a typed temporary.  Calls that would fail when the routine
+ * reads a local that was not passed are left alone so that the error
+ * is reported as before.
+ */
+static int ip_opt_resolve_locals
+    (const ip_opt_routine_t *routine, ip_opt_call_site_t *site)
+{
+    const ip_ast_node_t *stmt;
+    const ip_ast_node_t *value;
+    unsigned char *type;
+    unsigned bit;
+    int index;
+
+    /* Arguments have the type of the expression that is passed */
+    for (index = 0; index < IP_MAX_LOCALS; ++index) {
+        bit = 1U << index;
+        site->types[index] = IP_TYPE_UNKNOWN;
+        if (index < site->num_args) {
+            if ((routine->writes & bit) != 0) {
+                return 0;
+            }
+            site->types[index] = site->args[index]->value_type;
+            if (!ip_opt_is_temp_type(site->types[index])) {
+                return 0;
+            }
+        } else if ((routine->reads & bit) != 0 &&
+                   (routine->writes & bit) == 0) {
+            return 0;
+        }
+    }
+
+    /* Other locals have the type of the value that is assigned to them.
+     * The "SET" statements are visited in order because each one can
+     * only use the locals that have been assigned before it */
+    for (stmt = routine->first; stmt != routine->ret; stmt = stmt->next) {
+        if (stmt->type != ITOK_SET ||
+                stmt->children.left->type != ITOK_ARG_NUMBER) {
+            continue;
+        }
+        type = &(site->types[stmt->children.left->ivalue]);
+        value = stmt->children.right;
+        if (value->type == ITOK_ARG_NUMBER) {
+            *type = site->types[value->ivalue];
+        } else {
+            *type = value->value_type;
+        }
+        if (!ip_opt_is_temp_type(*type)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief Creates a temporary variable for a local at an inlined call site.
+ *
+ * @param[in,out] program The program.
+ * @param[in] type The type of the temporary.
+ * @param[in] index The index of the local variable.
+ *
+ * @return The new variable.  Its name starts with "@" so that it cannot
+ * clash with the names of variables in the program.
+ */
+static ip_var_t *ip_opt_make_temp
+    (ip_program_t *program, unsigned char type, int index)
+{
+    char name[64];
+    ip_var_t *var;
+    size_t counter = program->vars.num_vars;
+    do {
+        snprintf(name, sizeof(name), "@%d INLINE %lu",
+                 index + 1, (unsigned long)(counter++));
+        var = ip_var_create(&(program->vars), name, type);
+    } while (!var);
+    return var;
+}
+
+/**
+ * @brief Replaces references to local variables with their values at
+ * an inlined call site.
+ *
+ * @param[in] site The call site information.
+ * @param[in,out] node The first node to replace within, may be NULL.
+ *
+ * @return The replacement for @a node.
+ */
+static ip_ast_node_t *ip_opt_replace_locals
+    (const ip_opt_call_site_t *site, ip_ast_node_t *node)
+{
+    ip_ast_node_t *first = node;
+    ip_ast_node_t *prev = 0;
+    ip_ast_node_t *replacement;
+    while (node) {
+        if (node->type == ITOK_ARG_NUMBER) {
+            if (site->temps[node->ivalue]) {
+                replacement = ip_ast_make_variable
+                    (site->temps[node->ivalue], &(node->loc));
+            } else {
+                replacement = ip_ast_copy(site->args[node->ivalue]);
+            }
+            replacement->this_type = node->this_type;
+            replacement->next = node->next;
+            node->next = 0;
+            ip_ast_node_free(node);
+            node = replacement;
+        } else if (node->has_children) {
+            node->children.left =
+                ip_opt_replace_locals(site, node->children.left);
+            if (!(node->dont_free_right)) {
+                node->children.right =
+                    ip_opt_replace_locals(site, node->children.right);
+            }
+        }
+        if (prev) {
+            prev->next = node;
+        } else {
+            first = node;
+        }
+        prev = node;
+        node = node->next;
+    }
+    return first;
+}
+
+/**
+ * @brief Builds the code that replaces an inlined call.
+ *
+ * @param[in] routine The routine that is being called.
+ * @param[in,out] site The call site information.
+ * @param[in] call The "CALL" statement.
+ * @param[out] list Returns the list of statements.
+ *
+ * Arguments that are not constants are evaluated into temporaries at
+ * the location of the "CALL", so errors in them are reported on the
+ * same line and in the same order as before.  The statements of the
+ * body keep their own locations.  A "RETURN" with a value becomes a
+ * "TAKE" of that value, which leaves it in "THIS" as before.
+ */
+static void ip_opt_build_inline
+    (const ip_opt_routine_t *routine, ip_opt_call_site_t *site,
+     ip_ast_node_t *call, ip_ast_list_t *list)
+{
+    ip_ast_node_t *stmt;
+    ip_ast_node_t *copy;
+    int line_has_if = 0;
+    int index;
+    ip_ast_list_init(list);
+
+    /* Evaluate the arguments into temporaries */
+    for (index = 0; index < site->num_args; ++index) {
+        if (ip_opt_is_constant_arg(site->args[index])) {
+            continue;
+        }
+        copy = ip_ast_make_binary_statement
+            (ITOK_SET, IP_TYPE_DYNAMIC,
+             ip_ast_make_variable(site->temps[index], &(call->loc)),
+             ip_ast_copy(site->args[index]), &(call->loc));
+        ip_ast_list_add(list, copy);
+    }
+
+    /* Copy the body of the routine.  End of line markers are only
+     * needed to end the lines that contain a classic "IF" */
+    for (stmt = routine->first; stmt != routine->ret; stmt = stmt->next) {
+        if (stmt->type == ITOK_EOL) {
+            if (!line_has_if) {
+                continue;
+            }
+            line_has_if = 0;
+        } else if (stmt->type == ITOK_IF) {
+            line_has_if = 1;
+        }
+        ip_ast_list_add(list, ip_opt_replace_locals(site, ip_ast_copy(stmt)));
+    }
+
+    /* Convert "RETURN value" into "TAKE value" */
+    stmt = routine->ret;
+    if (stmt->has_children && stmt->children.left) {
+        copy = ip_ast_make_unary_statement
+            (ITOK_TAKE, IP_TYPE_DYNAMIC,
+             ip_opt_replace_locals(site, ip_ast_copy(stmt->children.left)),
+             &(stmt->loc));
+        ip_ast_list_add(list, copy);
+    }
+}
+
+size_t ip_opt_inline_routines(ip_optimiser_t *opt, ip_program_t *program)
+{
+    ip_opt_routine_t routine;
+    ip_opt_call_site_t site;
+    ip_ast_node_t *prev = 0;
+    ip_ast_node_t *stmt = program->statements.first;
+    ip_ast_node_t *next;
+    ip_ast_node_t *replacement;
+    ip_ast_list_t list;
+    int single_line = 0;
+    int after_input = 0;
+    int index;
+    size_t changes = 0;
+    (void)opt;
+    while (stmt) {
+        next = stmt->next;
+        if ((stmt->type == ITOK_CALL || stmt->type == ITOK_EXECUTE_PROCESS) &&
+                stmt->children.left->type == ITOK_LABEL &&
+                !after_input &&
+                ip_opt_analyse_routine(stmt->children.left->label, &routine) &&
+                (!(routine.has_if) || !single_line)) {
+            memset(&site, 0, sizeof(site));
+            ip_opt_collect_args(&site, stmt->children.right);
+            if (ip_opt_resolve_locals(&routine, &site)) {
+                for (index = 0; index < IP_MAX_LOCALS; ++index) {
+                    if (site.types[index] != IP_TYPE_UNKNOWN &&
+                            (index >= site.num_args ||
+                             !ip_opt_is_constant_arg(site.args[index]))) {
+                        site.temps[index] = ip_opt_make_temp
+                            (program, site.types[index], index);
+                    }
+                }
+                ip_opt_build_inline(&routine, &site, stmt, &list);
+
+                /* Splice the inlined code in place of the "CALL" */
+                if (list.first) {
+                    list.last->next = next;
+                    replacement = list.first;
+                } else {
+                    replacement = next;
+                }
+                if (prev) {
+                    prev->next = replacement;
+                } else {
+                    program->statements.first = replacement;
+                }
+                if (list.first) {
+                    prev = list.last;
+                }
+                if (!next) {
+                    program->statements.last = prev;
+                }
+                stmt->next = 0;
+                ip_ast_node_free(stmt);
+                after_input = 0;
+                stmt = next;
+                ++changes;
+                continue;
+            }
+        }
+
+        /* "IF" and "AT END OF INPUT" skip to the end of their line and
+         * "INPUT" may skip the statement after it, so an inlined body
+         * with end of line markers of its own cannot be placed there */
+        if (stmt->type == ITOK_IF || stmt->type == ITOK_AT_END_OF_INPUT) {
+            single_line = 1;
+        } else if (stmt->type == ITOK_EOL) {
+            single_line = 0;
+        }
+        after_input = (stmt->type == ITOK_INPUT);
+        prev = stmt;
+        stmt = next;
+    }
+    return changes;
+}
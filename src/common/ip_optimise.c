@@ -0,0 +1,205 @@
+/*
+ * Copyright (C) 2025 Rhys Weatherley
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "ip_optimise.h"
+#include <string.h>
+#include <time.h>
+
+/**
+ * @brief Table of all optimisation passes, in the order that they are run.
+ *
+ * The table is terminated by an entry with a NULL name.
+ */
+static const ip_opt_pass_t ip_opt_passes[] = {
+    {"inline-routines",
+     "Copy the bodies of small routines into their call sites",
+     2, ip_opt_inline_routines},
+    {"constant-folding",
+     "Evaluate operators on constant operands ahead of time",
+     1, ip_opt_fold_constants},
+    {"constant-propagation",
+     "Replace variables that hold constants with their values",
+     1, ip_opt_propagate_constants},
+    {"chain-fusion",
+     "Fuse runs of statements that operate on THIS into one expression",
+     2, ip_opt_fuse_this_chains},
+    {0, 0, 0, 0}
+};
+
+/**
+ * @brief Gets the current time in microseconds for timing the passes.
+ *
+ * @return The current time.
+ */
+static unsigned long ip_opt_usecs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned long)(now.tv_sec * 1000000UL + now.tv_nsec / 1000);
+}
+
+/**
+ * @brief Finds a pass by name.
+ *
+ * @param[in] name The name of the pass.
+ *
+ * @return The index of the pass in the table, or -1 if not found.
+ */
+static int ip_opt_find_pass(const char *name)
+{
+    int index;
+    for (index = 0; ip_opt_passes[index].name != 0; ++index) {
+        if (!strcmp(ip_opt_passes[index].name, name)) {
+            return index;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Determines if the pass at a specific index is enabled.
+ *
+ * @param[in] opt The optimiser.
+ * @param[in] index The index of the pass in the table.
+ *
+ * @return Non-zero if the pass is enabled.
+ */
+static int ip_opt_pass_enabled(const ip_optimiser_t *opt, int index)
+{
+    if (opt->enables[index] >= 0) {
+        return opt->enables[index];
+    }
+    return opt->level >= ip_opt_passes[index].level;
+}
+
+/**
+ * @brief Dumps the program to the optimiser's dump stream.
+ *
+ * @param[in] opt The optimiser.
+ * @param[in] program The program to dump.
+ * @param[in] when Describes when the dump is occurring.
+ * @param[in] name Name of the pass, or NULL for the initial dump.
+ */
+static void ip_opt_dump
+    (const ip_optimiser_t *opt, const ip_program_t *program,
+     const char *when, const char *name)
+{
+    if (name) {
+        fprintf(opt->dump, "=== %s %s ===\n", when, name);
+    } else {
+        fprintf(opt->dump, "=== %s ===\n", when);
+    }
+    ip_ast_dump(&(program->statements), opt->dump);
+}
+
+void ip_optimiser_init(ip_optimiser_t *opt, int level)
+{
+    memset(opt, 0, sizeof(ip_optimiser_t));
+    if (level < 0) {
+        level = 0;
+    } else if (level > IP_OPT_MAX_LEVEL) {
+        level = IP_OPT_MAX_LEVEL;
+    }
+    opt->level = level;
+    memset(opt->enables, -1, sizeof(opt->enables));
+}
+
+int ip_optimiser_set_pass(ip_optimiser_t *opt, const char *name, int enable)
+{
+    int index = ip_opt_find_pass(name);
+    if (index < 0) {
+        return 0;
+    }
+    opt->enables[index] = (enable != 0);
+    return 1;
+}
+
+int ip_optimiser_is_enabled(const ip_optimiser_t *opt, const char *name)
+{
+    int index = ip_opt_find_pass(name);
+    if (index < 0) {
+        return 0;
+    }
+    return ip_opt_pass_enabled(opt, index);
+}
+
+size_t ip_optimise_program(ip_optimiser_t *opt, ip_program_t *program)
+{
+    const ip_opt_pass_t *pass;
+    ip_opt_stats_t *stats;
+    size_t total = 0;
+    int index;
+    if (opt->dump) {
+        ip_opt_dump(opt, program, "before optimisation", 0);
+    }
+    for (index = 0; ip_opt_passes[index].name != 0; ++index) {
+        if (!ip_opt_pass_enabled(opt, index)) {
+            continue;
+        }
+        pass = &(ip_opt_passes[index]);
+        stats = &(opt->stats[index]);
+        stats->ran = 1;
+        stats->nodes_before = ip_ast_count_nodes(program->statements.first);
+        stats->usecs = ip_opt_usecs();
+        stats->changes = (*(pass->run))(opt, program);
+        stats->usecs = ip_opt_usecs() - stats->usecs;
+        stats->nodes_after = ip_ast_count_nodes(program->statements.first);
+        total += stats->changes;
+        if (opt->dump) {
+            ip_opt_dump(opt, program, "after", pass->name);
+        }
+    }
+    return total;
+}
+
+void ip_optimiser_report(const ip_optimiser_t *opt, FILE *out)
+{
+    const ip_opt_stats_t *stats;
+    int index;
+    fprintf(out, "Optimisation level %d:\n", opt->level);
+    fprintf(out, "%-24s %10s %12s %12s %10s\n",
+            "Pass", "Changes", "Nodes before", "Nodes after", "Usecs");
+    for (index = 0; ip_opt_passes[index].name != 0; ++index) {
+        stats = &(opt->stats[index]);
+        if (stats->ran) {
+            fprintf(out, "%-24s %10lu %12lu %12lu %10lu\n",
+                    ip_opt_passes[index].name,
+                    (unsigned long)(stats->changes),
+                    (unsigned long)(stats->nodes_before),
+                    (unsigned long)(stats->nodes_after),
+                    stats->usecs);
+        } else {
+            fprintf(out, "%-24s %10s\n", ip_opt_passes[index].name,
+                    "disabled");
+        }
+    }
+}
+
+void ip_optimiser_list_passes(FILE *out)
+{
+    int index;
+    for (index = 0; ip_opt_passes[index].name != 0; ++index) {
+        fprintf(out, "%-24s -O%d  %s\n", ip_opt_passes[index].name,
+                ip_opt_passes[index].level,
+                ip_opt_passes[index].description);
+    }
+}
@@ -0,0 +1,245 @@
+/*
+ * Copyright (C) 2025 Rhys Weatherley
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef INTERPROGRAM_OPTIMISE_H
+#define INTERPROGRAM_OPTIMISE_H
+
+#include "ip_program.h"
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Highest optimisation level that is supported.
+ */
+#define IP_OPT_MAX_LEVEL 2
+
+/**
+ * @brief Maximum number of passes that the optimiser can have.
+ */
+#define IP_OPT_MAX_PASSES 16
+
+/**
+ * @brief State of the optimiser for a program.
+ */
+typedef struct ip_optimiser_s ip_optimiser_t;
+
+/**
+ * @brief Function that runs an optimisation pass over a program.
+ *
+ * @param[in,out] opt The optimiser.
+ * @param[in,out] program The program to optimise.
+ *
+ * @return The number of changes that were made to the program.
+ */
+typedef size_t (*ip_opt_pass_func_t)(ip_optimiser_t *opt, ip_program_t *program);
+
+/**
+ * @brief Information about an optimisation pass.
+ */
+typedef struct
+{
+    /** Name of the pass for command-line switches and reports */
+    const char *name;
+
+    /** Short description of what the pass does */
+    const char *description;
+
+    /** Lowest optimisation level that enables the pass by default */
+    int level;
+
+    /** Function that runs the pass */
+    ip_opt_pass_func_t run;
+
+} ip_opt_pass_t;
+
+/**
+ * @brief Statistics for a single optimisation pass.
+ */
+typedef struct
+{
+    /** Non-zero if the pass was run */
+    int ran;
+
+    /** Number of changes that the pass made to the program */
+    size_t changes;
+
+    /** Number of nodes in the program before the pass was run */
+    size_t nodes_before;
+
+    /** Number of nodes in the program after the pass was run */
+    size_t nodes_after;
+
+    /** Number of microseconds that the pass took to run */
+    unsigned long usecs;
+
+} ip_opt_stats_t;
+
+struct ip_optimiser_s
+{
+    /** Optimisation level from 0 to IP_OPT_MAX_LEVEL */
+    int level;
+
+    /** Per-pass overrides: -1 for the default, 0 to disable, 1 to enable */
+    signed char enables[IP_OPT_MAX_PASSES];
+
+    /** Stream to dump the program to before and after each pass, or NULL */
+    FILE *dump;
+
+    /** Statistics for each pass, indexed by position in the pass table */
+    ip_opt_stats_t stats[IP_OPT_MAX_PASSES];
+};
+
+/**
+ * @brief Initialises an optimiser.
+ *
+ * @param[out] opt The optimiser to initialise.
+ * @param[in] level The optimisation level, which is clamped to the
+ * range 0 to IP_OPT_MAX_LEVEL.
+ *
+ * Level 0 runs no passes, which leaves the program exactly as the
+ * parser built it.
+ */
+void ip_optimiser_init(ip_optimiser_t *opt, int level);
+
+/**
+ * @brief Enables or disables a pass, overriding the optimisation level.
+ *
+ * @param[in,out] opt The optimiser.
+ * @param[in] name The name of the pass.
+ * @param[in] enable Non-zero to enable the pass, zero to disable it.
+ *
+ * @return Non-zero if the pass was found, or zero if @a name is unknown.
+ */
+int ip_optimiser_set_pass(ip_optimiser_t *opt, const char *name, int enable);
+
+/**
+ * @brief Determines if a pass is enabled.
+ *
+ * @param[in] opt The optimiser.
+ * @param[in] name The name of the pass.
+ *
+ * @return Non-zero if the pass is enabled, or zero if the pass is
+ * disabled or @a name is unknown.
+ */
+int ip_optimiser_is_enabled(const ip_optimiser_t *opt, const char *name);
+
+/**
+ * @brief Runs the enabled optimisation passes over a program.
+ *
+ * @param[in,out] opt The optimiser.
+ * @param[in,out] program The program to optimise, which must have
+ * parsed without errors.
+ *
+ * @return The total number of changes that were made to the program.
+ *
+ * The passes are run in the order in which they appear in the pass table.
+ * If @a opt has a dump stream, then the program is dumped to it before
+ * the first pass and after each pass that was run.
+ */
+size_t ip_optimise_program(ip_optimiser_t *opt, ip_program_t *program);
+
+/**
+ * @brief Writes a report of the statistics for each pass.
+ *
+ * @param[in] opt The optimiser.
+ * @param[in] out The stream to write the report to.
+ */
+void ip_optimiser_report(const ip_optimiser_t *opt, FILE *out);
+
+/**
+ * @brief Lists the available passes with their levels and descriptions.
+ *
+ * @param[in] out The stream to write the list to.
+ */
+void ip_optimiser_list_passes(FILE *out);
+
+/**
+ * @brief Optimisation pass that folds constant sub-expressions.
+ *
+ * @param[in,out] opt The optimiser.
+ * @param[in,out] program The program to optimise.
+ *
+ * @return The number of sub-expressions that were folded.
+ *
+ * Operators and casts whose operands are all numeric constants are
+ * evaluated ahead of time with the same code that evaluates them at
+ * run time.  Expressions that would fail, such as division by zero,
+ * are left for the error to be reported when the program is run.
+ */
+size_t ip_opt_fold_constants(ip_optimiser_t *opt, ip_program_t *program);
+
+/**
+ * @brief Optimisation pass that propagates the values of constant
+ * variables into the expressions that use them.
+ *
+ * @param[in,out] opt The optimiser.
+ * @param[in,out] program The program to optimise.
+ *
+ * @return The number of variable references that were replaced, plus
+ * the number of sub-expressions that were folded as a result.
+ *
+ * Numeric variables that are never written and have a fixed initial
+ * value like "PI" are propagated, as are variables that are set exactly
+ * once to a constant in the straight-line code at the start of the
+ * program, before the first label or transfer of control.
+ */
+size_t ip_opt_propagate_constants(ip_optimiser_t *opt, ip_program_t *program);
+
+/**
+ * @brief Optimisation pass that inlines small routines at their call sites.
+ *
+ * @param[in,out] opt The optimiser.
+ * @param[in,out] program The program to optimise.
+ *
+ * @return The number of calls that were inlined.
+ *
+ * A routine can be inlined if its body is a short run of straight-line
+ * statements that ends in "RETURN" and only calls built-in statements.
+ * References to local variables are replaced with constant arguments or
+ * with temporaries that are assigned at the call site.
+ */
+size_t ip_opt_inline_routines(ip_optimiser_t *opt, ip_program_t *program);
+
+/**
+ * @brief Optimisation pass that fuses chains of statements that operate
+ * on "THIS" into single expressions.
+ *
+ * @param[in,out] opt The optimiser.
+ * @param[in,out] program The program to optimise.
+ *
+ * @return The number of chains that were fused.
+ *
+ * A straight-line run like "TAKE A", "ADD B", "MULTIPLY BY C",
+ * "REPLACE D" is replaced with a single ITOK_THIS_CHAIN statement that
+ * evaluates the whole run as one expression tree, stores the result in
+ * "THIS" once, and then assigns it to the "REPLACE" targets.
+ */
+size_t ip_opt_fuse_this_chains(ip_optimiser_t *opt, ip_program_t *program);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -25,6 +25,14 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/** Size of the blocks to use when reading program source from a pipe */
+#define IP_PARSE_READ_BLOCK_SIZE 65536
 
 /* Forward declarations */
 static ip_ast_node_t *ip_parse_extended_expression(ip_parser_t *parser);
@@ -1034,7 +1042,7 @@ static ip_ast_node_t *ip_parse_label_name(ip_parser_t *parser, int routine_call)
     } else if (parser->tokeniser.token == ITOK_ROUTINE_NAME && routine_call) {
         /* Registered routine name */
         name = parser->tokeniser.token_info->name;
-        label = ip_label_lookup_by_name(&(parser->program->labels), name);
+        label = ip_program_lookup_label(parser->program, name);
         if (!label) {
             label = ip_label_create_by_name
                 (&(parser->program->labels), name);
@@ -1044,7 +1052,7 @@ static ip_ast_node_t *ip_parse_label_name(ip_parser_t *parser, int routine_call)
                (parser->flags & ITOK_TYPE_EXTENSION) != 0) {
         /* Named label */
         name = parser->tokeniser.token_info->name;
-        label = ip_label_lookup_by_name(&(parser->program->labels), name);
+        label = ip_program_lookup_label(parser->program, name);
         if (!label) {
             label = ip_label_create_by_name
                 (&(parser->program->labels), name);
@@ -1055,7 +1063,7 @@ static ip_ast_node_t *ip_parse_label_name(ip_parser_t *parser, int routine_call)
         /* Named label using a string */
         if (ip_parse_verify_label_string(parser)) {
             name = parser->tokeniser.token_info->name;
-            label = ip_label_lookup_by_name(&(parser->program->labels), name);
+            label = ip_program_lookup_label(parser->program, name);
             if (!label) {
                 label = ip_label_create_by_name
                     (&(parser->program->labels), name);
@@ -1193,6 +1201,35 @@ static ip_ast_node_t *ip_parse_extract_substring(ip_parser_t *parser)
     return node;
 }
 
+/*
+ * FillRandomStatement ::= "FILL ARRAY WITH RANDOM NUMBERS" VAR-NAME
+ */
+static ip_ast_node_t *ip_parse_fill_random(ip_parser_t *parser)
+{
+    ip_var_t *var;
+    ip_ast_node_t *node;
+
+    /* Skip "FILL ARRAY WITH RANDOM NUMBERS" and look for the array name */
+    ip_parse_get_next(parser, ITOK_TYPE_EXPRESSION);
+    if (parser->tokeniser.token != ITOK_VAR_NAME) {
+        ip_error_near(parser, "array name expected");
+        return 0;
+    }
+    var = ip_var_lookup
+        (&(parser->program->vars), parser->tokeniser.token_info->name);
+    if (!var || ip_var_get_type(var) != IP_TYPE_ARRAY_OF_FLOAT) {
+        ip_error(parser, "'%s' is not an array of floating-point values",
+                 parser->tokeniser.token_info->name);
+        ip_parse_get_next(parser, ITOK_TYPE_STATEMENT);
+        return 0;
+    }
+    node = ip_ast_make_variable(var, &(parser->tokeniser.loc));
+    node = ip_ast_make_unary_statement
+        (ITOK_FILL_RANDOM, IP_TYPE_UNKNOWN, node, &(parser->tokeniser.loc));
+    ip_parse_get_next(parser, ITOK_TYPE_STATEMENT);
+    return node;
+}
+
 /*
  * Statement ::=
  *      AssignmentStatement
@@ -1201,6 +1238,7 @@ static ip_ast_node_t *ip_parse_extract_substring(ip_parser_t *parser)
  *    | ControlFlowStatement
  *    | InputOutputStatement
  *    | StringStatement
+ *    | FillRandomStatement             # Extension
  *    | "&" ...
  *
  * AssignmentStatement ::=
@@ -1376,8 +1414,8 @@ static ip_ast_node_t *ip_parse_statement(ip_parser_t *parser)
     case ITOK_ROUTINE_NAME:
         /* This might be the name of a routine that was declared with
          * "SYMBOLS FOR ROUTINES".  We can skip the "CALL" if it is. */
-        label = ip_label_lookup_by_name
-            (&(parser->program->labels), parser->tokeniser.token_info->name);
+        label = ip_program_lookup_label
+            (parser->program, parser->tokeniser.token_info->name);
         if (label && label->base.type == IP_TYPE_ROUTINE) {
             node = ip_parse_call_statement(parser, 1);
         } else {
@@ -1545,6 +1583,12 @@ static ip_ast_node_t *ip_parse_statement(ip_parser_t *parser)
         node->this_type = IP_TYPE_INT;
         break;
 
+    /* ------------- Other statements ------------- */
+
+    case ITOK_FILL_RANDOM:
+        node = ip_parse_fill_random(parser);
+        break;
+
     default:
         /* No idea what this is, so report an error for the current token */
         ip_error_near(parser, 0);
@@ -1607,7 +1651,7 @@ static void ip_parse_statement_label(ip_parser_t *parser)
                (parser->flags & ITOK_TYPE_EXTENSION) != 0) {
         /* Label that is referred to by name */
         name = parser->tokeniser.token_info->name;
-        label = ip_label_lookup_by_name(&(parser->program->labels), name);
+        label = ip_program_lookup_label(parser->program, name);
         if (label) {
             if (ip_label_is_defined(label)) {
                 ip_error(parser, "label '%s' is already defined", name);
@@ -1756,6 +1800,10 @@ static void ip_parse_symbols(ip_parser_t *parser)
                     ip_parse_verify_label_string(parser))) {
             /* Look up the name and create a new variable if necessary */
             name = parser->tokeniser.token_info->name;
+            if (type == IP_TYPE_ROUTINE) {
+                /* Routine symbols cannot redeclare built-in routines */
+                ip_program_lookup_label(parser->program, name);
+            }
             var = ip_var_lookup(&(parser->program->vars), name);
             if (var) {
                 ip_error(parser, "symbol '%s' is already declared", name);
@@ -1764,8 +1812,8 @@ static void ip_parse_symbols(ip_parser_t *parser)
             }
             if (type == IP_TYPE_ROUTINE) {
                 /* Also create a routine label with the same name */
-                ip_label_t *label = ip_label_lookup_by_name
-                    (&(parser->program->labels), name);
+                ip_label_t *label = ip_program_lookup_label
+                    (parser->program, name);
                 if (!label) {
                     label = ip_label_create_by_name
                         (&(parser->program->labels), name);
@@ -2021,10 +2069,7 @@ void ip_parse_preliminary_statements
 
             /* Once we see the title line we know if we are using the
              * Classic or Extended INTERPROGRAM syntax.  Register built-ins. */
-            if (register_builtins) {
-                (*register_builtins)(parser, parser->flags);
-                ip_parse_register_builtins(parser);
-            }
+            ip_parse_register_builtins(parser, register_builtins);
             break;
 
         case ITOK_PRELIM_2:
@@ -2137,66 +2182,149 @@ void ip_parse_check_open_blocks(ip_parser_t *parser)
     }
 }
 
-static void ip_parse_register_builtin(ip_parser_t *parser, ip_symbol_t *symbol)
+/**
+ * @brief Adds the name of a built-in to a parser's own word trie.
+ *
+ * @param[in] symbol The built-in to add.
+ * @param[in,out] user_data The parser.
+ */
+static void ip_parse_add_builtin_name(ip_symbol_t *symbol, void *user_data)
 {
-    if (symbol && symbol != &(parser->program->builtins.nil)) {
-        ip_parse_register_builtin(parser, symbol->left);
-        ip_tokeniser_register_routine_name(&(parser->tokeniser), symbol->name);
-        ip_parse_register_builtin(parser, symbol->right);
+    ip_parser_t *parser = (ip_parser_t *)user_data;
+    if (strchr(symbol->name, ' ') != 0) {
+        ip_word_trie_insert(&(parser->tokeniser.routines), symbol->name);
     }
 }
 
-void ip_parse_register_builtins(ip_parser_t *parser)
+/**
+ * @brief Registers built-ins with a private program while building a
+ * shared registry.
+ *
+ * @param[in,out] program The program to register the built-ins with.
+ * @param[in] options Options for the built-ins to register.
+ * @param[in] user_data Points to the parser's registration callback.
+ */
+static void ip_parse_init_registry
+    (ip_program_t *program, unsigned options, void *user_data)
 {
-    ip_parse_register_builtin(parser, parser->program->builtins.root.right);
+    ip_parse_register_builtins_t register_builtins =
+        *((ip_parse_register_builtins_t *)user_data);
+    ip_parser_t parser;
+    ip_parse_init(&parser);
+    parser.program = program;
+    parser.flags = options;
+    (*register_builtins)(&parser, options);
+    ip_parse_free(&parser);
 }
 
-static int ip_parse_read_stdio(FILE *input)
+void ip_parse_register_builtins
+    (ip_parser_t *parser, ip_parse_register_builtins_t register_builtins)
 {
-    return getc(input);
+    const ip_builtin_registry_t *registry;
+    const ip_symbol_table_t *builtins;
+
+    /* Nothing to do if there is no built-in library */
+    if (!register_builtins) {
+        return;
+    }
+
+    /* Refer to the shared registry for these built-ins, building it
+     * with the callback the first time that we see the callback */
+    parser->program->options = parser->flags;
+    registry = ip_program_register_shared
+        (parser->program, (const void *)register_builtins, parser->flags,
+         ip_parse_init_registry, &register_builtins);
+    if (registry) {
+        parser->tokeniser.shared_routines = &(registry->names);
+        return;
+    }
+
+    /* The built-ins were registered with the program directly,
+     * so register the names with this tokeniser only */
+    builtins = &(parser->program->builtins);
+    ip_symbol_table_visit(builtins, ip_parse_add_builtin_name, parser);
 }
 
-unsigned long ip_parse_program_file
-    (ip_program_t *program, const char *filename, unsigned options,
-     int argc, char **argv, ip_parse_register_builtins_t register_builtins)
+/**
+ * @brief Loads the program source from a file descriptor into memory.
+ *
+ * @param[in] fd The file descriptor to load from.
+ * @param[out] len Returns the length of the source in bytes.
+ * @param[out] mapped Returns non-zero if the source was mapped with
+ * mmap() and should be released with munmap(), or zero if it should
+ * be released with free().
+ *
+ * @return A pointer to the source, or NULL if it is empty.
+ *
+ * Regular files are mapped into memory.  Other kinds of files such as
+ * pipes are read in large blocks.  Read errors are treated as EOF.
+ */
+static char *ip_parse_load_source(int fd, size_t *len, int *mapped)
 {
-    FILE *input;
-    ip_parser_t parser;
-    unsigned long num_errors;
-    int index;
+    struct stat st;
+    char *data = 0;
+    size_t size = 0;
+    ssize_t n;
 
-    /* Create the "ARGV" variable if necessary */
-    if (argc > 0) {
-        ip_var_t *var = ip_var_create
-            (&(program->vars), "ARGV", IP_TYPE_STRING);
-        ip_var_dimension_array(var, 0, argc - 1);
-        var->base.flags |= IP_SYMBOL_NO_RESET;
-        for (index = 0; index < argc; ++index) {
-            ip_string_t *str = ip_string_create(argv[index]);
-            ip_value_t value;
-            value.type = IP_TYPE_STRING;
-            value.svalue = str;
-            ip_value_to_array(var, index, &value);
-            ip_value_release(&value);
-        }
-    }
-
-    /* Open the input file */
-    if (filename) {
-        input = fopen(filename, "r");
-        if (!input) {
-            perror(filename);
-            return 1; /* One error occurred */
+    /* Try to map regular files directly into memory */
+    *len = 0;
+    *mapped = 0;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        data = mmap(0, (size_t)(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            *len = (size_t)(st.st_size);
+            *mapped = 1;
+            return data;
         }
-    } else {
-        input = stdin;
+        data = 0;
+    }
+
+    /* Read the input in large blocks until EOF */
+    for (;;) {
+        if ((size - *len) < IP_PARSE_READ_BLOCK_SIZE) {
+            size += IP_PARSE_READ_BLOCK_SIZE * 4;
+            data = realloc(data, size);
+            if (!data) {
+                ip_out_of_memory();
+            }
+        }
+        n = read(fd, data + *len, size - *len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n <= 0) {
+            break;
+        }
+        *len += (size_t)n;
     }
+    return data;
+}
+
+/**
+ * @brief Parses a program from source in memory.
+ *
+ * @param[out] program Points to the program state to load into.
+ * @param[in] filename Name of the source file for error messages,
+ * or NULL if the source has no name.
+ * @param[in] data Points to the program source.
+ * @param[in] len Length of the program source in bytes.
+ * @param[in] options Flags for syntax options; e.g. ITOK_TYPE_EXTENSION.
+ * @param[in] register_builtins Callback function to register the
+ * built-in library.
+ *
+ * @return Zero on success or the number of errors that occured.
+ */
+static unsigned long ip_parse_program_source
+    (ip_program_t *program, const char *filename,
+     const char *data, size_t len, unsigned options,
+     ip_parse_register_builtins_t register_builtins)
+{
+    ip_parser_t parser;
+    unsigned long num_errors;
 
     /* Initialise the parser and tokeniser */
     ip_parse_init(&parser);
     parser.flags = options;
-    parser.tokeniser.read_char = (ip_token_read_char)ip_parse_read_stdio;
-    parser.tokeniser.user_data = input;
+    ip_tokeniser_set_block(&(parser.tokeniser), data, len);
     parser.program = program;
     if (filename) {
         /* Use the permanent version of the filename for setting the
@@ -2204,17 +2332,67 @@ unsigned long ip_parse_program_file
         parser.tokeniser.filename = program->filename;
     }
 
-    /* Parse the contents of the program file */
+    /* Parse the contents of the program source */
     ip_parse_preliminary_statements(&parser, register_builtins);
     ip_parse_statements(&parser);
     ip_parse_check_undefined_labels(&parser);
     ip_parse_check_open_blocks(&parser);
 
     /* Clean up and exit */
-    if (filename) {
-        fclose(input);
-    }
     num_errors = parser.num_errors;
     ip_parse_free(&parser);
     return num_errors;
 }
+
+unsigned long ip_parse_program_file
+    (ip_program_t *program, const char *filename, unsigned options,
+     int argc, char **argv, ip_parse_register_builtins_t register_builtins)
+{
+    unsigned long num_errors;
+    char *data;
+    size_t len;
+    int mapped;
+    int fd;
+
+    /* Create the "ARGV" variable if necessary */
+    ip_program_set_argv(program, argc, argv);
+
+    /* Open the input file and load it into memory */
+    if (filename) {
+        fd = open(filename, O_RDONLY);
+        if (fd < 0) {
+            fprintf(program->errors, "%s: %s\n", filename, strerror(errno));
+            return 1; /* One error occurred */
+        }
+    } else {
+        fd = STDIN_FILENO;
+    }
+    data = ip_parse_load_source(fd, &len, &mapped);
+    if (filename) {
+        close(fd);
+    }
+
+    /* Parse the contents of the program file */
+    num_errors = ip_parse_program_source
+        (program, filename, data, len, options, register_builtins);
+
+    /* Clean up and exit */
+    if (mapped) {
+        munmap(data, len);
+    } else {
+        free(data);
+    }
+    return num_errors;
+}
+
+unsigned long ip_parse_program_buffer
+    (ip_program_t *program, const char *data, size_t len, unsigned options,
+     int argc, char **argv, ip_parse_register_builtins_t register_builtins)
+{
+    /* Create the "ARGV" variable if necessary */
+    ip_program_set_argv(program, argc, argv);
+
+    /* Parse the contents of the buffer in place */
+    return ip_parse_program_source
+        (program, program->filename, data, len, options, register_builtins);
+}
@@ -152,13 +152,22 @@ void ip_parse_check_undefined_labels(ip_parser_t *parser);
 void ip_parse_check_open_blocks(ip_parser_t *parser);
 
 /**
- * @brief Registers built-in statements from the program with the parser.
+ * @brief Registers the built-in library with the parser's program.
  *
  * @param[in,out] parser The parser state.
- * @param[in] register_builtins Callback function to register the
- * built-in library when the "TITLE" preliminary statement is encountered.
+ * @param[in] register_builtins Callback function that registers the
+ * built-in library, or NULL.
+ *
+ * The built-ins are registered in a read-only registry that is shared
+ * between all programs that use the same @a register_builtins callback
+ * and options, so the callback only runs once per process for each
+ * dialect.  The callback is passed a private parser and program, so it
+ * must only register built-ins and global variables with the program,
+ * and must register the same ones every time that it is called with the
+ * same options.  Labels for built-in routines are created on first use.
  */
-void ip_parse_register_builtins(ip_parser_t *parser);
+void ip_parse_register_builtins
+    (ip_parser_t *parser, ip_parse_register_builtins_t register_builtins);
 
 /**
  * @brief Parse a program file and return the program image.
@@ -179,6 +188,26 @@ unsigned long ip_parse_program_file
     (ip_program_t *program, const char *filename, unsigned options,
      int argc, char **argv, ip_parse_register_builtins_t register_builtins);
 
+/**
+ * @brief Parse a program from a memory buffer and return the program image.
+ *
+ * @param[out] program Points to the program state to load into.
+ * The filename in @a program is used when reporting errors.
+ * @param[in] data Points to the program source.
+ * @param[in] len Length of the program source in bytes.
+ * @param[in] options Flags for syntax options; e.g. ITOK_TYPE_EXTENSION.
+ * @param[in] argc Number of arguments to write into the "ARGV" variable,
+ * or zero for no "ARGV" variable.
+ * @param[in] argv Array of arguments for the "ARGV" variable.
+ * @param[in] register_builtins Callback function to register the
+ * built-in library.
+ *
+ * @return Zero on success or the number of errors that occured.
+ */
+unsigned long ip_parse_program_buffer
+    (ip_program_t *program, const char *data, size_t len, unsigned options,
+     int argc, char **argv, ip_parse_register_builtins_t register_builtins);
+
 /**
  * @brief Prints an error message for the current line.
  *
@@ -0,0 +1,287 @@
+/*
+ * Copyright (C) 2025 Rhys Weatherley
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "ip_perf.h"
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+#if defined(HAVE_LINUX_PERF_EVENT_H)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+/**
+ * @brief Names of the counters for the report.
+ */
+static const char * const ip_perf_counter_names[IP_PERF_NUM_COUNTERS] = {
+    "Cycles",
+    "Instructions",
+    "Branch misses",
+    "Cache misses"
+};
+
+#if defined(HAVE_LINUX_PERF_EVENT_H)
+
+/**
+ * @brief Opens a single performance counter.
+ *
+ * @param[in] type The PERF_TYPE_* type of counter to open.
+ * @param[in] config The PERF_COUNT_* counter to open.
+ * @param[in] group_fd The leader of the counter group, or -1 to
+ * create a new group.
+ *
+ * @return The file descriptor for the counter, or -1 if the counter
+ * is not available.
+ */
+static int ip_perf_open_counter(uint32_t type, uint64_t config, int group_fd)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.read_format = PERF_FORMAT_GROUP;
+    attr.disabled = (group_fd < 0);
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+ip_perf_t *ip_perf_new(FILE *errors)
+{
+    static const uint64_t configs[IP_PERF_NUM_COUNTERS] = {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_BRANCH_MISSES,
+        PERF_COUNT_HW_CACHE_MISSES
+    };
+    ip_perf_t *perf;
+    int leader = -1;
+    int index;
+
+    perf = calloc(1, sizeof(ip_perf_t));
+    if (!perf) {
+        ip_out_of_memory();
+    }
+
+    /* Open the counters as a group so they can all be read at once.
+     * Counters that the machine does not support are left out. */
+    for (index = 0; index < IP_PERF_NUM_COUNTERS; ++index) {
+        perf->fds[index] = ip_perf_open_counter
+            (PERF_TYPE_HARDWARE, configs[index], leader);
+        if (perf->fds[index] < 0 && index == IP_PERF_CYCLES) {
+            /* Virtual machines often have no hardware counters at all,
+             * so fall back to the software task clock for timing. */
+            perf->fds[index] = ip_perf_open_counter
+                (PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK, leader);
+            perf->task_clock = (perf->fds[index] >= 0);
+        }
+        if (perf->fds[index] >= 0) {
+            perf->slots[index] = (perf->num_slots)++;
+            if (leader < 0) {
+                leader = perf->fds[index];
+            }
+        } else {
+            perf->slots[index] = -1;
+        }
+    }
+    if (leader < 0) {
+        fprintf(errors, "performance counters are not available; "
+                        "check /proc/sys/kernel/perf_event_paranoid\n");
+        free(perf);
+        return 0;
+    }
+    ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    return perf;
+}
+
+void ip_perf_free(ip_perf_t *perf)
+{
+    int index;
+    if (perf) {
+        for (index = 0; index < IP_PERF_NUM_COUNTERS; ++index) {
+            if (perf->fds[index] >= 0) {
+                close(perf->fds[index]);
+            }
+        }
+        free(perf);
+    }
+}
+
+/**
+ * @brief Reads the current values of all counters.
+ *
+ * @param[in] perf The counter state.
+ * @param[out] values Returns the counter values.
+ */
+static void ip_perf_read(const ip_perf_t *perf, ip_uint_t *values)
+{
+    uint64_t data[IP_PERF_NUM_COUNTERS + 1];
+    int index, leader = 0;
+    while (perf->slots[leader] != 0) {
+        ++leader;
+    }
+    memset(data, 0, sizeof(data));
+    if (read(perf->fds[leader], data, sizeof(data)) < 0) {
+        memset(data, 0, sizeof(data));
+    }
+    for (index = 0; index < IP_PERF_NUM_COUNTERS; ++index) {
+        if (perf->slots[index] >= 0) {
+            values[index] = data[perf->slots[index] + 1];
+        } else {
+            values[index] = 0;
+        }
+    }
+}
+
+#else /* !HAVE_LINUX_PERF_EVENT_H */
+
+ip_perf_t *ip_perf_new(FILE *errors)
+{
+    fprintf(errors, "performance counters are not supported "
+                    "on this platform\n");
+    return 0;
+}
+
+void ip_perf_free(ip_perf_t *perf)
+{
+    free(perf);
+}
+
+static void ip_perf_read(const ip_perf_t *perf, ip_uint_t *values)
+{
+    (void)perf;
+    memset(values, 0, sizeof(ip_uint_t) * IP_PERF_NUM_COUNTERS);
+}
+
+#endif /* !HAVE_LINUX_PERF_EVENT_H */
+
+void ip_perf_enter(ip_perf_t *perf, ip_perf_frame_t *frame)
+{
+    frame->parent = perf->current;
+    memset(frame->nested, 0, sizeof(frame->nested));
+    perf->current = frame;
+    ip_perf_read(perf, frame->start);
+}
+
+void ip_perf_leave
+    (ip_perf_t *perf, ip_perf_frame_t *frame, int kind, int type)
+{
+    ip_uint_t values[IP_PERF_NUM_COUNTERS];
+    ip_perf_stats_t *stats = &(perf->stats[kind][type & 0xFF]);
+    int index;
+    ip_perf_read(perf, values);
+    for (index = 0; index < IP_PERF_NUM_COUNTERS; ++index) {
+        values[index] -= frame->start[index];
+        stats->values[index] += values[index] - frame->nested[index];
+        if (frame->parent) {
+            frame->parent->nested[index] += values[index];
+        }
+    }
+    ++(stats->count);
+    perf->current = frame->parent;
+}
+
+/**
+ * @brief Compares two sets of node statistics to sort them into
+ * descending order of cycles.
+ *
+ * @param[in] e1 Points to the first set of statistics.
+ * @param[in] e2 Points to the second set of statistics.
+ *
+ * @return Comparison result for qsort().
+ */
+static int ip_perf_compare_stats(const void *e1, const void *e2)
+{
+    const ip_perf_stats_t *stats1 = *((const ip_perf_stats_t * const *)e1);
+    const ip_perf_stats_t *stats2 = *((const ip_perf_stats_t * const *)e2);
+    if (stats1->values[IP_PERF_CYCLES] > stats2->values[IP_PERF_CYCLES]) {
+        return -1;
+    } else if (stats1->values[IP_PERF_CYCLES] <
+                    stats2->values[IP_PERF_CYCLES]) {
+        return 1;
+    } else if (stats1 < stats2) {
+        return -1;
+    } else if (stats1 > stats2) {
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Writes the table of counters for one kind of node.
+ *
+ * @param[in] perf The counter state.
+ * @param[in] kind IP_PERF_STATEMENT or IP_PERF_EXPRESSION.
+ * @param[in] out The stream to write to.
+ */
+static void ip_perf_report_kind(const ip_perf_t *perf, int kind, FILE *out)
+{
+    const ip_perf_stats_t *sorted[256];
+    const ip_perf_stats_t *stats;
+    int count = 0;
+    int type, index, counter;
+
+    for (type = 0; type < 256; ++type) {
+        if (perf->stats[kind][type].count) {
+            sorted[count++] = &(perf->stats[kind][type]);
+        }
+    }
+    qsort(sorted, count, sizeof(ip_perf_stats_t *), ip_perf_compare_stats);
+
+    fprintf(out, "%-32s %12s",
+            kind == IP_PERF_STATEMENT ? "Statement" : "Expression", "Count");
+    for (counter = 0; counter < IP_PERF_NUM_COUNTERS; ++counter) {
+        if (counter == IP_PERF_CYCLES && perf->task_clock) {
+            fprintf(out, " %14s", "Nanoseconds");
+        } else {
+            fprintf(out, " %14s", ip_perf_counter_names[counter]);
+        }
+    }
+    fputc('\n', out);
+    for (index = 0; index < count; ++index) {
+        stats = sorted[index];
+        type = (int)(stats - perf->stats[kind]);
+        fprintf(out, "%-32s %12" PRIu64, ip_ast_type_name(type),
+                (uint64_t)(stats->count));
+        for (counter = 0; counter < IP_PERF_NUM_COUNTERS; ++counter) {
+            if (perf->slots[counter] >= 0) {
+                fprintf(out, " %14" PRIu64, (uint64_t)(stats->values[counter]));
+            } else {
+                fprintf(out, " %14s", "-");
+            }
+        }
+        fputc('\n', out);
+    }
+    fputc('\n', out);
+}
+
+void ip_perf_report(const ip_perf_t *perf, FILE *out)
+{
+    fprintf(out, "Performance counters per node type, "
+                 "excluding nested expressions:\n\n");
+    ip_perf_report_kind(perf, IP_PERF_STATEMENT, out);
+    ip_perf_report_kind(perf, IP_PERF_EXPRESSION, out);
+}
@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2025 Rhys Weatherley
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef INTERPROGRAM_PERF_H
+#define INTERPROGRAM_PERF_H
+
+#include "ip_exec.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Hardware performance counters that are collected */
+#define IP_PERF_CYCLES          0   /**< CPU cycles */
+#define IP_PERF_INSTRUCTIONS    1   /**< Instructions retired */
+#define IP_PERF_BRANCH_MISSES   2   /**< Branch mispredictions */
+#define IP_PERF_CACHE_MISSES    3   /**< Last level cache misses */
+#define IP_PERF_NUM_COUNTERS    4   /**< Number of counters */
+
+/* Kinds of nodes that counters are attributed to */
+#define IP_PERF_STATEMENT       0   /**< Statement in ip_exec_step() */
+#define IP_PERF_EXPRESSION      1   /**< Expression node */
+
+/**
+ * @brief Counter totals for a single kind of node.
+ */
+typedef struct
+{
+    /** Number of times that nodes of this type were executed */
+    ip_uint_t count;
+
+    /** Counter values, excluding the values for nested nodes */
+    ip_uint_t values[IP_PERF_NUM_COUNTERS];
+
+} ip_perf_stats_t;
+
+/**
+ * @brief Measurement of a node that is currently executing.
+ *
+ * Frames are allocated on the C stack by the interpreter and are linked
+ * together so that the counts for nested expressions can be subtracted
+ * from the counts for the enclosing node.
+ */
+typedef struct ip_perf_frame_s ip_perf_frame_t;
+struct ip_perf_frame_s
+{
+    /** Frame for the enclosing node, or NULL */
+    ip_perf_frame_t *parent;
+
+    /** Counter values when the node started executing */
+    ip_uint_t start[IP_PERF_NUM_COUNTERS];
+
+    /** Total counter values for the nested nodes */
+    ip_uint_t nested[IP_PERF_NUM_COUNTERS];
+};
+
+/**
+ * @brief Hardware performance counter state for an execution context.
+ */
+struct ip_perf_s
+{
+    /** File descriptors for the counters, or -1 if not available */
+    int fds[IP_PERF_NUM_COUNTERS];
+
+    /** Position of each counter in a group read, or -1 if not available */
+    int slots[IP_PERF_NUM_COUNTERS];
+
+    /** Number of counters in the group */
+    int num_slots;
+
+    /** Non-zero if the cycle counter is the software task clock instead */
+    int task_clock;
+
+    /** Frame for the innermost node that is executing */
+    ip_perf_frame_t *current;
+
+    /** Totals for statements and expressions, indexed by ITOK_* type */
+    ip_perf_stats_t stats[2][256];
+};
+
+/**
+ * @brief Opens the hardware performance counters for the current thread.
+ *
+ * @param[in] errors Stream to report problems on.
+ *
+ * @return The counter state, or NULL if no counters are available.
+ *
+ * Counters that are not supported by the CPU, the kernel, or the
+ * virtual machine are skipped.  If none of the counters can be opened,
+ * then a message is written to @a errors and NULL is returned so that
+ * the program can still run without instrumentation.
+ */
+ip_perf_t *ip_perf_new(FILE *errors);
+
+/**
+ * @brief Closes the hardware performance counters.
+ *
+ * @param[in] perf The counter state.
+ */
+void ip_perf_free(ip_perf_t *perf);
+
+/**
+ * @brief Starts measuring a node.
+ *
+ * @param[in,out] perf The counter state.
+ * @param[out] frame The frame for the node.
+ */
+void ip_perf_enter(ip_perf_t *perf, ip_perf_frame_t *frame);
+
+/**
+ * @brief Finishes measuring a node.
+ *
+ * @param[in,out] perf The counter state.
+ * @param[in,out] frame The frame for the node from ip_perf_enter().
+ * @param[in] kind IP_PERF_STATEMENT or IP_PERF_EXPRESSION.
+ * @param[in] type The ITOK_* type of the node.
+ */
+void ip_perf_leave
+    (ip_perf_t *perf, ip_perf_frame_t *frame, int kind, int type);
+
+/**
+ * @brief Writes a table of the counter totals for each kind of node.
+ *
+ * @param[in] perf The counter state.
+ * @param[in] out The stream to write the table to.
+ */
+void ip_perf_report(const ip_perf_t *perf, FILE *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
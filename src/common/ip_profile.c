@@ -0,0 +1,535 @@
+/*
+ * Copyright (C) 2025 Rhys Weatherley
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "ip_profile.h"
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define IP_PROFILE_HAVE_RDTSC 1
+#endif
+
+/**
+ * @brief Reads the current value of the cycle counter.
+ *
+ * @return The cycle counter value.
+ *
+ * On x86 this is the time stamp counter.  Elsewhere we fall back to
+ * the monotonic clock in nanoseconds, which is close enough for
+ * comparing the relative cost of lines.
+ */
+static ip_uint_t ip_profile_cycles(void)
+{
+#if defined(IP_PROFILE_HAVE_RDTSC)
+    return (ip_uint_t)__rdtsc();
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((ip_uint_t)now.tv_sec) * 1000000000U + (ip_uint_t)now.tv_nsec;
+#endif
+}
+
+/**
+ * @brief Grows the line statistics arrays in a profile.
+ *
+ * @param[in,out] profile The profile.
+ * @param[in] num_lines The new number of lines, which must be larger
+ * than the current number of lines.
+ */
+static void ip_profile_grow(ip_profile_t *profile, unsigned long num_lines)
+{
+    profile->lines = realloc
+        (profile->lines, num_lines * sizeof(ip_profile_line_t));
+    profile->line_labels = realloc
+        (profile->line_labels, num_lines * sizeof(unsigned long));
+    if (!(profile->lines) || !(profile->line_labels)) {
+        ip_out_of_memory();
+    }
+    memset(profile->lines + profile->num_lines, 0,
+           (num_lines - profile->num_lines) * sizeof(ip_profile_line_t));
+    memset(profile->line_labels + profile->num_lines, 0,
+           (num_lines - profile->num_lines) * sizeof(unsigned long));
+    profile->num_lines = num_lines;
+}
+
+ip_profile_t *ip_profile_new(const ip_program_t *program)
+{
+    ip_profile_t *profile;
+    const ip_ast_node_t *node;
+    unsigned long max_line = 0;
+    unsigned long label = 0;
+    unsigned long line;
+
+    profile = calloc(1, sizeof(ip_profile_t));
+    if (!profile) {
+        ip_out_of_memory();
+    }
+    profile->program = program;
+    ip_symbol_table_init(&(profile->stacks));
+
+    /* Find the largest line number and the number of labels */
+    for (node = program->statements.first; node; node = node->next) {
+        if (node->loc.line > max_line) {
+            max_line = node->loc.line;
+        }
+        if (node->type == ITOK_LABEL && node->label) {
+            ++(profile->num_labels);
+        }
+    }
+    ip_profile_grow(profile, max_line + 1);
+    profile->labels = calloc(profile->num_labels + 1, sizeof(ip_label_t *));
+    if (!(profile->labels)) {
+        ip_out_of_memory();
+    }
+
+    /* Assign each line to the closest preceding label.  Label 0 is used
+     * for the lines before the first label in the program. */
+    profile->num_labels = 0;
+    line = 0;
+    for (node = program->statements.first; node; node = node->next) {
+        if (node->type == ITOK_LABEL && node->label) {
+            profile->labels[++(profile->num_labels)] = node->label;
+            label = profile->num_labels;
+        }
+        for (; line <= node->loc.line; ++line) {
+            profile->line_labels[line] = label;
+        }
+    }
+    for (; line <= max_line; ++line) {
+        profile->line_labels[line] = label;
+    }
+    ++(profile->num_labels);
+    return profile;
+}
+
+void ip_profile_free(ip_profile_t *profile)
+{
+    if (profile) {
+        free(profile->lines);
+        free(profile->line_labels);
+        free(profile->labels);
+        ip_symbol_table_free(&(profile->stacks));
+        free(profile->stack_buffer);
+        free(profile);
+    }
+}
+
+void ip_profile_enable_stacks(ip_profile_t *profile, unsigned long interval)
+{
+    profile->sample_interval = interval > 0 ? interval : 1;
+    profile->sample_countdown = profile->sample_interval;
+}
+
+/**
+ * @brief Sample of a call stack in folded form.
+ */
+typedef struct
+{
+    /** Base class information; the name is the folded stack */
+    ip_symbol_t base;
+
+    /** Number of times that this call stack was sampled */
+    ip_uint_t count;
+
+} ip_profile_stack_t;
+
+/**
+ * @brief Gets the name of the routine that a call frame is running.
+ *
+ * @param[in] frame The call frame.
+ * @param[out] buf Buffer to format numeric labels into.
+ * @param[in] size Size of @a buf.
+ *
+ * @return The name of the routine.
+ */
+static const char *ip_profile_frame_name
+    (const ip_exec_stack_call_t *frame, char *buf, size_t size)
+{
+    const ip_ast_node_t *target = frame->call_node->children.left;
+    if (target->type != ITOK_LABEL) {
+        return "(computed)";
+    } else if (target->label->base.name) {
+        snprintf(buf, size, "*%s", target->label->base.name);
+    } else {
+        snprintf(buf, size, "*%" PRId64, (int64_t)(target->label->base.num));
+    }
+    return buf;
+}
+
+/**
+ * @brief Gets the name of the root frame for all call stacks.
+ *
+ * @param[in] profile The profile.
+ *
+ * @return The base name of the program's source file.
+ */
+static const char *ip_profile_root_name(const ip_profile_t *profile)
+{
+    const char *name = profile->program->filename;
+    const char *slash;
+    if (!name) {
+        return "program";
+    }
+    slash = strrchr(name, '/');
+    return slash ? slash + 1 : name;
+}
+
+/**
+ * @brief Records a sample of the current call stack.
+ *
+ * @param[in,out] profile The profile.
+ * @param[in] exec The execution context.
+ */
+static void ip_profile_sample(ip_profile_t *profile, const ip_exec_t *exec)
+{
+    const ip_exec_stack_item_t *item;
+    const char *root = ip_profile_root_name(profile);
+    const char *name;
+    char buf[32];
+    size_t len, posn;
+    ip_profile_stack_t *stack;
+    char *p;
+
+    /* Measure the length of the folded stack.  Frames are separated
+     * by semicolons, so each frame needs one extra character. */
+    len = strlen(root);
+    for (item = exec->stack; item; item = item->next) {
+        if (item->type == ITOK_CALL) {
+            name = ip_profile_frame_name
+                ((const ip_exec_stack_call_t *)item, buf, sizeof(buf));
+            len += strlen(name) + 1;
+        }
+    }
+    if (len >= profile->stack_buffer_size) {
+        profile->stack_buffer_size = len + 64;
+        profile->stack_buffer = realloc
+            (profile->stack_buffer, profile->stack_buffer_size);
+        if (!(profile->stack_buffer)) {
+            ip_out_of_memory();
+        }
+    }
+
+    /* The execution stack runs from the innermost frame to the outermost,
+     * so fill the buffer from the end backwards. */
+    posn = len;
+    profile->stack_buffer[posn] = '\0';
+    for (item = exec->stack; item; item = item->next) {
+        if (item->type == ITOK_CALL) {
+            name = ip_profile_frame_name
+                ((const ip_exec_stack_call_t *)item, buf, sizeof(buf));
+            posn -= strlen(name);
+            memcpy(profile->stack_buffer + posn, name, strlen(name));
+            profile->stack_buffer[--posn] = ';';
+        }
+    }
+    memcpy(profile->stack_buffer, root, posn);
+
+    /* Semicolons separate frames, so they cannot appear in the root name */
+    for (p = profile->stack_buffer; p < profile->stack_buffer + posn; ++p) {
+        if (*p == ';') {
+            *p = ':';
+        }
+    }
+
+    /* Count the sample against the folded stack */
+    stack = (ip_profile_stack_t *)ip_symbol_lookup_by_name
+        (&(profile->stacks), profile->stack_buffer);
+    if (!stack) {
+        stack = calloc(1, sizeof(ip_profile_stack_t));
+        if (!stack) {
+            ip_out_of_memory();
+        }
+        stack->base.name = strdup(profile->stack_buffer);
+        if (!(stack->base.name)) {
+            ip_out_of_memory();
+        }
+        stack->base.num = -1;
+        ip_symbol_insert(&(profile->stacks), &(stack->base));
+    }
+    ++(stack->count);
+}
+
+int ip_profile_step(ip_profile_t *profile, ip_exec_t *exec)
+{
+    ip_profile_line_t *stats;
+    unsigned long line;
+    ip_uint_t start;
+    int status;
+
+    /* Determine which line we are about to execute */
+    if (!(exec->pc)) {
+        return ip_exec_step(exec);
+    }
+    line = exec->pc->loc.line;
+    if (line >= profile->num_lines) {
+        ip_profile_grow(profile, line + 1);
+    }
+    if (profile->sample_interval && --(profile->sample_countdown) == 0) {
+        ip_profile_sample(profile, exec);
+        profile->sample_countdown = profile->sample_interval;
+    }
+
+    /* Execute the statement and charge its cost to the line */
+    start = ip_profile_cycles();
+    status = ip_exec_step(exec);
+    stats = &(profile->lines[line]);
+    stats->cycles += ip_profile_cycles() - start;
+    ++(stats->count);
+    return status;
+}
+
+/**
+ * @brief Computes the percentage that one cycle count is of the total.
+ *
+ * @param[in] cycles The cycle count.
+ * @param[in] total The total cycle count.
+ *
+ * @return The percentage.
+ */
+static double ip_profile_percent(ip_uint_t cycles, ip_uint_t total)
+{
+    if (!total) {
+        return 0.0;
+    }
+    return (100.0 * (double)cycles) / (double)total;
+}
+
+/**
+ * @brief Writes the name of a label in the form it appears in the source.
+ *
+ * @param[in] label The label, or NULL for the start of the program.
+ * @param[in] out The stream to write to.
+ */
+static void ip_profile_write_label(const ip_label_t *label, FILE *out)
+{
+    if (!label) {
+        fputs("(start)", out);
+    } else if (label->base.name) {
+        fprintf(out, "*%s", label->base.name);
+    } else {
+        fprintf(out, "*%" PRId64, (int64_t)(label->base.num));
+    }
+}
+
+/**
+ * @brief Writes the statistics columns for a line.
+ *
+ * @param[in] stats The statistics for the line.
+ * @param[in] total The total cycle count for the program.
+ * @param[in] out The stream to write to.
+ */
+static void ip_profile_write_stats
+    (const ip_profile_line_t *stats, ip_uint_t total, FILE *out)
+{
+    if (stats && stats->count) {
+        fprintf(out, "%12" PRIu64 " %14" PRIu64 " %6.2f%%",
+                (uint64_t)(stats->count), (uint64_t)(stats->cycles),
+                ip_profile_percent(stats->cycles, total));
+    } else {
+        fprintf(out, "%12s %14s %7s", "", "", "");
+    }
+}
+
+/**
+ * @brief Writes the program source annotated with the line statistics.
+ *
+ * @param[in] profile The profile.
+ * @param[in] total The total cycle count for the program.
+ * @param[in] out The stream to write to.
+ */
+static void ip_profile_write_listing
+    (const ip_profile_t *profile, ip_uint_t total, FILE *out)
+{
+    FILE *file;
+    unsigned long line = 1;
+    int ch = '\n';
+
+    if (!(profile->program->filename)) {
+        return;
+    }
+    file = fopen(profile->program->filename, "r");
+    if (!file) {
+        return;
+    }
+    fprintf(out, "%12s %14s %7s %6s  %s\n",
+            "Count", "Cycles", "Self", "Line", "Source");
+    while ((ch = getc(file)) != EOF) {
+        if (line < profile->num_lines) {
+            ip_profile_write_stats(&(profile->lines[line]), total, out);
+        } else {
+            ip_profile_write_stats(0, total, out);
+        }
+        fprintf(out, " %6lu  ", line);
+        while (ch != EOF && ch != '\n') {
+            putc(ch, out);
+            ch = getc(file);
+        }
+        putc('\n', out);
+        ++line;
+    }
+    fclose(file);
+    fputc('\n', out);
+}
+
+/**
+ * @brief Writes the statistics for each label.
+ *
+ * @param[in] profile The profile.
+ * @param[in] total The total cycle count for the program.
+ * @param[in] out The stream to write to.
+ */
+static void ip_profile_write_labels
+    (const ip_profile_t *profile, ip_uint_t total, FILE *out)
+{
+    ip_profile_line_t *stats;
+    unsigned long line;
+    unsigned long label;
+
+    stats = calloc(profile->num_labels, sizeof(ip_profile_line_t));
+    if (!stats) {
+        ip_out_of_memory();
+    }
+    for (line = 0; line < profile->num_lines; ++line) {
+        label = profile->line_labels[line];
+        stats[label].count += profile->lines[line].count;
+        stats[label].cycles += profile->lines[line].cycles;
+    }
+    fprintf(out, "%12s %14s %7s  %s\n", "Count", "Cycles", "Self", "Label");
+    for (label = 0; label < profile->num_labels; ++label) {
+        if (stats[label].count) {
+            ip_profile_write_stats(&(stats[label]), total, out);
+            fputs("  ", out);
+            ip_profile_write_label(profile->labels[label], out);
+            fputc('\n', out);
+        }
+    }
+    fputc('\n', out);
+    free(stats);
+}
+
+/**
+ * @brief Compares two lines to sort them into descending order of cost.
+ *
+ * @param[in] e1 Points to the first line's statistics.
+ * @param[in] e2 Points to the second line's statistics.
+ *
+ * @return Comparison result for qsort().
+ */
+static int ip_profile_compare_lines(const void *e1, const void *e2)
+{
+    const ip_profile_line_t *line1 = *((const ip_profile_line_t * const *)e1);
+    const ip_profile_line_t *line2 = *((const ip_profile_line_t * const *)e2);
+    if (line1->cycles > line2->cycles) {
+        return -1;
+    } else if (line1->cycles < line2->cycles) {
+        return 1;
+    } else if (line1 < line2) {
+        return -1;
+    } else if (line1 > line2) {
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Writes the hottest lines in the program.
+ *
+ * @param[in] profile The profile.
+ * @param[in] total The total cycle count for the program.
+ * @param[in] out The stream to write to.
+ * @param[in] top_n The maximum number of lines to write.
+ */
+static void ip_profile_write_hot_lines
+    (const ip_profile_t *profile, ip_uint_t total, FILE *out, unsigned top_n)
+{
+    const ip_profile_line_t **sorted;
+    unsigned long count = 0;
+    unsigned long line;
+
+    sorted = calloc(profile->num_lines + 1, sizeof(ip_profile_line_t *));
+    if (!sorted) {
+        ip_out_of_memory();
+    }
+    for (line = 0; line < profile->num_lines; ++line) {
+        if (profile->lines[line].count) {
+            sorted[count++] = &(profile->lines[line]);
+        }
+    }
+    qsort(sorted, count, sizeof(ip_profile_line_t *),
+          ip_profile_compare_lines);
+    if (count > top_n) {
+        count = top_n;
+    }
+    fprintf(out, "%12s %14s %7s %6s  %s\n",
+            "Count", "Cycles", "Self", "Line", "Label");
+    for (line = 0; line < count; ++line) {
+        ip_profile_write_stats(sorted[line], total, out);
+        fprintf(out, " %6lu  ", (unsigned long)(sorted[line] - profile->lines));
+        ip_profile_write_label
+            (profile->labels[profile->line_labels
+                [sorted[line] - profile->lines]], out);
+        fputc('\n', out);
+    }
+    free(sorted);
+}
+
+void ip_profile_report
+    (const ip_profile_t *profile, FILE *out, unsigned top_n)
+{
+    ip_uint_t total_count = 0;
+    ip_uint_t total_cycles = 0;
+    unsigned long line;
+
+    for (line = 0; line < profile->num_lines; ++line) {
+        total_count += profile->lines[line].count;
+        total_cycles += profile->lines[line].cycles;
+    }
+    fprintf(out, "Profile of %s: %" PRIu64 " statements, %" PRIu64
+                 " cycles\n\n",
+            profile->program->filename ? profile->program->filename : "program",
+            (uint64_t)total_count, (uint64_t)total_cycles);
+    ip_profile_write_listing(profile, total_cycles, out);
+    ip_profile_write_labels(profile, total_cycles, out);
+    fprintf(out, "Top %u lines:\n", top_n);
+    ip_profile_write_hot_lines(profile, total_cycles, out, top_n);
+}
+
+/**
+ * @brief Writes a single call stack sample in folded stack format.
+ *
+ * @param[in] symbol The call stack sample.
+ * @param[in] user_data The stream to write to.
+ */
+static void ip_profile_write_stack(ip_symbol_t *symbol, void *user_data)
+{
+    const ip_profile_stack_t *stack = (const ip_profile_stack_t *)symbol;
+    fprintf((FILE *)user_data, "%s %" PRIu64 "\n",
+            stack->base.name, (uint64_t)(stack->count));
+}
+
+void ip_profile_report_stacks(const ip_profile_t *profile, FILE *out)
+{
+    ip_symbol_table_visit
+        (&(profile->stacks), ip_profile_write_stack, out);
+}
@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2025 Rhys Weatherley
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef INTERPROGRAM_PROFILE_H
+#define INTERPROGRAM_PROFILE_H
+
+#include "ip_exec.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Default number of lines to list in the hot lines summary.
+ */
+#define IP_PROFILE_TOP_N 10
+
+/**
+ * @brief Execution statistics for a single source line.
+ */
+typedef struct
+{
+    /** Number of statements that were executed on this line */
+    ip_uint_t count;
+
+    /** Number of cycles that were spent executing those statements */
+    ip_uint_t cycles;
+
+} ip_profile_line_t;
+
+/**
+ * @brief Execution profile for a program.
+ */
+struct ip_profile_s
+{
+    /** The program that is being profiled */
+    const ip_program_t *program;
+
+    /** Statistics for each line, indexed by line number */
+    ip_profile_line_t *lines;
+
+    /** Number of entries in the "lines" array */
+    unsigned long num_lines;
+
+    /** Label that each line belongs to, indexed by line number */
+    unsigned long *line_labels;
+
+    /** Labels in the order in which they appear in the program */
+    const ip_label_t **labels;
+
+    /** Number of entries in the "labels" array */
+    unsigned long num_labels;
+
+    /** Number of steps between call stack samples, or zero if disabled */
+    unsigned long sample_interval;
+
+    /** Number of steps until the next call stack sample */
+    unsigned long sample_countdown;
+
+    /** Number of samples for each call stack, keyed by folded stack */
+    ip_symbol_table_t stacks;
+
+    /** Buffer for building the folded form of a call stack */
+    char *stack_buffer;
+
+    /** Size of the folded call stack buffer */
+    size_t stack_buffer_size;
+};
+
+/**
+ * @brief Creates a new execution profile for a program.
+ *
+ * @param[in] program The program to be profiled.
+ *
+ * @return The new profile.
+ *
+ * Every line of the program is assigned to the closest label that
+ * precedes it so that the report can summarise the time spent in
+ * each labelled block of code.
+ */
+ip_profile_t *ip_profile_new(const ip_program_t *program);
+
+/**
+ * @brief Frees an execution profile.
+ *
+ * @param[in] profile The profile to free.
+ */
+void ip_profile_free(ip_profile_t *profile);
+
+/**
+ * @brief Enables sampling of the call stack while profiling.
+ *
+ * @param[in,out] profile The profile.
+ * @param[in] interval Number of statements to execute between samples;
+ * 1 to sample every statement.
+ *
+ * Each sample records the chain of routine labels that are active on
+ * the execution stack of the program, from the outermost "CALL" or
+ * "EXECUTE PROCESS" to the innermost.
+ */
+void ip_profile_enable_stacks(ip_profile_t *profile, unsigned long interval);
+
+/**
+ * @brief Performs a single instruction and records its cost.
+ *
+ * @param[in,out] profile The profile to record the cost into.
+ * @param[in,out] exec The execution context.
+ *
+ * @return The status from ip_exec_step().
+ *
+ * The cost of a statement is charged to the line that contains it.
+ * Statements inside a called subroutine are charged to their own lines,
+ * so the cost of a line is its "self" time.
+ */
+int ip_profile_step(ip_profile_t *profile, ip_exec_t *exec);
+
+/**
+ * @brief Writes a profile report.
+ *
+ * @param[in] profile The profile.
+ * @param[in] out The stream to write the report to.
+ * @param[in] top_n The number of lines to list in the hot lines summary.
+ *
+ * The report consists of the program source annotated with the execution
+ * count, cycles, and percentage of the total cycles for each line,
+ * followed by a summary per label and the @a top_n hottest lines.
+ * If the source file cannot be read, then the listing is omitted.
+ */
+void ip_profile_report
+    (const ip_profile_t *profile, FILE *out, unsigned top_n);
+
+/**
+ * @brief Writes the call stack samples in folded stack format.
+ *
+ * @param[in] profile The profile.
+ * @param[in] out The stream to write the samples to.
+ *
+ * Each line of the output contains the frames of a call stack separated
+ * by semicolons, followed by a space and the number of samples for that
+ * stack.  This is the input format for flame graph tools.
+ */
+void ip_profile_report_stacks(const ip_profile_t *profile, FILE *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
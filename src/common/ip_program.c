@@ -21,6 +21,8 @@
  */
 
 #include "ip_program.h"
+#include "ip_atomic.h"
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -34,6 +36,7 @@ ip_program_t *ip_program_new(const char *filename)
     ip_label_table_init(&(program->labels));
     ip_ast_list_init(&(program->statements));
     ip_symbol_table_init(&(program->builtins));
+    program->errors = stderr;
     program->filename = strdup(filename);
     if (!(program->filename)) {
         ip_program_free(program);
@@ -57,12 +60,6 @@ void ip_program_free(ip_program_t *program)
     }
 }
 
-void ip_program_reset_variables(ip_program_t *program)
-{
-    ip_var_table_reset(&(program->vars));
-    program->next_input = program->embedded_input;
-}
-
 void ip_program_set_input(ip_program_t *program, const char *input)
 {
     char *temp;
@@ -78,7 +75,30 @@ void ip_program_set_input(ip_program_t *program, const char *input)
         free(program->embedded_input);
     }
     program->embedded_input = temp;
-    program->next_input = temp;
+}
+
+void ip_program_set_argv(ip_program_t *program, int argc, char **argv)
+{
+    ip_var_t *var;
+    int index;
+    if (argc <= 0) {
+        return;
+    }
+    var = ip_var_create(&(program->vars), "ARGV", IP_TYPE_STRING);
+    if (!var) {
+        /* "ARGV" has already been set */
+        return;
+    }
+    var->base.flags |= IP_SYMBOL_NO_RESET;
+    ip_var_dimension_array(var, 0, argc - 1);
+    for (index = 0; index < argc; ++index) {
+        ip_string_t *str = ip_string_create(argv[index]);
+        ip_value_t value;
+        value.type = IP_TYPE_STRING;
+        value.svalue = str;
+        ip_value_to_array(var, &(var->initial), index, &value);
+        ip_value_release(&value);
+    }
 }
 
 void ip_program_register_builtin
@@ -87,7 +107,6 @@ void ip_program_register_builtin
      signed char max_args)
 {
     ip_builtin_t *builtin;
-    ip_label_t *label;
 
     /* Do we already have this built-in? */
     builtin = (ip_builtin_t *)ip_symbol_lookup_by_name
@@ -116,16 +135,6 @@ void ip_program_register_builtin
     }
     builtin->handler = handler;
     ip_symbol_insert(&(program->builtins), &(builtin->base));
-
-    /* Create the corresponding routine label and variable so that the
-     * parser will recognise this name for implicit "CALL"'s */
-    if (min_args <= max_args) {
-        label = ip_label_create_by_name(&(program->labels), name);
-        label->base.type = IP_TYPE_ROUTINE;
-        label->builtin = (void *)handler;
-        ip_label_mark_as_defined(label);
-        ip_var_create(&(program->vars), name, IP_TYPE_ROUTINE);
-    }
 }
 
 void ip_program_register_builtins
@@ -139,11 +148,202 @@ void ip_program_register_builtins
     }
 }
 
-ip_builtin_t *ip_program_lookup_builtin_routine
+/** Maximum number of shared built-in registries */
+#define IP_PROGRAM_MAX_REGISTRIES 8
+
+/**
+ * @brief Shared built-in registries that have been built so far.
+ *
+ * Entries are filled in on first use and are never modified or freed
+ * after that, so they can be safely read from multiple threads.
+ */
+static ip_builtin_registry_t *builtin_registries[IP_PROGRAM_MAX_REGISTRIES];
+
+/**
+ * @brief Adds the names of the built-ins in a symbol tree to a word trie.
+ *
+ * @param[in] builtins The table of built-ins.
+ * @param[in] symbol The root of the symbol sub-tree to add.
+ * @param[in,out] names The word trie to add the names to.
+ */
+static void ip_program_add_builtin_names
+    (const ip_symbol_table_t *builtins, const ip_symbol_t *symbol,
+     ip_word_trie_t *names)
+{
+    if (symbol && symbol != &(builtins->nil)) {
+        ip_program_add_builtin_names(builtins, symbol->left, names);
+        if (strchr(symbol->name, ' ') != 0) {
+            ip_word_trie_insert(names, symbol->name);
+        }
+        ip_program_add_builtin_names(builtins, symbol->right, names);
+    }
+}
+
+/**
+ * @brief Builds a new built-in registry.
+ *
+ * @param[in] key Key that identifies the registration function.
+ * @param[in] options Options for the built-ins to register.
+ * @param[in] init Function that registers the built-ins.
+ * @param[in] user_data User data to pass to @a init.
+ *
+ * @return The new registry.
+ */
+static ip_builtin_registry_t *ip_builtin_registry_new
+    (const void *key, unsigned options,
+     ip_builtin_registry_init_t init, void *user_data)
+{
+    ip_builtin_registry_t *registry;
+    const ip_symbol_table_t *builtins;
+    registry = calloc(1, sizeof(ip_builtin_registry_t));
+    if (!registry) {
+        ip_out_of_memory();
+    }
+    registry->key = key;
+    registry->options = options;
+    registry->program = ip_program_new("");
+    registry->program->options = options;
+    (*init)(registry->program, options, user_data);
+    builtins = &(registry->program->builtins);
+    ip_word_trie_init(&(registry->names));
+    ip_program_add_builtin_names
+        (builtins, builtins->root.right, &(registry->names));
+    return registry;
+}
+
+/**
+ * @brief Frees a built-in registry that lost the race to be published.
+ *
+ * @param[in] registry The registry to free.
+ */
+static void ip_builtin_registry_free(ip_builtin_registry_t *registry)
+{
+    if (registry) {
+        ip_word_trie_free(&(registry->names));
+        ip_program_free(registry->program);
+        free(registry);
+    }
+}
+
+/**
+ * @brief Copies a global variable from a registry into a program.
+ *
+ * @param[in] symbol The variable in the registry.
+ * @param[in,out] user_data The program to copy the variable into.
+ */
+static void ip_program_copy_global(ip_symbol_t *symbol, void *user_data)
+{
+    ip_program_t *program = (ip_program_t *)user_data;
+    const ip_var_t *from = (const ip_var_t *)symbol;
+    ip_var_t *var;
+    unsigned char type = ip_var_get_type(from);
+    if (type != IP_TYPE_INT && type != IP_TYPE_FLOAT &&
+            type != IP_TYPE_STRING) {
+        /* Only scalar variables can be created by registration functions */
+        return;
+    }
+    var = ip_var_create(&(program->vars), symbol->name, type);
+    if (!var) {
+        /* The program already has a variable with this name */
+        return;
+    }
+    var->initial = from->initial;
+    if (type == IP_TYPE_STRING && var->initial.svalue) {
+        ip_string_ref(var->initial.svalue);
+    }
+    var->base.flags = symbol->flags;
+}
+
+const ip_builtin_registry_t *ip_program_register_shared
+    (ip_program_t *program, const void *key, unsigned options,
+     ip_builtin_registry_init_t init, void *user_data)
+{
+    ip_builtin_registry_t *registry = 0;
+    ip_builtin_registry_t *expected;
+    size_t index;
+
+    /* Look for a registry for the same built-ins.  If there isn't
+     * one yet, then build it and try to add it to the list. */
+    for (index = 0; index < IP_PROGRAM_MAX_REGISTRIES; ++index) {
+        expected = ip_atomic_load(&(builtin_registries[index]));
+        if (!expected) {
+            if (!registry) {
+                registry = ip_builtin_registry_new
+                    (key, options, init, user_data);
+            }
+            if (ip_atomic_compare_exchange
+                    (&(builtin_registries[index]), &expected, registry)) {
+                expected = registry;
+                registry = 0;
+            }
+        }
+        if (expected->key == key && expected->options == options) {
+            /* Another program may have already built this registry */
+            ip_builtin_registry_free(registry);
+            program->registry = expected;
+            ip_symbol_table_visit
+                (&(expected->program->vars.symbols),
+                 ip_program_copy_global, program);
+            return expected;
+        }
+    }
+
+    /* The list is full, so register the built-ins with this program only */
+    ip_builtin_registry_free(registry);
+    (*init)(program, options, user_data);
+    return 0;
+}
+
+/**
+ * @brief Looks up a built-in by name in a program or its registry.
+ *
+ * @param[in] program The program state.
+ * @param[in] name The name of the built-in statement.
+ *
+ * @return A pointer to the built-in or NULL if not found.
+ */
+static ip_builtin_t *ip_program_lookup_builtin
     (const ip_program_t *program, const char *name)
 {
     ip_builtin_t *builtin =
         (ip_builtin_t *)ip_symbol_lookup_by_name(&(program->builtins), name);
+    if (!builtin && program->registry) {
+        builtin = (ip_builtin_t *)ip_symbol_lookup_by_name
+            (&(program->registry->program->builtins), name);
+    }
+    return builtin;
+}
+
+ip_label_t *ip_program_lookup_label(ip_program_t *program, const char *name)
+{
+    ip_label_t *label;
+    ip_builtin_t *builtin;
+
+    /* Is this a label that the program already knows about? */
+    label = ip_label_lookup_by_name(&(program->labels), name);
+    if (label) {
+        return label;
+    }
+
+    /* Create the routine label and variable for a built-in routine
+     * on first use so that the parser will recognise this name for
+     * implicit "CALL"'s and reject attempts to redefine it */
+    builtin = ip_program_lookup_builtin_routine(program, name);
+    if (!builtin) {
+        return 0;
+    }
+    label = ip_label_create_by_name(&(program->labels), name);
+    label->base.type = IP_TYPE_ROUTINE;
+    label->builtin = (void *)(builtin->handler);
+    ip_label_mark_as_defined(label);
+    ip_var_create(&(program->vars), name, IP_TYPE_ROUTINE);
+    return label;
+}
+
+ip_builtin_t *ip_program_lookup_builtin_routine
+    (const ip_program_t *program, const char *name)
+{
+    ip_builtin_t *builtin = ip_program_lookup_builtin(program, name);
     if (builtin) {
         int min_args = builtin->base.type & 0x0F;
         int max_args = (builtin->base.type >> 4) & 0x0F;
@@ -158,8 +358,7 @@ ip_builtin_t *ip_program_lookup_builtin_routine
 ip_builtin_t *ip_program_lookup_builtin_function
     (const ip_program_t *program, const char *name)
 {
-    ip_builtin_t *builtin =
-        (ip_builtin_t *)ip_symbol_lookup_by_name(&(program->builtins), name);
+    ip_builtin_t *builtin = ip_program_lookup_builtin(program, name);
     if (builtin) {
         int min_args = builtin->base.type & 0x0F;
         int max_args = (builtin->base.type >> 4) & 0x0F;
@@ -26,31 +26,13 @@
 #include "ip_ast.h"
 #include "ip_labels.h"
 #include "ip_value.h"
+#include "ip_wordtrie.h"
+#include <stdio.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-/**
- * @brief Execution context for an INTERPROGRAM.
- */
-typedef struct ip_exec_s ip_exec_t;
-
-/**
- * @brief Function prototype for built-in statements.
- *
- * @param[in,out] exec The execution context.
- * @param[in] args Points to the arguments and local variable space.
- * @param[in] num_args Number of arguments (0 to IP_MAX_LOCALS-1).
- *
- * @return IP_EXEC_OK or an error code.
- *
- * The argument array pointed to by @a args has IP_MAX_LOCALS entries.
- * These can be used for temporary local variable storage by the built-in.
- */
-typedef int (*ip_builtin_handler_t)
-    (ip_exec_t *exec, ip_value_t *args, size_t num_args);
-
 /**
  * @brief Registered built-in statement in the interpreter.
  */
@@ -65,29 +47,41 @@ typedef struct
 } ip_builtin_t;
 
 /**
- * @brief Information about a built-in statement in the interpreter,
- * for registering multiple built-ins in bulk;
+ * @brief Read-only registry of built-ins that is shared between programs.
+ *
+ * A registry is built once per process for each combination of
+ * registration function and dialect options.  It is never modified
+ * or freed after it has been published, so any number of programs
+ * on any number of threads can refer to it at the same time.
  */
 typedef struct
 {
-    /** Name of the built-in, must be in uppercase; NULL at end of the list. */
-    const char *name;
+    /** Key that identifies the function that registered the built-ins */
+    const void *key;
 
-    /** Pointer to the built-in handler */
-    ip_builtin_handler_t handler;
+    /** Options that were passed to the registration function */
+    unsigned options;
 
-    /** Minimum number of allowable arguments (0 to 9) */
-    signed char min_args;
+    /** Program that holds the built-ins and their global variables */
+    ip_program_t *program;
 
-    /** Maximum number of allowable arguments (0 to 9) */
-    signed char max_args;
+    /** Multi-word names of the built-ins for the tokeniser */
+    ip_word_trie_t names;
 
-} ip_builtin_info_t;
+} ip_builtin_registry_t;
 
 /**
- * @brief Structure of a program in memory after it has been parsed.
+ * @brief Function that registers built-ins with a program.
+ *
+ * @param[in,out] program The program to register the built-ins with.
+ * @param[in] options Options for the built-ins to register.
+ * @param[in] user_data User data that was supplied to
+ * ip_program_register_shared().
  */
-typedef struct
+typedef void (*ip_builtin_registry_init_t)
+    (ip_program_t *program, unsigned options, void *user_data);
+
+struct ip_program_s
 {
     /** Table containing all variables in the program */
     ip_var_table_t vars;
@@ -98,19 +92,26 @@ typedef struct
     /** List of all statements in the program */
     ip_ast_list_t statements;
 
-    /** Table containing the registered built-in statements */
+    /** Table containing the built-in statements registered directly
+     *  with this program, which override those in the registry */
     ip_symbol_table_t builtins;
 
+    /** Shared registry of built-in statements, or NULL if none */
+    const ip_builtin_registry_t *registry;
+
     /** Name of the file that the program was loaded from */
     char *filename;
 
     /** Input data that is embedded in the program */
     char *embedded_input;
 
-    /** Next embedded character to be read by "INPUT" */
-    const char *next_input;
+    /** Parser options that were in effect when built-ins were registered */
+    unsigned options;
+
+    /** Stream to report parse errors on (default is stderr) */
+    FILE *errors;
 
-} ip_program_t;
+};
 
 /**
  * @brief Creates a new program.
@@ -127,19 +128,23 @@ ip_program_t *ip_program_new(const char *filename);
 void ip_program_free(ip_program_t *program);
 
 /**
- * @brief Resets all variables to zero and marks them as uninitialised.
+ * @brief Sets the embedded input for the program.
  *
- * @param[in,out] program The program containing the variables to reset.
+ * @param[in,out] program The program state.
+ * @param[in] input The input to be embedded.
  */
-void ip_program_reset_variables(ip_program_t *program);
+void ip_program_set_input(ip_program_t *program, const char *input);
 
 /**
- * @brief Sets the embedded input for the program.
+ * @brief Sets the command-line arguments for the program in "ARGV".
  *
  * @param[in,out] program The program state.
- * @param[in] input The input to be embedded.
+ * @param[in] argc Number of command-line arguments.
+ * @param[in] argv The command-line arguments.
+ *
+ * Nothing is done if @a argc is zero.
  */
-void ip_program_set_input(ip_program_t *program, const char *input);
+void ip_program_set_argv(ip_program_t *program, int argc, char **argv);
 
 /**
  * @brief Registers a built-in statement with the program.
@@ -153,6 +158,9 @@ void ip_program_set_input(ip_program_t *program, const char *input);
  * This function will update the handler and number of arguments if the
  * built-in has already been registered.  This allows pre-defined built-ins
  * to be overridden by the application.
+ *
+ * The label and variable for a built-in routine are not created until
+ * the routine is first referred to with ip_program_lookup_label().
  */
 void ip_program_register_builtin
     (ip_program_t *program, const char *name,
@@ -168,6 +176,41 @@ void ip_program_register_builtin
 void ip_program_register_builtins
     (ip_program_t *program, const ip_builtin_info_t *builtins);
 
+/**
+ * @brief Registers built-ins with a program using a shared registry.
+ *
+ * @param[in,out] program The program state.
+ * @param[in] key Key that identifies the registration function,
+ * usually the address of the application's registration callback.
+ * @param[in] options Options for the built-ins to register.
+ * @param[in] init Function that registers the built-ins.
+ * @param[in] user_data User data to pass to @a init.
+ *
+ * @return The shared registry that @a program now refers to, or NULL
+ * if the built-ins were registered directly with @a program instead.
+ *
+ * The first call for a given @a key and @a options builds the registry
+ * by calling @a init on a private program.  Later calls reuse it, only
+ * copying the global variables that @a init created, such as "PI".
+ * The function @a init must register the same built-ins and variables
+ * every time that it is called with the same @a options.
+ */
+const ip_builtin_registry_t *ip_program_register_shared
+    (ip_program_t *program, const void *key, unsigned options,
+     ip_builtin_registry_init_t init, void *user_data);
+
+/**
+ * @brief Looks up a named label, creating the label for a built-in
+ * routine the first time that it is referred to.
+ *
+ * @param[in,out] program The program state.
+ * @param[in] name The name of the label.
+ *
+ * @return A pointer to the label, or NULL if @a name is neither a
+ * label nor a built-in routine.
+ */
+ip_label_t *ip_program_lookup_label(ip_program_t *program, const char *name);
+
 /**
  * @brief Looks up a built-in routine by name.
  *
@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2025 Rhys Weatherley
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "ip_random.h"
+
+/**
+ * @brief Rotates a 64-bit value left.
+ *
+ * @param[in] x The value to rotate.
+ * @param[in] k The number of bits to rotate by, between 1 and 63.
+ *
+ * @return The rotated value.
+ */
+#define ip_random_rotl(x, k) (((x) << (k)) | ((x) >> (64 - (k))))
+
+/**
+ * @brief Converts a 64-bit random number into a floating-point number
+ * between 0 and 1, excluding 1.
+ *
+ * @param[in] x The 64-bit random number.
+ *
+ * @return The floating-point number, using the top 53 bits of @a x.
+ */
+#define ip_random_to_float(x) \
+    (((ip_float_t)((x) >> 11)) * (1.0 / 9007199254740992.0))
+
+/**
+ * @brief Mixes the bits of a 64-bit value with the SplitMix64 finaliser.
+ *
+ * @param[in] z The value to mix.
+ *
+ * @return The mixed value.  The mapping is one-to-one and zero maps to zero.
+ */
+static ip_uint_t ip_random_mix64(ip_uint_t z)
+{
+    z = (z ^ (z >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+    z = (z ^ (z >> 27)) * UINT64_C(0x94D049BB133111EB);
+    return z ^ (z >> 31);
+}
+
+/**
+ * @brief Generates the next value from SplitMix64.
+ *
+ * @param[in,out] x The SplitMix64 state.
+ *
+ * @return The next value.
+ */
+static ip_uint_t ip_random_splitmix64(ip_uint_t *x)
+{
+    return ip_random_mix64(*x += UINT64_C(0x9E3779B97F4A7C15));
+}
+
+void ip_random_seed(ip_random_t *rng, ip_uint_t seed)
+{
+    rng->s[0] = ip_random_splitmix64(&seed);
+    rng->s[1] = ip_random_splitmix64(&seed);
+    rng->s[2] = ip_random_splitmix64(&seed);
+    rng->s[3] = ip_random_splitmix64(&seed);
+}
+
+void ip_random_seed_stream
+    (ip_random_t *rng, ip_uint_t seed, unsigned long stream)
+{
+    /* Hash the stream number into the seed so that any stream can be
+     * selected in constant time.  Stream zero is the same as the plain
+     * seed, and distinct streams always give distinct seeds. */
+    ip_random_seed(rng, seed ^ ip_random_mix64((ip_uint_t)stream));
+}
+
+ip_uint_t ip_random_next(ip_random_t *rng)
+{
+    ip_uint_t result = ip_random_rotl(rng->s[1] * 5, 7) * 9;
+    ip_uint_t t = rng->s[1] << 17;
+    rng->s[2] ^= rng->s[0];
+    rng->s[3] ^= rng->s[1];
+    rng->s[1] ^= rng->s[2];
+    rng->s[0] ^= rng->s[3];
+    rng->s[2] ^= t;
+    rng->s[3] = ip_random_rotl(rng->s[3], 45);
+    return result;
+}
+
+ip_float_t ip_random_float(ip_random_t *rng)
+{
+    ip_uint_t x = ip_random_next(rng);
+    return ip_random_to_float(x);
+}
+
+void ip_random_fill
+    (ip_random_t *rng, ip_float_t *values, size_t count)
+{
+    /* Copy the state into locals so that the compiler can keep it in
+     * registers rather than reloading it through "rng" every time. */
+    ip_uint_t s0 = rng->s[0];
+    ip_uint_t s1 = rng->s[1];
+    ip_uint_t s2 = rng->s[2];
+    ip_uint_t s3 = rng->s[3];
+    ip_uint_t x, t;
+    size_t index;
+    for (index = 0; index < count; ++index) {
+        x = ip_random_rotl(s1 * 5, 7) * 9;
+        t = s1 << 17;
+        s2 ^= s0;
+        s3 ^= s1;
+        s1 ^= s2;
+        s0 ^= s3;
+        s2 ^= t;
+        s3 = ip_random_rotl(s3, 45);
+        values[index] = ip_random_to_float(x);
+    }
+    rng->s[0] = s0;
+    rng->s[1] = s1;
+    rng->s[2] = s2;
+    rng->s[3] = s3;
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2025 Rhys Weatherley
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef INTERPROGRAM_RANDOM_H
+#define INTERPROGRAM_RANDOM_H
+
+#include "ip_types.h"
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief State of a random number generator.
+ *
+ * The generator is xoshiro256** by David Blackman and Sebastiano Vigna.
+ * It is fast, has a period of 2^256 - 1, and passes the usual statistical
+ * test suites.  Parallel jobs get separate streams by hashing the stream
+ * number into the seed, rather than by jumping ahead in a single sequence.
+ * The streams are not guaranteed to be disjoint, but with a period of
+ * 2^256 - 1 the chance of two jobs' sequences overlapping is negligible.
+ */
+typedef struct
+{
+    /** Internal state of the generator; must not be all-zeroes */
+    ip_uint_t s[4];
+
+} ip_random_t;
+
+/**
+ * @brief Seeds a random number generator.
+ *
+ * @param[out] rng The random number generator.
+ * @param[in] seed The seed value.
+ *
+ * The 256-bit state is expanded from the 64-bit @a seed with SplitMix64,
+ * so every seed value, including zero, gives a valid state.
+ */
+void ip_random_seed(ip_random_t *rng, ip_uint_t seed);
+
+/**
+ * @brief Seeds a random number generator and then selects a stream.
+ *
+ * @param[out] rng The random number generator.
+ * @param[in] seed The seed value.
+ * @param[in] stream The stream number, which is hashed into @a seed
+ * with SplitMix64.  Stream zero gives the same state as ip_random_seed().
+ *
+ * Parallel jobs that use the same @a seed but different @a stream
+ * numbers get independent sequences of random numbers that are
+ * reproducible from one run to the next.  Selecting a stream takes
+ * constant time, no matter how large @a stream is.
+ */
+void ip_random_seed_stream
+    (ip_random_t *rng, ip_uint_t seed, unsigned long stream);
+
+/**
+ * @brief Generates the next 64-bit random number.
+ *
+ * @param[in,out] rng The random number generator.
+ *
+ * @return The random number.
+ */
+ip_uint_t ip_random_next(ip_random_t *rng);
+
+/**
+ * @brief Generates a random floating-point number.
+ *
+ * @param[in,out] rng The random number generator.
+ *
+ * @return A random number between 0 and 1, excluding 1.
+ */
+ip_float_t ip_random_float(ip_random_t *rng);
+
+/**
+ * @brief Fills an array with random floating-point numbers.
+ *
+ * @param[in,out] rng The random number generator.
+ * @param[out] values The array to fill.
+ * @param[in] count The number of values in the array.
+ *
+ * The result is the same as calling ip_random_float() @a count times,
+ * but the generator state is kept in registers for the whole loop.
+ */
+void ip_random_fill
+    (ip_random_t *rng, ip_float_t *values, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -22,9 +22,18 @@
 
 #include "ip_string.h"
 #include "ip_types.h"
+#include "ip_atomic.h"
 #include <stdlib.h>
 #include <string.h>
 
+/**
+ * @brief The empty string, which is shared by everyone and never freed.
+ *
+ * The reference count is never modified so that threads that share
+ * the empty string do not contend over it.
+ */
+static ip_string_t ip_string_empty = {1, 0, {0}};
+
 ip_string_t *ip_string_create(const char *str)
 {
     if (str && *str != '\0') {
@@ -53,10 +62,7 @@ ip_string_t *ip_string_create_with_length(const char *str, size_t len)
 
 ip_string_t *ip_string_create_empty(void)
 {
-    /* String object that can never be deallocated because "ref" is 1 */
-    static ip_string_t empty = {1, 0, {0}};
-    ip_string_ref(&empty);
-    return &empty;
+    return &ip_string_empty;
 }
 
 size_t ip_string_length(const ip_string_t *str)
@@ -66,17 +72,19 @@ size_t ip_string_length(const ip_string_t *str)
 
 void ip_string_ref(ip_string_t *str)
 {
-    /* In the future, may want to make this atomic for multi-threaded code */
-    if (str) {
-        ++(str->ref);
+    /* Strings may be shared between threads, so update the count
+     * atomically.  The empty string is immortal and has no count. */
+    if (str && str != &ip_string_empty) {
+        ip_atomic_increment(&(str->ref));
     }
 }
 
 void ip_string_deref(ip_string_t *str)
 {
-    /* In the future, may want to make this atomic for multi-threaded code */
-    if (str) {
-        if (--(str->ref) == 0) {
+    /* Strings may be shared between threads, so update the count
+     * atomically.  The empty string is immortal and has no count. */
+    if (str && str != &ip_string_empty) {
+        if (ip_atomic_decrement(&(str->ref)) == 0) {
             free(str);
         }
     }
@@ -34,7 +34,7 @@ extern "C" {
  */
 typedef struct
 {
-    /** Reference counter for this string */
+    /** Reference counter for this string, which is updated atomically */
     size_t ref;
 
     /** Length of this string, not including the NUL terminator */
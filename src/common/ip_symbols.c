@@ -216,8 +216,8 @@ void ip_symbol_insert(ip_symbol_table_t *symbols, ip_symbol_t *symbol)
             x->right->red = 0;
             if (p->red) {
                 g->red = 1;
-                cmp  = ip_symbol_compare(symbol, g);
-                cmp2 = ip_symbol_compare(symbol, p);
+                cmp  = ip_symbol_compare(symbol, g) < 0;
+                cmp2 = ip_symbol_compare(symbol, p) < 0;
                 if (cmp != cmp2) {
                     p = ip_symbol_rotate(symbol, g);
                 }
@@ -240,8 +240,8 @@ void ip_symbol_insert(ip_symbol_table_t *symbols, ip_symbol_t *symbol)
     x->right->red = 0;
     if (p->red) {
         g->red = 1;
-        cmp  = ip_symbol_compare(symbol, g);
-        cmp2 = ip_symbol_compare(symbol, p);
+        cmp  = ip_symbol_compare(symbol, g) < 0;
+        cmp2 = ip_symbol_compare(symbol, p) < 0;
         if (cmp != cmp2) {
             p = ip_symbol_rotate(symbol, g);
         }
@@ -250,3 +250,21 @@ void ip_symbol_insert(ip_symbol_table_t *symbols, ip_symbol_t *symbol)
     }
     symbols->root.right->red = 0;
 }
+
+static void ip_symbol_walk_and_visit
+    (const ip_symbol_table_t *symbols, ip_symbol_t *symbol,
+     ip_symbol_visitor_t visitor, void *user_data)
+{
+    if (symbol != &(symbols->nil)) {
+        ip_symbol_walk_and_visit(symbols, symbol->left, visitor, user_data);
+        (*visitor)(symbol, user_data);
+        ip_symbol_walk_and_visit(symbols, symbol->right, visitor, user_data);
+    }
+}
+
+void ip_symbol_table_visit
+    (const ip_symbol_table_t *symbols, ip_symbol_visitor_t visitor,
+     void *user_data)
+{
+    ip_symbol_walk_and_visit(symbols, symbols->root.right, visitor, user_data);
+}
@@ -138,6 +138,25 @@ ip_symbol_t *ip_symbol_lookup_by_number
  */
 void ip_symbol_insert(ip_symbol_table_t *symbols, ip_symbol_t *symbol);
 
+/**
+ * @brief Callback function for ip_symbol_table_visit().
+ *
+ * @param[in] symbol The symbol that is being visited.
+ * @param[in] user_data User data that was supplied to ip_symbol_table_visit().
+ */
+typedef void (*ip_symbol_visitor_t)(ip_symbol_t *symbol, void *user_data);
+
+/**
+ * @brief Visits all symbols in a table in order.
+ *
+ * @param[in] symbols The symbol table.
+ * @param[in] visitor The visitor function.
+ * @param[in] user_data User data to pass to the visitor function.
+ */
+void ip_symbol_table_visit
+    (const ip_symbol_table_t *symbols, ip_symbol_visitor_t visitor,
+     void *user_data);
+
 #ifdef __cplusplus
 }
 #endif
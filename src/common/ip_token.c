@@ -21,9 +21,14 @@
  */
 
 #include "ip_token.h"
+#include "ip_atomic.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#if defined(__SSE2__) && defined(__GNUC__)
+#include <emmintrin.h>
+#define IP_TOKENISER_SSE2 1
+#endif
 
 static ip_token_info_t const tokens[] = {
     {",",                                   ITOK_COMMA,             ITOK_TYPE_ANY},
@@ -102,6 +107,7 @@ static ip_token_info_t const tokens[] = {
     {"BY",                                  ITOK_BY,                ITOK_TYPE_STATEMENT | ITOK_TYPE_EXPRESSION | ITOK_TYPE_EXTENSION},
     {"SYMBOLS FOR ROUTINES",                ITOK_SYMBOLS_ROUTINES,  ITOK_TYPE_PRELIMINARY | ITOK_TYPE_EXTENSION},
     {"AT END OF INPUT",                     ITOK_AT_END_OF_INPUT,   ITOK_TYPE_STATEMENT | ITOK_TYPE_EXTENSION},
+    {"FILL ARRAY WITH RANDOM NUMBERS",      ITOK_FILL_RANDOM,       ITOK_TYPE_STATEMENT | ITOK_TYPE_EXTENSION},
     {0,                                     ITOK_ERROR,             0}
 };
 
@@ -113,14 +119,16 @@ static ip_token_info_t const tokens[] = {
  */
 static void ip_tokeniser_add_line(ip_tokeniser_t *tokeniser, int ch)
 {
-    if (tokeniser->buffer_len >= tokeniser->buffer_max) {
-        tokeniser->buffer_max = tokeniser->buffer_len + 1024;
-        tokeniser->buffer = realloc(tokeniser->buffer, tokeniser->buffer_max);
-        if (!(tokeniser->buffer)) {
+    if (tokeniser->buffer_len >= tokeniser->line_storage_max) {
+        tokeniser->line_storage_max = tokeniser->buffer_len + 1024;
+        tokeniser->line_storage = realloc
+            (tokeniser->line_storage, tokeniser->line_storage_max);
+        if (!(tokeniser->line_storage)) {
             ip_out_of_memory();
         }
+        tokeniser->buffer = tokeniser->line_storage;
     }
-    tokeniser->buffer[(tokeniser->buffer_len)++] = (char)ch;
+    tokeniser->line_storage[(tokeniser->buffer_len)++] = (char)ch;
 }
 
 /**
@@ -151,10 +159,15 @@ static void ip_tokeniser_add_name(ip_tokeniser_t *tokeniser, int ch)
 static void ip_tokeniser_add_name_chars
     (ip_tokeniser_t *tokeniser, const char *name, size_t len)
 {
-    while (len > 0) {
-        ip_tokeniser_add_name(tokeniser, *name++);
-        --len;
+    if ((tokeniser->name_max - tokeniser->name_len) < len) {
+        tokeniser->name_max = tokeniser->name_len + len + 1024;
+        tokeniser->name = realloc(tokeniser->name, tokeniser->name_max);
+        if (!(tokeniser->name)) {
+            ip_out_of_memory();
+        }
     }
+    memcpy(tokeniser->name + tokeniser->name_len, name, len);
+    tokeniser->name_len += len;
 }
 
 /**
@@ -216,14 +229,22 @@ void ip_tokeniser_init(ip_tokeniser_t *tokeniser)
     tokeniser->integer_precision = sizeof(ip_uint_t) * 8;
     tokeniser->saved_token.code = ITOK_EOF;
     ip_tokeniser_set_token(tokeniser, ITOK_ERROR);
-    ip_symbol_table_init(&(tokeniser->routines));
+    ip_word_trie_init(&(tokeniser->routines));
+}
+
+void ip_tokeniser_set_block
+    (ip_tokeniser_t *tokeniser, const char *data, size_t len)
+{
+    tokeniser->block = data ? data : "";
+    tokeniser->block_posn = 0;
+    tokeniser->block_len = len;
 }
 
 void ip_tokeniser_free(ip_tokeniser_t *tokeniser)
 {
-    ip_symbol_table_free(&(tokeniser->routines));
-    if (tokeniser->buffer) {
-        free(tokeniser->buffer);
+    ip_word_trie_free(&(tokeniser->routines));
+    if (tokeniser->line_storage) {
+        free(tokeniser->line_storage);
     }
     if (tokeniser->name) {
         free(tokeniser->name);
@@ -407,6 +428,36 @@ static void ip_tokeniser_get_number(ip_tokeniser_t *tokeniser, unsigned context)
     ip_tokeniser_set_token(tokeniser, ITOK_FLOAT_VALUE);
 }
 
+/**
+ * @brief Finds the longest registered routine name at the start of a name.
+ *
+ * @param[in] tokeniser The tokeniser.
+ * @param[in] name Points to the name to look for.
+ * @param[in] len Length of the name to look for.
+ * @param[out] match_len Returns the number of characters of @a name
+ * that were matched.
+ *
+ * @return The normalised uppercase version of the routine name,
+ * or NULL if there is no routine name at the start of @a name.
+ */
+static const char *ip_tokeniser_find_routine_name
+    (const ip_tokeniser_t *tokeniser, const char *name, size_t len,
+     size_t *match_len)
+{
+    const char *routine;
+    const char *shared;
+    size_t shared_len;
+    routine = ip_word_trie_lookup_longest
+        (&(tokeniser->routines), name, len, match_len);
+    shared = ip_word_trie_lookup_longest
+        (tokeniser->shared_routines, name, len, &shared_len);
+    if (shared && (!routine || shared_len > *match_len)) {
+        *match_len = shared_len;
+        return shared;
+    }
+    return routine;
+}
+
 /**
  * @brief Gets an identifier and converts it into a keyword or variable name.
  *
@@ -444,24 +495,9 @@ static void ip_tokeniser_get_identifier
             (tokeniser->buffer + posn, tokeniser->buffer_posn - posn, context);
         if (info) {
             /* Full keyword found.  Keep looking because we may find a
-             * longer keyword later in the token table. */
-            if (strlen(info->name) > found_len) {
-                found_info = info;
-                found_len = strlen(info->name);
-                found_routine = 0;
-                end_keyword = tokeniser->buffer_posn;
-            }
-        } else {
-            /* Try looking for a registered routine with the name */
-            const char *routine = ip_tokeniser_is_routine_name
-                (tokeniser, tokeniser->buffer + posn,
-                 tokeniser->buffer_posn - posn);
-            if (routine && strlen(routine) > found_len) {
-                found_info = 0;
-                found_len = strlen(routine);
-                found_routine = routine;
-                end_keyword = tokeniser->buffer_posn;
-            }
+             * longer keyword by adding more words. */
+            found_info = info;
+            end_keyword = tokeniser->buffer_posn;
         }
 
         /* If there is whitespace followed by another word, then try
@@ -488,6 +524,17 @@ static void ip_tokeniser_get_identifier
         break;
     }
 
+    /* A multi-word routine name overrides a keyword if it is longer */
+    found_routine = ip_tokeniser_find_routine_name
+        (tokeniser, tokeniser->buffer + posn, tokeniser->buffer_posn - posn,
+         &found_len);
+    if (found_routine && (posn + found_len) > end_keyword) {
+        found_info = 0;
+        end_keyword = posn + found_len;
+    } else {
+        found_routine = 0;
+    }
+
     /* Did we find a suitable keyword? */
     if (found_info) {
         /* Built-in keyword */
@@ -520,6 +567,70 @@ static void ip_tokeniser_get_identifier
     ip_tokeniser_set_token(tokeniser, ITOK_VAR_NAME);
 }
 
+/**
+ * @brief Reads the next character of input.
+ *
+ * @param[in,out] tokeniser The tokeniser to read from.
+ *
+ * @return The character, or -1 at EOF.
+ */
+static int ip_tokeniser_read_next(ip_tokeniser_t *tokeniser)
+{
+    int ch = tokeniser->unget_char;
+    if (ch != -1) {
+        tokeniser->unget_char = -1;
+        return ch;
+    } else if (tokeniser->block) {
+        if (tokeniser->block_posn < tokeniser->block_len) {
+            return (unsigned char)(tokeniser->block[(tokeniser->block_posn)++]);
+        }
+        return -1;
+    } else {
+        return (*(tokeniser->read_char))(tokeniser->user_data);
+    }
+}
+
+/**
+ * @brief Finds the next character in a block that needs special handling
+ * when splitting the block into lines: LF, CR, or NUL.
+ *
+ * @param[in] data Points to the data to search.
+ * @param[in] len Length of the data to search.
+ *
+ * @return The offset of the next special character, or @a len if none.
+ */
+static size_t ip_tokeniser_find_eol(const char *data, size_t len)
+{
+    size_t posn = 0;
+#if defined(IP_TOKENISER_SSE2)
+    /* Search 16 bytes at a time */
+    const __m128i lf = _mm_set1_epi8('\n');
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i nul = _mm_setzero_si128();
+    __m128i chunk;
+    int mask;
+    while ((len - posn) >= 16) {
+        chunk = _mm_loadu_si128((const __m128i *)(data + posn));
+        mask = _mm_movemask_epi8
+            (_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, lf),
+                                       _mm_cmpeq_epi8(chunk, cr)),
+                          _mm_cmpeq_epi8(chunk, nul)));
+        if (mask != 0) {
+            return posn + (size_t)__builtin_ctz((unsigned)mask);
+        }
+        posn += 16;
+    }
+#endif
+    while (posn < len) {
+        char ch = data[posn];
+        if (ch == '\n' || ch == '\r' || ch == '\0') {
+            break;
+        }
+        ++posn;
+    }
+    return posn;
+}
+
 /**
  * @brief Gets the next line of input.
  *
@@ -529,6 +640,8 @@ static void ip_tokeniser_get_identifier
  */
 static int ip_tokeniser_get_line(ip_tokeniser_t *tokeniser)
 {
+    const char *line;
+    size_t eol;
     int ch;
     if (tokeniser->saw_eof) {
         /* We already saw EOF last time, so we are done */
@@ -538,13 +651,23 @@ static int ip_tokeniser_get_line(ip_tokeniser_t *tokeniser)
     ++(tokeniser->line);
     tokeniser->buffer_posn = 0;
     tokeniser->buffer_len = 0;
-    for (;;) {
-        if (tokeniser->unget_char == -1) {
-            ch = (*(tokeniser->read_char))(tokeniser->user_data);
-        } else {
-            ch = tokeniser->unget_char;
-            tokeniser->unget_char = -1;
+    if (tokeniser->block && tokeniser->unget_char == -1) {
+        /* If the line ends in a plain LF and has no NUL characters,
+         * then we can use it directly from the block without copying. */
+        line = tokeniser->block + tokeniser->block_posn;
+        eol = ip_tokeniser_find_eol
+            (line, tokeniser->block_len - tokeniser->block_posn);
+        if (eol < (tokeniser->block_len - tokeniser->block_posn) &&
+                line[eol] == '\n') {
+            tokeniser->buffer = line;
+            tokeniser->buffer_len = eol + 1;
+            tokeniser->block_posn += eol + 1;
+            return 1;
         }
+    }
+    tokeniser->buffer = tokeniser->line_storage;
+    for (;;) {
+        ch = ip_tokeniser_read_next(tokeniser);
         if (ch == '\n') {
             /* LF on its own marks the end of the line */
             ip_tokeniser_add_line(tokeniser, '\n');
@@ -552,7 +675,7 @@ static int ip_tokeniser_get_line(ip_tokeniser_t *tokeniser)
         } else if (ch == '\r') {
             /* CR or CRLF also marks the end of the line */
             ip_tokeniser_add_line(tokeniser, '\n');
-            ch = (*(tokeniser->read_char))(tokeniser->user_data);
+            ch = ip_tokeniser_read_next(tokeniser);
             if (ch == -1) {
                 /* CR followed by EOF - remember the EOF */
                 tokeniser->saw_eof = 1;
@@ -646,19 +769,24 @@ static void ip_tokeniser_get_string(ip_tokeniser_t *tokeniser, int quote)
  */
 static void ip_tokeniser_read_rest(ip_tokeniser_t *tokeniser)
 {
+    size_t len;
     int ch;
     while (!(tokeniser->saw_eof)) {
-        if (tokeniser->unget_char == -1) {
-            ch = (*(tokeniser->read_char))(tokeniser->user_data);
-        } else {
-            ch = tokeniser->unget_char;
-            tokeniser->unget_char = -1;
+        if (tokeniser->block && tokeniser->unget_char == -1) {
+            /* Copy ordinary characters from the block in bulk */
+            len = ip_tokeniser_find_eol
+                (tokeniser->block + tokeniser->block_posn,
+                 tokeniser->block_len - tokeniser->block_posn);
+            ip_tokeniser_add_name_chars
+                (tokeniser, tokeniser->block + tokeniser->block_posn, len);
+            tokeniser->block_posn += len;
         }
+        ch = ip_tokeniser_read_next(tokeniser);
         if (ch == -1) {
             tokeniser->saw_eof = 1;
         } else if (ch == '\r') {
             /* Check for CRLF and convert it into just LF */
-            ch = (*(tokeniser->read_char))(tokeniser->user_data);
+            ch = ip_tokeniser_read_next(tokeniser);
             if (ch == -1) {
                 tokeniser->saw_eof = 1;
             } else if (ch != '\n') {
@@ -859,76 +987,151 @@ const ip_token_info_t *ip_tokeniser_get_keyword(int token)
 }
 
 /**
- * @brief Match an alphabetic keyword token.
+ * @brief Node in the keyword trie.
+ */
+typedef struct
+{
+    /** Character on the edge leading to this node; ' ' for whitespace */
+    char ch;
+
+    /** Index of the first child of this node, or zero for none */
+    unsigned short child;
+
+    /** Index of the next sibling of this node, or zero for none */
+    unsigned short sibling;
+
+    /** Keyword that ends at this node in the classic language, or NULL */
+    const ip_token_info_t *classic;
+
+    /** Keyword that ends at this node in the extended language, or NULL */
+    const ip_token_info_t *extended;
+
+} ip_keyword_node_t;
+
+/**
+ * @brief Trie over all keywords, shared by all tokenisers.
+ *
+ * Node zero is the root.  The trie is built on first use and is never
+ * modified after that, so it can be safely read from multiple threads.
+ */
+static ip_keyword_node_t *keyword_trie = 0;
+
+/**
+ * @brief Builds the keyword trie.
  *
- * @param[in] name Points to the name to match.
- * @param[in] len Length of the name in characters.
- * @param[in] name2 Points to the normalised keyword name to match against.
+ * @return The nodes of the trie.
  *
- * @return Non-zero if the keyword matches, zero if not.
+ * Alphabetic keywords are stored in upper case with a single space
+ * between words.  Punctuation keywords are stored as-is.  When the same
+ * name appears more than once in the token table, the earliest entry
+ * that is valid in each dialect wins.
  */
-static int ip_tokeniser_match_keyword
-    (const char *name, size_t len, const char *name2)
+static ip_keyword_node_t *ip_tokeniser_build_keyword_trie(void)
 {
-    while (len > 0 && *name2 != '\0') {
-        if (*name2 == ' ') {
-            /* We expect one or more whitespace characters in this position */
-            if (!ip_tokeniser_is_space(*name)) {
-                return 0;
-            }
-            while (len > 0 && ip_tokeniser_is_space(*name)) {
-                ++name;
-                --len;
-            }
-        } else {
-            /* Match the next alphabetic character in upper case */
-            int ch = *name++;
-            if (ch >= 'a' && ch <= 'z') {
-                ch = ch - 'a' + 'A';
+    ip_keyword_node_t *nodes;
+    const ip_token_info_t *info;
+    const char *name;
+    size_t max_nodes = 1;
+    size_t num_nodes = 1;
+    size_t node, child;
+
+    for (info = tokens; info->name != 0; ++info) {
+        max_nodes += strlen(info->name);
+    }
+    nodes = calloc(max_nodes, sizeof(ip_keyword_node_t));
+    if (!nodes) {
+        ip_out_of_memory();
+    }
+    for (info = tokens; info->name != 0; ++info) {
+        node = 0;
+        for (name = info->name; *name != '\0'; ++name) {
+            for (child = nodes[node].child; child != 0;
+                    child = nodes[child].sibling) {
+                if (nodes[child].ch == *name) {
+                    break;
+                }
             }
-            if (*name2 != ch) {
-                return 0;
+            if (!child) {
+                child = num_nodes++;
+                nodes[child].ch = *name;
+                nodes[child].sibling = nodes[node].child;
+                nodes[node].child = (unsigned short)child;
             }
-            --len;
+            node = child;
+        }
+        if (!(nodes[node].extended)) {
+            nodes[node].extended = info;
+        }
+        if (!(nodes[node].classic) &&
+                (info->flags & ITOK_TYPE_EXTENSION) == 0) {
+            nodes[node].classic = info;
         }
-        ++name2;
     }
-    return (len == 0 && *name2 == '\0');
+    return nodes;
+}
+
+/**
+ * @brief Gets the keyword trie, building it if necessary.
+ *
+ * @return The nodes of the trie.
+ */
+static const ip_keyword_node_t *ip_tokeniser_keyword_trie(void)
+{
+    ip_keyword_node_t *nodes = ip_atomic_load(&keyword_trie);
+    ip_keyword_node_t *expected = 0;
+    if (!nodes) {
+        /* If another thread beat us to it, then use its copy instead */
+        nodes = ip_tokeniser_build_keyword_trie();
+        if (!ip_atomic_compare_exchange(&keyword_trie, &expected, nodes)) {
+            free(nodes);
+            nodes = expected;
+        }
+    }
+    return nodes;
 }
 
 const ip_token_info_t *ip_tokeniser_lookup_keyword
     (const char *name, size_t len, unsigned context)
 {
-    const ip_token_info_t *info;
-    size_t tlen;
+    const ip_keyword_node_t *nodes = ip_tokeniser_keyword_trie();
+    size_t node = 0;
+    int exact;
+    int ch;
     if (!len) {
         return 0;
     }
-    for (info = tokens; info->name != 0; ++info) {
-        /* Ignore the token if it is an extension but we are not
-         * currently parsing the extended syntax. */
-        if ((info->flags & ITOK_TYPE_EXTENSION) != 0) {
-            if ((context & ITOK_TYPE_EXTENSION) == 0) {
-                continue;
+
+    /* Punctuation tokens must match exactly.  Alphabetic keywords are
+     * case-insensitive and allow any amount of whitespace between words. */
+    exact = !ip_tokeniser_is_alpha(name[0]);
+    while (len > 0) {
+        ch = *name++;
+        --len;
+        if (!exact) {
+            if (ip_tokeniser_is_space(ch)) {
+                while (len > 0 && ip_tokeniser_is_space(*name)) {
+                    ++name;
+                    --len;
+                }
+                ch = ' ';
+            } else if (ch >= 'a' && ch <= 'z') {
+                ch = ch - 'a' + 'A';
             }
         }
-
-        /* Handle punctuation tokens, which must match exactly */
-        tlen = strlen(info->name);
-        if (!ip_tokeniser_is_alpha(name[0]) ||
-                !ip_tokeniser_is_alpha(info->name[0])) {
-            if (len == tlen && !memcmp(name, info->name, len)) {
-                return info;
+        for (node = nodes[node].child; node != 0; node = nodes[node].sibling) {
+            if (nodes[node].ch == ch) {
+                break;
             }
-            continue;
         }
-
-        /* Match against an alphabetic keyword */
-        if (ip_tokeniser_match_keyword(name, len, info->name)) {
-            return info;
+        if (!node) {
+            return 0;
         }
     }
-    return 0;
+    if ((context & ITOK_TYPE_EXTENSION) != 0) {
+        return nodes[node].extended;
+    } else {
+        return nodes[node].classic;
+    }
 }
 
 char *ip_tokeniser_read_punch(ip_tokeniser_t *tokeniser)
@@ -1064,50 +1267,27 @@ int ip_tokeniser_lookahead(ip_tokeniser_t *tokeniser, int ch)
 void ip_tokeniser_register_routine_name
     (ip_tokeniser_t *tokeniser, const char *name)
 {
-    ip_symbol_t *routine;
-
     /* Single-word routine names do not need to be registered */
     if (strchr(name, ' ') == 0) {
         return;
     }
 
-    /* Register the routine */
-    routine = calloc(1, sizeof(ip_symbol_t));
-    if (!routine) {
-        ip_out_of_memory();
-    }
-    routine->name = strdup(name);
-    if (!(routine->name)) {
-        ip_out_of_memory();
+    /* Register the routine unless it is already in the shared names */
+    if (!ip_word_trie_lookup
+            (tokeniser->shared_routines, name, strlen(name))) {
+        ip_word_trie_insert(&(tokeniser->routines), name);
     }
-    ip_symbol_insert(&(tokeniser->routines), routine);
-}
-
-static const char *ip_tokeniser_find_routine_name
-    (const ip_tokeniser_t *tokeniser, const char *name, size_t len,
-     ip_symbol_t *routine)
-{
-    const char *result;
-    if (routine && routine != &(tokeniser->routines.nil)) {
-        if (ip_tokeniser_match_keyword(name, len, routine->name)) {
-            return routine->name;
-        }
-        result = ip_tokeniser_find_routine_name
-            (tokeniser, name, len, routine->left);
-        if (result) {
-            return result;
-        }
-        return ip_tokeniser_find_routine_name
-            (tokeniser, name, len, routine->right);
-    }
-    return 0;
 }
 
 const char *ip_tokeniser_is_routine_name
     (const ip_tokeniser_t *tokeniser, const char *name, size_t len)
 {
-    return ip_tokeniser_find_routine_name
-        (tokeniser, name, len, tokeniser->routines.root.right);
+    const char *routine;
+    routine = ip_word_trie_lookup(&(tokeniser->routines), name, len);
+    if (!routine) {
+        routine = ip_word_trie_lookup(tokeniser->shared_routines, name, len);
+    }
+    return routine;
 }
 
 void ip_tokeniser_save_token(ip_tokeniser_t *tokeniser)
@@ -24,6 +24,7 @@
 #define INTERPROGRAM_TOKEN_H
 
 #include "ip_symbols.h"
+#include "ip_wordtrie.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -108,12 +109,13 @@ extern "C" {
 #define ITOK_BY                 0xC9    /**< BY */
 #define ITOK_SYMBOLS_ROUTINES   0xCA    /**< SYMBOLS FOR ROUTINES */
 #define ITOK_AT_END_OF_INPUT    0xCB    /**< AT END OF INPUT */
+#define ITOK_FILL_RANDOM        0xCC    /**< FILL ARRAY WITH RANDOM NUMBERS */
 
 /** First keyword token */
 #define ITOK_FIRST_KEYWORD      ITOK_COMMA
 
 /** Last keyword token */
-#define ITOK_LAST_KEYWORD       ITOK_AT_END_OF_INPUT
+#define ITOK_LAST_KEYWORD       ITOK_FILL_RANDOM
 
 /* Meta-tokens for non-keyword elements */
 #define ITOK_VAR_NAME           0xE0    /**< Variable name */
@@ -139,6 +141,7 @@ extern "C" {
 #define ITOK_FUNCTION_NAME      0xF4    /**< Name of a function as a keyword */
 #define ITOK_FUNCTION_NAME0     0xF5    /**< Function with no arguments */
 #define ITOK_FUNCTION_INVOKE    0xF6    /**< Invocation of a function */
+#define ITOK_THIS_CHAIN         0xF7    /**< Fused chain of "THIS" statements */
 
 /* Token type flags */
 /** Token can appear in the preliminary statements */
@@ -249,8 +252,8 @@ typedef struct
     /** Number of the current line */
     unsigned long line;
 
-    /** Buffer for storing the current line temporarily */
-    char *buffer;
+    /** Current line, which points into "line_storage" or "block" */
+    const char *buffer;
 
     /** Position within the current line */
     size_t buffer_posn;
@@ -258,8 +261,20 @@ typedef struct
     /** Length of the current line */
     size_t buffer_len;
 
-    /** Maximum length of the current line buffer */
-    size_t buffer_max;
+    /** Storage for lines that need to be copied from the input */
+    char *line_storage;
+
+    /** Maximum length of the line storage buffer */
+    size_t line_storage_max;
+
+    /** Block of input data to read from instead of "read_char", or NULL */
+    const char *block;
+
+    /** Position within the block of input data */
+    size_t block_posn;
+
+    /** Length of the block of input data */
+    size_t block_len;
 
     /** Buffer for storing token names temporarily */
     char *name;
@@ -273,8 +288,11 @@ typedef struct
     /** Space for information about variable names and numeric tokens */
     ip_token_info_t token_space;
 
-    /** Registered routine names */
-    ip_symbol_table_t routines;
+    /** Registered routine names that are specific to this tokeniser */
+    ip_word_trie_t routines;
+
+    /** Routine names that are shared with other tokenisers, or NULL */
+    const ip_word_trie_t *shared_routines;
 
     /** Saved token information */
     ip_token_info_t saved_token;
@@ -293,10 +311,26 @@ typedef struct
  * @param[out] tokeniser The tokeniser to initialise.
  *
  * This function call must be followed by setting "read_char",
- * "user_data", and "filename" in the @a tokeniser object.
+ * "user_data", and "filename" in the @a tokeniser object, or by
+ * calling ip_tokeniser_set_block() and setting "filename".
  */
 void ip_tokeniser_init(ip_tokeniser_t *tokeniser);
 
+/**
+ * @brief Sets a block of memory as the input for a tokeniser.
+ *
+ * @param[in,out] tokeniser The tokeniser.
+ * @param[in] data Points to the input data.
+ * @param[in] len Length of the input data in bytes.
+ *
+ * This is faster than reading the input through "read_char" because
+ * lines that end in LF are handed out as slices of @a data without
+ * being copied.  The @a data must remain valid until the tokeniser
+ * is freed.
+ */
+void ip_tokeniser_set_block
+    (ip_tokeniser_t *tokeniser, const char *data, size_t len);
+
 /**
  * @brief Frees the memory associated with a tokeniser.
  *
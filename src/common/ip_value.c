@@ -132,11 +132,12 @@ int ip_value_to_string(ip_value_t *value)
     }
 }
 
-int ip_value_from_var(ip_value_t *dest, const ip_var_t *src)
+int ip_value_from_var
+    (ip_value_t *dest, const ip_var_t *var, const ip_var_value_t *src)
 {
     ip_value_release(dest);
 
-    switch (ip_var_get_type(src)) {
+    switch (ip_var_get_type(var)) {
     case IP_TYPE_INT:
         dest->type = IP_TYPE_INT;
         dest->ivalue = src->ivalue;
@@ -169,23 +170,24 @@ int ip_value_from_var(ip_value_t *dest, const ip_var_t *src)
         dest->svalue = ip_string_create_empty();
         return IP_EXEC_BAD_TYPE;
     }
-    if (ip_var_is_initialised(src)) {
+    if (src->initialised) {
         return IP_EXEC_OK;
     } else {
         return IP_EXEC_UNINIT;
     }
 }
 
-int ip_value_to_var(ip_var_t *dest, const ip_value_t *src)
+int ip_value_to_var
+    (const ip_var_t *var, ip_var_value_t *dest, const ip_value_t *src)
 {
-    switch (ip_var_get_type(dest)) {
+    switch (ip_var_get_type(var)) {
     case IP_TYPE_INT:
         if (src->type == IP_TYPE_INT) {
             dest->ivalue = src->ivalue;
-            ip_var_mark_as_initialised(dest);
+            dest->initialised = 1;
         } else if (src->type == IP_TYPE_FLOAT) {
             dest->ivalue = (ip_int_t)(src->fvalue);
-            ip_var_mark_as_initialised(dest);
+            dest->initialised = 1;
         } else {
             return IP_EXEC_BAD_TYPE;
         }
@@ -194,10 +196,10 @@ int ip_value_to_var(ip_var_t *dest, const ip_value_t *src)
     case IP_TYPE_FLOAT:
         if (src->type == IP_TYPE_FLOAT) {
             dest->fvalue = src->fvalue;
-            ip_var_mark_as_initialised(dest);
+            dest->initialised = 1;
         } else if (src->type == IP_TYPE_INT) {
             dest->fvalue = (ip_float_t)(src->ivalue);
-            ip_var_mark_as_initialised(dest);
+            dest->initialised = 1;
         } else {
             return IP_EXEC_BAD_TYPE;
         }
@@ -208,7 +210,7 @@ int ip_value_to_var(ip_var_t *dest, const ip_value_t *src)
             ip_string_ref(src->svalue);
             ip_string_deref(dest->svalue);
             dest->svalue = src->svalue;
-            ip_var_mark_as_initialised(dest);
+            dest->initialised = 1;
         } else {
             return IP_EXEC_BAD_TYPE;
         }
@@ -220,16 +222,18 @@ int ip_value_to_var(ip_var_t *dest, const ip_value_t *src)
     return IP_EXEC_OK;
 }
 
-static int ip_value_validate_index(const ip_var_t *src, ip_int_t index)
+static int ip_value_validate_index(const ip_var_t *var, ip_int_t index)
 {
-    return (index >= src->min_subscript && index <= src->max_subscript);
+    return (index >= var->min_subscript && index <= var->max_subscript);
 }
 
-int ip_value_from_array(ip_value_t *dest, const ip_var_t *src, ip_int_t index)
+int ip_value_from_array
+    (ip_value_t *dest, const ip_var_t *var, const ip_var_value_t *src,
+     ip_int_t index)
 {
     ip_value_release(dest);
 
-    switch (ip_var_get_type(src)) {
+    switch (ip_var_get_type(var)) {
     case IP_TYPE_INT:
     default:
         dest->type = IP_TYPE_INT;
@@ -255,8 +259,8 @@ int ip_value_from_array(ip_value_t *dest, const ip_var_t *src, ip_int_t index)
 
     case IP_TYPE_ARRAY_OF_INT:
         dest->type = IP_TYPE_INT;
-        if (ip_value_validate_index(src, index)) {
-            dest->ivalue = src->iarray[index - src->min_subscript];
+        if (ip_value_validate_index(var, index)) {
+            dest->ivalue = src->iarray[index - var->min_subscript];
         } else {
             dest->ivalue = 0;
             return IP_EXEC_BAD_INDEX;
@@ -265,8 +269,8 @@ int ip_value_from_array(ip_value_t *dest, const ip_var_t *src, ip_int_t index)
 
     case IP_TYPE_ARRAY_OF_FLOAT:
         dest->type = IP_TYPE_FLOAT;
-        if (ip_value_validate_index(src, index)) {
-            dest->fvalue = src->farray[index - src->min_subscript];
+        if (ip_value_validate_index(var, index)) {
+            dest->fvalue = src->farray[index - var->min_subscript];
         } else {
             dest->fvalue = 0;
             return IP_EXEC_BAD_INDEX;
@@ -275,8 +279,8 @@ int ip_value_from_array(ip_value_t *dest, const ip_var_t *src, ip_int_t index)
 
     case IP_TYPE_ARRAY_OF_STRING:
         dest->type = IP_TYPE_STRING;
-        if (ip_value_validate_index(src, index)) {
-            ip_string_t *str = src->sarray[index - src->min_subscript];
+        if (ip_value_validate_index(var, index)) {
+            ip_string_t *str = src->sarray[index - var->min_subscript];
             ip_string_ref(str);
             dest->svalue = str;
         } else {
@@ -288,41 +292,43 @@ int ip_value_from_array(ip_value_t *dest, const ip_var_t *src, ip_int_t index)
     return IP_EXEC_OK;
 }
 
-int ip_value_to_array(ip_var_t *dest, ip_int_t index, const ip_value_t *src)
+int ip_value_to_array
+    (const ip_var_t *var, ip_var_value_t *dest, ip_int_t index,
+     const ip_value_t *src)
 {
-    switch (ip_var_get_type(dest)) {
+    switch (ip_var_get_type(var)) {
     case IP_TYPE_ARRAY_OF_INT:
-        if (!ip_value_validate_index(dest, index)) {
+        if (!ip_value_validate_index(var, index)) {
             return IP_EXEC_BAD_INDEX;
         }
         if (src->type == IP_TYPE_INT) {
-            dest->iarray[index - dest->min_subscript] = src->ivalue;
+            dest->iarray[index - var->min_subscript] = src->ivalue;
         } else if (src->type == IP_TYPE_FLOAT) {
-            dest->iarray[index - dest->min_subscript] = (ip_int_t)(src->fvalue);
+            dest->iarray[index - var->min_subscript] = (ip_int_t)(src->fvalue);
         } else {
             return IP_EXEC_BAD_TYPE;
         }
         break;
 
     case IP_TYPE_ARRAY_OF_FLOAT:
-        if (!ip_value_validate_index(dest, index)) {
+        if (!ip_value_validate_index(var, index)) {
             return IP_EXEC_BAD_INDEX;
         }
         if (src->type == IP_TYPE_FLOAT) {
-            dest->farray[index - dest->min_subscript] = src->fvalue;
+            dest->farray[index - var->min_subscript] = src->fvalue;
         } else if (src->type == IP_TYPE_INT) {
-            dest->farray[index - dest->min_subscript] = (ip_float_t)(src->ivalue);
+            dest->farray[index - var->min_subscript] = (ip_float_t)(src->ivalue);
         } else {
             return IP_EXEC_BAD_TYPE;
         }
         break;
 
     case IP_TYPE_ARRAY_OF_STRING:
-        if (!ip_value_validate_index(dest, index)) {
+        if (!ip_value_validate_index(var, index)) {
             return IP_EXEC_BAD_INDEX;
         }
         if (src->type == IP_TYPE_STRING) {
-            ip_string_t **elem = &(dest->sarray[index - dest->min_subscript]);
+            ip_string_t **elem = &(dest->sarray[index - var->min_subscript]);
             ip_string_t *str = src->svalue;
             ip_string_ref(str);
             ip_string_deref(*elem);
@@ -23,35 +23,13 @@
 #ifndef INTERPROGRAM_VALUE_H
 #define INTERPROGRAM_VALUE_H
 
-#include "ip_types.h"
+#include "ip_builtin.h"
 #include "ip_vars.h"
-#include "ip_string.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-/**
- * @brief Value that has been evaluated by the program.
- */
-typedef struct
-{
-    /** Type of value; e.g. IP_TYPE_INT */
-    unsigned char type;
-
-    union {
-        /** Integer value */
-        ip_int_t ivalue;
-
-        /** Floating-point value */
-        ip_float_t fvalue;
-
-        /** String value (reference counted) */
-        ip_string_t *svalue;
-    };
-
-} ip_value_t;
-
 /**
  * @brief Initialises a value to unknown.
  *
@@ -138,43 +116,53 @@ int ip_value_to_string(ip_value_t *value);
  * @brief Assigns the contents of a variable to a value.
  *
  * @param[in,out] dest Destination to assign to.
- * @param[in] src The source variable to assign.
+ * @param[in] var The source variable to assign.
+ * @param[in] src The value of the source variable.
  *
  * @return IP_EXEC_OK or an error code.
  */
-int ip_value_from_var(ip_value_t *dest, const ip_var_t *src);
+int ip_value_from_var
+    (ip_value_t *dest, const ip_var_t *var, const ip_var_value_t *src);
 
 /**
  * @brief Assigns a value to a destination variable.
  *
- * @param[in,out] dest Destination variable to assign to.
+ * @param[in] var Destination variable to assign to.
+ * @param[in,out] dest The value of the destination variable.
  * @param[in] src The source value to assign.
  *
  * @return IP_EXEC_OK or an error code.
  */
-int ip_value_to_var(ip_var_t *dest, const ip_value_t *src);
+int ip_value_to_var
+    (const ip_var_t *var, ip_var_value_t *dest, const ip_value_t *src);
 
 /**
  * @brief Copies an array element into a value.
  *
  * @param[in,out] dest Destination value to assign to.
- * @param[in] src The source array variable.
+ * @param[in] var The source array variable.
+ * @param[in] src The value of the source array variable.
  * @param[in] index The index within the array to access.
  *
  * @return IP_EXEC_OK or an error code.
  */
-int ip_value_from_array(ip_value_t *dest, const ip_var_t *src, ip_int_t index);
+int ip_value_from_array
+    (ip_value_t *dest, const ip_var_t *var, const ip_var_value_t *src,
+     ip_int_t index);
 
 /**
  * @brief Copies a value into an array element.
  *
- * @param[in,out] dest Destination array variable.
+ * @param[in] var Destination array variable.
+ * @param[in,out] dest The value of the destination array variable.
  * @param[in] index The index within the array to access.
  * @param[in] src The source value to assign.
  *
  * @return IP_EXEC_OK or an error code.
  */
-int ip_value_to_array(ip_var_t *dest, ip_int_t index, const ip_value_t *src);
+int ip_value_to_array
+    (const ip_var_t *var, ip_var_value_t *dest, ip_int_t index,
+     const ip_value_t *src);
 
 #ifdef __cplusplus
 }
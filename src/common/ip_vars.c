@@ -44,96 +44,149 @@ static void ip_var_free_string_array(ip_string_t **array, ip_uint_t size)
     }
 }
 
-static void ip_var_free(ip_symbol_t *symbol)
+/**
+ * @brief Gets the number of elements in an array variable.
+ *
+ * @param[in] var The variable.
+ *
+ * @return The number of elements.
+ */
+static ip_uint_t ip_var_array_size(const ip_var_t *var)
+{
+    return var->max_subscript - var->min_subscript + 1;
+}
+
+/**
+ * @brief Frees the contents of a variable's value.
+ *
+ * @param[in] var The variable, which determines the type of the value.
+ * @param[in,out] value The value to free.
+ */
+static void ip_var_free_value(const ip_var_t *var, ip_var_value_t *value)
 {
-    ip_var_t *var = (ip_var_t *)symbol;
     switch (ip_var_get_type(var)) {
     case IP_TYPE_STRING:
-        ip_string_deref(var->svalue);
+        ip_string_deref(value->svalue);
         break;
 
     case IP_TYPE_ARRAY_OF_INT:
-        if (var->iarray) {
-            free(var->iarray);
+        if (value->iarray) {
+            free(value->iarray);
         }
         break;
 
     case IP_TYPE_ARRAY_OF_FLOAT:
-        if (var->farray) {
-            free(var->farray);
+        if (value->farray) {
+            free(value->farray);
         }
         break;
 
     case IP_TYPE_ARRAY_OF_STRING:
-        if (var->sarray) {
-            ip_var_free_string_array
-                (var->sarray, var->max_subscript - var->min_subscript + 1);
-            free(var->sarray);
+        if (value->sarray) {
+            ip_var_free_string_array(value->sarray, ip_var_array_size(var));
+            free(value->sarray);
         }
         break;
 
     default: break;
     }
+    memset(value, 0, sizeof(ip_var_value_t));
 }
 
-static void ip_var_reset(ip_symbol_t *symbol)
+/**
+ * @brief Sets a variable's value to its starting value for execution.
+ *
+ * @param[in] var The variable.
+ * @param[out] value The value to set.
+ */
+static void ip_var_start_value(const ip_var_t *var, ip_var_value_t *value)
 {
-    ip_var_t *var = (ip_var_t *)symbol;
+    int copy = (var->base.flags & IP_SYMBOL_NO_RESET) != 0;
     ip_uint_t size;
+    ip_uint_t index;
+    memset(value, 0, sizeof(ip_var_value_t));
     switch (ip_var_get_type(var)) {
     case IP_TYPE_INT:
-        ip_var_mark_as_uninitialised(var);
-        var->ivalue = 0;
-        break;
-
     case IP_TYPE_FLOAT:
-        ip_var_mark_as_uninitialised(var);
-        var->fvalue = 0;
+        if (copy) {
+            *value = var->initial;
+            value->initialised = ip_var_is_initialised(var);
+        }
         break;
 
     case IP_TYPE_STRING:
-        ip_var_mark_as_uninitialised(var);
-        if (var->svalue->len != 0) {
-            ip_string_deref(var->svalue);
-            var->svalue = ip_string_create_empty();
+        if (copy) {
+            value->svalue = var->initial.svalue;
+            ip_string_ref(value->svalue);
+            value->initialised = ip_var_is_initialised(var);
+        } else {
+            value->svalue = ip_string_create_empty();
         }
         break;
 
     case IP_TYPE_ARRAY_OF_INT:
-        size = var->max_subscript - var->min_subscript + 1;
-        memset(var->iarray, 0, sizeof(ip_int_t) * size);
+        size = ip_var_array_size(var);
+        value->iarray = calloc(size, sizeof(ip_int_t));
+        if (!(value->iarray)) {
+            ip_out_of_memory();
+        }
+        if (copy && var->initial.iarray) {
+            memcpy(value->iarray, var->initial.iarray, size * sizeof(ip_int_t));
+        }
+        value->initialised = 1; /* Arrays are implicitly initialised */
         break;
 
     case IP_TYPE_ARRAY_OF_FLOAT:
-        size = var->max_subscript - var->min_subscript + 1;
-        memset(var->farray, 0, sizeof(ip_float_t) * size);
+        size = ip_var_array_size(var);
+        value->farray = calloc(size, sizeof(ip_float_t));
+        if (!(value->farray)) {
+            ip_out_of_memory();
+        }
+        if (copy && var->initial.farray) {
+            memcpy(value->farray, var->initial.farray,
+                   size * sizeof(ip_float_t));
+        }
+        value->initialised = 1; /* Arrays are implicitly initialised */
         break;
 
     case IP_TYPE_ARRAY_OF_STRING:
-        size = var->max_subscript - var->min_subscript + 1;
-        ip_var_free_string_array(var->sarray, size);
-        ip_var_init_string_array(var->sarray, size);
+        size = ip_var_array_size(var);
+        value->sarray = malloc(size * sizeof(ip_string_t *));
+        if (!(value->sarray)) {
+            ip_out_of_memory();
+        }
+        if (copy && var->initial.sarray) {
+            for (index = 0; index < size; ++index) {
+                value->sarray[index] = var->initial.sarray[index];
+                ip_string_ref(value->sarray[index]);
+            }
+        } else {
+            ip_var_init_string_array(value->sarray, size);
+        }
+        value->initialised = 1; /* Arrays are implicitly initialised */
         break;
 
     default: break;
     }
 }
 
+static void ip_var_free(ip_symbol_t *symbol)
+{
+    ip_var_t *var = (ip_var_t *)symbol;
+    ip_var_free_value(var, &(var->initial));
+}
+
 void ip_var_table_init(ip_var_table_t *vars)
 {
     ip_symbol_table_init(&(vars->symbols));
     vars->symbols.free_symbol = ip_var_free;
-    vars->symbols.reset_symbol = ip_var_reset;
+    vars->num_vars = 0;
 }
 
 void ip_var_table_free(ip_var_table_t *vars)
 {
     ip_symbol_table_free(&(vars->symbols));
-}
-
-void ip_var_table_reset(ip_var_table_t *vars)
-{
-    ip_symbol_table_reset(&(vars->symbols));
+    vars->num_vars = 0;
 }
 
 ip_var_t *ip_var_lookup(const ip_var_table_t *vars, const char *name)
@@ -164,8 +217,9 @@ ip_var_t *ip_var_create
         ip_out_of_memory();
     }
     var->base.type = type;
+    var->index = (vars->num_vars)++;
     if (type == IP_TYPE_STRING) {
-        var->svalue = ip_string_create_empty();
+        var->initial.svalue = ip_string_create_empty();
     }
 
     /* Insert the new variable into the red-black tree */
@@ -176,7 +230,7 @@ ip_var_t *ip_var_create
 void ip_var_dimension_array
     (ip_var_t *var, ip_int_t min_subscript, ip_int_t max_subscript)
 {
-    ip_uint_t prev_size;
+    ip_var_value_t *value = &(var->initial);
     ip_uint_t size;
 
     /* Check that the variable can be converted into an array */
@@ -185,59 +239,44 @@ void ip_var_dimension_array
         return;
     }
 
-    /* Determine the size of the array from the subscript range */
-    prev_size = var->max_subscript - var->min_subscript + 1;
-    size = max_subscript - min_subscript + 1;
-    var->min_subscript = min_subscript;
-    var->max_subscript = max_subscript;
-    ip_var_mark_as_initialised(var); /* Arrays are implicitly initialised */
-
-    /* Convert the variable into an array if it isn't already */
+    /* Free the previous initial value and convert the variable into
+     * an array if it isn't already */
+    ip_var_free_value(var, value);
     if (var->base.type == IP_TYPE_INT) {
         var->base.type = IP_TYPE_ARRAY_OF_INT;
-        var->iarray = 0;
     } else if (var->base.type == IP_TYPE_FLOAT) {
         var->base.type = IP_TYPE_ARRAY_OF_FLOAT;
-        var->farray = 0;
     } else if (var->base.type == IP_TYPE_STRING) {
         var->base.type = IP_TYPE_ARRAY_OF_STRING;
-        var->sarray = 0;
     }
 
-    /* Allocate or reallocate the memory for the array */
+    /* Determine the size of the array from the subscript range */
+    size = max_subscript - min_subscript + 1;
+    var->min_subscript = min_subscript;
+    var->max_subscript = max_subscript;
+    ip_var_mark_as_initialised(var); /* Arrays are implicitly initialised */
+    value->initialised = 1;
+
+    /* Allocate memory for the initial contents if the variable needs it */
+    if ((var->base.flags & IP_SYMBOL_NO_RESET) == 0) {
+        return;
+    }
     if (var->base.type == IP_TYPE_ARRAY_OF_INT) {
-        if (!(var->iarray)) {
-            var->iarray = malloc(size * sizeof(ip_int_t));
-        } else if (size != prev_size) {
-            var->iarray = realloc(var->iarray, size * sizeof(ip_int_t));
-        }
-        if (!(var->iarray)) {
+        value->iarray = calloc(size, sizeof(ip_int_t));
+        if (!(value->iarray)) {
             ip_out_of_memory();
         }
-        memset(var->iarray, 0, size * sizeof(ip_int_t));
     } else if (var->base.type == IP_TYPE_ARRAY_OF_FLOAT) {
-        if (!(var->farray)) {
-            var->farray = malloc(size * sizeof(ip_float_t));
-        } else if (size != prev_size) {
-            var->farray = realloc(var->farray, size * sizeof(ip_float_t));
-        }
-        if (!(var->farray)) {
+        value->farray = calloc(size, sizeof(ip_float_t));
+        if (!(value->farray)) {
             ip_out_of_memory();
         }
-        memset(var->farray, 0, size * sizeof(ip_float_t));
     } else {
-        if (var->sarray) {
-            ip_var_free_string_array(var->sarray, size);
-            if (size != prev_size) {
-                var->sarray = realloc(var->sarray, size * sizeof(ip_string_t));
-            }
-        } else {
-            var->sarray = malloc(size * sizeof(ip_string_t *));
-        }
-        if (!(var->sarray)) {
+        value->sarray = malloc(size * sizeof(ip_string_t *));
+        if (!(value->sarray)) {
             ip_out_of_memory();
         }
-        ip_var_init_string_array(var->sarray, size);
+        ip_var_init_string_array(value->sarray, size);
     }
 }
 
@@ -250,3 +289,60 @@ int ip_var_is_array(const ip_var_t *var)
            var->base.type == IP_TYPE_ARRAY_OF_FLOAT ||
            var->base.type == IP_TYPE_ARRAY_OF_STRING;
 }
+
+/**
+ * @brief Visitor that sets a variable's value to its starting value.
+ *
+ * @param[in] symbol The variable's symbol.
+ * @param[in] user_data Points to the variable state.
+ */
+static void ip_var_state_start_visitor(ip_symbol_t *symbol, void *user_data)
+{
+    ip_var_t *var = (ip_var_t *)symbol;
+    ip_var_state_t *state = (ip_var_state_t *)user_data;
+    ip_var_start_value(var, ip_var_state_get(state, var));
+}
+
+/**
+ * @brief Visitor that frees a variable's value.
+ *
+ * @param[in] symbol The variable's symbol.
+ * @param[in] user_data Points to the variable state.
+ */
+static void ip_var_state_free_visitor(ip_symbol_t *symbol, void *user_data)
+{
+    ip_var_t *var = (ip_var_t *)symbol;
+    ip_var_state_t *state = (ip_var_state_t *)user_data;
+    ip_var_free_value(var, ip_var_state_get(state, var));
+}
+
+void ip_var_state_init(ip_var_state_t *state, const ip_var_table_t *vars)
+{
+    state->vars = vars;
+    state->values = calloc
+        (vars->num_vars ? vars->num_vars : 1, sizeof(ip_var_value_t));
+    if (!(state->values)) {
+        ip_out_of_memory();
+    }
+    ip_symbol_table_visit
+        (&(vars->symbols), ip_var_state_start_visitor, state);
+}
+
+void ip_var_state_free(ip_var_state_t *state)
+{
+    if (state->values) {
+        ip_symbol_table_visit
+            (&(state->vars->symbols), ip_var_state_free_visitor, state);
+        free(state->values);
+    }
+    state->vars = 0;
+    state->values = 0;
+}
+
+void ip_var_state_reset(ip_var_state_t *state)
+{
+    ip_symbol_table_visit
+        (&(state->vars->symbols), ip_var_state_free_visitor, state);
+    ip_symbol_table_visit
+        (&(state->vars->symbols), ip_var_state_start_visitor, state);
+}
@@ -31,18 +31,16 @@ extern "C" {
 #endif
 
 /**
- * @brief Information about a variable that is stored in the variable table.
+ * @brief Value of a variable.
+ *
+ * The values of variables are stored in an execution context rather
+ * than in the program so that several execution contexts can run the
+ * same parsed program at the same time.
  */
 typedef struct
 {
-    /** Base class information */
-    ip_symbol_t base;
-
-    /** Minimum array subscript if the type is an array */
-    ip_int_t min_subscript;
-
-    /** Maximum array subscript if the type is an array */
-    ip_int_t max_subscript;
+    /** Non-zero if the variable has been initialised */
+    int initialised;
 
     union {
         /** Integer value of the variable, if type is IP_TYPE_INT */
@@ -64,6 +62,31 @@ typedef struct
         ip_string_t **sarray;
     };
 
+} ip_var_value_t;
+
+/**
+ * @brief Information about a variable that is stored in the variable table.
+ */
+typedef struct
+{
+    /** Base class information */
+    ip_symbol_t base;
+
+    /** Minimum array subscript if the type is an array */
+    ip_int_t min_subscript;
+
+    /** Maximum array subscript if the type is an array */
+    ip_int_t max_subscript;
+
+    /** Index of the variable's value within an ip_var_state_t */
+    size_t index;
+
+    /**
+     * Initial value of the variable if it is marked IP_SYMBOL_NO_RESET.
+     * All other variables start off with a zero or empty value.
+     */
+    ip_var_value_t initial;
+
 } ip_var_t;
 
 /**
@@ -73,8 +96,23 @@ typedef struct
 {
     ip_symbol_table_t symbols;  /**< Embedded symbol table */
 
+    size_t num_vars;            /**< Number of variables in the table */
+
 } ip_var_table_t;
 
+/**
+ * @brief Values of all variables in a program for an execution context.
+ */
+typedef struct
+{
+    /** The variable table that the values are for */
+    const ip_var_table_t *vars;
+
+    /** Array of values, indexed by the "index" field in ip_var_t */
+    ip_var_value_t *values;
+
+} ip_var_state_t;
+
 /**
  * @brief Initialises a variable table.
  *
@@ -89,14 +127,6 @@ void ip_var_table_init(ip_var_table_t *vars);
  */
 void ip_var_table_free(ip_var_table_t *vars);
 
-/**
- * @brief Resets all variables in a variable table to their default values
- * and mark them as uninitialised.
- *
- * @param[in,out] vars The variable table to reset.
- */
-void ip_var_table_reset(ip_var_table_t *vars);
-
 /**
  * @brief Looks up a variable in a variable table.
  *
@@ -132,10 +162,52 @@ ip_var_t *ip_var_create
  *
  * If the variable already exists as an array, then this will redimension
  * the array and clear the contents to zero.
+ *
+ * Storage for the initial contents of the array is only allocated if
+ * the variable is already marked IP_SYMBOL_NO_RESET.  Other arrays are
+ * allocated separately for each execution context.
  */
 void ip_var_dimension_array
     (ip_var_t *var, ip_int_t min_subscript, ip_int_t max_subscript);
 
+/**
+ * @brief Initialises the values of the variables for an execution context.
+ *
+ * @param[out] state The variable state to initialise.
+ * @param[in] vars The variable table for the program, which must not
+ * have any more variables added while @a state is in use.
+ *
+ * Variables that are marked IP_SYMBOL_NO_RESET are set to their initial
+ * values.  All other variables are set to zero or empty and are marked
+ * as uninitialised, except for arrays which are implicitly initialised.
+ */
+void ip_var_state_init(ip_var_state_t *state, const ip_var_table_t *vars);
+
+/**
+ * @brief Frees the values of the variables for an execution context.
+ *
+ * @param[in] state The variable state to free.
+ */
+void ip_var_state_free(ip_var_state_t *state);
+
+/**
+ * @brief Resets the values of the variables for an execution context
+ * back to their starting values.
+ *
+ * @param[in,out] state The variable state to reset.
+ */
+void ip_var_state_reset(ip_var_state_t *state);
+
+/**
+ * @brief Gets the value of a variable from a variable state.
+ *
+ * @param[in] state The variable state.
+ * @param[in] var The variable.
+ *
+ * @return A pointer to the variable's value.
+ */
+#define ip_var_state_get(state, var) (&((state)->values[(var)->index]))
+
 /**
  * @brief Determine if a variable is an array.
  *
@@ -164,17 +236,18 @@ int ip_var_is_array(const ip_var_t *var);
 #define ip_var_get_type(var) ((var)->base.type)
 
 /**
- * @brief Determine if a variable has been initialised.
+ * @brief Determine if a variable has an initial value.
  *
  * @param[in] var The variable.
  *
- * @return Non-zero if the variable is initialised, zero if not.
+ * @return Non-zero if the variable's initial value is initialised,
+ * zero if not.
  */
 #define ip_var_is_initialised(var) \
     (((var)->base.flags & IP_SYMBOL_DEFINED) != 0)
 
 /**
- * @brief Marks a variable as initialised.
+ * @brief Marks a variable's initial value as initialised.
  *
  * @param[in] var The variable.
  */
@@ -182,7 +255,7 @@ int ip_var_is_array(const ip_var_t *var);
     ((var)->base.flags |= IP_SYMBOL_DEFINED)
 
 /**
- * @brief Marks a variable as uninitialised.
+ * @brief Marks a variable's initial value as uninitialised.
  *
  * @param[in] var The variable.
  */
@@ -0,0 +1,268 @@
+/*
+ * Copyright (C) 2025 Rhys Weatherley
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "ip_wordtrie.h"
+#include <stdlib.h>
+#include <string.h>
+
+/** Initial number of hash buckets in a word trie */
+#define IP_WORD_TRIE_INITIAL_BUCKETS 64
+
+void ip_word_trie_init(ip_word_trie_t *trie)
+{
+    memset(trie, 0, sizeof(ip_word_trie_t));
+}
+
+void ip_word_trie_free(ip_word_trie_t *trie)
+{
+    ip_word_trie_node_t *node;
+    ip_word_trie_node_t *next;
+    size_t index;
+    for (index = 0; index < trie->num_buckets; ++index) {
+        node = trie->buckets[index];
+        while (node != 0) {
+            next = node->next;
+            free(node->name);
+            free(node);
+            node = next;
+        }
+    }
+    free(trie->buckets);
+    memset(trie, 0, sizeof(ip_word_trie_t));
+}
+
+/**
+ * @brief Determine if a character is non-EOL whitespace.
+ *
+ * @param[in] ch The character to test.
+ *
+ * @return Non-zero if @a ch is whitespace; zero if not.
+ */
+static int ip_word_trie_is_space(int ch)
+{
+    return ch == ' ' || ch == '\t' || ch == '\v' || ch == '\f';
+}
+
+/**
+ * @brief Converts a character to upper case.
+ *
+ * @param[in] ch The character to convert.
+ *
+ * @return The upper case version of @a ch.
+ */
+static int ip_word_trie_to_upper(int ch)
+{
+    if (ch >= 'a' && ch <= 'z') {
+        return ch - 'a' + 'A';
+    }
+    return ch;
+}
+
+/**
+ * @brief Hashes a word and the parent node that it hangs off.
+ *
+ * @param[in] parent The parent node, or NULL for the root.
+ * @param[in] word Points to the word, in any case.
+ * @param[in] len Length of the word.
+ *
+ * @return The hash value.
+ */
+static unsigned long ip_word_trie_hash
+    (const ip_word_trie_node_t *parent, const char *word, size_t len)
+{
+    /* FNV-1a over the parent pointer and the upper case word */
+    unsigned long hash = 2166136261UL ^ (unsigned long)(size_t)parent;
+    while (len > 0) {
+        hash ^= (unsigned long)ip_word_trie_to_upper(*word++);
+        hash *= 16777619UL;
+        --len;
+    }
+    return hash;
+}
+
+/**
+ * @brief Finds the child of a node for a word.
+ *
+ * @param[in] trie The word trie.
+ * @param[in] parent The parent node, or NULL for the root.
+ * @param[in] word Points to the word, in any case.
+ * @param[in] len Length of the word.
+ *
+ * @return The child node, or NULL if there is no child for @a word.
+ */
+static ip_word_trie_node_t *ip_word_trie_find_child
+    (const ip_word_trie_t *trie, const ip_word_trie_node_t *parent,
+     const char *word, size_t len)
+{
+    unsigned long hash;
+    ip_word_trie_node_t *node;
+    size_t posn;
+    if (!(trie->num_buckets)) {
+        return 0;
+    }
+    hash = ip_word_trie_hash(parent, word, len);
+    node = trie->buckets[hash & (trie->num_buckets - 1)];
+    while (node != 0) {
+        if (node->hash == hash && node->parent == parent) {
+            for (posn = 0; posn < len; ++posn) {
+                if (node->word[posn] != ip_word_trie_to_upper(word[posn])) {
+                    break;
+                }
+            }
+            if (posn == len && node->word[len] == '\0') {
+                return node;
+            }
+        }
+        node = node->next;
+    }
+    return 0;
+}
+
+/**
+ * @brief Doubles the number of hash buckets in a word trie.
+ *
+ * @param[in,out] trie The word trie.
+ */
+static void ip_word_trie_grow(ip_word_trie_t *trie)
+{
+    size_t num_buckets = trie->num_buckets * 2;
+    ip_word_trie_node_t **buckets;
+    ip_word_trie_node_t *node;
+    ip_word_trie_node_t *next;
+    size_t index;
+    if (!num_buckets) {
+        num_buckets = IP_WORD_TRIE_INITIAL_BUCKETS;
+    }
+    buckets = calloc(num_buckets, sizeof(ip_word_trie_node_t *));
+    if (!buckets) {
+        ip_out_of_memory();
+    }
+    for (index = 0; index < trie->num_buckets; ++index) {
+        node = trie->buckets[index];
+        while (node != 0) {
+            next = node->next;
+            node->next = buckets[node->hash & (num_buckets - 1)];
+            buckets[node->hash & (num_buckets - 1)] = node;
+            node = next;
+        }
+    }
+    free(trie->buckets);
+    trie->buckets = buckets;
+    trie->num_buckets = num_buckets;
+}
+
+void ip_word_trie_insert(ip_word_trie_t *trie, const char *name)
+{
+    const ip_word_trie_node_t *parent = 0;
+    ip_word_trie_node_t *node = 0;
+    const char *word = name;
+    size_t len;
+    unsigned long hash;
+    for (;;) {
+        /* Find the extent of the next word */
+        len = 0;
+        while (word[len] != '\0' && word[len] != ' ') {
+            ++len;
+        }
+
+        /* Find or create the child node for this word */
+        node = ip_word_trie_find_child(trie, parent, word, len);
+        if (!node) {
+            if (trie->num_nodes >= trie->num_buckets) {
+                ip_word_trie_grow(trie);
+            }
+            node = calloc(1, sizeof(ip_word_trie_node_t) + len + 1);
+            if (!node) {
+                ip_out_of_memory();
+            }
+            hash = ip_word_trie_hash(parent, word, len);
+            node->parent = parent;
+            node->hash = hash;
+            memcpy(node->word, word, len);
+            node->next = trie->buckets[hash & (trie->num_buckets - 1)];
+            trie->buckets[hash & (trie->num_buckets - 1)] = node;
+            ++(trie->num_nodes);
+        }
+        parent = node;
+
+        /* Move on to the next word */
+        if (word[len] == '\0') {
+            break;
+        }
+        word += len + 1;
+    }
+    if (!(node->name)) {
+        node->name = strdup(name);
+        if (!(node->name)) {
+            ip_out_of_memory();
+        }
+    }
+}
+
+const char *ip_word_trie_lookup
+    (const ip_word_trie_t *trie, const char *name, size_t len)
+{
+    const char *result;
+    size_t match_len;
+    result = ip_word_trie_lookup_longest(trie, name, len, &match_len);
+    if (result && match_len == len) {
+        return result;
+    }
+    return 0;
+}
+
+const char *ip_word_trie_lookup_longest
+    (const ip_word_trie_t *trie, const char *name, size_t len,
+     size_t *match_len)
+{
+    const ip_word_trie_node_t *node = 0;
+    const char *result = 0;
+    size_t posn = 0;
+    size_t start;
+    *match_len = 0;
+    if (!trie || !(trie->num_nodes)) {
+        return 0;
+    }
+    while (posn < len && !ip_word_trie_is_space(name[posn])) {
+        /* Find the extent of the next word */
+        start = posn;
+        while (posn < len && !ip_word_trie_is_space(name[posn])) {
+            ++posn;
+        }
+
+        /* Follow the edge for the word */
+        node = ip_word_trie_find_child(trie, node, name + start, posn - start);
+        if (!node) {
+            break;
+        }
+        if (node->name) {
+            result = node->name;
+            *match_len = posn;
+        }
+
+        /* Skip the whitespace before the next word */
+        while (posn < len && ip_word_trie_is_space(name[posn])) {
+            ++posn;
+        }
+    }
+    return result;
+}
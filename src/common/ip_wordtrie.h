@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2025 Rhys Weatherley
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef INTERPROGRAM_WORDTRIE_H
+#define INTERPROGRAM_WORDTRIE_H
+
+#include "ip_types.h"
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Node in a word trie.
+ */
+typedef struct ip_word_trie_node_s ip_word_trie_node_t;
+struct ip_word_trie_node_s
+{
+    /** Next node in the same hash bucket */
+    ip_word_trie_node_t *next;
+
+    /** Parent of this node, or NULL if the parent is the root */
+    const ip_word_trie_node_t *parent;
+
+    /** Hash of the parent and the word */
+    unsigned long hash;
+
+    /** Full normalised name if a name ends at this node, or NULL */
+    char *name;
+
+    /** Word on the edge leading to this node, in upper case */
+    char word[];
+};
+
+/**
+ * @brief Trie of multi-word names, with one edge per word.
+ *
+ * Children are found through a hash table that is keyed on the parent
+ * node and the word, so the cost of a lookup depends only upon the length
+ * of the name being looked up and not upon the number of names.
+ */
+typedef struct
+{
+    /** Hash buckets for the nodes in the trie */
+    ip_word_trie_node_t **buckets;
+
+    /** Number of hash buckets; always a power of two */
+    size_t num_buckets;
+
+    /** Number of nodes in the trie */
+    size_t num_nodes;
+
+} ip_word_trie_t;
+
+/**
+ * @brief Initialises a word trie.
+ *
+ * @param[out] trie The word trie to initialise.
+ */
+void ip_word_trie_init(ip_word_trie_t *trie);
+
+/**
+ * @brief Frees a word trie.
+ *
+ * @param[in,out] trie The word trie to free.
+ */
+void ip_word_trie_free(ip_word_trie_t *trie);
+
+/**
+ * @brief Inserts a name into a word trie.
+ *
+ * @param[in,out] trie The word trie.
+ * @param[in] name The name to insert, in upper case with a single
+ * space between words.  A copy is made of the name.
+ */
+void ip_word_trie_insert(ip_word_trie_t *trie, const char *name);
+
+/**
+ * @brief Looks up a name in a word trie.
+ *
+ * @param[in] trie The word trie, or NULL.
+ * @param[in] name Points to the name to look up.
+ * @param[in] len Length of the name to look up.
+ *
+ * @return The normalised version of the name, or NULL if the whole
+ * of @a name is not in the trie.
+ *
+ * The lookup is case-insensitive and words may be separated by any
+ * amount of non-EOL whitespace.
+ */
+const char *ip_word_trie_lookup
+    (const ip_word_trie_t *trie, const char *name, size_t len);
+
+/**
+ * @brief Finds the longest name in a word trie that is a prefix of a name.
+ *
+ * @param[in] trie The word trie, or NULL.
+ * @param[in] name Points to the name to look up.
+ * @param[in] len Length of the name to look up.
+ * @param[out] match_len Returns the number of characters of @a name
+ * that were matched, ending at a word boundary.
+ *
+ * @return The normalised version of the longest matching name, or NULL
+ * if no prefix of @a name is in the trie.
+ */
+const char *ip_word_trie_lookup_longest
+    (const ip_word_trie_t *trie, const char *name, size_t len,
+     size_t *match_len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -21,25 +21,35 @@
  */
 
 #include "ip_console.h"
+#include "ip_atomic.h"
 #include <curses.h>
 #include <term.h>
 #include <locale.h>
 #include <stdio.h>
 #include <stdlib.h>
 
-/** Non-zero once screen initialisation is done */
-static int init_screen_done = 0;
+/** Default text attributes for an execution context */
+#define DEFAULT_TEXT_ATTRIBUTES \
+    (A_NORMAL | COLOR_PAIR(COLOR_BLACK * 8 + COLOR_WHITE))
 
-/** Current text attributes */
-static int text_attributes =
-    A_NORMAL | COLOR_PAIR(COLOR_BLACK * 8 + COLOR_WHITE);
+/**
+ * @brief Execution context that currently owns the screen, or NULL.
+ *
+ * There is only one terminal per process, so only one execution context
+ * at a time can be in console mode.  All other console state is stored
+ * in the execution context.
+ */
+static ip_exec_t *screen_owner = 0;
+
+/** Non-zero once end_screen() has been registered with atexit() */
+static int end_screen_registered = 0;
 
 /**
  * @brief Ends screen operations when the program terminates.
  */
 static void end_screen(void)
 {
-    if (init_screen_done) {
+    if (ip_atomic_load(&screen_owner)) {
         endwin();
     }
 }
@@ -92,13 +102,13 @@ static void console_input_line(ip_exec_t *exec, char *buf, size_t size)
  */
 static void console_deactivate(ip_exec_t *exec)
 {
-    if (init_screen_done) {
+    if (ip_atomic_load(&screen_owner) == exec) {
         exec->output_string = 0;
         exec->output_char = 0;
         exec->input_line = 0;
         exec->deactivate_console = 0;
-        init_screen_done = 0;
         endwin();
+        ip_atomic_store(&screen_owner, (ip_exec_t *)0);
     }
 }
 
@@ -109,19 +119,31 @@ static void console_deactivate(ip_exec_t *exec)
  */
 static void init_screen(ip_exec_t *exec)
 {
+    ip_exec_t *owner = 0;
     int fg, bg;
-    if (!init_screen_done) {
+    if (!exec->console_attributes) {
+        exec->console_attributes = DEFAULT_TEXT_ATTRIBUTES;
+    }
+    if (ip_atomic_load(&screen_owner) != exec) {
+        if (exec->input != stdin ||
+                exec->output != stdout) {
+            fputs("Cannot initialise the screen; aborting.\n", stderr);
+            exit(3);
+        }
+        if (!ip_atomic_compare_exchange(&screen_owner, &owner, exec)) {
+            fputs("Screen is in use by another program; aborting.\n", stderr);
+            exit(3);
+        }
         exec->output_string = console_output_string;
         exec->output_char = console_output_char;
         exec->input_line = console_input_line;
         exec->deactivate_console = console_deactivate;
         fflush(exec->output);
-        if (exec->input != stdin ||
-                exec->output != stdout) {
-            fputs("Cannot initialise the screen; aborting.\n", stderr);
-            exit(3);
+        if (!end_screen_registered) {
+            /* Only the screen owner gets here, so this is race-free */
+            atexit(end_screen);
+            end_screen_registered = 1;
         }
-        atexit(end_screen);
         setlocale(LC_ALL, "");
         initscr();
         scrollok(stdscr, TRUE);
@@ -132,11 +154,10 @@ static void init_screen(ip_exec_t *exec)
                 init_pair(bg * 8 + fg, fg, bg);
             }
         }
-        attrset(text_attributes);
-        bkgd(' ' | text_attributes);
+        attrset(exec->console_attributes);
+        bkgd(' ' | exec->console_attributes);
         clear();
         refresh();
-        init_screen_done = 1;
     }
 }
 
@@ -155,7 +176,7 @@ static int ip_clear_screen
     (void)args;
     (void)num_args;
     init_screen(exec);
-    bkgd(' ' | text_attributes);
+    bkgd(' ' | exec->console_attributes);
     clear();
     refresh();
     return IP_EXEC_OK;
@@ -339,9 +360,9 @@ static int ip_normal_text
     (void)args;
     (void)num_args;
     init_screen(exec);
-    text_attributes &= ~A_BOLD;
-    text_attributes |= A_NORMAL;
-    attrset(text_attributes);
+    exec->console_attributes &= ~A_BOLD;
+    exec->console_attributes |= A_NORMAL;
+    attrset(exec->console_attributes);
     return IP_EXEC_OK;
 }
 
@@ -360,9 +381,9 @@ static int ip_bold_text
     (void)args;
     (void)num_args;
     init_screen(exec);
-    text_attributes &= ~A_NORMAL;
-    text_attributes |= A_BOLD;
-    attrset(text_attributes);
+    exec->console_attributes &= ~A_NORMAL;
+    exec->console_attributes |= A_BOLD;
+    attrset(exec->console_attributes);
     return IP_EXEC_OK;
 }
 
@@ -380,7 +401,7 @@ static int ip_text_color
 {
     int status;
     int fg, bg;
-    bg = (PAIR_NUMBER(text_attributes) >> 3) & 0x07;
+    bg = (PAIR_NUMBER(exec->console_attributes) >> 3) & 0x07;
     status = ip_value_to_int(&(args[0]));
     if (status == IP_EXEC_OK) {
         fg = args[0].ivalue & 0x07;
@@ -393,9 +414,9 @@ static int ip_text_color
     }
     if (status == IP_EXEC_OK) {
         init_screen(exec);
-        text_attributes &= ~A_COLOR;
-        text_attributes |= COLOR_PAIR(bg * 8 + fg);
-        attrset(text_attributes);
+        exec->console_attributes &= ~A_COLOR;
+        exec->console_attributes |= COLOR_PAIR(bg * 8 + fg);
+        attrset(exec->console_attributes);
     }
     return status;
 }
@@ -696,7 +717,7 @@ static void ip_create_color(ip_program_t *program, const char *name, int value)
 {
     ip_var_t *var = ip_var_create(&(program->vars), name, IP_TYPE_INT);
     if (var) {
-        var->ivalue = value;
+        var->initial.ivalue = value;
         var->base.flags |= IP_SYMBOL_DEFINED | IP_SYMBOL_NO_RESET;
     }
 }
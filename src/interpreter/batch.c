@@ -0,0 +1,579 @@
+/*
+ * Copyright (C) 2025 Rhys Weatherley
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "batch.h"
+#include "ip_exec.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+
+/**
+ * @brief Information about a job in a batch.
+ */
+typedef struct
+{
+    /** Path to the program for the job */
+    char *program;
+
+    /** Path to the input file for the job, or "-" */
+    char *input;
+
+    /** Path to the output file for the job, or "-" */
+    char *output;
+
+    /** Exit status for the job */
+    int status;
+
+    /** Elapsed wall-clock seconds for the job */
+    double wall;
+
+    /** CPU seconds for the job */
+    double cpu;
+
+} ip_batch_job_t;
+
+/**
+ * @brief Program that is shared between all jobs that use it.
+ */
+typedef struct ip_batch_program_s ip_batch_program_t;
+struct ip_batch_program_s
+{
+    /** Next program in the batch */
+    ip_batch_program_t *next;
+
+    /** Path to the program, which is owned by the job */
+    const char *path;
+
+    /** Lock that is held while the program is being parsed */
+    pthread_mutex_t lock;
+
+    /** Non-zero once the program has been parsed */
+    int parsed;
+
+    /** The parsed program, or NULL if the program failed to parse */
+    ip_program_t *program;
+};
+
+/* Forward declaration */
+typedef struct ip_batch_s ip_batch_t;
+
+/**
+ * @brief State for a worker thread in a batch.
+ */
+typedef struct
+{
+    /** Lock that protects the queue of jobs for this worker */
+    pthread_mutex_t lock;
+
+    /** Index of the first job in the queue, which is stolen first */
+    size_t head;
+
+    /** Index just past the last job in the queue, which is run first */
+    size_t tail;
+
+    /** Identifier for the worker thread */
+    pthread_t thread;
+
+    /** Index of this worker */
+    int index;
+
+    /** Points back to the batch that owns the worker */
+    ip_batch_t *batch;
+
+} ip_batch_worker_t;
+
+/**
+ * @brief State for running a batch of jobs.
+ */
+struct ip_batch_s
+{
+    /** Array of all jobs in the batch */
+    ip_batch_job_t *jobs;
+
+    /** Number of jobs in the batch */
+    size_t num_jobs;
+
+    /** Array of worker threads */
+    ip_batch_worker_t *workers;
+
+    /** Number of worker threads */
+    int num_workers;
+
+    /** Lock that protects the list of programs */
+    pthread_mutex_t lock;
+
+    /** List of all programs that the jobs have asked for so far */
+    ip_batch_program_t *programs;
+
+    /** Flags for syntax options; e.g. ITOK_TYPE_EXTENSION */
+    unsigned options;
+
+    /** Random number seed; each job uses the stream for its position */
+    ip_uint_t seed;
+
+    /** Callback function to register the built-in library */
+    ip_parse_register_builtins_t register_builtins;
+
+    /** Optimisation settings for the programs, or NULL to not optimise */
+    const ip_optimiser_t *optimiser;
+};
+
+/**
+ * @brief Gets the number of seconds between two times.
+ *
+ * @param[in] start The start time.
+ * @param[in] end The end time.
+ *
+ * @return The number of seconds between @a start and @a end.
+ */
+static double ip_batch_seconds
+    (const struct timespec *start, const struct timespec *end)
+{
+    return (double)(end->tv_sec - start->tv_sec) +
+           ((double)(end->tv_nsec - start->tv_nsec)) / 1000000000.0;
+}
+
+/**
+ * @brief Extracts the next whitespace-separated word from a manifest line
+ * and resolves it relative to the manifest's directory.
+ *
+ * @param[in,out] line Points to the current position in the line.
+ * @param[in] dir Directory containing the manifest, including the
+ * trailing '/', or the empty string for the current directory.
+ *
+ * @return The path, or NULL if there are no more words on the line.
+ */
+static char *ip_batch_next_path(char **line, const char *dir)
+{
+    char *word = *line;
+    char *path;
+    size_t len;
+    while (*word == ' ' || *word == '\t' || *word == '\r' || *word == '\n') {
+        ++word;
+    }
+    if (*word == '\0') {
+        *line = word;
+        return 0;
+    }
+    *line = word;
+    while (**line != '\0' && **line != ' ' && **line != '\t' &&
+           **line != '\r' && **line != '\n') {
+        ++(*line);
+    }
+    if (**line != '\0') {
+        **line = '\0';
+        ++(*line);
+    }
+    if (word[0] == '/' || !strcmp(word, "-")) {
+        dir = "";
+    }
+    len = strlen(dir);
+    path = malloc(len + strlen(word) + 1);
+    if (!path) {
+        ip_out_of_memory();
+    }
+    strcpy(path, dir);
+    strcpy(path + len, word);
+    return path;
+}
+
+/**
+ * @brief Reads the jobs from a manifest file.
+ *
+ * @param[in,out] batch The batch to add the jobs to.
+ * @param[in] manifest Name of the manifest file.
+ *
+ * @return Non-zero if the manifest was read, or zero on error.
+ */
+static int ip_batch_read_manifest(ip_batch_t *batch, const char *manifest)
+{
+    FILE *file;
+    char *dir;
+    const char *slash;
+    char *line = 0;
+    size_t line_size = 0;
+    size_t max_jobs = 0;
+    ip_batch_job_t *job;
+    char *posn;
+
+    /* Open the manifest and find the directory that it is in */
+    file = fopen(manifest, "r");
+    if (!file) {
+        perror(manifest);
+        return 0;
+    }
+    slash = strrchr(manifest, '/');
+    dir = strdup(manifest);
+    if (!dir) {
+        ip_out_of_memory();
+    }
+    dir[slash ? (size_t)(slash - manifest + 1) : 0] = '\0';
+
+    /* Read the jobs */
+    while (getline(&line, &line_size, file) >= 0) {
+        /* Skip blank lines and comments */
+        posn = line;
+        while (*posn == ' ' || *posn == '\t') {
+            ++posn;
+        }
+        if (*posn == '#') {
+            continue;
+        }
+
+        /* Add a new job to the batch */
+        if (batch->num_jobs >= max_jobs) {
+            max_jobs = max_jobs ? max_jobs * 2 : 64;
+            batch->jobs = realloc
+                (batch->jobs, max_jobs * sizeof(ip_batch_job_t));
+            if (!(batch->jobs)) {
+                ip_out_of_memory();
+            }
+        }
+        job = &(batch->jobs[batch->num_jobs]);
+        memset(job, 0, sizeof(ip_batch_job_t));
+        job->program = ip_batch_next_path(&posn, dir);
+        if (!(job->program)) {
+            continue;
+        }
+        job->input = ip_batch_next_path(&posn, dir);
+        if (job->input) {
+            job->output = ip_batch_next_path(&posn, dir);
+        }
+        if (!(job->input)) {
+            job->input = strdup("-");
+        }
+        if (!(job->output)) {
+            job->output = strdup("-");
+        }
+        if (!(job->input) || !(job->output)) {
+            ip_out_of_memory();
+        }
+        ++(batch->num_jobs);
+    }
+
+    /* Clean up */
+    free(line);
+    free(dir);
+    fclose(file);
+    return 1;
+}
+
+/**
+ * @brief Gets the parsed version of a program, parsing it if this is
+ * the first time that any worker has asked for it.
+ *
+ * @param[in,out] batch The batch.
+ * @param[in] path The path to the program.
+ *
+ * @return The parsed program, or NULL if the program failed to parse.
+ *
+ * Different programs can be parsed by different workers at the same
+ * time.  If two workers ask for the same program, then the second
+ * waits for the first to finish parsing it.
+ */
+static const ip_program_t *ip_batch_get_program
+    (ip_batch_t *batch, const char *path)
+{
+    ip_batch_program_t *prog;
+    ip_optimiser_t optimiser;
+    char *argv[1];
+
+    /* Find the program or add a new entry for it */
+    pthread_mutex_lock(&(batch->lock));
+    for (prog = batch->programs; prog != 0; prog = prog->next) {
+        if (!strcmp(prog->path, path)) {
+            break;
+        }
+    }
+    if (!prog) {
+        prog = calloc(1, sizeof(ip_batch_program_t));
+        if (!prog) {
+            ip_out_of_memory();
+        }
+        prog->path = path;
+        pthread_mutex_init(&(prog->lock), 0);
+        prog->next = batch->programs;
+        batch->programs = prog;
+    }
+    pthread_mutex_unlock(&(batch->lock));
+
+    /* Parse the program if nobody has done so yet */
+    pthread_mutex_lock(&(prog->lock));
+    if (!(prog->parsed)) {
+        prog->program = ip_program_new(path);
+        argv[0] = (char *)path;
+        if (ip_parse_program_file
+                (prog->program, path, batch->options, 1, argv,
+                 batch->register_builtins) != 0) {
+            ip_program_free(prog->program);
+            prog->program = 0;
+        } else if (batch->optimiser) {
+            /* Each program gets its own copy of the optimiser settings
+             * so that the statistics are not shared between threads */
+            optimiser = *(batch->optimiser);
+            optimiser.dump = 0;
+            ip_optimise_program(&optimiser, prog->program);
+        }
+        prog->parsed = 1;
+    }
+    pthread_mutex_unlock(&(prog->lock));
+    return prog->program;
+}
+
+/**
+ * @brief Runs a single job on a worker thread.
+ *
+ * @param[in,out] worker The worker thread.
+ * @param[in,out] job The job to run.
+ */
+static void ip_batch_run_job(ip_batch_worker_t *worker, ip_batch_job_t *job)
+{
+    struct timespec start, end;
+    struct timespec cpu_start, cpu_end;
+    const ip_program_t *program;
+    ip_exec_t exec;
+    FILE *input = 0;
+    FILE *output = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_start);
+
+    /* Get the parsed program and open the input and output files */
+    program = ip_batch_get_program(worker->batch, job->program);
+    if (!program) {
+        job->status = 1;
+        goto done;
+    }
+    input = fopen
+        (strcmp(job->input, "-") != 0 ? job->input : "/dev/null", "r");
+    if (!input) {
+        perror(job->input);
+        job->status = 255;
+        goto done;
+    }
+    output = fopen
+        (strcmp(job->output, "-") != 0 ? job->output : "/dev/null", "w");
+    if (!output) {
+        perror(job->output);
+        job->status = 255;
+        goto done;
+    }
+
+    /* Run the program */
+    ip_exec_init(&exec, program);
+    ip_random_seed_stream
+        (&(exec.random), worker->batch->seed,
+         (unsigned long)(job - worker->batch->jobs));
+    exec.input = input;
+    exec.output = output;
+    job->status = ip_exec_run(&exec);
+    ip_exec_free(&exec);
+
+done:
+    if (input) {
+        fclose(input);
+    }
+    if (output && fclose(output) != 0) {
+        perror(job->output);
+        job->status = 255;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_end);
+    job->wall = ip_batch_seconds(&start, &end);
+    job->cpu = ip_batch_seconds(&cpu_start, &cpu_end);
+}
+
+/**
+ * @brief Takes the next job from the end of a worker's own queue.
+ *
+ * @param[in,out] worker The worker thread.
+ *
+ * @return The job, or NULL if the worker's queue is empty.
+ */
+static ip_batch_job_t *ip_batch_pop(ip_batch_worker_t *worker)
+{
+    ip_batch_job_t *job = 0;
+    pthread_mutex_lock(&(worker->lock));
+    if (worker->head < worker->tail) {
+        job = &(worker->batch->jobs[--(worker->tail)]);
+    }
+    pthread_mutex_unlock(&(worker->lock));
+    return job;
+}
+
+/**
+ * @brief Steals a job from the front of another worker's queue.
+ *
+ * @param[in,out] worker The worker thread that wants a job.
+ *
+ * @return The job, or NULL if all of the other queues are empty.
+ */
+static ip_batch_job_t *ip_batch_steal(ip_batch_worker_t *worker)
+{
+    ip_batch_t *batch = worker->batch;
+    ip_batch_worker_t *victim;
+    ip_batch_job_t *job = 0;
+    int offset;
+    for (offset = 1; offset < batch->num_workers && !job; ++offset) {
+        victim = &(batch->workers
+                    [(worker->index + offset) % batch->num_workers]);
+        pthread_mutex_lock(&(victim->lock));
+        if (victim->head < victim->tail) {
+            job = &(batch->jobs[(victim->head)++]);
+        }
+        pthread_mutex_unlock(&(victim->lock));
+    }
+    return job;
+}
+
+/**
+ * @brief Main function for a worker thread.
+ *
+ * @param[in] arg Points to the worker's state.
+ *
+ * @return Always NULL.
+ */
+static void *ip_batch_worker_main(void *arg)
+{
+    ip_batch_worker_t *worker = (ip_batch_worker_t *)arg;
+    ip_batch_job_t *job;
+
+    /* Run jobs from our own queue, then steal from others.  Jobs are
+     * never added once the batch starts, so when every queue is empty
+     * there is nothing left to do. */
+    while ((job = ip_batch_pop(worker)) != 0 ||
+           (job = ip_batch_steal(worker)) != 0) {
+        ip_batch_run_job(worker, job);
+    }
+    return 0;
+}
+
+int ip_batch_run
+    (const char *manifest, int num_threads, unsigned options,
+     ip_parse_register_builtins_t register_builtins,
+     const ip_optimiser_t *optimiser, const ip_uint_t *seed)
+{
+    ip_batch_t batch;
+    ip_batch_worker_t *worker;
+    ip_batch_program_t *prog;
+    ip_batch_job_t *job;
+    struct timespec start, end;
+    unsigned long num_failed = 0;
+    double elapsed, cpu = 0;
+    size_t index;
+    int exitval = 0;
+    int started;
+
+    /* Read the manifest */
+    memset(&batch, 0, sizeof(batch));
+    batch.options = options;
+    batch.register_builtins = register_builtins;
+    batch.optimiser = optimiser;
+    if (seed) {
+        batch.seed = *seed;
+    } else {
+        batch.seed = ((ip_uint_t)time(0)) ^ (ip_uint_t)getpid();
+    }
+    if (!ip_batch_read_manifest(&batch, manifest)) {
+        return 1;
+    }
+    pthread_mutex_init(&(batch.lock), 0);
+
+    /* Divide the jobs up between the workers in contiguous runs, so that
+     * each worker tends to run jobs for the same programs. */
+    if ((size_t)num_threads > batch.num_jobs) {
+        num_threads = batch.num_jobs > 0 ? (int)(batch.num_jobs) : 1;
+    }
+    batch.num_workers = num_threads;
+    batch.workers = calloc((size_t)num_threads, sizeof(ip_batch_worker_t));
+    if (!(batch.workers)) {
+        ip_out_of_memory();
+    }
+    for (started = 0; started < num_threads; ++started) {
+        worker = &(batch.workers[started]);
+        pthread_mutex_init(&(worker->lock), 0);
+        worker->head = batch.num_jobs * (size_t)started / (size_t)num_threads;
+        worker->tail =
+            batch.num_jobs * (size_t)(started + 1) / (size_t)num_threads;
+        worker->index = started;
+        worker->batch = &batch;
+    }
+
+    /* Start the workers and wait for them to finish.  If a thread cannot
+     * be started, the other workers will steal its jobs. */
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (started = 0; started < num_threads; ++started) {
+        worker = &(batch.workers[started]);
+        if (pthread_create(&(worker->thread), 0,
+                           ip_batch_worker_main, worker) != 0) {
+            break;
+        }
+    }
+    for (index = 0; index < (size_t)started; ++index) {
+        pthread_join(batch.workers[index].thread, 0);
+    }
+    if (started == 0) {
+        /* No threads at all, so run everything on this thread */
+        ip_batch_worker_main(&(batch.workers[0]));
+        started = 1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    elapsed = ip_batch_seconds(&start, &end);
+
+    /* Free the parsed programs */
+    while ((prog = batch.programs) != 0) {
+        batch.programs = prog->next;
+        ip_program_free(prog->program);
+        pthread_mutex_destroy(&(prog->lock));
+        free(prog);
+    }
+    pthread_mutex_destroy(&(batch.lock));
+
+    /* Report on the jobs and clean up */
+    for (index = 0; index < batch.num_jobs; ++index) {
+        job = &(batch.jobs[index]);
+        printf("%lu\t%d\t%.6f\t%.6f\t%s\t%s\t%s\n", (unsigned long)(index + 1),
+               job->status, job->wall, job->cpu, job->program,
+               job->input, job->output);
+        if (job->status != 0) {
+            ++num_failed;
+            exitval = 1;
+        }
+        cpu += job->cpu;
+        free(job->program);
+        free(job->input);
+        free(job->output);
+    }
+    printf("# %lu jobs, %lu failed, %d threads, %.6f seconds, "
+           "%.1f jobs/s, %.6f CPU seconds\n",
+           (unsigned long)(batch.num_jobs), num_failed, started,
+           elapsed, elapsed > 0 ? batch.num_jobs / elapsed : 0.0, cpu);
+    for (index = 0; index < (size_t)num_threads; ++index) {
+        pthread_mutex_destroy(&(batch.workers[index].lock));
+    }
+    free(batch.workers);
+    free(batch.jobs);
+    return exitval;
+}
@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2025 Rhys Weatherley
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef INTERPROGRAM_BATCH_H
+#define INTERPROGRAM_BATCH_H
+
+#include "ip_parser.h"
+#include "ip_optimise.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Runs the jobs in a batch manifest on a pool of threads.
+ *
+ * @param[in] manifest Name of the manifest file.
+ * @param[in] num_threads Number of worker threads, which must be at least 1.
+ * @param[in] options Flags for syntax options; e.g. ITOK_TYPE_EXTENSION.
+ * @param[in] register_builtins Callback function to register the
+ * built-in library when parsing programs.
+ * @param[in] optimiser Optimisation settings to apply to each program
+ * after it is parsed, or NULL to run the programs as parsed.
+ * @param[in] seed Points to the seed for the random number generator,
+ * or NULL to seed the whole batch once from the system time.  Each job
+ * uses the random number stream for its position in the manifest, so that
+ * jobs get independent sequences that do not depend upon the thread
+ * scheduling.
+ *
+ * @return Zero if all jobs exited with a status of zero, or 1 otherwise.
+ *
+ * The manifest contains one job per line, consisting of a program path,
+ * an input file path, and an output file path separated by whitespace.
+ * The input and output paths can be omitted or "-" for an empty input
+ * or discarded output.  Relative paths are relative to the directory
+ * that contains the manifest.  Blank lines and lines starting with '#'
+ * are ignored.
+ *
+ * The jobs are spread across the worker threads, and a thread that runs
+ * out of jobs steals them from the other threads.  Each program is parsed
+ * once, the first time that a job needs it, and the parsed program is
+ * then shared by all jobs on all threads that use the same program.
+ *
+ * Once all jobs have finished, a report line is written to standard
+ * output for each job in manifest order, containing the job number,
+ * exit status, elapsed wall-clock seconds, CPU seconds, program path,
+ * input path, and output path, separated by tabs.  The exit status is
+ * 255 if the job's files could not be opened.  This is followed by a
+ * summary line starting with '#' that gives the overall throughput.
+ */
+int ip_batch_run
+    (const char *manifest, int num_threads, unsigned options,
+     ip_parse_register_builtins_t register_builtins,
+     const ip_optimiser_t *optimiser, const ip_uint_t *seed);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,308 @@
+/*
+ * Copyright (C) 2025 Rhys Weatherley
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "fork_server.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+/**
+ * @brief Information about a job that is running in a child process.
+ */
+typedef struct
+{
+    /** Process identifier for the child, or zero if the slot is free */
+    pid_t pid;
+
+    /** Job number, starting at 1 */
+    unsigned long job;
+
+    /** Time that the job started */
+    struct timespec start;
+
+    /** Path to the input file for the job */
+    char *input;
+
+    /** Path to the output file for the job */
+    char *output;
+
+} ip_fork_job_t;
+
+/**
+ * @brief Gets the number of seconds that have elapsed since a start time.
+ *
+ * @param[in] start The start time.
+ *
+ * @return The number of elapsed seconds.
+ */
+static double ip_fork_elapsed(const struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - start->tv_sec) +
+           ((double)(now.tv_nsec - start->tv_nsec)) / 1000000000.0;
+}
+
+/**
+ * @brief Writes a report line for a job that has finished.
+ *
+ * @param[in] job The job.
+ * @param[in] status The exit status for the job.
+ * @param[in] cpu The number of CPU seconds used by the job.
+ */
+static void ip_fork_report(const ip_fork_job_t *job, int status, double cpu)
+{
+    printf("%lu\t%d\t%.6f\t%.6f\t%s\t%s\n", job->job, status,
+           ip_fork_elapsed(&(job->start)), cpu, job->input, job->output);
+    fflush(stdout);
+}
+
+/**
+ * @brief Runs a job in the child process and exits.
+ *
+ * @param[in,out] exec The template execution context that was
+ * inherited from the server.
+ * @param[in] input_path The path to the input file.
+ * @param[in] output_path The path to the output file.
+ * @param[in] job The job number, starting at 1.
+ * @param[in] seed The random number seed for the server.
+ */
+static void ip_fork_child
+    (ip_exec_t *exec, const char *input_path, const char *output_path,
+     unsigned long job, ip_uint_t seed)
+{
+    FILE *input;
+    FILE *output;
+    int exitval;
+
+    /* Open the input and output files for the job */
+    input = fopen(strcmp(input_path, "-") != 0 ? input_path : "/dev/null", "r");
+    if (!input) {
+        perror(input_path);
+        _exit(255);
+    }
+    output = fopen
+        (strcmp(output_path, "-") != 0 ? output_path : "/dev/null", "w");
+    if (!output) {
+        perror(output_path);
+        _exit(255);
+    }
+
+    /* Every child inherits the same random number state from the
+     * template, so reseed to give each job a different sequence. */
+    ip_random_seed_stream(&(exec->random), seed, job - 1);
+
+    /* Run the program and exit with its status */
+    exec->input = input;
+    exec->output = output;
+    exitval = ip_exec_run(exec);
+    if (fclose(output) != 0) {
+        perror(output_path);
+        exitval = 255;
+    }
+    fflush(stderr);
+    _exit(exitval);
+}
+
+/**
+ * @brief Waits for a child process to finish and reports on the job.
+ *
+ * @param[in,out] jobs The array of running jobs.
+ * @param[in] max_children The size of the @a jobs array.
+ * @param[out] exitval Set to 1 if the job failed.
+ *
+ * @return Non-zero if a child was reaped, or zero if there are no children.
+ */
+static int ip_fork_reap(ip_fork_job_t *jobs, int max_children, int *exitval)
+{
+    struct rusage usage;
+    double cpu;
+    pid_t pid;
+    int status;
+    int index;
+    for (;;) {
+        pid = wait4(-1, &status, 0, &usage);
+        if (pid < 0) {
+            return 0;
+        }
+        for (index = 0; index < max_children; ++index) {
+            if (jobs[index].pid == pid) {
+                break;
+            }
+        }
+        if (index < max_children) {
+            break;
+        }
+    }
+    cpu = (double)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) +
+          ((double)(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec)) /
+          1000000.0;
+    if (WIFEXITED(status)) {
+        status = WEXITSTATUS(status);
+    } else if (WIFSIGNALED(status)) {
+        status = 128 + WTERMSIG(status);
+    } else {
+        status = 255;
+    }
+    ip_fork_report(&(jobs[index]), status, cpu);
+    if (status != 0) {
+        *exitval = 1;
+    }
+    free(jobs[index].input);
+    free(jobs[index].output);
+    memset(&(jobs[index]), 0, sizeof(ip_fork_job_t));
+    return 1;
+}
+
+/**
+ * @brief Extracts the next whitespace-separated word from a line.
+ *
+ * @param[in,out] line Points to the current position in the line.
+ *
+ * @return The word, or NULL if there are no more words on the line.
+ */
+static char *ip_fork_next_word(char **line)
+{
+    char *word = *line;
+    while (*word == ' ' || *word == '\t' || *word == '\r' || *word == '\n') {
+        ++word;
+    }
+    if (*word == '\0') {
+        *line = word;
+        return 0;
+    }
+    *line = word;
+    while (**line != '\0' && **line != ' ' && **line != '\t' &&
+           **line != '\r' && **line != '\n') {
+        ++(*line);
+    }
+    if (**line != '\0') {
+        **line = '\0';
+        ++(*line);
+    }
+    word = strdup(word);
+    if (!word) {
+        ip_out_of_memory();
+    }
+    return word;
+}
+
+int ip_fork_server_run
+    (ip_program_t *program, FILE *control, int max_children,
+     const ip_uint_t *seed)
+{
+    ip_exec_t exec;
+    ip_fork_job_t *jobs;
+    ip_uint_t stream_seed;
+    unsigned long job_number = 0;
+    int num_running = 0;
+    int exitval = 0;
+    char *line = 0;
+    size_t line_size = 0;
+    char *posn;
+    char *input;
+    char *output;
+    int index;
+
+    /* Set up the template execution context.  Every child inherits
+     * this and the parsed program without needing to do it again. */
+    ip_exec_init(&exec, program);
+    if (seed) {
+        stream_seed = *seed;
+    } else {
+        stream_seed = ((ip_uint_t)time(0)) ^ (ip_uint_t)getpid();
+    }
+    jobs = calloc((size_t)max_children, sizeof(ip_fork_job_t));
+    if (!jobs) {
+        ip_out_of_memory();
+    }
+
+    /* Read jobs from standard input until EOF */
+    while (getline(&line, &line_size, control) >= 0) {
+        /* Skip blank lines and comments */
+        posn = line;
+        input = ip_fork_next_word(&posn);
+        if (!input) {
+            continue;
+        } else if (input[0] == '#') {
+            free(input);
+            continue;
+        }
+        output = ip_fork_next_word(&posn);
+        if (!output) {
+            output = strdup("-");
+            if (!output) {
+                ip_out_of_memory();
+            }
+        }
+
+        /* Wait for a free slot if we have too many children already */
+        while (num_running >= max_children &&
+               ip_fork_reap(jobs, max_children, &exitval)) {
+            --num_running;
+        }
+        for (index = 0; index < max_children; ++index) {
+            if (!(jobs[index].pid)) {
+                break;
+            }
+        }
+
+        /* Fork a child to run the job */
+        jobs[index].job = ++job_number;
+        jobs[index].input = input;
+        jobs[index].output = output;
+        clock_gettime(CLOCK_MONOTONIC, &(jobs[index].start));
+        fflush(stdout);
+        fflush(stderr);
+        jobs[index].pid = fork();
+        if (jobs[index].pid == 0) {
+            ip_fork_child(&exec, input, output, job_number, stream_seed);
+        } else if (jobs[index].pid < 0) {
+            perror("fork");
+            ip_fork_report(&(jobs[index]), 255, 0);
+            exitval = 1;
+            free(input);
+            free(output);
+            memset(&(jobs[index]), 0, sizeof(ip_fork_job_t));
+        } else {
+            ++num_running;
+        }
+    }
+
+    /* Wait for the remaining children to finish */
+    while (num_running > 0 && ip_fork_reap(jobs, max_children, &exitval)) {
+        --num_running;
+    }
+
+    /* Clean up and exit */
+    free(line);
+    free(jobs);
+    ip_exec_free(&exec);
+    ip_program_free(program);
+    return exitval;
+}
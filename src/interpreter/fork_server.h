@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2025 Rhys Weatherley
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef INTERPROGRAM_FORK_SERVER_H
+#define INTERPROGRAM_FORK_SERVER_H
+
+#include "ip_exec.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Runs a parsed program as a fork server.
+ *
+ * @param[in] program The parsed program; ownership is taken by this
+ * function and the program will be freed on exit.
+ * @param[in] control The stream to read jobs from, which may be a
+ * regular file or a pipe.
+ * @param[in] max_children Maximum number of child processes to run at
+ * the same time, which must be at least 1.
+ * @param[in] seed Points to the seed for the random number generator,
+ * or NULL to seed the server once from the system time.  Each job uses
+ * the random number stream for its job number, so that jobs get
+ * independent sequences that are reproducible when a seed is supplied.
+ *
+ * @return Zero if all jobs exited with a status of zero, or 1 otherwise.
+ *
+ * The server reads jobs from @a control, one per line, each
+ * consisting of an input file path and an output file path separated
+ * by whitespace.  Either path can be "-" for an empty input or discarded
+ * output.  The program is executed in a forked child process for each
+ * job so that the parsed program is inherited copy-on-write.
+ *
+ * When each job finishes, a report line is written to standard output
+ * containing the job number, exit status, elapsed wall-clock seconds,
+ * CPU seconds, input path, and output path, separated by tabs.
+ * The exit status is 128 plus the signal number if the child was killed,
+ * or 255 if the child could not be started.
+ */
+int ip_fork_server_run
+    (ip_program_t *program, FILE *control, int max_children,
+     const ip_uint_t *seed);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -22,15 +22,25 @@
 
 #include "ip_parser.h"
 #include "ip_exec.h"
+#include "ip_image.h"
+#include "ip_module.h"
+#include "ip_optimise.h"
+#include "ip_profile.h"
+#include "ip_perf.h"
 #include "ip_math_lib.h"
 #include "ip_string_lib.h"
 #include "ip_console.h"
+#include "fork_server.h"
+#include "batch.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <inttypes.h>
 #include <getopt.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
-#define short_options "o:i:cepv"
+#define short_options "o:i:cepvCD:F::B:j:s:P::S::I:H::m:O:f:"
 static struct option long_options[] = {
     {"output",      required_argument,  0,  'o'},
     {"input",       required_argument,  0,  'i'},
@@ -38,12 +48,30 @@ static struct option long_options[] = {
     {"extended",    no_argument,        0,  'e'},
     {"parse-only",  no_argument,        0,  'p'},
     {"verify-chars",no_argument,        0,  'v'},
+    {"cache",       no_argument,        0,  'C'},
+    {"cache-dir",   required_argument,  0,  'D'},
+    {"cache-required", no_argument,     0,  'R'},
+    {"fork-server", optional_argument,  0,  'F'},
+    {"batch",       required_argument,  0,  'B'},
+    {"jobs",        required_argument,  0,  'j'},
+    {"seed",        required_argument,  0,  's'},
+    {"profile",     optional_argument,  0,  'P'},
+    {"profile-stacks", optional_argument, 0, 'S'},
+    {"profile-interval", required_argument, 0, 'I'},
+    {"perf-counters", optional_argument, 0, 'H'},
+    {"load-module", required_argument,  0,  'm'},
+    {"optimise",    required_argument,  0,  'O'},
+    {"pass",        required_argument,  0,  'f'},
+    {"list-passes", no_argument,        0,  'L'},
+    {"opt-stats",   optional_argument,  0,  'T'},
+    {"dump-ast",    optional_argument,  0,  'A'},
     {0,             0,                  0,  0},
 };
 
 static void usage(const char *progname)
 {
-    fprintf(stderr, "Usage: %s program [input]\n\n", progname);
+    fprintf(stderr, "Usage: %s program [input]\n", progname);
+    fprintf(stderr, "       %s --batch MANIFEST [--jobs N]\n\n", progname);
 
     fprintf(stderr, "--output FILE, -o FILE\n");
     fprintf(stderr, "    Set the output file (default is standard output).\n\n");
@@ -62,13 +90,171 @@ static void usage(const char *progname)
 
     fprintf(stderr, "--verify-chars, -v\n");
     fprintf(stderr, "    Verify that only Flexowriter-compatible characters are in use.\n\n");
+
+    fprintf(stderr, "--cache, -C\n");
+    fprintf(stderr, "    Cache the parsed program in an image file next to the source.\n\n");
+
+    fprintf(stderr, "--cache-dir DIR, -D DIR\n");
+    fprintf(stderr, "    Cache the parsed program in an image file within DIR.\n\n");
+
+    fprintf(stderr, "--cache-required\n");
+    fprintf(stderr, "    Fail if the program cannot be loaded from its cached image,\n");
+    fprintf(stderr, "    rather than parsing the source again.\n\n");
+
+    fprintf(stderr, "--fork-server[=N], -F[N]\n");
+    fprintf(stderr, "    Parse the program once and then run it in a forked child process\n");
+    fprintf(stderr, "    for each \"input output\" pair of paths read from the --input file\n");
+    fprintf(stderr, "    or standard input, with up to N children at once (default is 1).\n");
+    fprintf(stderr, "    A line is written to standard output for each job with its exit\n");
+    fprintf(stderr, "    status and timing.\n\n");
+
+    fprintf(stderr, "--batch MANIFEST, -B MANIFEST\n");
+    fprintf(stderr, "    Run the \"program input output\" jobs listed in MANIFEST on a pool\n");
+    fprintf(stderr, "    of threads and report the exit status and timing of each job.\n\n");
+
+    fprintf(stderr, "--jobs N, -j N\n");
+    fprintf(stderr, "    Number of threads to use with --batch (default is the number of CPUs).\n\n");
+
+    fprintf(stderr, "--seed N, -s N\n");
+    fprintf(stderr, "    Seed the random number generator with N instead of the system time.\n");
+    fprintf(stderr, "    With --fork-server or --batch, each job gets its own stream of\n");
+    fprintf(stderr, "    random numbers derived from N and the job number.\n\n");
+
+    fprintf(stderr, "--profile[=FILE], -P[FILE]\n");
+    fprintf(stderr, "    Profile the program and write an annotated listing with the\n");
+    fprintf(stderr, "    execution count and cycles for each line to FILE when the\n");
+    fprintf(stderr, "    program exits (default is standard error).\n\n");
+
+    fprintf(stderr, "--profile-stacks[=FILE], -S[FILE]\n");
+    fprintf(stderr, "    Sample the chain of active routine calls and write the samples to\n");
+    fprintf(stderr, "    FILE in folded stack format for flame graph tools when the\n");
+    fprintf(stderr, "    program exits (default is standard error).\n\n");
+
+    fprintf(stderr, "--profile-interval N, -I N\n");
+    fprintf(stderr, "    Number of statements between call stack samples (default is 1).\n\n");
+
+    fprintf(stderr, "--perf-counters[=FILE], -H[FILE]\n");
+    fprintf(stderr, "    Attribute hardware performance counters to each kind of statement\n");
+    fprintf(stderr, "    and expression, and write a table to FILE when the program exits\n");
+    fprintf(stderr, "    (default is standard error).  Requires a build with the\n");
+    fprintf(stderr, "    INTERPROGRAM_PERF_COUNTERS option.\n\n");
+
+    fprintf(stderr, "--load-module PATH, -m PATH\n");
+    fprintf(stderr, "    Load extra built-ins from the native extension module in the\n");
+    fprintf(stderr, "    shared object PATH.  May be given more than once.  Programs are\n");
+    fprintf(stderr, "    not cached in images when modules are loaded.\n\n");
+
+    fprintf(stderr, "--optimise LEVEL, -O LEVEL\n");
+    fprintf(stderr, "    Set the optimisation level from 0 to %d (default is 0, which runs\n", IP_OPT_MAX_LEVEL);
+    fprintf(stderr, "    the program exactly as it was parsed).\n\n");
+
+    fprintf(stderr, "--pass [no-]NAME, -f [no-]NAME\n");
+    fprintf(stderr, "    Enable or disable the optimisation pass NAME regardless of the\n");
+    fprintf(stderr, "    optimisation level.  May be given more than once.\n\n");
+
+    fprintf(stderr, "--list-passes\n");
+    fprintf(stderr, "    List the optimisation passes and the levels that enable them.\n\n");
+
+    fprintf(stderr, "--opt-stats[=FILE]\n");
+    fprintf(stderr, "    Write statistics for each optimisation pass to FILE\n");
+    fprintf(stderr, "    (default is standard error).\n\n");
+
+    fprintf(stderr, "--dump-ast[=FILE]\n");
+    fprintf(stderr, "    Dump the program's syntax tree to FILE before optimisation and\n");
+    fprintf(stderr, "    after each optimisation pass (default is standard error).\n\n");
+}
+
+/* Native extension modules that were loaded with "--load-module" */
+static const ip_module_t **modules = 0;
+static size_t num_modules = 0;
+
+static void register_program_builtins(ip_program_t *program, unsigned options)
+{
+    size_t index;
+    ip_register_math_builtins(program, options);
+    ip_register_string_builtins(program, options);
+    ip_register_console_builtins(program, options);
+
+    /* Modules are registered last so that they can override built-ins */
+    for (index = 0; index < num_modules; ++index) {
+        ip_module_register(modules[index], program, options);
+    }
+}
+
+/* Load a native extension module and remember it so that its built-ins
+ * are registered with every program.  Returns zero on error. */
+static int load_module(const char *progname, const char *path)
+{
+    const ip_module_t *module;
+    const char *error;
+    module = ip_module_load(path, &error);
+    if (!module) {
+        fprintf(stderr, "%s: %s\n", progname, error);
+        return 0;
+    }
+    modules = realloc(modules, (num_modules + 1) * sizeof(ip_module_t *));
+    if (!modules) {
+        ip_out_of_memory();
+    }
+    modules[num_modules++] = module;
+    return 1;
 }
 
 static void register_builtins(ip_parser_t *parser, unsigned options)
 {
-    ip_register_math_builtins(parser->program, options);
-    ip_register_string_builtins(parser->program, options);
-    ip_register_console_builtins(parser->program, options);
+    register_program_builtins(parser->program, options);
+}
+
+/* Enable or disable an optimisation pass from a "--pass" option.
+ * Returns zero if the pass name is unknown. */
+static int set_pass(ip_optimiser_t *optimiser, const char *progname,
+                    const char *arg)
+{
+    int enable = 1;
+    if (!strncmp(arg, "no-", 3)) {
+        enable = 0;
+        arg += 3;
+    }
+    if (!ip_optimiser_set_pass(optimiser, arg, enable)) {
+        fprintf(stderr, "%s: unknown optimisation pass '%s'\n",
+                progname, arg);
+        return 0;
+    }
+    return 1;
+}
+
+/* Get the name of the image file to use to cache a parsed program.
+ * If there is a cache directory, then the image is named after the
+ * cache key.  Otherwise the image is placed next to the source file
+ * with the extension ".ipc". */
+static char *image_filename(const char *filename, const char *cache_dir,
+                            ip_uint_t key)
+{
+    size_t len;
+    char *name;
+    if (cache_dir) {
+        mkdir(cache_dir, 0777);
+        len = strlen(cache_dir) + 22;
+        name = malloc(len);
+        if (name) {
+            snprintf(name, len, "%s/%016" PRIx64 ".ipc", cache_dir, key);
+        }
+    } else {
+        len = strlen(filename);
+        name = malloc(len + 5);
+        if (name) {
+            strcpy(name, filename);
+            if (len >= 3 && !strcmp(name + len - 3, ".ip")) {
+                strcpy(name + len, "c");
+            } else {
+                strcpy(name + len, ".ipc");
+            }
+        }
+    }
+    if (!name) {
+        ip_out_of_memory();
+    }
+    return name;
 }
 
 /* Verify that a file only contains characters compatible with the
@@ -101,23 +287,72 @@ static int verify_characters(const char *filename)
     return exitval;
 }
 
+/* Open a file to write a profile report to, or use standard error
+ * if there is no file name or the file cannot be opened. */
+static FILE *open_report(const char *filename)
+{
+    FILE *file;
+    if (!filename) {
+        return stderr;
+    }
+    file = fopen(filename, "w");
+    if (!file) {
+        perror(filename);
+        return stderr;
+    }
+    return file;
+}
+
+/* Close a file that was opened by open_report() */
+static void close_report(FILE *file)
+{
+    if (file != stderr) {
+        fclose(file);
+    }
+}
+
 int main(int argc, char **argv)
 {
     const char *progname = argv[0];
     unsigned options = 0;
     int parse_only = 0;
     int verify_chars = 0;
+    int use_cache = 0;
+    int cache_required = 0;
+    int fork_server = 0;
+    const char *batch_manifest = 0;
+    int num_jobs = 0;
+    ip_uint_t seed = 0;
+    int have_seed = 0;
+    int profile = 0;
+    const char *profile_filename = 0;
+    int profile_stacks = 0;
+    const char *stacks_filename = 0;
+    unsigned long profile_interval = 1;
+    int perf_counters = 0;
+    const char *perf_filename = 0;
+    ip_optimiser_t optimiser;
+    int opt_stats = 0;
+    const char *opt_stats_filename = 0;
+    int dump_ast = 0;
+    const char *dump_ast_filename = 0;
+    FILE *opt_output;
+    const char *cache_dir = 0;
+    char *image_name = 0;
+    ip_uint_t key = 0;
     const char *program_filename = 0;
     const char *input_filename = 0;
     const char *output_filename = 0;
     ip_program_t *program = 0;
     ip_exec_t exec;
+    FILE *profile_output;
     int opt, index;
     int exitval = 0;
     FILE *input = stdin;
     FILE *output = stdout;
 
     /* Parse the command-line options */
+    ip_optimiser_init(&optimiser, 0);
     while ((opt = getopt_long
                     (argc, argv, short_options, long_options, &index)) >= 0) {
         switch (opt) {
@@ -147,12 +382,120 @@ int main(int argc, char **argv)
             verify_chars = 1;
             break;
 
+        case 'C':
+            use_cache = 1;
+            break;
+
+        case 'D':
+            cache_dir = optarg;
+            break;
+
+        case 'R':
+            use_cache = 1;
+            cache_required = 1;
+            break;
+
+        case 'F':
+            fork_server = optarg ? atoi(optarg) : 1;
+            if (fork_server < 1) {
+                usage(progname);
+                return 1;
+            }
+            break;
+
+        case 'B':
+            batch_manifest = optarg;
+            break;
+
+        case 'j':
+            num_jobs = atoi(optarg);
+            if (num_jobs < 1) {
+                usage(progname);
+                return 1;
+            }
+            break;
+
+        case 's':
+            seed = (ip_uint_t)strtoull(optarg, 0, 0);
+            have_seed = 1;
+            break;
+
+        case 'P':
+            profile = 1;
+            profile_filename = optarg;
+            break;
+
+        case 'S':
+            profile_stacks = 1;
+            stacks_filename = optarg;
+            break;
+
+        case 'I':
+            profile_interval = strtoul(optarg, 0, 0);
+            if (profile_interval < 1) {
+                usage(progname);
+                return 1;
+            }
+            break;
+
+        case 'H':
+            perf_counters = 1;
+            perf_filename = optarg;
+            break;
+
+        case 'm':
+            if (!load_module(progname, optarg)) {
+                return 1;
+            }
+            break;
+
+        case 'O':
+            optimiser.level = atoi(optarg);
+            if (optimiser.level < 0 || optimiser.level > IP_OPT_MAX_LEVEL) {
+                usage(progname);
+                return 1;
+            }
+            break;
+
+        case 'f':
+            if (!set_pass(&optimiser, progname, optarg)) {
+                return 1;
+            }
+            break;
+
+        case 'L':
+            ip_optimiser_list_passes(stdout);
+            return 0;
+
+        case 'T':
+            opt_stats = 1;
+            opt_stats_filename = optarg;
+            break;
+
+        case 'A':
+            dump_ast = 1;
+            dump_ast_filename = optarg;
+            break;
+
         default:
             usage(progname);
             return 1;
         }
     }
 
+    /* Run a batch of jobs from a manifest if requested */
+    if (batch_manifest) {
+        if (num_jobs < 1) {
+            num_jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+            if (num_jobs < 1) {
+                num_jobs = 1;
+            }
+        }
+        return ip_batch_run
+            (batch_manifest, num_jobs, options, register_builtins,
+             &optimiser, have_seed ? &seed : 0);
+    }
+
     /* Need at least one option for the program source file */
     if (optind >= argc) {
         usage(progname);
@@ -165,16 +508,66 @@ int main(int argc, char **argv)
         return verify_characters(program_filename);
     }
 
-    /* Create the program object and register built-in statements */
-    program = ip_program_new(program_filename);
+    /* Try to load a previously parsed image of the program.  Images do
+     * not record which modules the built-ins came from, so don't use
+     * the cache when there are modules. */
+    if ((use_cache || cache_dir) && num_modules == 0 &&
+            ip_image_compute_key(program_filename, options, &key)) {
+        image_name = image_filename(program_filename, cache_dir, key);
+        program = ip_program_new(program_filename);
+        if (!ip_image_load
+                (program, image_name, key, argc - optind, argv + optind,
+                 register_program_builtins)) {
+            /* Image is missing or stale, so we need to parse the source */
+            ip_program_free(program);
+            program = 0;
+        }
+    }
 
-    /* Load the program into memory */
-    if (ip_parse_program_file
-            (program, program_filename, options,
-             argc - optind, argv + optind, register_builtins) != 0) {
-        ip_program_free(program);
+    /* Parse the program if we don't have it yet */
+    if (!program && cache_required) {
+        fprintf(stderr, "%s: could not load the cached image\n",
+                program_filename);
+        free(image_name);
         return 1;
     }
+    if (!program) {
+        /* Create the program object and register built-in statements */
+        program = ip_program_new(program_filename);
+
+        /* Load the program into memory */
+        if (ip_parse_program_file
+                (program, program_filename, options,
+                 argc - optind, argv + optind, register_builtins) != 0) {
+            ip_program_free(program);
+            free(image_name);
+            return 1;
+        }
+
+        /* Save the parsed image for next time.  It isn't an error
+         * if we cannot write the image; we just won't get the speedup. */
+        if (image_name) {
+            ip_image_save(program, image_name, key);
+        }
+    }
+    free(image_name);
+
+    /* Optimise the program.  This is done after loading from the image
+     * cache rather than before saving so that images are the same at
+     * every optimisation level. */
+    if (dump_ast) {
+        optimiser.dump = open_report(dump_ast_filename);
+    }
+    ip_optimise_program(&optimiser, program);
+    if (dump_ast) {
+        close_report(optimiser.dump);
+        optimiser.dump = 0;
+    }
+    if (opt_stats) {
+        opt_output = open_report(opt_stats_filename);
+        ip_optimiser_report(&optimiser, opt_output);
+        close_report(opt_output);
+    }
 
     /* If we just want to parse, then we are done */
     if (parse_only) {
@@ -182,6 +575,25 @@ int main(int argc, char **argv)
         return 0;
     }
 
+    /* Hand the program off to the fork server if requested.
+     * The input file is used as the source of jobs in this mode. */
+    if (fork_server) {
+        if (input_filename) {
+            input = fopen(input_filename, "r");
+            if (!input) {
+                perror(input_filename);
+                ip_program_free(program);
+                return 1;
+            }
+        }
+        exitval = ip_fork_server_run
+            (program, input, fork_server, have_seed ? &seed : 0);
+        if (input_filename) {
+            fclose(input);
+        }
+        return exitval;
+    }
+
     /* Open the input and output sources */
     if (input_filename) {
         input = fopen(input_filename, "r");
@@ -205,10 +617,50 @@ int main(int argc, char **argv)
 
     /* Run the program */
     ip_exec_init(&exec, program);
+    if (have_seed) {
+        ip_exec_seed_random(&exec, seed);
+    }
     exec.input = input;
     exec.output = output;
+    if (profile || profile_stacks) {
+        exec.profile = ip_profile_new(program);
+        if (profile_stacks) {
+            ip_profile_enable_stacks(exec.profile, profile_interval);
+        }
+    }
+    if (perf_counters) {
+#if defined(IP_PERF_COUNTERS)
+        exec.perf = ip_perf_new(stderr);
+#else
+        fprintf(stderr, "%s: built without INTERPROGRAM_PERF_COUNTERS, "
+                        "ignoring --perf-counters\n", progname);
+#endif
+    }
     exitval = ip_exec_run(&exec);
+    if (exec.perf) {
+        fflush(output);
+        profile_output = open_report(perf_filename);
+        ip_perf_report(exec.perf, profile_output);
+        close_report(profile_output);
+        ip_perf_free(exec.perf);
+    }
+    if (exec.profile) {
+        /* Write the profile reports, after the program's own output */
+        fflush(output);
+        if (profile) {
+            profile_output = open_report(profile_filename);
+            ip_profile_report(exec.profile, profile_output, IP_PROFILE_TOP_N);
+            close_report(profile_output);
+        }
+        if (profile_stacks) {
+            profile_output = open_report(stacks_filename);
+            ip_profile_report_stacks(exec.profile, profile_output);
+            close_report(profile_output);
+        }
+        ip_profile_free(exec.profile);
+    }
     ip_exec_free(&exec);
+    ip_program_free(program);
 
     /* Clean up and exit */
     if (input_filename) {
@@ -0,0 +1,421 @@
+/*
+ * Copyright (C) 2025 Rhys Weatherley
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/* Needed for fopencookie() */
+#define _GNU_SOURCE
+
+#include "interprogram.h"
+#include "ip_exec.h"
+#include "ip_parser.h"
+#include "ip_math_lib.h"
+#include "ip_string_lib.h"
+#include "ip_console.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <sys/types.h>
+
+/**
+ * @brief Parsed program for the library API.
+ */
+struct ip_lib_program_s
+{
+    /** The parsed program */
+    ip_program_t *program;
+};
+
+/**
+ * @brief Running instance of a program for the library API.
+ */
+struct ip_lib_instance_s
+{
+    /** Execution context for the program */
+    ip_exec_t exec;
+
+    /** Input data from ip_lib_instance_set_input() */
+    char *input_data;
+
+    /** Length of the input data */
+    size_t input_len;
+
+    /** Position of the next byte to read from the input data */
+    size_t input_posn;
+
+    /** Callback for reading input, or NULL to use the input data */
+    ip_lib_read_t read;
+
+    /** User data for the input callback */
+    void *read_data;
+
+    /** Callback for writing output, or NULL to collect the output */
+    ip_lib_write_t write;
+
+    /** User data for the output callback */
+    void *write_data;
+
+    /** Callback for writing errors, or NULL for standard error */
+    ip_lib_write_t write_errors;
+
+    /** User data for the errors callback */
+    void *write_errors_data;
+
+    /** Collected output if there is no output callback */
+    char *output_data;
+
+    /** Length of the collected output */
+    size_t output_len;
+
+    /** Non-zero once the streams for the instance have been opened */
+    int streams_open;
+
+    /** IP_LIB_RUNNING, or the exit status once the program finishes */
+    int status;
+};
+
+/**
+ * @brief Writer for passing data on a stream to a write callback.
+ */
+typedef struct
+{
+    /** The callback */
+    ip_lib_write_t write;
+
+    /** User data for the callback */
+    void *user_data;
+
+} ip_lib_writer_t;
+
+/**
+ * @brief Reads from the input of an instance for a cookie stream.
+ *
+ * @param[in] cookie The instance.
+ * @param[out] buf Buffer to read into.
+ * @param[in] size Size of the buffer.
+ *
+ * @return The number of bytes read, or zero at end of input.
+ */
+static ssize_t ip_lib_read_input(void *cookie, char *buf, size_t size)
+{
+    ip_lib_instance_t *instance = (ip_lib_instance_t *)cookie;
+    size_t left;
+    if (instance->read) {
+        return (ssize_t)((*(instance->read))(instance->read_data, buf, size));
+    }
+    left = instance->input_len - instance->input_posn;
+    if (size > left) {
+        size = left;
+    }
+    if (size > 0) {
+        memcpy(buf, instance->input_data + instance->input_posn, size);
+        instance->input_posn += size;
+    }
+    return (ssize_t)size;
+}
+
+/**
+ * @brief Writes to a callback for a cookie stream.
+ *
+ * @param[in] cookie The ip_lib_writer_t to write with.
+ * @param[in] buf The data to write.
+ * @param[in] size Number of bytes to write.
+ *
+ * @return The number of bytes written.
+ */
+static ssize_t ip_lib_write(void *cookie, const char *buf, size_t size)
+{
+    ip_lib_writer_t *writer = (ip_lib_writer_t *)cookie;
+    (*(writer->write))(writer->user_data, buf, size);
+    return (ssize_t)size;
+}
+
+/**
+ * @brief Closes a cookie stream for a write callback.
+ *
+ * @param[in] cookie The ip_lib_writer_t to free.
+ *
+ * @return Always zero.
+ */
+static int ip_lib_close_writer(void *cookie)
+{
+    free(cookie);
+    return 0;
+}
+
+/**
+ * @brief Opens a stream that passes everything written to it to a callback.
+ *
+ * @param[in] write The callback.
+ * @param[in] user_data User data for the callback.
+ *
+ * @return The stream.
+ */
+static FILE *ip_lib_open_writer(ip_lib_write_t write, void *user_data)
+{
+    cookie_io_functions_t funcs;
+    ip_lib_writer_t *writer;
+    FILE *stream;
+    writer = malloc(sizeof(ip_lib_writer_t));
+    if (!writer) {
+        ip_out_of_memory();
+    }
+    writer->write = write;
+    writer->user_data = user_data;
+    memset(&funcs, 0, sizeof(funcs));
+    funcs.write = ip_lib_write;
+    funcs.close = ip_lib_close_writer;
+    stream = fopencookie(writer, "w", funcs);
+    if (!stream) {
+        ip_out_of_memory();
+    }
+    return stream;
+}
+
+/**
+ * @brief Registers the built-in library for a program.
+ *
+ * @param[in,out] parser The parser.
+ * @param[in] options Options for the built-ins to register.
+ */
+static void ip_lib_register_builtins(ip_parser_t *parser, unsigned options)
+{
+    ip_register_math_builtins(parser->program, options);
+    ip_register_string_builtins(parser->program, options);
+    ip_register_console_builtins(parser->program, options);
+}
+
+const char *ip_lib_version(void)
+{
+    return INTERPROGRAM_VERSION;
+}
+
+ip_lib_program_t *ip_lib_program_parse
+    (const char *name, const char *source, size_t len, unsigned options,
+     int argc, char **argv, ip_lib_write_t errors, void *user_data)
+{
+    ip_lib_program_t *program;
+    unsigned parse_options = 0;
+    unsigned long num_errors;
+
+    /* Map the public options onto the parser's options */
+    if ((options & IP_LIB_CLASSIC) != 0) {
+        parse_options |= ITOK_TYPE_CLASSIC;
+    } else if ((options & IP_LIB_EXTENDED) != 0) {
+        parse_options |= ITOK_TYPE_EXTENSION;
+    }
+
+    /* Parse the program, reporting errors to the callback if necessary */
+    program = calloc(1, sizeof(ip_lib_program_t));
+    if (!program) {
+        ip_out_of_memory();
+    }
+    program->program = ip_program_new(name ? name : "program");
+    if (errors) {
+        program->program->errors = ip_lib_open_writer(errors, user_data);
+    }
+    num_errors = ip_parse_program_buffer
+        (program->program, source, len, parse_options, argc, argv,
+         ip_lib_register_builtins);
+    if (errors) {
+        fclose(program->program->errors);
+        program->program->errors = stderr;
+    }
+    if (num_errors != 0) {
+        ip_lib_program_free(program);
+        return 0;
+    }
+    return program;
+}
+
+void ip_lib_program_free(ip_lib_program_t *program)
+{
+    if (program) {
+        ip_program_free(program->program);
+        free(program);
+    }
+}
+
+ip_lib_instance_t *ip_lib_instance_new(const ip_lib_program_t *program)
+{
+    ip_lib_instance_t *instance = calloc(1, sizeof(ip_lib_instance_t));
+    if (!instance) {
+        ip_out_of_memory();
+    }
+    ip_exec_init(&(instance->exec), program->program);
+    instance->status = IP_LIB_RUNNING;
+    return instance;
+}
+
+/**
+ * @brief Closes the streams for an instance.
+ *
+ * @param[in,out] instance The instance.
+ */
+static void ip_lib_instance_close_streams(ip_lib_instance_t *instance)
+{
+    if (instance->streams_open) {
+        fclose(instance->exec.input);
+        fclose(instance->exec.output);
+        if (instance->exec.errors != stderr) {
+            fclose(instance->exec.errors);
+        }
+        instance->exec.input = stdin;
+        instance->exec.output = stdout;
+        instance->exec.errors = stderr;
+        instance->streams_open = 0;
+    }
+    free(instance->output_data);
+    instance->output_data = 0;
+    instance->output_len = 0;
+}
+
+/**
+ * @brief Opens the streams for an instance if they are not open already.
+ *
+ * @param[in,out] instance The instance.
+ */
+static void ip_lib_instance_open_streams(ip_lib_instance_t *instance)
+{
+    cookie_io_functions_t funcs;
+    if (instance->streams_open) {
+        return;
+    }
+    memset(&funcs, 0, sizeof(funcs));
+    funcs.read = ip_lib_read_input;
+    instance->exec.input = fopencookie(instance, "r", funcs);
+    if (instance->write) {
+        instance->exec.output =
+            ip_lib_open_writer(instance->write, instance->write_data);
+    } else {
+        instance->exec.output = open_memstream
+            (&(instance->output_data), &(instance->output_len));
+    }
+    if (instance->write_errors) {
+        instance->exec.errors = ip_lib_open_writer
+            (instance->write_errors, instance->write_errors_data);
+    }
+    if (!(instance->exec.input) || !(instance->exec.output)) {
+        ip_out_of_memory();
+    }
+    instance->streams_open = 1;
+}
+
+void ip_lib_instance_free(ip_lib_instance_t *instance)
+{
+    if (instance) {
+        ip_lib_instance_close_streams(instance);
+        ip_exec_free(&(instance->exec));
+        free(instance->input_data);
+        free(instance);
+    }
+}
+
+void ip_lib_instance_set_input
+    (ip_lib_instance_t *instance, const char *data, size_t len)
+{
+    free(instance->input_data);
+    instance->input_data = malloc(len ? len : 1);
+    if (!(instance->input_data)) {
+        ip_out_of_memory();
+    }
+    memcpy(instance->input_data, data, len);
+    instance->input_len = len;
+    instance->input_posn = 0;
+    instance->read = 0;
+    instance->read_data = 0;
+}
+
+void ip_lib_instance_set_input_callback
+    (ip_lib_instance_t *instance, ip_lib_read_t read, void *user_data)
+{
+    instance->read = read;
+    instance->read_data = user_data;
+}
+
+void ip_lib_instance_set_output_callback
+    (ip_lib_instance_t *instance, ip_lib_write_t write, void *user_data)
+{
+    instance->write = write;
+    instance->write_data = user_data;
+}
+
+void ip_lib_instance_set_error_callback
+    (ip_lib_instance_t *instance, ip_lib_write_t write, void *user_data)
+{
+    instance->write_errors = write;
+    instance->write_errors_data = user_data;
+}
+
+const char *ip_lib_instance_get_output
+    (ip_lib_instance_t *instance, size_t *len)
+{
+    if (instance->write) {
+        *len = 0;
+        return 0;
+    }
+    if (instance->streams_open) {
+        fflush(instance->exec.output);
+    }
+    *len = instance->output_len;
+    return instance->output_data ? instance->output_data : "";
+}
+
+void ip_lib_instance_seed_random
+    (ip_lib_instance_t *instance, uint64_t seed, unsigned long stream)
+{
+    ip_random_seed_stream(&(instance->exec.random), seed, stream);
+}
+
+int ip_lib_instance_run_steps
+    (ip_lib_instance_t *instance, unsigned long max_steps)
+{
+    int status;
+    if (instance->status != IP_LIB_RUNNING) {
+        return instance->status;
+    }
+    ip_lib_instance_open_streams(instance);
+    status = ip_exec_run_steps(&(instance->exec), max_steps);
+    if (status != IP_EXEC_OK) {
+        instance->status = ip_exec_finish(&(instance->exec), status);
+    }
+    fflush(instance->exec.output);
+    fflush(instance->exec.errors);
+    return instance->status;
+}
+
+int ip_lib_instance_run(ip_lib_instance_t *instance)
+{
+    int status;
+    while ((status = ip_lib_instance_run_steps(instance, ULONG_MAX))
+                == IP_LIB_RUNNING) {
+        /* Keep going until the program finishes */
+    }
+    return status;
+}
+
+void ip_lib_instance_reset(ip_lib_instance_t *instance)
+{
+    ip_lib_instance_close_streams(instance);
+    ip_exec_reset(&(instance->exec));
+    instance->input_posn = 0;
+    instance->status = IP_LIB_RUNNING;
+}
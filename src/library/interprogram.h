@@ -0,0 +1,283 @@
+/*
+ * Copyright (C) 2025 Rhys Weatherley
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef INTERPROGRAM_H
+#define INTERPROGRAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Public API for embedding the INTERPROGRAM interpreter in another
+ * application.  Only the types and functions in this file are part of
+ * the stable interface of libinterprogram; the internal structures of
+ * the interpreter may change from one release to the next.
+ *
+ * A parsed program is immutable and may be shared between any number
+ * of instances, including instances on different threads.  Each
+ * instance has its own variables, input, output, and random number
+ * generator.  An instance must only be used by one thread at a time.
+ */
+
+/**
+ * @brief Marks a function as part of the public API of the library.
+ *
+ * The library is built with hidden symbol visibility, so functions
+ * without this marking are not exported.
+ */
+#if defined(__GNUC__) && __GNUC__ >= 4
+#define IP_LIB_EXPORT __attribute__((visibility("default")))
+#else
+#define IP_LIB_EXPORT
+#endif
+
+/**
+ * @brief Major version of the library API.
+ *
+ * This is incremented whenever an incompatible change is made.
+ */
+#define IP_LIB_API_VERSION 1
+
+/**
+ * @brief Parse option to force the classic INTERPROGRAM syntax.
+ */
+#define IP_LIB_CLASSIC          0x0001
+
+/**
+ * @brief Parse option to force the extended INTERPROGRAM syntax.
+ */
+#define IP_LIB_EXTENDED         0x0002
+
+/**
+ * @brief Status returned by ip_lib_instance_run_steps() when the
+ * program is still running.
+ */
+#define IP_LIB_RUNNING          (-1)
+
+/**
+ * @brief Opaque type for a parsed program.
+ */
+typedef struct ip_lib_program_s ip_lib_program_t;
+
+/**
+ * @brief Opaque type for a running instance of a program.
+ */
+typedef struct ip_lib_instance_s ip_lib_instance_t;
+
+/**
+ * @brief Callback that reads input data for a program.
+ *
+ * @param[in] user_data User data pointer for the callback.
+ * @param[out] buf Buffer to read the data into.
+ * @param[in] size Maximum number of bytes to read.
+ *
+ * @return The number of bytes that were read, or zero at end of input.
+ */
+typedef size_t (*ip_lib_read_t)(void *user_data, char *buf, size_t size);
+
+/**
+ * @brief Callback that writes output or error data from a program.
+ *
+ * @param[in] user_data User data pointer for the callback.
+ * @param[in] data Points to the data to write.
+ * @param[in] size Number of bytes to write.
+ */
+typedef void (*ip_lib_write_t)
+    (void *user_data, const char *data, size_t size);
+
+/**
+ * @brief Gets the version of the library.
+ *
+ * @return The version string; e.g. "0.1.0".
+ */
+IP_LIB_EXPORT const char *ip_lib_version(void);
+
+/**
+ * @brief Parses a program from a memory buffer.
+ *
+ * @param[in] name Name of the program to use in error messages.
+ * @param[in] source Points to the source code for the program.
+ * @param[in] len Length of the source code in bytes.
+ * @param[in] options Parse options; e.g. IP_LIB_EXTENDED, or zero to
+ * detect the syntax from the source code.
+ * @param[in] argc Number of arguments to pass to the program in "ARGV",
+ * or zero for no arguments.
+ * @param[in] argv The arguments to pass to the program.
+ * @param[in] errors Callback for reporting parse errors, or NULL to
+ * report them on standard error.
+ * @param[in] user_data User data pointer for @a errors.
+ *
+ * @return The parsed program, or NULL if there were parse errors.
+ */
+IP_LIB_EXPORT ip_lib_program_t *ip_lib_program_parse
+    (const char *name, const char *source, size_t len, unsigned options,
+     int argc, char **argv, ip_lib_write_t errors, void *user_data);
+
+/**
+ * @brief Frees a parsed program.
+ *
+ * @param[in] program The program to free, or NULL.
+ *
+ * All instances of the program must be freed first.
+ */
+IP_LIB_EXPORT void ip_lib_program_free(ip_lib_program_t *program);
+
+/**
+ * @brief Creates a new instance of a program.
+ *
+ * @param[in] program The parsed program.
+ *
+ * @return The new instance.
+ *
+ * The instance has no input and collects its output into an internal
+ * buffer until other arrangements are made with the functions below.
+ * Errors are reported on standard error by default.
+ */
+IP_LIB_EXPORT ip_lib_instance_t *ip_lib_instance_new
+    (const ip_lib_program_t *program);
+
+/**
+ * @brief Frees an instance of a program.
+ *
+ * @param[in] instance The instance to free, or NULL.
+ */
+IP_LIB_EXPORT void ip_lib_instance_free(ip_lib_instance_t *instance);
+
+/**
+ * @brief Supplies the input for an instance from a memory buffer.
+ *
+ * @param[in,out] instance The instance.
+ * @param[in] data Points to the input data.
+ * @param[in] len Length of the input data in bytes.
+ *
+ * The data is copied, so the caller does not need to keep it.
+ * This must be called before the instance starts running.
+ */
+IP_LIB_EXPORT void ip_lib_instance_set_input
+    (ip_lib_instance_t *instance, const char *data, size_t len);
+
+/**
+ * @brief Supplies the input for an instance from a callback.
+ *
+ * @param[in,out] instance The instance.
+ * @param[in] read Callback to read input data.
+ * @param[in] user_data User data pointer for @a read.
+ *
+ * This must be called before the instance starts running.
+ */
+IP_LIB_EXPORT void ip_lib_instance_set_input_callback
+    (ip_lib_instance_t *instance, ip_lib_read_t read, void *user_data);
+
+/**
+ * @brief Sends the output for an instance to a callback instead of
+ * collecting it in a buffer.
+ *
+ * @param[in,out] instance The instance.
+ * @param[in] write Callback to write output data.
+ * @param[in] user_data User data pointer for @a write.
+ *
+ * This must be called before the instance starts running.  Output is
+ * delivered to @a write in chunks, and is always flushed before
+ * ip_lib_instance_run_steps() or ip_lib_instance_run() returns.
+ */
+IP_LIB_EXPORT void ip_lib_instance_set_output_callback
+    (ip_lib_instance_t *instance, ip_lib_write_t write, void *user_data);
+
+/**
+ * @brief Sends runtime errors for an instance to a callback.
+ *
+ * @param[in,out] instance The instance.
+ * @param[in] write Callback to write error messages.
+ * @param[in] user_data User data pointer for @a write.
+ */
+IP_LIB_EXPORT void ip_lib_instance_set_error_callback
+    (ip_lib_instance_t *instance, ip_lib_write_t write, void *user_data);
+
+/**
+ * @brief Gets the output that has been collected for an instance.
+ *
+ * @param[in,out] instance The instance.
+ * @param[out] len Returns the length of the output in bytes.
+ *
+ * @return Pointer to the output, which is NUL-terminated.  The pointer
+ * is valid until the instance runs again or is freed.  Returns NULL if
+ * the output is being sent to a callback.
+ */
+IP_LIB_EXPORT const char *ip_lib_instance_get_output
+    (ip_lib_instance_t *instance, size_t *len);
+
+/**
+ * @brief Seeds the random number generator for an instance.
+ *
+ * @param[in,out] instance The instance.
+ * @param[in] seed The seed value.
+ * @param[in] stream Stream number to select, for giving instances
+ * that share a seed independent random number sequences.
+ */
+IP_LIB_EXPORT void ip_lib_instance_seed_random
+    (ip_lib_instance_t *instance, uint64_t seed, unsigned long stream);
+
+/**
+ * @brief Runs an instance for a limited number of steps.
+ *
+ * @param[in,out] instance The instance.
+ * @param[in] max_steps Maximum number of statements to execute.
+ *
+ * @return IP_LIB_RUNNING if the program is still running after
+ * @a max_steps statements, or the program's exit status between 0
+ * and 255 if it has finished.  The exit status is 2 if the program
+ * stopped with a runtime error.
+ *
+ * Once the program has finished, further calls return the exit status
+ * again without executing anything.
+ */
+IP_LIB_EXPORT int ip_lib_instance_run_steps
+    (ip_lib_instance_t *instance, unsigned long max_steps);
+
+/**
+ * @brief Runs an instance until the program finishes.
+ *
+ * @param[in,out] instance The instance.
+ *
+ * @return The program's exit status between 0 and 255.
+ */
+IP_LIB_EXPORT int ip_lib_instance_run(ip_lib_instance_t *instance);
+
+/**
+ * @brief Resets an instance so that the program can be run again.
+ *
+ * @param[in,out] instance The instance.
+ *
+ * The variables are reset and any collected output is discarded.
+ * Input from a memory buffer is rewound to the start.
+ */
+IP_LIB_EXPORT void ip_lib_instance_reset(ip_lib_instance_t *instance);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -22,7 +22,6 @@
 
 #include "ip_math_lib.h"
 #include <stdlib.h>
-#include <time.h>
 #include <math.h>
 
 static ip_builtin_info_t const classic_math_builtins[] = {
@@ -85,7 +84,7 @@ static void ip_create_constant
 {
     ip_var_t *var = ip_var_create(&(program->vars), name, IP_TYPE_FLOAT);
     if (var) {
-        var->fvalue = value;
+        var->initial.fvalue = value;
         var->base.flags |= IP_SYMBOL_DEFINED | IP_SYMBOL_NO_RESET;
     }
 }
@@ -99,7 +98,4 @@ void ip_register_math_builtins(ip_program_t *program, unsigned options)
     } else {
         ip_program_register_builtins(program, classic_math_builtins);
     }
-
-    /* Seed the random number generator at startup */
-    srand(time(0));
 }
@@ -65,8 +65,7 @@ int ip_abs_of(ip_exec_t *exec, ip_value_t *args, size_t num_args)
 
 int ip_rand(ip_exec_t *exec, ip_value_t *args, size_t num_args)
 {
-    ip_float_t value = ((ip_float_t)rand()) / (((ip_float_t)RAND_MAX) + 1);
-    (void)exec;
+    ip_float_t value = ip_exec_random(exec);
     (void)num_args;
     ip_value_set_float(&(args[0]), value);
     return IP_EXEC_OK;
@@ -75,11 +74,10 @@ int ip_rand(ip_exec_t *exec, ip_value_t *args, size_t num_args)
 int ip_srand(ip_exec_t *exec, ip_value_t *args, size_t num_args)
 {
     int status;
-    (void)exec;
     (void)num_args;
     status = ip_value_to_int(&(args[0]));
     if (status == IP_EXEC_OK) {
-        srand((unsigned)(args[0].ivalue));
+        ip_exec_seed_random(exec, (ip_uint_t)(args[0].ivalue));
     }
     return status;
 }
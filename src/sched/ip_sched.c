@@ -0,0 +1,604 @@
+/*
+ * Copyright (C) 2025 Rhys Weatherley
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/* Needed for fopencookie() */
+#define _GNU_SOURCE
+
+#include "ip_sched.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/types.h>
+
+/** Number of bytes to read from an input file descriptor at a time */
+#define IP_GREEN_READ_SIZE 4096
+
+/** Maximum number of epoll events to process at once */
+#define IP_SCHED_MAX_EVENTS 64
+
+struct ip_green_s
+{
+    /** Next instance in the scheduler's run queue */
+    ip_green_t *next;
+
+    /** Scheduler that is running this instance */
+    ip_sched_t *sched;
+
+    /** Execution context for the program */
+    ip_exec_t exec;
+
+    /** File descriptor to read input from, or -1 for no input */
+    int input_fd;
+
+    /** Non-zero if the input can be polled with epoll */
+    int pollable;
+
+    /** Non-zero if the input has been added to the epoll set */
+    int registered;
+
+    /** Non-zero once the end of the input has been reached */
+    int eof;
+
+    /** Buffer of input data that has been read but not consumed yet */
+    char *buffer;
+
+    /** Position of the next byte to be consumed in the buffer */
+    size_t posn;
+
+    /** Number of bytes of valid data in the buffer */
+    size_t len;
+
+    /** Allocated size of the buffer */
+    size_t size;
+
+    /** Function to call when the instance finishes */
+    ip_green_exit_t on_exit;
+
+    /** User data for on_exit */
+    void *user_data;
+};
+
+struct ip_sched_s
+{
+    /** Lock that protects the run queue and counters */
+    pthread_mutex_t lock;
+
+    /** Signalled when an instance is added to the run queue */
+    pthread_cond_t runnable;
+
+    /** Signalled when the last live instance finishes */
+    pthread_cond_t finished;
+
+    /** First instance in the run queue */
+    ip_green_t *head;
+
+    /** Last instance in the run queue */
+    ip_green_t *tail;
+
+    /** Number of instances that have not finished yet */
+    unsigned long num_live;
+
+    /** Number of times that instances have been parked */
+    unsigned long num_parks;
+
+    /** Number of statements in a time slice */
+    unsigned long time_slice;
+
+    /** Non-zero when the threads have been asked to stop */
+    int shutdown;
+
+    /** File descriptor for the epoll set */
+    int epoll_fd;
+
+    /** Event file descriptor for waking up the poller thread */
+    int wake_fd;
+
+    /** The worker threads */
+    pthread_t *workers;
+
+    /** Number of worker threads */
+    int num_workers;
+
+    /** The poller thread */
+    pthread_t poller;
+};
+
+/**
+ * @brief Adds an instance to the end of a scheduler's run queue.
+ *
+ * @param[in,out] sched The scheduler.
+ * @param[in] green The instance to add.
+ */
+static void ip_sched_enqueue(ip_sched_t *sched, ip_green_t *green)
+{
+    pthread_mutex_lock(&(sched->lock));
+    green->next = 0;
+    if (sched->tail) {
+        sched->tail->next = green;
+    } else {
+        sched->head = green;
+    }
+    sched->tail = green;
+    pthread_cond_signal(&(sched->runnable));
+    pthread_mutex_unlock(&(sched->lock));
+}
+
+/**
+ * @brief Reads more input for an instance into its buffer.
+ *
+ * @param[in,out] green The instance.
+ * @param[in] wait Non-zero to wait for data if none is available yet.
+ *
+ * @return Non-zero if data was read or EOF was reached, or zero if
+ * no data is available yet.
+ */
+static int ip_green_fill(ip_green_t *green, int wait)
+{
+    struct pollfd fds;
+    ssize_t size;
+
+    /* Discard the consumed data and make room for more */
+    if (green->posn > 0) {
+        memmove(green->buffer, green->buffer + green->posn,
+                green->len - green->posn);
+        green->len -= green->posn;
+        green->posn = 0;
+    }
+    if ((green->size - green->len) < IP_GREEN_READ_SIZE) {
+        green->size = green->len + IP_GREEN_READ_SIZE;
+        green->buffer = realloc(green->buffer, green->size);
+        if (!(green->buffer)) {
+            ip_out_of_memory();
+        }
+    }
+
+    /* Read as much as we can */
+    for (;;) {
+        size = read(green->input_fd, green->buffer + green->len,
+                    green->size - green->len);
+        if (size > 0) {
+            green->len += (size_t)size;
+            return 1;
+        } else if (size == 0) {
+            green->eof = 1;
+            return 1;
+        } else if (errno == EINTR) {
+            continue;
+        } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            /* Treat read errors as the end of the input */
+            green->eof = 1;
+            return 1;
+        } else if (!wait) {
+            return 0;
+        }
+        fds.fd = green->input_fd;
+        fds.events = POLLIN;
+        fds.revents = 0;
+        poll(&fds, 1, -1);
+    }
+}
+
+/**
+ * @brief Reads input for the program from an instance's buffer.
+ *
+ * @param[in] cookie The instance.
+ * @param[out] buf Buffer to read into.
+ * @param[in] size Size of the buffer.
+ *
+ * @return The number of bytes read, or zero at EOF.
+ *
+ * Normally the scheduler only lets the program read once the data it
+ * needs is in the buffer.  If the program reads further than expected,
+ * then we have no choice but to block the worker thread until more
+ * data arrives.
+ */
+static ssize_t ip_green_read(void *cookie, char *buf, size_t size)
+{
+    ip_green_t *green = (ip_green_t *)cookie;
+    while (green->posn >= green->len) {
+        if (green->eof) {
+            return 0;
+        }
+        ip_green_fill(green, 1);
+    }
+    if (size > (green->len - green->posn)) {
+        size = green->len - green->posn;
+    }
+    memcpy(buf, green->buffer + green->posn, size);
+    green->posn += size;
+    return (ssize_t)size;
+}
+
+/**
+ * @brief Determine if the data that the next statement needs is available.
+ *
+ * @param[in] green The instance.
+ *
+ * @return Non-zero if the data is available.
+ *
+ * "INPUT" needs a whole line, and "COPY TAPE" or "IGNORE TAPE" needs
+ * everything up to the next "~~~~~" separator.
+ */
+static int ip_green_has_data(const ip_green_t *green)
+{
+    const char *data = green->buffer + green->posn;
+    size_t len = green->len - green->posn;
+    size_t index, tildes;
+    if (green->exec.pc->type == ITOK_INPUT) {
+        return memchr(data, '\n', len) != 0;
+    }
+    tildes = 0;
+    for (index = 0; index < len; ++index) {
+        if (data[index] != '~') {
+            tildes = 0;
+        } else if (++tildes >= 5) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Determine if an instance can execute its next statement
+ * without blocking on input.
+ *
+ * @param[in,out] green The instance.
+ *
+ * @return Non-zero if the instance can proceed, or zero if it must park.
+ */
+static int ip_green_ready(ip_green_t *green)
+{
+    const ip_ast_node_t *node = green->exec.pc;
+    if (!node || green->eof || green->exec.next_input) {
+        /* Finishing, at EOF, or still reading the embedded input */
+        return 1;
+    }
+    if (node->type != ITOK_INPUT && node->type != ITOK_COPY_TAPE &&
+            node->type != ITOK_IGNORE_TAPE) {
+        /* Statement does not read input */
+        return 1;
+    }
+    while (!ip_green_has_data(green) && !(green->eof)) {
+        if (!ip_green_fill(green, !(green->pollable))) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief Parks an instance until more input arrives.
+ *
+ * @param[in,out] green The instance.
+ *
+ * The input is re-armed in the epoll set in one-shot mode, so the
+ * poller thread will put the instance back on the run queue exactly
+ * once when the input becomes readable.
+ */
+static void ip_green_park(ip_green_t *green)
+{
+    ip_sched_t *sched = green->sched;
+    struct epoll_event event;
+
+    /* Flush the output so that any prompt is visible while we wait */
+    fflush(green->exec.output);
+
+    pthread_mutex_lock(&(sched->lock));
+    ++(sched->num_parks);
+    pthread_mutex_unlock(&(sched->lock));
+
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN | EPOLLONESHOT;
+    event.data.ptr = green;
+    if (green->registered) {
+        epoll_ctl(sched->epoll_fd, EPOLL_CTL_MOD, green->input_fd, &event);
+    } else {
+        epoll_ctl(sched->epoll_fd, EPOLL_CTL_ADD, green->input_fd, &event);
+        green->registered = 1;
+    }
+}
+
+/**
+ * @brief Finishes an instance and frees it.
+ *
+ * @param[in,out] green The instance.
+ * @param[in] status The status from the last statement.
+ */
+static void ip_green_finish(ip_green_t *green, int status)
+{
+    ip_sched_t *sched = green->sched;
+    int exitval;
+
+    /* Get the exit status and release the instance's resources */
+    exitval = ip_exec_finish(&(green->exec), status);
+    if (green->registered) {
+        epoll_ctl(sched->epoll_fd, EPOLL_CTL_DEL, green->input_fd, 0);
+    }
+    fflush(green->exec.output);
+    fclose(green->exec.input);
+    if (green->on_exit) {
+        (*(green->on_exit))(green, exitval, green->user_data);
+    }
+    ip_exec_free(&(green->exec));
+    free(green->buffer);
+    free(green);
+
+    /* Wake up anyone who is waiting for all instances to finish */
+    pthread_mutex_lock(&(sched->lock));
+    if (--(sched->num_live) == 0) {
+        pthread_cond_broadcast(&(sched->finished));
+    }
+    pthread_mutex_unlock(&(sched->lock));
+}
+
+/**
+ * @brief Runs an instance for one time slice.
+ *
+ * @param[in,out] green The instance.
+ */
+static void ip_green_run_slice(ip_green_t *green)
+{
+    unsigned long steps;
+    int status;
+    for (steps = green->sched->time_slice; steps > 0; --steps) {
+        if (!ip_green_ready(green)) {
+            ip_green_park(green);
+            return;
+        }
+        status = ip_exec_step(&(green->exec));
+        if (status != IP_EXEC_OK) {
+            ip_green_finish(green, status);
+            return;
+        }
+    }
+
+    /* Time slice has expired, so go to the back of the queue */
+    ip_sched_enqueue(green->sched, green);
+}
+
+/**
+ * @brief Main function for a worker thread.
+ *
+ * @param[in] arg The scheduler.
+ *
+ * @return Always NULL.
+ */
+static void *ip_sched_worker_main(void *arg)
+{
+    ip_sched_t *sched = (ip_sched_t *)arg;
+    ip_green_t *green;
+    for (;;) {
+        pthread_mutex_lock(&(sched->lock));
+        while (!(sched->head) && !(sched->shutdown)) {
+            pthread_cond_wait(&(sched->runnable), &(sched->lock));
+        }
+        green = sched->head;
+        if (!green) {
+            pthread_mutex_unlock(&(sched->lock));
+            break;
+        }
+        sched->head = green->next;
+        if (!(sched->head)) {
+            sched->tail = 0;
+        }
+        pthread_mutex_unlock(&(sched->lock));
+        ip_green_run_slice(green);
+    }
+    return 0;
+}
+
+/**
+ * @brief Main function for the poller thread.
+ *
+ * @param[in] arg The scheduler.
+ *
+ * @return Always NULL.
+ */
+static void *ip_sched_poller_main(void *arg)
+{
+    ip_sched_t *sched = (ip_sched_t *)arg;
+    struct epoll_event events[IP_SCHED_MAX_EVENTS];
+    int count, index;
+    for (;;) {
+        count = epoll_wait(sched->epoll_fd, events, IP_SCHED_MAX_EVENTS, -1);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        for (index = 0; index < count; ++index) {
+            if (!(events[index].data.ptr)) {
+                /* Woken up by ip_sched_free() */
+                return 0;
+            }
+            ip_sched_enqueue(sched, (ip_green_t *)(events[index].data.ptr));
+        }
+    }
+    return 0;
+}
+
+ip_sched_t *ip_sched_new(int num_threads, unsigned long time_slice)
+{
+    ip_sched_t *sched;
+    struct epoll_event event;
+    sched = calloc(1, sizeof(ip_sched_t));
+    if (!sched) {
+        ip_out_of_memory();
+    }
+    sched->workers = calloc((size_t)num_threads, sizeof(pthread_t));
+    if (!(sched->workers)) {
+        ip_out_of_memory();
+    }
+    sched->time_slice = time_slice > 0 ? time_slice : 1;
+    pthread_mutex_init(&(sched->lock), 0);
+    pthread_cond_init(&(sched->runnable), 0);
+    pthread_cond_init(&(sched->finished), 0);
+
+    /* Set up the epoll set, with an event to wake up the poller */
+    sched->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    sched->wake_fd = eventfd(0, EFD_CLOEXEC);
+    if (sched->epoll_fd < 0 || sched->wake_fd < 0) {
+        ip_sched_free(sched);
+        return 0;
+    }
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.ptr = 0;
+    epoll_ctl(sched->epoll_fd, EPOLL_CTL_ADD, sched->wake_fd, &event);
+
+    /* Start the threads */
+    if (pthread_create(&(sched->poller), 0, ip_sched_poller_main, sched)) {
+        close(sched->wake_fd);
+        sched->wake_fd = -1;
+        ip_sched_free(sched);
+        return 0;
+    }
+    while (sched->num_workers < num_threads) {
+        if (pthread_create(&(sched->workers[sched->num_workers]), 0,
+                           ip_sched_worker_main, sched)) {
+            break;
+        }
+        ++(sched->num_workers);
+    }
+    if (sched->num_workers == 0) {
+        ip_sched_free(sched);
+        return 0;
+    }
+    return sched;
+}
+
+void ip_sched_free(ip_sched_t *sched)
+{
+    uint64_t value = 1;
+    int index;
+    if (!sched) {
+        return;
+    }
+
+    /* Stop the worker threads */
+    pthread_mutex_lock(&(sched->lock));
+    sched->shutdown = 1;
+    pthread_cond_broadcast(&(sched->runnable));
+    pthread_mutex_unlock(&(sched->lock));
+    for (index = 0; index < sched->num_workers; ++index) {
+        pthread_join(sched->workers[index], 0);
+    }
+
+    /* Stop the poller thread */
+    if (sched->wake_fd >= 0 && sched->epoll_fd >= 0) {
+        if (write(sched->wake_fd, &value, sizeof(value)) == sizeof(value)) {
+            pthread_join(sched->poller, 0);
+        }
+    }
+
+    /* Clean up */
+    if (sched->wake_fd >= 0) {
+        close(sched->wake_fd);
+    }
+    if (sched->epoll_fd >= 0) {
+        close(sched->epoll_fd);
+    }
+    pthread_cond_destroy(&(sched->finished));
+    pthread_cond_destroy(&(sched->runnable));
+    pthread_mutex_destroy(&(sched->lock));
+    free(sched->workers);
+    free(sched);
+}
+
+ip_green_t *ip_sched_spawn
+    (ip_sched_t *sched, const ip_program_t *program, int input_fd,
+     FILE *output, ip_green_exit_t on_exit, void *user_data)
+{
+    cookie_io_functions_t funcs;
+    struct epoll_event event;
+    ip_green_t *green;
+    int flags;
+
+    /* Create the instance */
+    green = calloc(1, sizeof(ip_green_t));
+    if (!green) {
+        ip_out_of_memory();
+    }
+    green->sched = sched;
+    green->input_fd = input_fd;
+    green->eof = (input_fd < 0);
+    green->on_exit = on_exit;
+    green->user_data = user_data;
+    ip_exec_init(&(green->exec), program);
+    green->exec.output = output;
+
+    /* The program reads input through the instance's buffer.  The stream
+     * is unbuffered so that stdio never reads ahead of the program. */
+    memset(&funcs, 0, sizeof(funcs));
+    funcs.read = ip_green_read;
+    green->exec.input = fopencookie(green, "r", funcs);
+    if (!(green->exec.input)) {
+        ip_out_of_memory();
+    }
+    setvbuf(green->exec.input, 0, _IONBF, 0);
+
+    /* Determine if the input can be polled.  epoll refuses regular files,
+     * so we try adding the descriptor in a disabled state to find out. */
+    if (input_fd >= 0) {
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLONESHOT;
+        event.data.ptr = green;
+        if (epoll_ctl(sched->epoll_fd, EPOLL_CTL_ADD, input_fd, &event) == 0) {
+            epoll_ctl(sched->epoll_fd, EPOLL_CTL_DEL, input_fd, 0);
+            flags = fcntl(input_fd, F_GETFL);
+            fcntl(input_fd, F_SETFL, flags | O_NONBLOCK);
+            green->pollable = 1;
+        }
+    }
+
+    /* Put the instance on the run queue */
+    pthread_mutex_lock(&(sched->lock));
+    ++(sched->num_live);
+    pthread_mutex_unlock(&(sched->lock));
+    ip_sched_enqueue(sched, green);
+    return green;
+}
+
+void ip_sched_wait(ip_sched_t *sched)
+{
+    pthread_mutex_lock(&(sched->lock));
+    while (sched->num_live > 0) {
+        pthread_cond_wait(&(sched->finished), &(sched->lock));
+    }
+    pthread_mutex_unlock(&(sched->lock));
+}
+
+unsigned long ip_sched_park_count(ip_sched_t *sched)
+{
+    unsigned long count;
+    pthread_mutex_lock(&(sched->lock));
+    count = sched->num_parks;
+    pthread_mutex_unlock(&(sched->lock));
+    return count;
+}
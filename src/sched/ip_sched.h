@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2025 Rhys Weatherley
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef INTERPROGRAM_SCHED_H
+#define INTERPROGRAM_SCHED_H
+
+#include "ip_exec.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Scheduler that multiplexes many running programs onto a
+ * small number of OS threads.
+ */
+typedef struct ip_sched_s ip_sched_t;
+
+/**
+ * @brief Program instance that is running under a scheduler.
+ */
+typedef struct ip_green_s ip_green_t;
+
+/**
+ * @brief Function that is called when a program instance finishes.
+ *
+ * @param[in] green The program instance.
+ * @param[in] status The exit status of the program.
+ * @param[in] user_data The user data that was supplied to ip_sched_spawn().
+ *
+ * This is called on one of the scheduler's worker threads.  The instance
+ * has already stopped using its input file descriptor and output stream,
+ * so the callback may close them.  The instance is freed when the
+ * callback returns.
+ */
+typedef void (*ip_green_exit_t)
+    (ip_green_t *green, int status, void *user_data);
+
+/**
+ * @brief Creates a new scheduler.
+ *
+ * @param[in] num_threads Number of worker threads, which must be at least 1.
+ * @param[in] time_slice Number of statements that an instance may execute
+ * before it must give up its worker thread to another instance.
+ *
+ * @return The new scheduler, or NULL if the scheduler's threads or
+ * polling resources could not be created.
+ */
+ip_sched_t *ip_sched_new(int num_threads, unsigned long time_slice);
+
+/**
+ * @brief Frees a scheduler.
+ *
+ * @param[in] sched The scheduler.
+ *
+ * The worker threads are stopped.  This should only be called once all
+ * instances have finished; use ip_sched_wait() first.
+ */
+void ip_sched_free(ip_sched_t *sched);
+
+/**
+ * @brief Starts running a new instance of a program under a scheduler.
+ *
+ * @param[in,out] sched The scheduler.
+ * @param[in] program The program to run, which may be shared with other
+ * instances and must not be freed until the instance finishes.
+ * @param[in] input_fd File descriptor to read input from, or -1 for
+ * no input.
+ * @param[in] output Stream to write output to.
+ * @param[in] on_exit Function to call when the instance finishes, or NULL.
+ * @param[in] user_data User data to pass to @a on_exit.
+ *
+ * @return The new instance.
+ *
+ * If @a input_fd refers to a pipe, socket, or terminal, then it is put
+ * into non-blocking mode.  When the program is about to read input that
+ * has not arrived yet, the instance is parked and its worker thread moves
+ * on to other instances.  The instance resumes when epoll reports that
+ * more data is available.  Regular files are always ready, so instances
+ * that read from them are never parked.
+ *
+ * The scheduler does not close @a input_fd or @a output.
+ */
+ip_green_t *ip_sched_spawn
+    (ip_sched_t *sched, const ip_program_t *program, int input_fd,
+     FILE *output, ip_green_exit_t on_exit, void *user_data);
+
+/**
+ * @brief Waits for all instances in a scheduler to finish.
+ *
+ * @param[in,out] sched The scheduler.
+ */
+void ip_sched_wait(ip_sched_t *sched);
+
+/**
+ * @brief Gets the number of times that instances have been parked
+ * waiting for input.
+ *
+ * @param[in] sched The scheduler.
+ *
+ * @return The number of times that instances have been parked.
+ */
+unsigned long ip_sched_park_count(ip_sched_t *sched);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,1451 @@
+/*
+ * Copyright (C) 2025 Rhys Weatherley
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Local server that runs INTERPROGRAM's from a warm cache of parsed
+ * programs.  Clients connect to a UNIX domain socket and send a request
+ * made up of header lines, some of which are followed by a payload:
+ *
+ *     PROGRAM path         Run the program in the file "path".
+ *     SOURCE length        Run the program source in the payload.
+ *     ARG text             Add "text" to the "ARGV" variable.
+ *     CLASSIC              Force the use of the classic syntax.
+ *     EXTENDED             Force the use of the extended syntax.
+ *     INPUT length         Use the payload as the program's input.
+ *     RUN                  End of the request; run the program.
+ *
+ * The server replies with the program's output and error messages,
+ * followed by its exit status, and then closes the connection:
+ *
+ *     OUTPUT length        Payload is the output from the program.
+ *     ERRORS length        Payload is the error messages from the program.
+ *     STATUS code          Exit status from the program.
+ *
+ * Each request runs in a forked worker process so that the cached
+ * program is never modified by the execution of the program.
+ */
+
+#include "ip_parser.h"
+#include "ip_exec.h"
+#include "ip_image.h"
+#include "ip_math_lib.h"
+#include "ip_string_lib.h"
+#include "ip_console.h"
+#include "program_cache.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <time.h>
+#include <getopt.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+/** Maximum size of a payload in a request or response */
+#define IP_SERVER_MAX_PAYLOAD (16UL * 1024UL * 1024UL)
+
+/** Maximum size of the error messages that are captured from a program */
+#define IP_SERVER_MAX_ERRORS 65536
+
+/** Number of seconds to wait for a client to send its request */
+#define IP_SERVER_READ_TIMEOUT 10
+
+/** Maximum number of clients that can be sending requests at once */
+#define IP_SERVER_MAX_CLIENTS 64
+
+/** Maximum size of a request, including the program source and input */
+#define IP_SERVER_MAX_REQUEST (2UL * IP_SERVER_MAX_PAYLOAD + 65536UL)
+
+#define short_options "w:s:m:t:dkri:ceS"
+static struct option long_options[] = {
+    {"workers",     required_argument,  0,  'w'},
+    {"cache-size",  required_argument,  0,  's'},
+    {"max-requests",required_argument,  0,  'm'},
+    {"idle-timeout",required_argument,  0,  't'},
+    {"daemon",      no_argument,        0,  'd'},
+    {"connect",     no_argument,        0,  'k'},
+    {"input",       required_argument,  0,  'i'},
+    {"classic",     no_argument,        0,  'c'},
+    {"extended",    no_argument,        0,  'e'},
+    {"source",      no_argument,        0,  'S'},
+    {0,             0,                  0,  0},
+};
+
+static void usage(const char *progname)
+{
+    fprintf(stderr, "Usage: %s [options] socket\n", progname);
+    fprintf(stderr, "       %s --connect [options] socket program [args]\n\n", progname);
+
+    fprintf(stderr, "Server options:\n\n");
+
+    fprintf(stderr, "--workers N, -w N\n");
+    fprintf(stderr, "    Run at most N programs at once (default is 4).\n\n");
+
+    fprintf(stderr, "--cache-size N, -s N\n");
+    fprintf(stderr, "    Cache at most N parsed programs (default is 64).\n\n");
+
+    fprintf(stderr, "--max-requests N, -m N\n");
+    fprintf(stderr, "    Exit after serving N requests (default is no limit).\n\n");
+
+    fprintf(stderr, "--idle-timeout SECS, -t SECS\n");
+    fprintf(stderr, "    Exit after SECS seconds without a request (default is no limit).\n\n");
+
+    fprintf(stderr, "--daemon, -d\n");
+    fprintf(stderr, "    Run in the background once the socket is listening.\n\n");
+
+    fprintf(stderr, "Client options:\n\n");
+
+    fprintf(stderr, "--connect, -k\n");
+    fprintf(stderr, "    Send a request to run a program to the server on socket.\n\n");
+
+    fprintf(stderr, "--input FILE, -i FILE\n");
+    fprintf(stderr, "    Send FILE as the program's input, or \"-\" for standard input\n");
+    fprintf(stderr, "    (default is no input).\n\n");
+
+    fprintf(stderr, "--classic, -c\n");
+    fprintf(stderr, "    Force the use of the classic INTERPROGRAM syntax.\n\n");
+
+    fprintf(stderr, "--extended, -e\n");
+    fprintf(stderr, "    Force the use of the extended INTERPROGRAM syntax.\n\n");
+
+    fprintf(stderr, "--source, -S\n");
+    fprintf(stderr, "    Send the program's source rather than its path.\n\n");
+}
+
+static void register_builtins(ip_parser_t *parser, unsigned options)
+{
+    ip_register_math_builtins(parser->program, options);
+    ip_register_string_builtins(parser->program, options);
+    ip_register_console_builtins(parser->program, options);
+}
+
+/**
+ * @brief Set when the server has been asked to stop by a signal.
+ */
+static volatile sig_atomic_t ip_server_stop = 0;
+
+static void ip_server_handle_signal(int sig)
+{
+    (void)sig;
+    ip_server_stop = 1;
+}
+
+/**
+ * @brief Request from a client to run a program.
+ */
+typedef struct
+{
+    /** Path to the program's source file, or NULL for inline source */
+    char *path;
+
+    /** Inline source for the program, or NULL */
+    char *source;
+
+    /** Length of the inline source in bytes */
+    size_t source_len;
+
+    /** Input data for the program, or NULL */
+    char *input;
+
+    /** Length of the input data in bytes */
+    size_t input_len;
+
+    /** Arguments for the "ARGV" variable; the first is the program name */
+    char **argv;
+
+    /** Number of arguments in "argv" */
+    int argc;
+
+    /** Syntax options for the program; e.g. ITOK_TYPE_EXTENSION */
+    unsigned options;
+
+} ip_server_request_t;
+
+/**
+ * @brief Frees a request.
+ *
+ * @param[in] request The request to free.
+ */
+static void ip_server_request_free(ip_server_request_t *request)
+{
+    int index;
+    for (index = 0; index < request->argc; ++index) {
+        free(request->argv[index]);
+    }
+    free(request->argv);
+    free(request->path);
+    free(request->source);
+    free(request->input);
+    memset(request, 0, sizeof(ip_server_request_t));
+}
+
+/**
+ * @brief Adds an argument to a request.
+ *
+ * @param[in,out] request The request.
+ * @param[in] arg The argument to add.
+ */
+static void ip_server_request_add_arg
+    (ip_server_request_t *request, const char *arg)
+{
+    request->argv = realloc
+        (request->argv, sizeof(char *) * (size_t)(request->argc + 1));
+    if (!(request->argv)) {
+        ip_out_of_memory();
+    }
+    request->argv[request->argc] = strdup(arg);
+    if (!(request->argv[request->argc])) {
+        ip_out_of_memory();
+    }
+    ++(request->argc);
+}
+
+/**
+ * @brief Reads a payload from a stream.
+ *
+ * @param[in] stream The stream to read from.
+ * @param[in] length The length of the payload as a decimal string.
+ * @param[out] len Returns the length of the payload.
+ *
+ * @return The payload, or NULL if the length is invalid or the
+ * payload could not be read.
+ */
+static char *ip_server_read_payload
+    (FILE *stream, const char *length, size_t *len)
+{
+    unsigned long size;
+    char *end;
+    char *data;
+    size = strtoul(length, &end, 10);
+    if (end == length || *end != '\0' || size > IP_SERVER_MAX_PAYLOAD) {
+        return 0;
+    }
+    data = malloc(size ? size : 1);
+    if (!data) {
+        ip_out_of_memory();
+    }
+    if (fread(data, 1, size, stream) != size) {
+        free(data);
+        return 0;
+    }
+    *len = size;
+    return data;
+}
+
+/**
+ * @brief Reads a request from a client.
+ *
+ * @param[in] stream The stream to read the request from.
+ * @param[out] request Returns the request.
+ *
+ * @return NULL if the request was read, or an error message otherwise.
+ */
+static const char *ip_server_read_request
+    (FILE *stream, ip_server_request_t *request)
+{
+    char *line = 0;
+    size_t line_size = 0;
+    ssize_t len;
+    const char *error = "incomplete request";
+    char *value;
+
+    /* The first argument will be filled in with the program name later */
+    memset(request, 0, sizeof(ip_server_request_t));
+    ip_server_request_add_arg(request, "-");
+    while ((len = getline(&line, &line_size, stream)) > 0) {
+        /* Strip the end of line and split off the value */
+        if (line[len - 1] == '\n') {
+            line[--len] = '\0';
+        }
+        value = strchr(line, ' ');
+        if (value) {
+            *value++ = '\0';
+        } else {
+            value = line + len;
+        }
+
+        /* Process the request line */
+        if (!strcmp(line, "RUN")) {
+            error = 0;
+            break;
+        } else if (!strcmp(line, "PROGRAM") && *value != '\0' &&
+                   !(request->path) && !(request->source)) {
+            request->path = strdup(value);
+            if (!(request->path)) {
+                ip_out_of_memory();
+            }
+        } else if (!strcmp(line, "SOURCE") &&
+                   !(request->path) && !(request->source)) {
+            request->source = ip_server_read_payload
+                (stream, value, &(request->source_len));
+            if (!(request->source)) {
+                error = "invalid program source";
+                break;
+            }
+        } else if (!strcmp(line, "INPUT") && !(request->input)) {
+            request->input = ip_server_read_payload
+                (stream, value, &(request->input_len));
+            if (!(request->input)) {
+                error = "invalid program input";
+                break;
+            }
+        } else if (!strcmp(line, "ARG")) {
+            ip_server_request_add_arg(request, value);
+        } else if (!strcmp(line, "CLASSIC")) {
+            request->options &= ~ITOK_TYPE_EXTENSION;
+            request->options |= ITOK_TYPE_CLASSIC;
+        } else if (!strcmp(line, "EXTENDED")) {
+            request->options &= ~ITOK_TYPE_CLASSIC;
+            request->options |= ITOK_TYPE_EXTENSION;
+        } else {
+            error = "invalid request";
+            break;
+        }
+    }
+    free(line);
+    if (!error && !(request->path) && !(request->source)) {
+        error = "no program in request";
+    }
+    if (!error && request->path) {
+        free(request->argv[0]);
+        request->argv[0] = strdup(request->path);
+        if (!(request->argv[0])) {
+            ip_out_of_memory();
+        }
+    }
+    return error;
+}
+
+/**
+ * @brief Gets the identity of the program in a request for the cache.
+ *
+ * @param[in] request The request.
+ * @param[out] len Returns the length of the identity.
+ *
+ * @return The identity, which is the program's arguments separated
+ * by NUL characters.
+ *
+ * The arguments are part of the identity because they are baked into
+ * the "ARGV" variable of the parsed program.
+ */
+static char *ip_server_request_ident
+    (const ip_server_request_t *request, size_t *len)
+{
+    size_t size = 0;
+    char *ident;
+    int index;
+    for (index = 0; index < request->argc; ++index) {
+        size += strlen(request->argv[index]) + 1;
+    }
+    ident = malloc(size);
+    if (!ident) {
+        ip_out_of_memory();
+    }
+    *len = 0;
+    for (index = 0; index < request->argc; ++index) {
+        size = strlen(request->argv[index]) + 1;
+        memcpy(ident + *len, request->argv[index], size);
+        *len += size;
+    }
+    return ident;
+}
+
+/**
+ * @brief Writes a block of data to a file descriptor, retrying on
+ * short writes and interrupts.
+ *
+ * @param[in] fd The file descriptor to write to.
+ * @param[in] data Points to the data to write.
+ * @param[in] len Length of the data to write.
+ *
+ * @return Non-zero if the data was written, or zero on error.
+ */
+static int ip_server_write_all(int fd, const void *data, size_t len)
+{
+    const char *d = (const char *)data;
+    ssize_t written;
+    while (len > 0) {
+        written = write(fd, d, len);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return 0;
+        }
+        d += written;
+        len -= (size_t)written;
+    }
+    return 1;
+}
+
+/**
+ * @brief Writes a payload with a header line to a file descriptor.
+ *
+ * @param[in] fd The file descriptor to write to.
+ * @param[in] name The name for the header line.
+ * @param[in] data Points to the payload data.
+ * @param[in] len Length of the payload data.
+ *
+ * @return Non-zero if the payload was written, or zero on error.
+ */
+static int ip_server_write_payload
+    (int fd, const char *name, const char *data, size_t len)
+{
+    char header[64];
+    snprintf(header, sizeof(header), "%s %lu\n", name, (unsigned long)len);
+    return ip_server_write_all(fd, header, strlen(header)) &&
+           ip_server_write_all(fd, data, len);
+}
+
+/**
+ * @brief Sends a response to a client.
+ *
+ * @param[in] fd The file descriptor for the client connection.
+ * @param[in] output The output from the program.
+ * @param[in] output_len The length of the output.
+ * @param[in] errors The error messages from the program.
+ * @param[in] errors_len The length of the error messages.
+ * @param[in] status The exit status from the program.
+ */
+static void ip_server_respond
+    (int fd, const char *output, size_t output_len,
+     const char *errors, size_t errors_len, int status)
+{
+    char header[64];
+    snprintf(header, sizeof(header), "STATUS %d\n", status);
+    if (ip_server_write_payload(fd, "OUTPUT", output, output_len) &&
+            ip_server_write_payload(fd, "ERRORS", errors, errors_len)) {
+        ip_server_write_all(fd, header, strlen(header));
+    }
+}
+
+/**
+ * @brief Opens a memory stream to collect the error messages from
+ * parsing or running a program, to send back to the client.
+ *
+ * @param[out] data Returns the collected messages once the stream is closed.
+ * @param[out] len Returns the length of the collected messages.
+ *
+ * @return The stream.
+ *
+ * The messages are collected per request rather than by redirecting
+ * standard error, which is shared with the rest of the server.
+ */
+static FILE *ip_server_open_errors(char **data, size_t *len)
+{
+    FILE *file;
+    *data = 0;
+    *len = 0;
+    file = open_memstream(data, len);
+    if (!file) {
+        ip_out_of_memory();
+    }
+    return file;
+}
+
+/**
+ * @brief Closes a stream that was collecting error messages.
+ *
+ * @param[in] file The stream from ip_server_open_errors().
+ * @param[in,out] len The length of the collected messages, which is
+ * truncated to IP_SERVER_MAX_ERRORS.
+ */
+static void ip_server_close_errors(FILE *file, size_t *len)
+{
+    fclose(file);
+    if (*len > IP_SERVER_MAX_ERRORS) {
+        *len = IP_SERVER_MAX_ERRORS;
+    }
+}
+
+/**
+ * @brief Runs a request in a worker process and exits.
+ *
+ * @param[in] fd The file descriptor for the client connection.
+ * @param[in] program The program to run.
+ * @param[in] request The request from the client.
+ * @param[in] other_fds The server's other file descriptors, which were
+ * inherited by the worker and must be closed.
+ * @param[in] num_other_fds The number of entries in @a other_fds.
+ */
+static void ip_server_worker
+    (int fd, ip_program_t *program, const ip_server_request_t *request,
+     const int *other_fds, int num_other_fds)
+{
+    ip_exec_t exec;
+    FILE *errors;
+    FILE *input;
+    FILE *output;
+    char *output_data = 0;
+    size_t output_len = 0;
+    char *errors_data;
+    size_t errors_len;
+    int status;
+    int index;
+
+    /* Close the listening socket and the connections to other clients
+     * so that they are not held open for as long as this worker runs */
+    for (index = 0; index < num_other_fds; ++index) {
+        close(other_fds[index]);
+    }
+
+    /* Restore the default signal handlers in the worker */
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+
+    /* Set up the input, output, and error streams for the program */
+    errors = ip_server_open_errors(&errors_data, &errors_len);
+    if (request->input_len > 0) {
+        input = fmemopen(request->input, request->input_len, "r");
+    } else {
+        input = fopen("/dev/null", "r");
+    }
+    output = open_memstream(&output_data, &output_len);
+    if (!input || !output) {
+        ip_out_of_memory();
+    }
+
+    /* Run the program.  Every worker inherits the same random number
+     * state from the server, so reseed to give each a different sequence. */
+    ip_exec_init(&exec, program);
+    ip_exec_seed_random(&exec, ((ip_uint_t)time(0)) ^ (ip_uint_t)getpid());
+    exec.input = input;
+    exec.output = output;
+    exec.errors = errors;
+    status = ip_exec_run(&exec);
+    fclose(output);
+    ip_server_close_errors(errors, &errors_len);
+
+    /* Send the response back to the client */
+    ip_server_respond
+        (fd, output_data, output_len, errors_data, errors_len, status);
+    _exit(0);
+}
+
+/**
+ * @brief Client that is in the middle of sending a request.
+ */
+typedef struct
+{
+    /** File descriptor for the client connection */
+    int fd;
+
+    /** Data that has been received from the client so far */
+    char *data;
+
+    /** Length of the received data */
+    size_t len;
+
+    /** Number of bytes that have been allocated for "data" */
+    size_t max;
+
+    /** Offset of the first request line that has not been scanned */
+    size_t scanned;
+
+    /** Time at which to stop waiting for the rest of the request */
+    time_t deadline;
+
+} ip_server_client_t;
+
+/**
+ * @brief Determines if a client has sent a complete request.
+ *
+ * @param[in,out] client The client.
+ *
+ * @return Non-zero if the request is complete, or if it is malformed
+ * in a way that ip_server_read_request() will report.
+ *
+ * Only the header lines are checked, with payloads skipped over by
+ * their lengths.  Scanning resumes where it left off the last time.
+ */
+static int ip_server_request_complete(ip_server_client_t *client)
+{
+    const char *line;
+    const char *end;
+    const char *value;
+    char *value_end;
+    unsigned long size;
+    size_t posn;
+    while (client->scanned < client->len) {
+        line = client->data + client->scanned;
+        end = memchr(line, '\n', client->len - client->scanned);
+        if (!end) {
+            return 0;
+        }
+        posn = (size_t)(end - client->data) + 1;
+        if ((end - line) == 3 && !memcmp(line, "RUN", 3)) {
+            return 1;
+        }
+        if (((end - line) >= 6 && !memcmp(line, "SOURCE", 6)) ||
+                ((end - line) >= 5 && !memcmp(line, "INPUT", 5))) {
+            value = memchr(line, ' ', (size_t)(end - line));
+            if (!value || value[1] < '0' || value[1] > '9') {
+                return 1;
+            }
+            size = strtoul(value + 1, &value_end, 10);
+            if (value_end != end || size > IP_SERVER_MAX_PAYLOAD) {
+                return 1;
+            }
+            if ((client->len - posn) < size) {
+                return 0;
+            }
+            posn += size;
+        }
+        client->scanned = posn;
+    }
+    return 0;
+}
+
+/**
+ * @brief Reads whatever data is available from a client.
+ *
+ * @param[in,out] client The client.
+ *
+ * @return Non-zero if the request is ready to be handled, because it is
+ * complete or the client has stopped sending, or zero to keep waiting.
+ */
+static int ip_server_client_read(ip_server_client_t *client)
+{
+    ssize_t len;
+    for (;;) {
+        if (client->len >= client->max) {
+            if (client->max >= IP_SERVER_MAX_REQUEST) {
+                return 1;
+            }
+            client->max = client->max ? client->max * 2 : 4096;
+            client->data = realloc(client->data, client->max);
+            if (!(client->data)) {
+                ip_out_of_memory();
+            }
+        }
+        len = read(client->fd, client->data + client->len,
+                   client->max - client->len);
+        if (len < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno != EAGAIN && errno != EWOULDBLOCK;
+        } else if (len == 0) {
+            return 1;
+        }
+        client->len += (size_t)len;
+        if (ip_server_request_complete(client)) {
+            return 1;
+        }
+    }
+}
+
+/**
+ * @brief Handles a request from a client.
+ *
+ * @param[in,out] cache The cache of parsed programs.
+ * @param[in] fd The file descriptor for the client connection.
+ * @param[in] data The request data that was received from the client.
+ * @param[in] len The length of the request data.
+ * @param[in] other_fds The server's other file descriptors, for the
+ * worker to close.
+ * @param[in] num_other_fds The number of entries in @a other_fds.
+ *
+ * @return The process identifier of the worker that is running the
+ * request, or zero if the request was answered without a worker.
+ */
+static pid_t ip_server_handle
+    (ip_program_cache_t *cache, int fd, char *data, size_t len,
+     const int *other_fds, int num_other_fds)
+{
+    ip_server_request_t request;
+    ip_program_t *program;
+    const char *error;
+    char *errors_data;
+    size_t errors_len;
+    char *ident;
+    size_t ident_len;
+    ip_uint_t key;
+    unsigned long num_errors;
+    FILE *stream;
+    pid_t pid;
+
+    /* Parse the request from the client */
+    if (len == 0) {
+        return 0;
+    }
+    stream = fmemopen(data, len, "r");
+    if (!stream) {
+        ip_out_of_memory();
+    }
+    error = ip_server_read_request(stream, &request);
+    fclose(stream);
+    if (error) {
+        ip_server_respond(fd, 0, 0, error, strlen(error), 255);
+        ip_server_request_free(&request);
+        return 0;
+    }
+
+    /* Compute the cache key for the program */
+    if (request.path) {
+        if (!ip_image_compute_key(request.path, request.options, &key)) {
+            error = strerror(errno);
+            ip_server_respond(fd, 0, 0, error, strlen(error), 1);
+            ip_server_request_free(&request);
+            return 0;
+        }
+    } else {
+        key = ip_image_compute_buffer_key
+            (request.source, request.source_len, request.options);
+    }
+
+    /* Look for the program in the cache and parse it if necessary */
+    ident = ip_server_request_ident(&request, &ident_len);
+    program = ip_program_cache_lookup(cache, key, ident, ident_len);
+    if (!program) {
+        program = ip_program_new(request.argv[0]);
+        program->errors = ip_server_open_errors(&errors_data, &errors_len);
+        if (request.path) {
+            num_errors = ip_parse_program_file
+                (program, request.path, request.options,
+                 request.argc, request.argv, register_builtins);
+        } else {
+            num_errors = ip_parse_program_buffer
+                (program, request.source, request.source_len,
+                 request.options, request.argc, request.argv,
+                 register_builtins);
+        }
+        ip_server_close_errors(program->errors, &errors_len);
+        program->errors = stderr;
+        if (num_errors != 0) {
+            ip_server_respond(fd, 0, 0, errors_data, errors_len, 1);
+            ip_program_free(program);
+            free(errors_data);
+            free(ident);
+            ip_server_request_free(&request);
+            return 0;
+        }
+        free(errors_data);
+        ip_program_cache_insert(cache, key, ident, ident_len, program);
+    }
+    free(ident);
+
+    /* Fork a worker to run the program */
+    fflush(stdout);
+    fflush(stderr);
+    pid = fork();
+    if (pid == 0) {
+        ip_server_worker(fd, program, &request, other_fds, num_other_fds);
+    } else if (pid < 0) {
+        error = strerror(errno);
+        ip_server_respond(fd, 0, 0, error, strlen(error), 255);
+        pid = 0;
+    }
+    ip_server_request_free(&request);
+    return pid;
+}
+
+/**
+ * @brief Handles the request from a client once it has been received,
+ * and then closes the connection to the client.
+ *
+ * @param[in,out] cache The cache of parsed programs.
+ * @param[in,out] clients The clients that are sending requests.
+ * @param[in] num_clients The number of clients.
+ * @param[in] index The index of the client to handle.
+ * @param[in] listen_fd The listening socket for the server.
+ *
+ * @return The process identifier of the worker that is running the
+ * request, or zero if the request was answered without a worker.
+ */
+static pid_t ip_server_client_finish
+    (ip_program_cache_t *cache, ip_server_client_t *clients,
+     int num_clients, int index, int listen_fd)
+{
+    ip_server_client_t *client = &(clients[index]);
+    int other_fds[IP_SERVER_MAX_CLIENTS + 1];
+    int num_other_fds = 0;
+    int flags;
+    pid_t pid;
+    int posn;
+
+    /* Collect the file descriptors that the worker must not keep open */
+    other_fds[num_other_fds++] = listen_fd;
+    for (posn = 0; posn < num_clients; ++posn) {
+        if (posn != index) {
+            other_fds[num_other_fds++] = clients[posn].fd;
+        }
+    }
+
+    /* Responses are written with blocking writes */
+    flags = fcntl(client->fd, F_GETFL);
+    if (flags >= 0) {
+        fcntl(client->fd, F_SETFL, flags & ~O_NONBLOCK);
+    }
+    pid = ip_server_handle
+        (cache, client->fd, client->data, client->len,
+         other_fds, num_other_fds);
+    close(client->fd);
+    free(client->data);
+    return pid;
+}
+
+/**
+ * @brief Determines if a server is already listening on a socket.
+ *
+ * @param[in] addr The address of the socket.
+ *
+ * @return Non-zero if a connection to the socket succeeded.
+ */
+static int ip_server_is_listening(const struct sockaddr_un *addr)
+{
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    int result;
+    if (fd < 0) {
+        return 0;
+    }
+    result = connect(fd, (const struct sockaddr *)addr, sizeof(*addr)) == 0;
+    close(fd);
+    return result;
+}
+
+/**
+ * @brief Creates the listening socket for the server.
+ *
+ * @param[in] path The path to the UNIX domain socket.
+ * @param[out] info Returns the identity of the socket that was created,
+ * for ip_server_unlink() to check later.
+ *
+ * @return The file descriptor for the socket, or -1 on error.
+ *
+ * A stale socket that was left behind by an earlier server is replaced,
+ * but anything else at @a path is left alone.
+ */
+static int ip_server_listen(const char *path, struct stat *info)
+{
+    struct sockaddr_un addr;
+    struct stat st;
+    int fd;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "%s: socket path is too long\n", path);
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    if (lstat(path, &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) {
+            fprintf(stderr, "%s: file exists and is not a socket\n", path);
+            return -1;
+        }
+        if (ip_server_is_listening(&addr)) {
+            fprintf(stderr, "%s: a server is already listening\n", path);
+            return -1;
+        }
+        if (unlink(path) < 0) {
+            perror(path);
+            return -1;
+        }
+    } else if (errno != ENOENT) {
+        perror(path);
+        return -1;
+    }
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror(path);
+        close(fd);
+        return -1;
+    }
+    if (lstat(path, info) < 0 || listen(fd, 64) < 0) {
+        perror(path);
+        close(fd);
+        unlink(path);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * @brief Removes the server's socket when the server exits.
+ *
+ * @param[in] path The path to the UNIX domain socket.
+ * @param[in] info The identity of the socket from ip_server_listen().
+ *
+ * Nothing is removed if @a path has been replaced since the server
+ * created it; e.g. by another server that is now using the same path.
+ */
+static void ip_server_unlink(const char *path, const struct stat *info)
+{
+    struct stat st;
+    if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode) &&
+            st.st_dev == info->st_dev && st.st_ino == info->st_ino) {
+        unlink(path);
+    }
+}
+
+/**
+ * @brief Runs the server.
+ *
+ * @param[in] path The path to the UNIX domain socket.
+ * @param[in] max_workers The maximum number of workers to run at once.
+ * @param[in] cache_size The maximum number of programs to cache.
+ * @param[in] max_requests The maximum number of requests to serve,
+ * or zero for no limit.
+ * @param[in] idle_timeout The number of seconds to wait for a request
+ * before exiting, or zero for no limit.
+ * @param[in] background Non-zero to run in the background as a daemon.
+ *
+ * @return The exit status for the server.
+ */
+static int ip_server_run
+    (const char *path, int max_workers, int cache_size,
+     unsigned long max_requests, int idle_timeout, int background)
+{
+    ip_program_cache_t cache;
+    ip_server_client_t clients[IP_SERVER_MAX_CLIENTS];
+    ip_server_client_t *client;
+    struct pollfd pfds[IP_SERVER_MAX_CLIENTS + 1];
+    struct stat info;
+    unsigned long num_requests = 0;
+    int num_workers = 0;
+    int num_clients = 0;
+    time_t idle_deadline;
+    time_t deadline;
+    time_t now;
+    int listen_fd;
+    int fd;
+    int ret;
+    int index;
+    int null_fd;
+    int flags;
+    pid_t pid;
+
+    /* Create the listening socket */
+    listen_fd = ip_server_listen(path, &info);
+    if (listen_fd < 0) {
+        return 1;
+    }
+
+    /* Detach from the terminal if we are running as a daemon.
+     * The parent exits once the socket is ready to accept requests. */
+    if (background) {
+        fflush(stdout);
+        fflush(stderr);
+        pid = fork();
+        if (pid < 0) {
+            perror("fork");
+            close(listen_fd);
+            ip_server_unlink(path, &info);
+            return 1;
+        } else if (pid > 0) {
+            _exit(0);
+        }
+        setsid();
+        null_fd = open("/dev/null", O_RDWR);
+        if (null_fd >= 0) {
+            dup2(null_fd, 0);
+            dup2(null_fd, 1);
+            dup2(null_fd, 2);
+            if (null_fd > 2) {
+                close(null_fd);
+            }
+        }
+    }
+
+    /* Set up the signal handlers */
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, ip_server_handle_signal);
+    signal(SIGTERM, ip_server_handle_signal);
+
+    /* Accept and handle requests until told to stop.  Requests are read
+     * with non-blocking reads from all clients at once, so that a client
+     * that is slow to send its request does not hold up the others. */
+    flags = fcntl(listen_fd, F_GETFL);
+    if (flags >= 0) {
+        fcntl(listen_fd, F_SETFL, flags | O_NONBLOCK);
+    }
+    ip_program_cache_init(&cache, (size_t)cache_size);
+    idle_deadline = time(0) + idle_timeout;
+    while (!ip_server_stop) {
+        /* Clean up workers that have finished */
+        while (num_workers > 0 && waitpid(-1, 0, WNOHANG) > 0) {
+            --num_workers;
+        }
+        if (max_requests && num_requests >= max_requests) {
+            break;
+        }
+
+        /* Wait for a new client, or for more data from the clients that
+         * are sending requests.  Stop accepting new clients if there are
+         * too many already or the request limit has been reached. */
+        if (num_clients < IP_SERVER_MAX_CLIENTS &&
+                (!max_requests ||
+                 (num_requests + (unsigned long)num_clients) < max_requests)) {
+            pfds[0].fd = listen_fd;
+        } else {
+            pfds[0].fd = -1;
+        }
+        pfds[0].events = POLLIN;
+        pfds[0].revents = 0;
+        deadline = idle_timeout ? idle_deadline : 0;
+        for (index = 0; index < num_clients; ++index) {
+            pfds[index + 1].fd = clients[index].fd;
+            pfds[index + 1].events = POLLIN;
+            pfds[index + 1].revents = 0;
+            if (!deadline || clients[index].deadline < deadline) {
+                deadline = clients[index].deadline;
+            }
+        }
+        now = time(0);
+        if (!deadline) {
+            ret = poll(pfds, (nfds_t)(num_clients + 1), -1);
+        } else if (deadline > now) {
+            ret = poll(pfds, (nfds_t)(num_clients + 1),
+                       (int)(deadline - now) * 1000);
+        } else {
+            ret = poll(pfds, (nfds_t)(num_clients + 1), 0);
+        }
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("poll");
+            break;
+        }
+        now = time(0);
+
+        /* Read from the clients and handle the requests that are ready.
+         * A client that runs out of time is sent an error response. */
+        for (index = num_clients - 1; index >= 0; --index) {
+            client = &(clients[index]);
+            if (pfds[index + 1].revents != 0 &&
+                    ip_server_client_read(client)) {
+                /* The request is ready to be handled */
+            } else if (now < client->deadline) {
+                continue;
+            }
+
+            /* Wait for a worker to finish if all of them are busy */
+            while (num_workers >= max_workers && waitpid(-1, 0, 0) > 0) {
+                --num_workers;
+            }
+            if (ip_server_client_finish
+                    (&cache, clients, num_clients, index, listen_fd) > 0) {
+                ++num_workers;
+            }
+            ++num_requests;
+            clients[index] = clients[--num_clients];
+        }
+
+        /* Accept the next client */
+        if ((pfds[0].revents & POLLIN) != 0) {
+            fd = accept(listen_fd, 0, 0);
+            if (fd < 0) {
+                if (errno != EINTR && errno != ECONNABORTED &&
+                        errno != EAGAIN && errno != EWOULDBLOCK) {
+                    perror("accept");
+                }
+            } else {
+                flags = fcntl(fd, F_GETFL);
+                if (flags >= 0) {
+                    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+                }
+                client = &(clients[num_clients++]);
+                memset(client, 0, sizeof(ip_server_client_t));
+                client->fd = fd;
+                client->deadline = now + IP_SERVER_READ_TIMEOUT;
+            }
+        }
+
+        /* Exit if there have been no requests for the idle timeout */
+        if (ret > 0) {
+            idle_deadline = now + idle_timeout;
+        } else if (idle_timeout && now >= idle_deadline) {
+            if (num_workers == 0 && num_clients == 0) {
+                break;
+            }
+            idle_deadline = now + idle_timeout;
+        }
+    }
+
+    /* Drop the clients that did not finish sending their requests */
+    for (index = 0; index < num_clients; ++index) {
+        close(clients[index].fd);
+        free(clients[index].data);
+    }
+
+    /* Wait for the remaining workers to finish and clean up */
+    while (num_workers > 0 && waitpid(-1, 0, 0) > 0) {
+        --num_workers;
+    }
+    close(listen_fd);
+    ip_server_unlink(path, &info);
+    ip_program_cache_free(&cache);
+    return 0;
+}
+
+/**
+ * @brief Reads the entire contents of a stream into memory.
+ *
+ * @param[in] stream The stream to read.
+ * @param[out] len Returns the length of the contents.
+ *
+ * @return The contents, which must be freed by the caller.
+ */
+static char *ip_client_read_all(FILE *stream, size_t *len)
+{
+    char *data = 0;
+    size_t size = 0;
+    size_t max = 0;
+    size_t n;
+    do {
+        if (size >= max) {
+            max = max ? max * 2 : 4096;
+            data = realloc(data, max);
+            if (!data) {
+                ip_out_of_memory();
+            }
+        }
+        n = fread(data + size, 1, max - size, stream);
+        size += n;
+    } while (n > 0);
+    *len = size;
+    return data;
+}
+
+/**
+ * @brief Reads the entire contents of a file into memory.
+ *
+ * @param[in] filename The name of the file, or "-" for standard input.
+ * @param[out] len Returns the length of the contents.
+ *
+ * @return The contents, or NULL if the file could not be read.
+ */
+static char *ip_client_read_file(const char *filename, size_t *len)
+{
+    FILE *file;
+    char *data;
+    if (!strcmp(filename, "-")) {
+        return ip_client_read_all(stdin, len);
+    }
+    file = fopen(filename, "rb");
+    if (!file) {
+        perror(filename);
+        return 0;
+    }
+    data = ip_client_read_all(file, len);
+    fclose(file);
+    return data;
+}
+
+/**
+ * @brief Copies a payload in a response from the server to a stream.
+ *
+ * @param[in] response The response stream from the server.
+ * @param[in] length The length of the payload as a decimal string.
+ * @param[in] stream The stream to write the payload to.
+ *
+ * @return Non-zero if the payload was copied, or zero on error.
+ */
+static int ip_client_copy_payload
+    (FILE *response, const char *length, FILE *stream)
+{
+    size_t len;
+    char *data = ip_server_read_payload(response, length, &len);
+    if (!data) {
+        return 0;
+    }
+    fwrite(data, 1, len, stream);
+    fflush(stream);
+    free(data);
+    return 1;
+}
+
+/**
+ * @brief Sends a request to the server and reports on the response.
+ *
+ * @param[in] path The path to the UNIX domain socket.
+ * @param[in] program_filename The name of the program to run.
+ * @param[in] argc Number of extra arguments for the program.
+ * @param[in] argv The extra arguments for the program.
+ * @param[in] input_filename The name of the input file, or NULL.
+ * @param[in] options Syntax options for the program.
+ * @param[in] send_source Non-zero to send the program's source.
+ *
+ * @return The exit status from the program, or 255 if the request failed.
+ */
+static int ip_client_run
+    (const char *path, const char *program_filename, int argc, char **argv,
+     const char *input_filename, unsigned options, int send_source)
+{
+    struct sockaddr_un addr;
+    char *data;
+    size_t len;
+    char *line = 0;
+    size_t line_size = 0;
+    ssize_t line_len;
+    char *value;
+    char *full_path;
+    FILE *response;
+    int status = 255;
+    int have_status = 0;
+    int ok;
+    int fd;
+    int index;
+
+    /* Connect to the server */
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "%s: socket path is too long\n", path);
+        return 255;
+    }
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return 255;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror(path);
+        close(fd);
+        return 255;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    /* Send the program.  Paths are made absolute because the server
+     * may be running in a different directory. */
+    if (send_source) {
+        data = ip_client_read_file(program_filename, &len);
+        if (!data) {
+            close(fd);
+            return 255;
+        }
+        ok = ip_server_write_payload(fd, "SOURCE", data, len);
+        free(data);
+    } else {
+        full_path = realpath(program_filename, 0);
+        if (!full_path) {
+            perror(program_filename);
+            close(fd);
+            return 255;
+        }
+        ok = ip_server_write_all(fd, "PROGRAM ", 8) &&
+             ip_server_write_all(fd, full_path, strlen(full_path)) &&
+             ip_server_write_all(fd, "\n", 1);
+        free(full_path);
+    }
+
+    /* Send the arguments, options, and input */
+    for (index = 0; ok && index < argc; ++index) {
+        ok = ip_server_write_all(fd, "ARG ", 4) &&
+             ip_server_write_all(fd, argv[index], strlen(argv[index])) &&
+             ip_server_write_all(fd, "\n", 1);
+    }
+    if (ok && (options & ITOK_TYPE_CLASSIC) != 0) {
+        ok = ip_server_write_all(fd, "CLASSIC\n", 8);
+    } else if (ok && (options & ITOK_TYPE_EXTENSION) != 0) {
+        ok = ip_server_write_all(fd, "EXTENDED\n", 9);
+    }
+    if (ok && input_filename) {
+        data = ip_client_read_file(input_filename, &len);
+        if (!data) {
+            close(fd);
+            return 255;
+        }
+        ok = ip_server_write_payload(fd, "INPUT", data, len);
+        free(data);
+    }
+    if (ok) {
+        ok = ip_server_write_all(fd, "RUN\n", 4);
+    }
+    if (!ok) {
+        perror(path);
+        close(fd);
+        return 255;
+    }
+
+    /* Read the response */
+    response = fdopen(fd, "r");
+    if (!response) {
+        perror(path);
+        close(fd);
+        return 255;
+    }
+    while ((line_len = getline(&line, &line_size, response)) > 0) {
+        if (line[line_len - 1] == '\n') {
+            line[--line_len] = '\0';
+        }
+        value = strchr(line, ' ');
+        if (!value) {
+            break;
+        }
+        *value++ = '\0';
+        if (!strcmp(line, "OUTPUT")) {
+            if (!ip_client_copy_payload(response, value, stdout)) {
+                break;
+            }
+        } else if (!strcmp(line, "ERRORS")) {
+            if (!ip_client_copy_payload(response, value, stderr)) {
+                break;
+            }
+        } else if (!strcmp(line, "STATUS")) {
+            status = atoi(value);
+            have_status = 1;
+            break;
+        } else {
+            break;
+        }
+    }
+    if (!have_status) {
+        fprintf(stderr, "%s: incomplete response from server\n", path);
+    }
+    free(line);
+    fclose(response);
+    return status;
+}
+
+/**
+ * @brief Parses a positive integer command-line argument.
+ *
+ * @param[in] arg The argument.
+ *
+ * @return The value of the argument, or zero if it is not a
+ * positive integer.
+ */
+static long parse_positive(const char *arg)
+{
+    char *end;
+    long value = strtol(arg, &end, 10);
+    if (end == arg || *end != '\0' || value <= 0 || value > INT_MAX) {
+        return 0;
+    }
+    return value;
+}
+
+int main(int argc, char **argv)
+{
+    const char *progname = argv[0];
+    int max_workers = 4;
+    int cache_size = 64;
+    unsigned long max_requests = 0;
+    int idle_timeout = 0;
+    int background = 0;
+    int client = 0;
+    int send_source = 0;
+    const char *input_filename = 0;
+    unsigned options = 0;
+    int opt, index;
+
+    /* Parse the command-line options */
+    while ((opt = getopt_long
+                    (argc, argv, short_options, long_options, &index)) >= 0) {
+        switch (opt) {
+        case 'w':
+            max_workers = (int)parse_positive(optarg);
+            if (!max_workers) {
+                usage(progname);
+                return 1;
+            }
+            break;
+
+        case 's':
+            cache_size = (int)parse_positive(optarg);
+            if (!cache_size) {
+                usage(progname);
+                return 1;
+            }
+            break;
+
+        case 'm':
+            max_requests = (unsigned long)parse_positive(optarg);
+            if (!max_requests) {
+                usage(progname);
+                return 1;
+            }
+            break;
+
+        case 't':
+            idle_timeout = (int)parse_positive(optarg);
+            if (!idle_timeout) {
+                usage(progname);
+                return 1;
+            }
+            break;
+
+        case 'd':
+            background = 1;
+            break;
+
+        case 'k':
+            client = 1;
+            break;
+
+        case 'i':
+            input_filename = optarg;
+            break;
+
+        case 'c':
+            options &= ~ITOK_TYPE_EXTENSION;
+            options |= ITOK_TYPE_CLASSIC;
+            break;
+
+        case 'e':
+            options &= ~ITOK_TYPE_CLASSIC;
+            options |= ITOK_TYPE_EXTENSION;
+            break;
+
+        case 'S':
+            send_source = 1;
+            break;
+
+        default:
+            usage(progname);
+            return 1;
+        }
+    }
+
+    /* Run as a client or a server */
+    if (client) {
+        if ((optind + 2) > argc) {
+            usage(progname);
+            return 1;
+        }
+        return ip_client_run
+            (argv[optind], argv[optind + 1], argc - optind - 2,
+             argv + optind + 2, input_filename, options, send_source);
+    }
+    if ((optind + 1) != argc) {
+        usage(progname);
+        return 1;
+    }
+    return ip_server_run
+        (argv[optind], max_workers, cache_size, max_requests,
+         idle_timeout, background);
+}
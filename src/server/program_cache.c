@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) 2025 Rhys Weatherley
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "program_cache.h"
+#include <stdlib.h>
+#include <string.h>
+
+void ip_program_cache_init(ip_program_cache_t *cache, size_t capacity)
+{
+    memset(cache, 0, sizeof(ip_program_cache_t));
+    cache->capacity = capacity;
+}
+
+/**
+ * @brief Frees a cache entry and the program within it.
+ *
+ * @param[in] entry The entry to free.
+ */
+static void ip_program_cache_free_entry(ip_program_cache_entry_t *entry)
+{
+    ip_program_free(entry->program);
+    free(entry->ident);
+    free(entry);
+}
+
+void ip_program_cache_free(ip_program_cache_t *cache)
+{
+    ip_program_cache_entry_t *entry;
+    ip_program_cache_entry_t *next;
+    for (entry = cache->head; entry != 0; entry = next) {
+        next = entry->next;
+        ip_program_cache_free_entry(entry);
+    }
+    memset(cache, 0, sizeof(ip_program_cache_t));
+}
+
+/**
+ * @brief Removes an entry from the list of entries in a cache.
+ *
+ * @param[in,out] cache The program cache.
+ * @param[in] entry The entry to remove.
+ */
+static void ip_program_cache_unlink
+    (ip_program_cache_t *cache, ip_program_cache_entry_t *entry)
+{
+    if (entry->prev) {
+        entry->prev->next = entry->next;
+    } else {
+        cache->head = entry->next;
+    }
+    if (entry->next) {
+        entry->next->prev = entry->prev;
+    } else {
+        cache->tail = entry->prev;
+    }
+    entry->prev = 0;
+    entry->next = 0;
+}
+
+/**
+ * @brief Adds an entry to the front of the list of entries in a cache.
+ *
+ * @param[in,out] cache The program cache.
+ * @param[in] entry The entry to add, which becomes the most recently used.
+ */
+static void ip_program_cache_push_front
+    (ip_program_cache_t *cache, ip_program_cache_entry_t *entry)
+{
+    entry->prev = 0;
+    entry->next = cache->head;
+    if (cache->head) {
+        cache->head->prev = entry;
+    } else {
+        cache->tail = entry;
+    }
+    cache->head = entry;
+}
+
+ip_program_t *ip_program_cache_lookup
+    (ip_program_cache_t *cache, ip_uint_t key,
+     const char *ident, size_t ident_len)
+{
+    ip_program_cache_entry_t *entry;
+    for (entry = cache->head; entry != 0; entry = entry->next) {
+        if (entry->key == key && entry->ident_len == ident_len &&
+                !memcmp(entry->ident, ident, ident_len)) {
+            if (entry != cache->head) {
+                ip_program_cache_unlink(cache, entry);
+                ip_program_cache_push_front(cache, entry);
+            }
+            ++(cache->hits);
+            return entry->program;
+        }
+    }
+    ++(cache->misses);
+    return 0;
+}
+
+void ip_program_cache_insert
+    (ip_program_cache_t *cache, ip_uint_t key,
+     const char *ident, size_t ident_len, ip_program_t *program)
+{
+    ip_program_cache_entry_t *entry;
+
+    /* Evict the least recently used programs if the cache is full */
+    while (cache->size >= cache->capacity && cache->tail) {
+        entry = cache->tail;
+        ip_program_cache_unlink(cache, entry);
+        ip_program_cache_free_entry(entry);
+        --(cache->size);
+    }
+
+    /* Add the new program as the most recently used */
+    entry = calloc(1, sizeof(ip_program_cache_entry_t));
+    if (!entry) {
+        ip_out_of_memory();
+    }
+    entry->ident = malloc(ident_len ? ident_len : 1);
+    if (!(entry->ident)) {
+        ip_out_of_memory();
+    }
+    memcpy(entry->ident, ident, ident_len);
+    entry->key = key;
+    entry->ident_len = ident_len;
+    entry->program = program;
+    ip_program_cache_push_front(cache, entry);
+    ++(cache->size);
+}
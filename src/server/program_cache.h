@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2025 Rhys Weatherley
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef INTERPROGRAM_PROGRAM_CACHE_H
+#define INTERPROGRAM_PROGRAM_CACHE_H
+
+#include "ip_program.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Entry in a cache of parsed programs.
+ */
+typedef struct ip_program_cache_entry_s ip_program_cache_entry_t;
+struct ip_program_cache_entry_s
+{
+    /** Previous entry, which was used more recently than this one */
+    ip_program_cache_entry_t *prev;
+
+    /** Next entry, which was used less recently than this one */
+    ip_program_cache_entry_t *next;
+
+    /** Cache key for the program source and options */
+    ip_uint_t key;
+
+    /** Identity of the program: its name and arguments */
+    char *ident;
+
+    /** Length of the identity in bytes */
+    size_t ident_len;
+
+    /** The parsed program */
+    ip_program_t *program;
+};
+
+/**
+ * @brief Cache of parsed programs that evicts the least recently used
+ * program when it is full.
+ */
+typedef struct
+{
+    /** Most recently used entry in the cache */
+    ip_program_cache_entry_t *head;
+
+    /** Least recently used entry in the cache */
+    ip_program_cache_entry_t *tail;
+
+    /** Number of programs in the cache */
+    size_t size;
+
+    /** Maximum number of programs in the cache */
+    size_t capacity;
+
+    /** Number of lookups that found the program in the cache */
+    unsigned long hits;
+
+    /** Number of lookups that did not find the program in the cache */
+    unsigned long misses;
+
+} ip_program_cache_t;
+
+/**
+ * @brief Initialises a program cache.
+ *
+ * @param[out] cache The program cache to initialise.
+ * @param[in] capacity The maximum number of programs to cache,
+ * which must be at least 1.
+ */
+void ip_program_cache_init(ip_program_cache_t *cache, size_t capacity);
+
+/**
+ * @brief Frees a program cache and all of the programs within it.
+ *
+ * @param[in] cache The program cache to free.
+ */
+void ip_program_cache_free(ip_program_cache_t *cache);
+
+/**
+ * @brief Looks up a program in a cache.
+ *
+ * @param[in,out] cache The program cache.
+ * @param[in] key The cache key for the program source and options.
+ * @param[in] ident Identity of the program: its name and arguments.
+ * @param[in] ident_len Length of the identity in bytes.
+ *
+ * @return The program, or NULL if it is not in the cache.
+ *
+ * If the program is found, then it becomes the most recently used.
+ */
+ip_program_t *ip_program_cache_lookup
+    (ip_program_cache_t *cache, ip_uint_t key,
+     const char *ident, size_t ident_len);
+
+/**
+ * @brief Inserts a program into a cache.
+ *
+ * @param[in,out] cache The program cache.
+ * @param[in] key The cache key for the program source and options.
+ * @param[in] ident Identity of the program: its name and arguments.
+ * @param[in] ident_len Length of the identity in bytes.
+ * @param[in] program The program, which must not already be in the
+ * cache.  The cache takes ownership of the program.
+ *
+ * If the cache is full, then the least recently used program is freed.
+ */
+void ip_program_cache_insert
+    (ip_program_cache_t *cache, ip_uint_t key,
+     const char *ident, size_t ident_len, ip_program_t *program);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
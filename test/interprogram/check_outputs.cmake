@@ -0,0 +1,81 @@
+# Runs the interpreter in a mode that writes its results to output files,
+# and then checks the contents of the files.  Use it from add_test() with
+# "${CMAKE_COMMAND} -D<name>=<value> ... -P check_outputs.cmake":
+#
+#   COMMAND     The command to run.  Separate arguments with "$<SEMICOLON>".
+#   INPUT       Optional file to send to the command's standard input.
+#   OUTPUTS     The output files that the command writes, in order.
+#   EXPECTED    Optional file containing the expected contents of the
+#               outputs, all concatenated together in order.
+#   DISTINCT    If true, also check that no two outputs are the same.
+#   STATUSES    Optional exit status that is expected for each job in the
+#               report on standard output.  Without this, the command
+#               itself must exit with a status of zero.
+
+# Remove the outputs from previous runs so that stale files can't pass.
+foreach(OUTPUT ${OUTPUTS})
+    file(REMOVE ${OUTPUT})
+endforeach()
+
+# Run the command.
+if(INPUT)
+    execute_process(COMMAND ${COMMAND}
+        INPUT_FILE ${INPUT}
+        RESULT_VARIABLE RESULT
+        OUTPUT_VARIABLE REPORT)
+else()
+    execute_process(COMMAND ${COMMAND}
+        RESULT_VARIABLE RESULT
+        OUTPUT_VARIABLE REPORT)
+endif()
+message("${REPORT}")
+
+# Check the exit status of the command, or of each job in the report.
+# Report lines start with the job number and the job's exit status,
+# but jobs that run in parallel may be reported out of order.
+if(STATUSES)
+    string(REPLACE "\n" ";" LINES "${REPORT}")
+    set(NUM_JOBS 0)
+    foreach(LINE ${LINES})
+        if(LINE MATCHES "^([0-9]+)\t([0-9]+)\t")
+            set(STATUS_${CMAKE_MATCH_1} ${CMAKE_MATCH_2})
+            math(EXPR NUM_JOBS "${NUM_JOBS} + 1")
+        endif()
+    endforeach()
+    set(ACTUAL)
+    if(NUM_JOBS GREATER 0)
+        foreach(JOB RANGE 1 ${NUM_JOBS})
+            list(APPEND ACTUAL "${STATUS_${JOB}}")
+        endforeach()
+    endif()
+    if(NOT "${ACTUAL}" STREQUAL "${STATUSES}")
+        message(FATAL_ERROR "job statuses are '${ACTUAL}', expected '${STATUSES}'")
+    endif()
+elseif(NOT RESULT EQUAL 0)
+    message(FATAL_ERROR "command exited with status ${RESULT}")
+endif()
+
+# Compare the outputs against the expected contents.
+set(ALL_OUTPUTS "")
+set(SEEN)
+foreach(OUTPUT ${OUTPUTS})
+    if(NOT EXISTS ${OUTPUT})
+        message(FATAL_ERROR "${OUTPUT} was not written")
+    endif()
+    file(READ ${OUTPUT} CONTENTS)
+    set(ALL_OUTPUTS "${ALL_OUTPUTS}${CONTENTS}")
+    if(DISTINCT)
+        string(MD5 HASH "${CONTENTS}")
+        list(FIND SEEN ${HASH} POSN)
+        if(NOT POSN EQUAL -1)
+            message(FATAL_ERROR "${OUTPUT} is the same as an earlier output")
+        endif()
+        list(APPEND SEEN ${HASH})
+    endif()
+endforeach()
+if(EXPECTED)
+    file(READ ${EXPECTED} EXPECTED_OUTPUTS)
+    if(NOT "${ALL_OUTPUTS}" STREQUAL "${EXPECTED_OUTPUTS}")
+        message(FATAL_ERROR "outputs do not match ${EXPECTED}:\n${ALL_OUTPUTS}")
+    endif()
+endif()
@@ -0,0 +1,286 @@
+/*
+ * Copyright (C) 2025 Rhys Weatherley
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "interprogram.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Program that echoes its input lines and then adds up some numbers */
+static char const echo_program[] =
+    "TITLE Echo\n"
+    "symbols for integers J, T\n"
+    "symbols for strings S\n"
+    "at end of input, go to DONE\n"
+    "*NEXT\n"
+    "input S\n"
+    "output S\n"
+    "go to NEXT\n"
+    "*DONE\n"
+    "set T = 0\n"
+    "repeat for J = 1 to 100\n"
+    "    set T = T + J\n"
+    "end repeat\n"
+    "output T\n"
+    "take 3, exit interprogram\n";
+
+/* Program with a syntax error */
+static char const bad_program[] =
+    "TITLE Bad\n"
+    "set X = \n";
+
+/* Program with a runtime error */
+static char const div_zero_program[] =
+    "TITLE Division by zero\n"
+    "symbols for integers X, Y\n"
+    "set X = 0\n"
+    "set Y = 1 / X\n";
+
+/* Program that prints some random numbers */
+static char const random_program[] =
+    "TITLE Random\n"
+    "output random number\n"
+    "output random number\n";
+
+/* Buffer for collecting data from the write callbacks */
+typedef struct
+{
+    char data[1024];
+    size_t len;
+
+} buffer_t;
+
+static void write_buffer(void *user_data, const char *data, size_t size)
+{
+    buffer_t *buffer = (buffer_t *)user_data;
+    if (size > (sizeof(buffer->data) - 1 - buffer->len)) {
+        size = sizeof(buffer->data) - 1 - buffer->len;
+    }
+    memcpy(buffer->data + buffer->len, data, size);
+    buffer->len += size;
+    buffer->data[buffer->len] = '\0';
+}
+
+/* Reads input one character at a time to exercise the callback path */
+static size_t read_slowly(void *user_data, char *buf, size_t size)
+{
+    const char **input = (const char **)user_data;
+    if (size == 0 || **input == '\0') {
+        return 0;
+    }
+    buf[0] = *(*input)++;
+    return 1;
+}
+
+static ip_lib_program_t *parse(const char *source)
+{
+    return ip_lib_program_parse
+        ("test", source, strlen(source), IP_LIB_EXTENDED, 0, 0, 0, 0);
+}
+
+static int check_buffers(void)
+{
+    static char const input[] = "Hello\nWorld\n";
+    static char const expected[] = "Hello\nWorld\n5050\n";
+    ip_lib_program_t *program;
+    ip_lib_instance_t *instance;
+    const char *output;
+    size_t len;
+    int exitval = 0;
+
+    program = parse(echo_program);
+    if (!program) {
+        return 1;
+    }
+    instance = ip_lib_instance_new(program);
+    ip_lib_instance_set_input(instance, input, strlen(input));
+    if (ip_lib_instance_run(instance) != 3) {
+        exitval = 1;
+    }
+    output = ip_lib_instance_get_output(instance, &len);
+    if (!output || len != strlen(expected) || strcmp(output, expected) != 0) {
+        exitval = 1;
+    }
+
+    /* Run it again after a reset to check that the input is rewound */
+    ip_lib_instance_reset(instance);
+    if (ip_lib_instance_run(instance) != 3) {
+        exitval = 1;
+    }
+    output = ip_lib_instance_get_output(instance, &len);
+    if (!output || strcmp(output, expected) != 0) {
+        exitval = 1;
+    }
+    ip_lib_instance_free(instance);
+    ip_lib_program_free(program);
+    return exitval;
+}
+
+static int check_callbacks(void)
+{
+    static char const expected[] = "One\nTwo\n5050\n";
+    const char *input = "One\nTwo\n";
+    ip_lib_program_t *program;
+    ip_lib_instance_t *instance;
+    buffer_t output;
+    size_t len;
+    int exitval = 0;
+    int status;
+    int calls = 0;
+
+    program = parse(echo_program);
+    if (!program) {
+        return 1;
+    }
+    memset(&output, 0, sizeof(output));
+    instance = ip_lib_instance_new(program);
+    ip_lib_instance_set_input_callback(instance, read_slowly, &input);
+    ip_lib_instance_set_output_callback(instance, write_buffer, &output);
+
+    /* Run a few steps at a time; the program should need many calls */
+    while ((status = ip_lib_instance_run_steps(instance, 10))
+                == IP_LIB_RUNNING) {
+        ++calls;
+    }
+    if (status != 3 || calls < 10) {
+        exitval = 1;
+    }
+    if (strcmp(output.data, expected) != 0) {
+        exitval = 1;
+    }
+    if (ip_lib_instance_get_output(instance, &len) != 0) {
+        exitval = 1;
+    }
+
+    /* Further calls should keep returning the exit status */
+    if (ip_lib_instance_run_steps(instance, 10) != 3) {
+        exitval = 1;
+    }
+    ip_lib_instance_free(instance);
+    ip_lib_program_free(program);
+    return exitval;
+}
+
+static int check_errors(void)
+{
+    ip_lib_program_t *program;
+    ip_lib_instance_t *instance;
+    buffer_t errors;
+    int exitval = 0;
+
+    /* Parse errors should be reported through the callback */
+    memset(&errors, 0, sizeof(errors));
+    program = ip_lib_program_parse
+        ("bad.ip", bad_program, strlen(bad_program), IP_LIB_EXTENDED,
+         0, 0, write_buffer, &errors);
+    if (program || strncmp(errors.data, "bad.ip:2: ", 10) != 0) {
+        ip_lib_program_free(program);
+        exitval = 1;
+    }
+
+    /* Runtime errors should be reported through the callback */
+    memset(&errors, 0, sizeof(errors));
+    program = parse(div_zero_program);
+    if (!program) {
+        return 1;
+    }
+    instance = ip_lib_instance_new(program);
+    ip_lib_instance_set_error_callback(instance, write_buffer, &errors);
+    if (ip_lib_instance_run(instance) != 2) {
+        exitval = 1;
+    }
+    if (strcmp(errors.data, "test:4: division by zero\n") != 0) {
+        exitval = 1;
+    }
+    ip_lib_instance_free(instance);
+    ip_lib_program_free(program);
+    return exitval;
+}
+
+static int check_shared_program(void)
+{
+    ip_lib_program_t *program;
+    ip_lib_instance_t *instance1;
+    ip_lib_instance_t *instance2;
+    ip_lib_instance_t *instance3;
+    const char *output1;
+    const char *output2;
+    const char *output3;
+    size_t len;
+    int exitval = 0;
+
+    /* Run three instances of the same program, where two of them have
+     * the same random number stream and the third is different. */
+    program = parse(random_program);
+    if (!program) {
+        return 1;
+    }
+    instance1 = ip_lib_instance_new(program);
+    instance2 = ip_lib_instance_new(program);
+    instance3 = ip_lib_instance_new(program);
+    ip_lib_instance_seed_random(instance1, 42, 0);
+    ip_lib_instance_seed_random(instance2, 42, 0);
+    ip_lib_instance_seed_random(instance3, 42, 1);
+    if (ip_lib_instance_run(instance1) != 0 ||
+            ip_lib_instance_run(instance2) != 0 ||
+            ip_lib_instance_run(instance3) != 0) {
+        exitval = 1;
+    }
+    output1 = ip_lib_instance_get_output(instance1, &len);
+    output2 = ip_lib_instance_get_output(instance2, &len);
+    output3 = ip_lib_instance_get_output(instance3, &len);
+    if (strcmp(output1, output2) != 0 || strcmp(output1, output3) == 0) {
+        exitval = 1;
+    }
+    ip_lib_instance_free(instance1);
+    ip_lib_instance_free(instance2);
+    ip_lib_instance_free(instance3);
+    ip_lib_program_free(program);
+    return exitval;
+}
+
+int main(int argc, char **argv)
+{
+    int exitval = 0;
+
+    (void)argc;
+    (void)argv;
+
+#define RUN_TEST(name) \
+    do { \
+        printf(#name " ... "); \
+        fflush(stdout); \
+        if (name()) { \
+            printf("FAILED\n"); \
+            exitval = 1; \
+        } else { \
+            printf("ok\n"); \
+        } \
+    } while (0)
+
+    printf("libinterprogram %s\n", ip_lib_version());
+    RUN_TEST(check_buffers);
+    RUN_TEST(check_callbacks);
+    RUN_TEST(check_errors);
+    RUN_TEST(check_shared_program);
+    return exitval;
+}
@@ -0,0 +1,293 @@
+/*
+ * Copyright (C) 2025 Rhys Weatherley
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+#include "ip_sched.h"
+#include "ip_parser.h"
+#include "ip_math_lib.h"
+#include "ip_string_lib.h"
+#include "ip_console.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Number of instances to run at once */
+#define NUM_INSTANCES 200
+
+/* Number of lines to send to each instance */
+#define NUM_ROUNDS 5
+
+/* Program that echoes its input lines and then adds up some numbers */
+static char const echo_program[] =
+    "TITLE Echo\n"
+    "symbols for integers J, T\n"
+    "symbols for strings S\n"
+    "at end of input, go to DONE\n"
+    "*NEXT\n"
+    "input S\n"
+    "output S\n"
+    "go to NEXT\n"
+    "*DONE\n"
+    "set T = 0\n"
+    "repeat for J = 1 to 100\n"
+    "    set T = T + J\n"
+    "end repeat\n"
+    "output T\n"
+    "take 3, exit interprogram\n";
+
+/* State for a single instance in the test */
+typedef struct
+{
+    int input_fd;
+    int status;
+    int finished;
+    FILE *output;
+    char *data;
+    size_t len;
+
+} instance_t;
+
+static void register_builtins(ip_parser_t *parser, unsigned options)
+{
+    ip_register_math_builtins(parser->program, options);
+    ip_register_string_builtins(parser->program, options);
+    ip_register_console_builtins(parser->program, options);
+}
+
+static ip_program_t *parse(const char *source)
+{
+    ip_program_t *program = ip_program_new("test");
+    if (ip_parse_program_buffer
+            (program, source, strlen(source), ITOK_TYPE_EXTENSION,
+             0, 0, register_builtins) != 0) {
+        ip_program_free(program);
+        return 0;
+    }
+    return program;
+}
+
+static void instance_exit(ip_green_t *green, int status, void *user_data)
+{
+    instance_t *instance = (instance_t *)user_data;
+    (void)green;
+    instance->status = status;
+    instance->finished = 1;
+    fclose(instance->output);
+    instance->output = 0;
+    if (instance->input_fd >= 0) {
+        close(instance->input_fd);
+        instance->input_fd = -1;
+    }
+}
+
+static int check_instance(const instance_t *instance, const char *expected)
+{
+    if (!(instance->finished) || instance->status != 3) {
+        return 1;
+    }
+    if (!(instance->data) || strcmp(instance->data, expected) != 0) {
+        return 1;
+    }
+    return 0;
+}
+
+static int check_pipes(void)
+{
+    static instance_t instances[NUM_INSTANCES];
+    int write_fds[NUM_INSTANCES];
+    ip_program_t *program;
+    ip_sched_t *sched;
+    char line[64];
+    char expected[NUM_ROUNDS * 16 + 16];
+    int fds[2];
+    int index, round;
+    int exitval = 0;
+
+    program = parse(echo_program);
+    if (!program) {
+        return 1;
+    }
+    sched = ip_sched_new(4, 100);
+    if (!sched) {
+        ip_program_free(program);
+        return 1;
+    }
+
+    /* Start all of the instances.  They will all park immediately
+     * because no input has been written to the pipes yet. */
+    for (index = 0; index < NUM_INSTANCES; ++index) {
+        if (pipe(fds) < 0) {
+            perror("pipe");
+            exit(1);
+        }
+        memset(&(instances[index]), 0, sizeof(instance_t));
+        instances[index].input_fd = fds[0];
+        instances[index].output = open_memstream
+            (&(instances[index].data), &(instances[index].len));
+        write_fds[index] = fds[1];
+        ip_sched_spawn(sched, program, fds[0], instances[index].output,
+                       instance_exit, &(instances[index]));
+    }
+
+    /* Feed lines to the instances a round at a time, then close the pipes */
+    for (round = 0; round < NUM_ROUNDS; ++round) {
+        for (index = 0; index < NUM_INSTANCES; ++index) {
+            snprintf(line, sizeof(line), "Line %d\n", round);
+            if (write(write_fds[index], line, strlen(line)) < 0) {
+                perror("write");
+                exit(1);
+            }
+        }
+        usleep(1000);
+    }
+    for (index = 0; index < NUM_INSTANCES; ++index) {
+        close(write_fds[index]);
+    }
+    ip_sched_wait(sched);
+
+    /* Check the results */
+    expected[0] = '\0';
+    for (round = 0; round < NUM_ROUNDS; ++round) {
+        snprintf(line, sizeof(line), "Line %d\n", round);
+        strcat(expected, line);
+    }
+    strcat(expected, "5050\n");
+    for (index = 0; index < NUM_INSTANCES; ++index) {
+        exitval |= check_instance(&(instances[index]), expected);
+        free(instances[index].data);
+    }
+    if (ip_sched_park_count(sched) < NUM_INSTANCES) {
+        exitval = 1;
+    }
+    ip_sched_free(sched);
+    ip_program_free(program);
+    return exitval;
+}
+
+static int check_files(void)
+{
+    static char const input[] = "One\nTwo\nThree";
+    static char const expected[] = "One\nTwo\nThree\n5050\n";
+    instance_t instances[8];
+    ip_program_t *program;
+    ip_sched_t *sched;
+    FILE *file;
+    int index;
+    int exitval = 0;
+
+    program = parse(echo_program);
+    if (!program) {
+        return 1;
+    }
+    sched = ip_sched_new(2, 7);
+    if (!sched) {
+        ip_program_free(program);
+        return 1;
+    }
+
+    /* Regular files cannot be polled, so the instances should never park */
+    for (index = 0; index < 8; ++index) {
+        file = tmpfile();
+        if (!file) {
+            perror("tmpfile");
+            exit(1);
+        }
+        fputs(input, file);
+        fflush(file);
+        memset(&(instances[index]), 0, sizeof(instance_t));
+        instances[index].input_fd = dup(fileno(file));
+        fclose(file);
+        lseek(instances[index].input_fd, 0, SEEK_SET);
+        instances[index].output = open_memstream
+            (&(instances[index].data), &(instances[index].len));
+        ip_sched_spawn(sched, program, instances[index].input_fd,
+                       instances[index].output, instance_exit,
+                       &(instances[index]));
+    }
+    ip_sched_wait(sched);
+    for (index = 0; index < 8; ++index) {
+        exitval |= check_instance(&(instances[index]), expected);
+        free(instances[index].data);
+    }
+    if (ip_sched_park_count(sched) != 0) {
+        exitval = 1;
+    }
+    ip_sched_free(sched);
+    ip_program_free(program);
+    return exitval;
+}
+
+static int check_no_input(void)
+{
+    static char const expected[] = "5050\n";
+    instance_t instance;
+    ip_program_t *program;
+    ip_sched_t *sched;
+    int exitval = 0;
+
+    program = parse(echo_program);
+    if (!program) {
+        return 1;
+    }
+    sched = ip_sched_new(1, 1);
+    if (!sched) {
+        ip_program_free(program);
+        return 1;
+    }
+    memset(&instance, 0, sizeof(instance));
+    instance.input_fd = -1;
+    instance.output = open_memstream(&(instance.data), &(instance.len));
+    ip_sched_spawn(sched, program, -1, instance.output,
+                   instance_exit, &instance);
+    ip_sched_wait(sched);
+    exitval |= check_instance(&instance, expected);
+    free(instance.data);
+    ip_sched_free(sched);
+    ip_program_free(program);
+    return exitval;
+}
+
+int main(int argc, char **argv)
+{
+    int exitval = 0;
+
+    (void)argc;
+    (void)argv;
+
+#define RUN_TEST(name) \
+    do { \
+        printf(#name " ... "); \
+        fflush(stdout); \
+        if (name()) { \
+            printf("FAILED\n"); \
+            exitval = 1; \
+        } else { \
+            printf("ok\n"); \
+        } \
+    } while (0)
+
+    RUN_TEST(check_pipes);
+    RUN_TEST(check_files);
+    RUN_TEST(check_no_input);
+    return exitval;
+}
@@ -150,6 +150,7 @@ static int check_identifiers(void)
     KEYWORD("BY",                                   ITOK_BY);
     KEYWORD("SYMBOLS FOR ROUTINES",                 ITOK_SYMBOLS_ROUTINES);
     KEYWORD("AT END OF INPUT",                      ITOK_AT_END_OF_INPUT);
+    KEYWORD("FILL ARRAY WITH RANDOM NUMBERS",       ITOK_FILL_RANDOM);
 
     /* Check that we have tested all of the keywords */
     for (index = ITOK_FIRST_KEYWORD; index <= ITOK_LAST_KEYWORD; ++index) {
@@ -162,6 +163,60 @@ static int check_identifiers(void)
     return exitval;
 }
 
+static int check_lookup
+    (const char *name, int id, unsigned context)
+{
+    const ip_token_info_t *info;
+    info = ip_tokeniser_lookup_keyword(name, strlen(name), context);
+    if (id == 0) {
+        if (info) {
+            printf("\"%s\" should not be a keyword\n", name);
+            return 1;
+        }
+    } else if (!info || info->code != id) {
+        printf("\"%s\" should be 0x%02X\n", name, id);
+        return 1;
+    }
+    return 0;
+}
+
+static int check_keyword_matching(void)
+{
+    int exitval = 0;
+    const unsigned classic = ITOK_TYPE_ANY;
+    const unsigned extended = ITOK_TYPE_ANY | ITOK_TYPE_EXTENSION;
+
+    /* Case and whitespace between words are not significant */
+    exitval |= check_lookup("go to", ITOK_GO_TO, classic);
+    exitval |= check_lookup("Go \t  To", ITOK_GO_TO, classic);
+    exitval |= check_lookup("punch  the following\tcharacters", ITOK_PUNCH, classic);
+
+    /* Prefixes, extensions, and trailing whitespace do not match */
+    exitval |= check_lookup("GO", 0, extended);
+    exitval |= check_lookup("GO TO ", 0, extended);
+    exitval |= check_lookup("GOTO", 0, extended);
+    exitval |= check_lookup("GREATER THAN OR", 0, extended);
+    exitval |= check_lookup("GREATER THAN OR EQUAL TOO", 0, extended);
+    exitval |= check_lookup("SETS", 0, extended);
+    exitval |= check_lookup(" SET", 0, extended);
+
+    /* Extension keywords are only recognised in the extended dialect */
+    exitval |= check_lookup("CALL", 0, classic);
+    exitval |= check_lookup("CALL", ITOK_CALL, extended);
+    exitval |= check_lookup("GREATER THAN OR EQUAL TO", 0, classic);
+    exitval |= check_lookup("GREATER THAN OR EQUAL TO", ITOK_GREATER_OR_EQUAL, extended);
+    exitval |= check_lookup("/", 0, classic);
+    exitval |= check_lookup("/", ITOK_DIV, extended);
+
+    /* Punctuation must match exactly, and the first "*" entry wins */
+    exitval |= check_lookup("(1)", ITOK_PRELIM_1, classic);
+    exitval |= check_lookup("( 1)", 0, classic);
+    exitval |= check_lookup("*", ITOK_LABEL, classic);
+    exitval |= check_lookup("*", ITOK_LABEL, extended);
+
+    return exitval;
+}
+
 typedef struct
 {
     const char *data;
@@ -215,6 +270,34 @@ static int check_lexer(const char *str, int token, unsigned context)
     return !ok;
 }
 
+static int check_routine_lexer
+    (const char *str, int token, const char *name)
+{
+    test_stream_t stream;
+    ip_tokeniser_t tokeniser;
+    unsigned context = ITOK_TYPE_STATEMENT | ITOK_TYPE_EXTENSION;
+    int ok = 0;
+
+    test_stream_init(&stream, str);
+
+    ip_tokeniser_init(&tokeniser);
+    tokeniser.read_char = test_stream_read;
+    tokeniser.user_data = &stream;
+    tokeniser.filename = "dummy.ip";
+    ip_tokeniser_register_routine_name(&tokeniser, "FORM ARCCOS");
+    ip_tokeniser_register_routine_name(&tokeniser, "FORM ARCCOS TWICE");
+    ip_tokeniser_register_routine_name(&tokeniser, "GO TO MARS");
+    ip_tokeniser_register_routine_name(&tokeniser, "SINGLE");
+
+    if (ip_tokeniser_get_next(&tokeniser, context) == token &&
+            !strcmp(tokeniser.token_info->name, name)) {
+        ok = 1;
+    }
+
+    ip_tokeniser_free(&tokeniser);
+    return !ok;
+}
+
 int main(int argc, char **argv)
 {
     int exitval = 0;
@@ -246,6 +329,30 @@ int main(int argc, char **argv)
     } while (0)
 
     RUN_TEST(check_identifiers);
+    RUN_TEST(check_keyword_matching);
+
+#define RUN_ROUTINE_TEST(str, token, name) \
+    do { \
+        printf("check_routine_lexer[%s] ... ", (str)); \
+        fflush(stdout); \
+        if (check_routine_lexer((str), (token), (name))) { \
+            printf("FAILED\n"); \
+            exitval = 1; \
+        } else { \
+            printf("ok\n"); \
+        } \
+    } while (0)
+
+    /* The longest registered routine name or keyword wins */
+    RUN_ROUTINE_TEST("form arccos", ITOK_ROUTINE_NAME, "FORM ARCCOS");
+    RUN_ROUTINE_TEST("FORM  ARCCOS 0.5", ITOK_ROUTINE_NAME, "FORM ARCCOS");
+    RUN_ROUTINE_TEST("Form Arccos\tTwice", ITOK_ROUTINE_NAME, "FORM ARCCOS TWICE");
+    RUN_ROUTINE_TEST("FORM ARCCOS THRICE", ITOK_ROUTINE_NAME, "FORM ARCCOS");
+    RUN_ROUTINE_TEST("FORM", ITOK_VAR_NAME, "FORM");
+    RUN_ROUTINE_TEST("FORMARCCOS", ITOK_VAR_NAME, "FORMARCCOS");
+    RUN_ROUTINE_TEST("SINGLE", ITOK_VAR_NAME, "SINGLE");
+    RUN_ROUTINE_TEST("GO TO MARS", ITOK_ROUTINE_NAME, "GO TO MARS");
+    RUN_ROUTINE_TEST("GO TO VENUS", ITOK_GO_TO, "GO TO");
 
     RUN_LEXER_TEST("var", ITOK_VAR_NAME, ITOK_TYPE_EXPRESSION);
     RUN_LEXER_TEST("DIVIDE BY", ITOK_DIVIDE, ITOK_TYPE_STATEMENT);